@@ -276,6 +276,33 @@ void audit_symbols_add(struct cmd_args *args, const char **groupnames,
     free(filepath);
 }
 
+void audit_symbols_cap(struct cmd_args *args, const char **groupnames,
+        char **error){
+    char *megabytes = argcopy(args, groupnames[0]);
+
+    if(!megabytes){
+        concat(error, "need a limit in megabytes");
+        return;
+    }
+
+    if(strlen(megabytes) > 7)
+        concat(error, "limit is too big");
+
+    free(megabytes);
+}
+
+void audit_symbols_path(struct cmd_args *args, const char **groupnames,
+        char **error){
+    char *dir = argcopy(args, groupnames[0]);
+
+    if(!dir){
+        concat(error, "need a directory");
+        return;
+    }
+
+    free(dir);
+}
+
 void audit_thread_list(struct cmd_args *args, const char **groupnames,
         char **error){
     if(debuggee->pid == -1){
@@ -21,6 +21,8 @@ void audit_signal_deliver(struct cmd_args *, const char **, char **);
 void audit_step_inst_into(struct cmd_args *, const char **, char **);
 void audit_step_inst_over(struct cmd_args *, const char **, char **);
 void audit_symbols_add(struct cmd_args *, const char **, char **);
+void audit_symbols_cap(struct cmd_args *, const char **, char **);
+void audit_symbols_path(struct cmd_args *, const char **, char **);
 void audit_thread_list(struct cmd_args *, const char **, char **);
 void audit_thread_select(struct cmd_args *, const char **, char **);
 void audit_watchpoint_set(struct cmd_args *, const char **, char **);
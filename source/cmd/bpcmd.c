@@ -1,5 +1,7 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bpcmd.h"
 
@@ -10,6 +12,9 @@
 #include "../linkedlist.h"
 #include "../strext.h"
 
+#include "../symbol/dwarfreg.h"
+#include "../symbol/sym.h"
+
 enum cmd_error_t cmdfunc_breakpoint_delete(struct cmd_args *args,
         int arg1, char **outbuffer, char **error){
     if(debuggee->num_breakpoints == 0){
@@ -95,6 +100,52 @@ enum cmd_error_t cmdfunc_breakpoint_list(struct cmd_args *args,
     return CMD_SUCCESS;
 }
 
+/* Is location of the form file:line? */
+static int is_source_location(char *location, char **colonout){
+    char *colon = strrchr(location, ':');
+
+    if(!colon || colon == location || *(colon + 1) == '\0')
+        return 0;
+
+    for(char *p = colon + 1; *p; p++){
+        if(!isdigit(*p))
+            return 0;
+    }
+
+    *colonout = colon;
+
+    return 1;
+}
+
+/* A line can be compiled to more than one place (inlined, templates,
+ * a header included by several files), so this gives back every
+ * address it has. The caller frees *pcsout.
+ */
+static int source_location_to_addresses(char *location, char *colon,
+        uint64_t **pcsout, int *numpcsout, char **outbuffer, char **error){
+    if(!debuggee->has_dwarf_debug_info()){
+        concat(error, "no debug info, load some with 'symbols add'");
+        return 1;
+    }
+
+    *colon = '\0';
+
+    uint64_t lineno = strtoull(colon + 1, NULL, 10);
+    sym_error_t sym_err = {0};
+
+    int failed = dwarfreg_lineno_to_pcs(location, &lineno, pcsout,
+            numpcsout, outbuffer, &sym_err);
+
+    if(failed){
+        concat(error, "%s:%s: %s", location, colon + 1,
+                sym_strerror(sym_err));
+    }
+
+    *colon = ':';
+
+    return failed;
+}
+
 enum cmd_error_t cmdfunc_breakpoint_set(struct cmd_args *args, 
         int arg1, char **outbuffer, char **error){
     char *thread_str = argcopy(args, BREAKPOINT_SET_COMMAND_REGEX_GROUPS[0]);
@@ -126,18 +177,39 @@ enum cmd_error_t cmdfunc_breakpoint_set(struct cmd_args *args,
     char *location_str = argcopy(args, BREAKPOINT_SET_COMMAND_REGEX_GROUPS[1]);
 
     while(location_str){
-        char *e = NULL;
-        long location = eval_expr(location_str, &e);
-
-        if(e)
-            concat(outbuffer, "warning: could not set breakpoint: %s\n", e);
+        char *e = NULL, *colon = NULL;
+
+        if(is_source_location(location_str, &colon)){
+            uint64_t *pcs = NULL;
+            int numpcs = 0;
+
+            if(source_location_to_addresses(location_str, colon, &pcs,
+                        &numpcs, outbuffer, &e) == 0){
+                for(int i=0; i<numpcs; i++){
+                    breakpoint_at_address((long)pcs[i], BP_NO_TEMP, thread,
+                            outbuffer, &e);
+
+                    if(e){
+                        concat(outbuffer,
+                                "warning: could not set breakpoint: %s\n", e);
+                        free(e);
+                        e = NULL;
+                    }
+                }
+
+                free(pcs);
+            }
+        }
         else{
-            breakpoint_at_address(location, BP_NO_TEMP, thread, outbuffer, &e);
+            long location = eval_expr(location_str, &e);
 
-            if(e)
-                concat(outbuffer, "warning: could not set breakpoint: %s\n", e);
+            if(!e)
+                breakpoint_at_address(location, BP_NO_TEMP, thread, outbuffer, &e);
         }
 
+        if(e)
+            concat(outbuffer, "warning: could not set breakpoint: %s\n", e);
+
         free(e);
         free(location_str);
 
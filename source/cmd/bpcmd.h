@@ -35,6 +35,8 @@ static const char *BREAKPOINT_SET_COMMAND_DOCUMENTATION =
     "\nMandatory arguments:\n"
     "\tlocation\n"
     "\t\tThis expression will used as the location for the breakpoint.\n"
+    "\t\tIf debug info has been loaded, it can also be a source\n"
+    "\t\tlocation, like 'main.c:42'.\n"
     "\t\tThis command accepts an arbitrary amount of this argument.\n"
     "\n"
     "\nOptional arguments:\n"
@@ -53,7 +55,7 @@ static const char *BREAKPOINT_DELETE_COMMAND_REGEX =
     "(?<ids>[\\d\\s]+)?";
 
 static const char *BREAKPOINT_SET_COMMAND_REGEX =
-    "(--t\\s+(?<tid>(0[xX])?[[:xdigit:]]+)\\s+)?(?<locations>[\\w+\\-*\\/\\$()]+)";
+    "(--t\\s+(?<tid>(0[xX])?[[:xdigit:]]+)\\s+)?(?<locations>[\\w+\\-*\\/\\$().:]+)";
 
 /*
  * Regex groups
@@ -195,8 +195,8 @@ void initialize_commands(void){
 
     struct dbg_cmd *backtrace = create_parent_cmd("backtrace",
             "bt", BACKTRACE_COMMAND_DOCUMENTATION, _AT_LEVEL(0),
-            NO_ARGUMENT_REGEX, _NUM_GROUPS(0), _UNK_ARGS(0),
-            NO_GROUPS, _NUM_SUBCMDS(0), cmdfunc_backtrace,
+            BACKTRACE_COMMAND_REGEX, _NUM_GROUPS(1), _UNK_ARGS(0),
+            BACKTRACE_COMMAND_REGEX_GROUPS, _NUM_SUBCMDS(0), cmdfunc_backtrace,
             audit_backtrace);
 
     ADD_CMD(backtrace);
@@ -392,15 +392,33 @@ void initialize_commands(void){
     struct dbg_cmd *symbols = create_parent_cmd("symbols",
             NULL, SYMBOLS_COMMAND_DOCUMENTATION, _AT_LEVEL(0),
             NO_ARGUMENT_REGEX, _NUM_GROUPS(0), _UNK_ARGS(0),
-            NO_GROUPS, _NUM_SUBCMDS(1), NULL, NULL);
+            NO_GROUPS, _NUM_SUBCMDS(4), NULL, NULL);
     {
         struct dbg_cmd *add = create_child_cmd("add",
                 NULL, SYMBOLS_ADD_COMMAND_DOCUMENTATION, _AT_LEVEL(1),
                 SYMBOLS_ADD_COMMAND_REGEX, _NUM_GROUPS(1), _UNK_ARGS(0),
                 SYMBOLS_ADD_COMMAND_REGEX_GROUPS, cmdfunc_symbols_add,
                 audit_symbols_add);
+        struct dbg_cmd *cap = create_child_cmd("cap",
+                NULL, SYMBOLS_CAP_COMMAND_DOCUMENTATION, _AT_LEVEL(1),
+                SYMBOLS_CAP_COMMAND_REGEX, _NUM_GROUPS(1), _UNK_ARGS(0),
+                SYMBOLS_CAP_COMMAND_REGEX_GROUPS, cmdfunc_symbols_cap,
+                audit_symbols_cap);
+        struct dbg_cmd *list = create_child_cmd("list",
+                NULL, SYMBOLS_LIST_COMMAND_DOCUMENTATION, _AT_LEVEL(1),
+                NO_ARGUMENT_REGEX, _NUM_GROUPS(0), _UNK_ARGS(0),
+                NO_GROUPS, cmdfunc_symbols_list,
+                NULL);
+        struct dbg_cmd *path = create_child_cmd("path",
+                NULL, SYMBOLS_PATH_COMMAND_DOCUMENTATION, _AT_LEVEL(1),
+                SYMBOLS_PATH_COMMAND_REGEX, _NUM_GROUPS(1), _UNK_ARGS(0),
+                SYMBOLS_PATH_COMMAND_REGEX_GROUPS, cmdfunc_symbols_path,
+                audit_symbols_path);
 
         symbols->subcmds[0] = add;
+        symbols->subcmds[1] = cap;
+        symbols->subcmds[2] = list;
+        symbols->subcmds[3] = path;
     }
 
     ADD_CMD(symbols);
@@ -36,8 +36,10 @@
 #include "../watchpoint.h"
 
 #include "../symbol/dbgsymbol.h"
+#include "../symbol/dbgunwind.h"
 #include "../symbol/image.h"
 #include "../symbol/sym.h"
+#include "../symbol/symloader.h"
 
 int KEEP_CHECKING_FOR_PROCESS;
 
@@ -259,6 +261,8 @@ enum cmd_error_t cmdfunc_attach(struct cmd_args *args,
     if(DSCDATA){
         if(initialize_debuggee_dyld_all_image_infos())
             concat(outbuffer, "%s", dscwarnmsg);
+        else
+            symloader_start(SL_REGISTRY | SL_SYMBOLS | SL_DWARF);
     }
 
     char *nosigs = argcopy(args, ATTACH_COMMAND_REGEX_GROUPS[2]);
@@ -276,6 +280,37 @@ enum cmd_error_t cmdfunc_attach(struct cmd_args *args,
     return CMD_SUCCESS;
 }
 
+/* One line for vmaddr, or one for every function inlined at vmaddr
+ * and one for the function they were inlined into.
+ */
+static void describe_frames(unsigned long vmaddr, int *frame_counter,
+        char **outbuffer){
+    char **frstrs = NULL;
+    int numfrstrs = 0;
+
+    create_frame_strings(vmaddr, &frstrs, &numfrstrs);
+
+    for(int i=0; i<numfrstrs; i++){
+        if(*frame_counter == 0)
+            concat(outbuffer, "  * frame #0: 0x%16.16lx", vmaddr);
+        else{
+            concat(outbuffer, "%4sframe #%d: 0x%16.16lx", "",
+                    *frame_counter, vmaddr);
+        }
+
+        if(frstrs[i]){
+            concat(outbuffer, " %s", frstrs[i]);
+            free(frstrs[i]);
+        }
+
+        concat(outbuffer, "\n");
+
+        (*frame_counter)++;
+    }
+
+    free(frstrs);
+}
+
 enum cmd_error_t cmdfunc_backtrace(struct cmd_args *args, 
         int arg1, char **outbuffer, char **error){
     if(!debuggee->suspended()){
@@ -287,64 +322,36 @@ enum cmd_error_t cmdfunc_backtrace(struct cmd_args *args,
 
     get_thread_state(focused);
 
-    concat(outbuffer, "  * frame #0: 0x%16.16llx", focused->thread_state.__pc);
+    char *savepath = argcopy(args, BACKTRACE_COMMAND_REGEX_GROUPS[0]);
 
-    char *frstr = NULL;
-    create_frame_string(focused->thread_state.__pc, &frstr);
-        
-    if(frstr){
-        concat(outbuffer, " %s", frstr);
-        free(frstr);
-        frstr = NULL;
-    }
-
-    concat(outbuffer, "\n");
-    concat(outbuffer, "%4sframe #1: 0x%16.16llx", "", focused->thread_state.__lr);
-
-    create_frame_string(focused->thread_state.__lr, &frstr);
-
-    if(frstr){
-        concat(outbuffer, " %s", frstr);
-        free(frstr);
-        frstr = NULL;
-    }
-
-    concat(outbuffer, "\n");
-
-    struct frame {
-        struct frame *next;
-        unsigned long vmaddr;
-    } frame;
+    if(savepath){
+        if(save_unwind_snapshot(focused, savepath)){
+            concat(error, "could not save stack snapshot to '%s'", savepath);
+            free(savepath);
+            return CMD_FAILURE;
+        }
 
-    kern_return_t err = read_memory_at_location(focused->thread_state.__fp,
-            &frame, sizeof(frame));
-    
-    if(err){
-        concat(error, "backtrace failed: %s", mach_error_string(err));
-        return CMD_FAILURE;
+        concat(outbuffer, "Saved stack snapshot to '%s'\n", savepath);
+        free(savepath);
     }
 
-    int frame_counter = 2;
+    unsigned long *pcs = NULL;
+    int numpcs = 0;
 
-    while(frame.next){
-        concat(outbuffer, "%4sframe #%d: 0x%16.16lx", "", frame_counter, frame.vmaddr);
+    int incomplete = unwind_thread(focused, &pcs, &numpcs);
 
-        create_frame_string(frame.vmaddr, &frstr);
+    int frame_counter = 0;
 
-        if(frstr){
-            concat(outbuffer, " %s", frstr);
-            free(frstr);
-            frstr = NULL;
-        }
+    for(int i=0; i<numpcs; i++)
+        describe_frames(pcs[i], &frame_counter, outbuffer);
 
-        concat(outbuffer, "\n");
+    free(pcs);
 
-        read_memory_at_location((uintptr_t)frame.next, &frame, sizeof(frame)); 
-        frame_counter++;
+    if(incomplete){
+        concat(outbuffer, " - cannot unwind past frame %d -\n",
+                frame_counter - 1);
     }
 
-    concat(outbuffer, " - cannot unwind past frame %d -\n", frame_counter - 1);
-
     return CMD_SUCCESS;
 }
 
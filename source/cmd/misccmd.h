@@ -45,9 +45,15 @@ static const char *ATTACH_COMMAND_DOCUMENTATION =
 
 static const char *BACKTRACE_COMMAND_DOCUMENTATION =
     "Print a backtrace of the entire stack. All stack frames are printed.\n"
-    "This command has no arguments.\n"
+    "Frames are unwound with each function's compact unwind or CFI, so\n"
+    "leaf functions and code built without frame pointers come out right.\n"
+    "This command has no mandatory arguments and one optional argument.\n"
+    "\nOptional arguments:\n"
+    "\t--save path\n"
+    "\t\tAlso save the registers, stack, and unwind info to path, so\n"
+    "\t\tthe unwind can be replayed with unwbench.\n"
     "\nSyntax:\n"
-    "\tbacktrace\n"
+    "\tbacktrace --save path?\n"
     "\n";
 
 static const char *CONTINUE_COMMAND_DOCUMENTATION =
@@ -124,6 +130,9 @@ static const char *ATTACH_COMMAND_REGEX =
     "^\\s*((\"(?<target>.*)\")|"
     "(?!.*\")(?<target>\\w+)))(\\s+(?<nosigs>--ns))?";
 
+static const char *BACKTRACE_COMMAND_REGEX =
+    "(--save\\s+(?<path>[^\\s]+))?";
+
 static const char *EVALUATE_COMMAND_REGEX =
     "(?<expr>[^\\s]+)";
 
@@ -136,6 +145,9 @@ static const char *HELP_COMMAND_REGEX =
 static const char *ATTACH_COMMAND_REGEX_GROUPS[MAX_GROUPS] =
     { "waitfor", "target", "nosigs" };
 
+static const char *BACKTRACE_COMMAND_REGEX_GROUPS[MAX_GROUPS] =
+    { "path" };
+
 static const char *EVALUATE_COMMAND_REGEX_GROUPS[MAX_GROUPS] =
     { "expr" };
 
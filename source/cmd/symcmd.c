@@ -3,7 +3,10 @@
 
 #include "symcmd.h"
 
+#include "../symbol/dbgsymbol.h"
+#include "../symbol/dwarfreg.h"
 #include "../symbol/sym.h"
+#include "../symbol/symloader.h"
 
 #include "../debuggee.h"
 #include "../strext.h"
@@ -11,14 +14,74 @@
 enum cmd_error_t cmdfunc_symbols_add(struct cmd_args *args, int arg1,
         char **outbuffer, char **error){
     char *filepath = argcopy(args, SYMBOLS_ADD_COMMAND_REGEX_GROUPS[0]);
+    char *imagename = NULL;
 
     sym_error_t sym_err = {0};
-    if(sym_init_with_dwarf_file(filepath, &debuggee->dwarfinfo, &sym_err)){
+    if(dwarfreg_add_dwarf_file(filepath, &imagename, &sym_err)){
         concat(error, "failed: %s\n", sym_strerror(sym_err));
+        free(filepath);
         return CMD_FAILURE;
     }
 
+    if(imagename){
+        concat(outbuffer, "%s: loading %s in the background\n", imagename,
+                filepath);
+        symloader_start(SL_DWARF);
+    }
+    else{
+        concat(outbuffer, "%s doesn't match any loaded image, it will be"
+                " used if one gets loaded\n", filepath);
+    }
+
+    free(imagename);
     free(filepath);
 
     return CMD_SUCCESS;
 }
+
+enum cmd_error_t cmdfunc_symbols_cap(struct cmd_args *args, int arg1,
+        char **outbuffer, char **error){
+    char *megabytes_str = argcopy(args, SYMBOLS_CAP_COMMAND_REGEX_GROUPS[0]);
+    uint64_t megabytes = strtoull(megabytes_str, NULL, 10);
+
+    free(megabytes_str);
+
+    dwarfreg_set_die_tree_cap(megabytes << 20);
+
+    if(megabytes == 0)
+        concat(outbuffer, "DIE trees are no longer limited\n");
+    else{
+        concat(outbuffer, "DIE trees limited to %llu MB per dSYM\n",
+                megabytes);
+    }
+
+    return CMD_SUCCESS;
+}
+
+enum cmd_error_t cmdfunc_symbols_list(struct cmd_args *args, int arg1,
+        char **outbuffer, char **error){
+    dwarfreg_describe(outbuffer);
+
+    if(debuggee->symbols){
+        unsigned long numimages = 0, numsyms = 0;
+        size_t bytes = 0;
+
+        get_symbol_memory_usage(&numimages, &numsyms, &bytes);
+
+        concat(outbuffer, "%lu symbols in %lu images, %zu KB of symbol"
+                " tables\n", numsyms, numimages, bytes / 1024);
+    }
+
+    return CMD_SUCCESS;
+}
+
+enum cmd_error_t cmdfunc_symbols_path(struct cmd_args *args, int arg1,
+        char **outbuffer, char **error){
+    char *dir = argcopy(args, SYMBOLS_PATH_COMMAND_REGEX_GROUPS[0]);
+
+    dwarfreg_add_search_path(dir);
+
+    free(dir);
+
+    return CMD_SUCCESS;
+}
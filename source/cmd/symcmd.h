@@ -4,6 +4,9 @@
 #include "argparse.h"
 
 enum cmd_error_t cmdfunc_symbols_add(struct cmd_args *, int, char **, char **);
+enum cmd_error_t cmdfunc_symbols_cap(struct cmd_args *, int, char **, char **);
+enum cmd_error_t cmdfunc_symbols_list(struct cmd_args *, int, char **, char **);
+enum cmd_error_t cmdfunc_symbols_path(struct cmd_args *, int, char **, char **);
 
 static const char *SYMBOLS_COMMAND_DOCUMENTATION =
     "'symbols' describes the group of commands which deal with DWARF"
@@ -11,6 +14,8 @@ static const char *SYMBOLS_COMMAND_DOCUMENTATION =
 
 static const char *SYMBOLS_ADD_COMMAND_DOCUMENTATION =
     "Specify a DWARF file for source level debugging. C language only.\n"
+    "It is used for whichever image has the same UUID, now and every time"
+    " you attach after this.\n"
     "This command has one mandatory arguments and no optional arguments.\n"
     "\nMandatory arguments:\n"
     "\tpath\n"
@@ -19,16 +24,68 @@ static const char *SYMBOLS_ADD_COMMAND_DOCUMENTATION =
     "\tsymbols add path\n"
     "\n";
 
+static const char *SYMBOLS_CAP_COMMAND_DOCUMENTATION =
+    "Limit how much memory the parsed DIE trees of each dSYM can take up."
+    " A compilation unit's DIE tree is parsed the first time something"
+    " asks about it. Past the limit, the trees used least recently are"
+    " thrown away and parsed again if they're needed. 0 means no limit,"
+    " which is the default.\n"
+    "This command has one mandatory argument and no optional arguments.\n"
+    "\nMandatory arguments:\n"
+    "\tmegabytes\n"
+    "\t\tThe limit, in megabytes.\n"
+    "\nSyntax:\n"
+    "\tsymbols cap megabytes\n"
+    "\n";
+
+static const char *SYMBOLS_LIST_COMMAND_DOCUMENTATION =
+    "List every image with a dSYM, whether it has been loaded yet, and"
+    " the dSYM search path. Also shows how many symbols the debuggee's"
+    " images have and how much memory their symbol tables take up.\n"
+    "This command has no mandatory arguments and no optional arguments.\n"
+    "\nSyntax:\n"
+    "\tsymbols list\n"
+    "\n";
+
+static const char *SYMBOLS_PATH_COMMAND_DOCUMENTATION =
+    "Add a directory to look for dSYMs in. For an image named Foo inside"
+    " Foo.app, both Foo.dSYM and Foo.app.dSYM are looked for. Directories"
+    " on the search path are looked in before the directory the image is"
+    " in. A dSYM is only used if its UUID matches the image's, and isn't"
+    " loaded until something needs it.\n"
+    "Images dyld loads after you attach, like ones from dlopen, are"
+    " matched with a dSYM the first time something asks about one of"
+    " their addresses or source files.\n"
+    "This command has one mandatory argument and no optional arguments.\n"
+    "\nMandatory arguments:\n"
+    "\tpath\n"
+    "\t\tThe directory.\n"
+    "\nSyntax:\n"
+    "\tsymbols path path\n"
+    "\n";
+
 /*
  * Regexes
  */
 static const char *SYMBOLS_ADD_COMMAND_REGEX =
     "(?<path>[\\.\\/\\w\\s]+)";
 
+static const char *SYMBOLS_CAP_COMMAND_REGEX =
+    "^\\s*(?<megabytes>\\d+)";
+
+static const char *SYMBOLS_PATH_COMMAND_REGEX =
+    "(?<path>[\\.\\/\\w\\s]+)";
+
 /*
  * Regex groups
  */
 static const char *SYMBOLS_ADD_COMMAND_REGEX_GROUPS[MAX_GROUPS] =
     { "path" };
 
+static const char *SYMBOLS_CAP_COMMAND_REGEX_GROUPS[MAX_GROUPS] =
+    { "megabytes" };
+
+static const char *SYMBOLS_PATH_COMMAND_REGEX_GROUPS[MAX_GROUPS] =
+    { "path" };
+
 #endif
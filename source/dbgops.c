@@ -22,7 +22,9 @@
 #include "watchpoint.h"
 
 #include "symbol/dbgsymbol.h"
-#include "symbol/sym.h"
+#include "symbol/dbgunwind.h"
+#include "symbol/dwarfreg.h"
+#include "symbol/symloader.h"
 
 void ops_printsiginfo(char **outbuffer){
     concat(outbuffer, "%-11s %-5s %-5s %-6s\n", "NAME", "PASS", "STOP", "NOTIFY");
@@ -158,16 +160,18 @@ void ops_detach(int from_death, char **outbuffer){
     void_convvar("$__");
     void_convvar("$ASLR");
 
+    /* The loader could still be filling in what's freed below */
+    symloader_stop();
+
     destroy_all_symbol_entries();
+    unwinder_end();
 
     if(debuggee->symbols){
         linkedlist_free(debuggee->symbols);
         debuggee->symbols = NULL;
     }
 
-    sym_end(debuggee->dwarfinfo);
-    free(debuggee->dwarfinfo);
-    debuggee->dwarfinfo = NULL;
+    dwarfreg_end();
 
     reset_unnamed_sym_cnt();
 
@@ -15,9 +15,6 @@ struct debuggee {
     /* PID of the debuggee. */
     pid_t pid;
 
-    /* dwarfinfo pointer for the debuggee. */
-    void *dwarfinfo;
-
     /* dyld_all_image_infos pointer for the debuggee. */
     struct dyld_all_image_infos dyld_all_image_infos;
 
@@ -27,6 +24,9 @@ struct debuggee {
     /* List of symbols for the debuggee. */
     struct linkedlist *symbols;
 
+    /* Every symbol in symbols, sorted by address. Set before symbols. */
+    struct symtable *symtable;
+
     /* If this variable is non-zero, tracing is not supported. */
     int tracing_disabled;
 
@@ -8,6 +8,9 @@
 #include "strext.h"
 #include "thread.h"
 
+#include "symbol/dwarfreg.h"
+#include "symbol/symloader.h"
+
 unsigned long find_slide(void){
     kern_return_t err = KERN_SUCCESS;
     vm_address_t addr = 0;
@@ -167,7 +170,10 @@ kern_return_t get_threads(thread_act_port_array_t *threads,
 }
 
 int has_dwarf_debug_info(void){
-    return debuggee->dwarfinfo != NULL;
+    /* Finding dSYMs is quick, so wait for it rather than say no */
+    symloader_wait(SL_REGISTRY);
+
+    return dwarfreg_has_dwarf();
 }
 
 int suspended(void){
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable.h"
+
+static const unsigned long STARTING_CAPACITY = 16;
+
+static unsigned long hash_key(unsigned long key, unsigned long capacity){
+    /* Fibonacci hashing spreads out sequential keys, like DIE offsets */
+    return (key * 0x9e3779b97f4a7c15UL) & (capacity - 1);
+}
+
+static struct hashtable_entry *find_slot(struct hashtable_entry *entries,
+        unsigned long capacity, unsigned long key){
+    unsigned long idx = hash_key(key, capacity);
+
+    while(entries[idx].used && entries[idx].key != key)
+        idx = (idx + 1) & (capacity - 1);
+
+    return &entries[idx];
+}
+
+static void grow(struct hashtable *h){
+    unsigned long newcapacity = h->capacity * 2;
+    struct hashtable_entry *newentries =
+        calloc(newcapacity, sizeof(struct hashtable_entry));
+
+    for(unsigned long i=0; i<h->capacity; i++){
+        struct hashtable_entry *e = &h->entries[i];
+
+        if(!e->used)
+            continue;
+
+        *find_slot(newentries, newcapacity, e->key) = *e;
+    }
+
+    free(h->entries);
+
+    h->entries = newentries;
+    h->capacity = newcapacity;
+}
+
+int hashtable_destroy(struct hashtable **h){
+    if(!h || !(*h))
+        return HASHTABLE_NULL;
+
+    free((*h)->entries);
+    free(*h);
+    *h = NULL;
+
+    return HASHTABLE_OK;
+}
+
+int hashtable_get(struct hashtable *h, unsigned long key, void **valueout){
+    if(!h)
+        return HASHTABLE_NULL;
+
+    struct hashtable_entry *e = find_slot(h->entries, h->capacity, key);
+
+    if(!e->used)
+        return HASHTABLE_KEY_NOT_FOUND;
+
+    if(valueout)
+        *valueout = e->value;
+
+    return HASHTABLE_OK;
+}
+
+/* If key is already present, its value is replaced. */
+int hashtable_insert(struct hashtable *h, unsigned long key, void *value){
+    if(!h)
+        return HASHTABLE_NULL;
+
+    if((h->len + 1) * 4 > h->capacity * 3)
+        grow(h);
+
+    struct hashtable_entry *e = find_slot(h->entries, h->capacity, key);
+
+    if(!e->used){
+        e->used = 1;
+        e->key = key;
+        h->len++;
+    }
+
+    e->value = value;
+
+    return HASHTABLE_OK;
+}
+
+/* FNV-1a */
+unsigned long hashtable_strhash(const char *str){
+    unsigned long hash = 0xcbf29ce484222325UL;
+
+    while(*str){
+        hash ^= (unsigned char)*str++;
+        hash *= 0x100000001b3UL;
+    }
+
+    return hash;
+}
+
+struct hashtable *hashtable_new(void){
+    struct hashtable *h = malloc(sizeof(struct hashtable));
+
+    h->len = 0;
+    h->capacity = STARTING_CAPACITY;
+    h->entries = calloc(h->capacity, sizeof(struct hashtable_entry));
+
+    return h;
+}
@@ -0,0 +1,34 @@
+#ifndef _HASHTABLE_H_
+#define _HASHTABLE_H_
+
+struct hashtable_entry {
+    unsigned long key;
+    void *value;
+    int used;
+};
+
+/* Open addressing, linear probing. Keys are integers, so anything
+ * else (strings, tuples) has to be hashed or packed into one first.
+ */
+struct hashtable {
+    struct hashtable_entry *entries;
+
+    /* how many entries are in use */
+    unsigned long len;
+
+    /* Always a power of two. Doubles once the table is 3/4 full. */
+    unsigned long capacity;
+};
+
+enum {
+    HASHTABLE_OK = 0, HASHTABLE_NULL, HASHTABLE_KEY_NOT_FOUND
+};
+
+int hashtable_destroy(struct hashtable **);
+int hashtable_get(struct hashtable *, unsigned long, void **);
+int hashtable_insert(struct hashtable *, unsigned long, void *);
+unsigned long hashtable_strhash(const char *);
+
+struct hashtable *hashtable_new(void);
+
+#endif
@@ -26,6 +26,8 @@
 #include "cmd/completer.h"  /* For IS_HELP_COMMAND */
 #include "cmd/misccmd.h"    /* For KEEP_CHECKING_FOR_PROCESS */
 
+#include "symbol/symloader.h"
+
 struct debuggee *debuggee = NULL;
 
 char **bsd_syscalls = NULL, **mach_traps = NULL, **mach_traps2 = NULL;
@@ -440,9 +442,38 @@ static void linecb(char *line){
     free(line);
 }
 
+static const char *PROMPT = "\033[2m(iosdbg) \033[0m";
+
+/* While symbols load in the background, the prompt says how far
+ * along they are. Returns non-zero if they still are.
+ */
+static int update_prompt(void){
+    static int showing_progress = 0;
+
+    char progress[64];
+    int busy = symloader_get_progress(progress, sizeof(progress));
+
+    if(!busy && !showing_progress)
+        return 0;
+
+    if(busy){
+        char *prompt = NULL;
+        concat(&prompt, "\033[2m(iosdbg: %s) \033[0m", progress);
+        rl_set_prompt(prompt);
+        free(prompt);
+    }
+    else{
+        rl_set_prompt(PROMPT);
+    }
+
+    showing_progress = busy;
+    rl_redisplay();
+
+    return busy;
+}
+
 static void inputloop(void){
-    static const char *prompt = "\033[2m(iosdbg) \033[0m";
-    rl_callback_handler_install(prompt, linecb);
+    rl_callback_handler_install(PROMPT, linecb);
 
     while(1){
         fd_set read_fds;
@@ -450,7 +481,10 @@ static void inputloop(void){
         FD_SET(fileno(rl_instream), &read_fds);
         FD_SET(IOSDBG_IO_PIPE[0], &read_fds);
 
-        int ret = select(FD_SETSIZE, &read_fds, NULL, NULL, NULL);
+        /* Wake up now and then to move the progress along */
+        struct timeval progress_interval = { 0, 250000 };
+        int ret = select(FD_SETSIZE, &read_fds, NULL, NULL,
+                update_prompt() ? &progress_interval : NULL);
 
         if(ret < 0){
             if(errno != EINTR){
@@ -53,7 +53,7 @@ kern_return_t disassemble_at_location(unsigned long location, int num_instrs,
     char *current_fxn = NULL;
 
     if(debuggee->symbols){
-        get_symbol_info_from_address(debuggee->symbols, location,
+        get_symbol_info_from_address(debuggee->symtable, location,
                 NULL, &current_fxn, NULL);
     }
 
@@ -187,7 +187,7 @@ kern_return_t disassemble_at_location(unsigned long location, int num_instrs,
 
         if(debuggee->symbols){
             free(previous_fxn);
-            get_symbol_info_from_address(debuggee->symbols, current_location,
+            get_symbol_info_from_address(debuggee->symtable, current_location,
                     NULL, &previous_fxn, NULL);
         }
 
@@ -195,7 +195,7 @@ kern_return_t disassemble_at_location(unsigned long location, int num_instrs,
 
         if(debuggee->symbols){
             free(current_fxn);
-            get_symbol_info_from_address(debuggee->symbols, current_location,
+            get_symbol_info_from_address(debuggee->symtable, current_location,
                     NULL, &current_fxn, NULL);
         }
     }
@@ -0,0 +1,756 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <dwarf.h>
+#include <libdwarf.h>
+
+#include "../hashtable.h"
+#include "../linkedlist.h"
+
+#include "common.h"
+#include "compunit.h"
+#include "objfile.h"
+
+/* Global name lookups. Apple's linker emits hashed name tables into
+ * the dSYM (.apple_names, .apple_types, .apple_objc) and DWARF 5 has
+ * .debug_names, so the DIE offsets for a name can be looked up
+ * without parsing .debug_info at all. If neither is present, we walk
+ * every compilation unit once and hash the names ourselves.
+ *
+ * libdwarf doesn't give out raw section contents, so the DWARF file
+ * is mapped and its sections are found with objfile.c.
+ */
+
+struct section {
+    const uint8_t *s_data;
+    uint64_t s_size;
+};
+
+enum {
+    APPLE_ATOM_DIE_OFFSET = 1
+};
+
+#define APPLE_HASH_MAGIC        (0x48415348)
+#define APPLE_MAX_ATOMS         (8)
+#define NO_BUCKET               (0xffffffff)
+
+/* One of .apple_names, .apple_types, or .apple_objc */
+struct appletable {
+    struct section at_sect;
+
+    uint32_t at_bucketcnt;
+    uint32_t at_hashcnt;
+
+    const uint32_t *at_buckets;
+    const uint32_t *at_hashes;
+    const uint32_t *at_offsets;
+
+    uint32_t at_dieoffsetbase;
+
+    int at_numatoms;
+    uint16_t at_atomtypes[APPLE_MAX_ATOMS];
+    uint16_t at_atomforms[APPLE_MAX_ATOMS];
+};
+
+#define DEBUG_NAMES_MAX_ABBREV_ATTRS    (8)
+
+struct dnabbrev {
+    uint64_t dna_code;
+    int dna_numattrs;
+    uint64_t dna_idx[DEBUG_NAMES_MAX_ABBREV_ATTRS];
+    uint64_t dna_form[DEBUG_NAMES_MAX_ABBREV_ATTRS];
+};
+
+/* One name index from .debug_names */
+struct dnindex {
+    uint32_t dn_cucnt;
+    const uint32_t *dn_cuoffsets;
+
+    uint32_t dn_bucketcnt;
+    uint32_t dn_namecnt;
+
+    const uint32_t *dn_buckets;
+    const uint32_t *dn_hashes;
+    const uint32_t *dn_stroffsets;
+    const uint32_t *dn_entryoffsets;
+
+    struct dnabbrev *dn_abbrevs;
+    int dn_numabbrevs;
+
+    const uint8_t *dn_entrypool;
+    const uint8_t *dn_end;
+};
+
+/* Built ourselves when there are no accelerator tables. Only the DIE
+ * offset is kept, names are checked against the DIE on lookup.
+ */
+struct accelname {
+    uint64_t an_dieoffset;
+    /* Index of the next name with the same hash, or -1 */
+    int an_next;
+};
+
+struct accel {
+    dwarfinfo_t *ac_dwarfinfo;
+
+    void *ac_map;
+    size_t ac_mapsize;
+
+    struct section ac_debugstr;
+
+    struct appletable ac_appletables[3];
+    int ac_numappletables;
+
+    struct dnindex *ac_dnindexes;
+    int ac_numdnindexes;
+
+    int ac_fallbackbuilt;
+    struct hashtable *ac_fallback;
+    struct accelname *ac_fallbacknames;
+    int ac_numfallbacknames;
+};
+
+static uint32_t djb_hash(const char *str, int casefold){
+    uint32_t hash = 5381;
+
+    for(; *str; str++){
+        unsigned char c = (unsigned char)*str;
+
+        if(casefold && c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+
+        hash = (hash << 5) + hash + c;
+    }
+
+    return hash;
+}
+
+static int in_bounds(struct section *s, const uint8_t *p, uint64_t len){
+    return p >= s->s_data && p + len <= s->s_data + s->s_size;
+}
+
+static uint64_t read_uleb(const uint8_t **p, const uint8_t *end){
+    uint64_t result = 0;
+    int shift = 0;
+
+    while(*p < end){
+        uint8_t byte = *(*p)++;
+
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+
+        if(!(byte & 0x80))
+            break;
+    }
+
+    return result;
+}
+
+/* Returns how much data a value of the given form takes up, or -1 if
+ * it's variable length. Only forms accelerator tables use.
+ */
+static int form_size(uint64_t form){
+    switch(form){
+        case DW_FORM_flag_present:
+            return 0;
+        case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag:
+            return 1;
+        case DW_FORM_data2: case DW_FORM_ref2:
+            return 2;
+        case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_strp:
+            return 4;
+        case DW_FORM_data8: case DW_FORM_ref8:
+            return 8;
+        default:
+            return -1;
+    }
+}
+
+static uint64_t read_form(const uint8_t **p, const uint8_t *end,
+        uint64_t form){
+    int sz = form_size(form);
+
+    if(sz == -1)
+        return read_uleb(p, end);
+
+    if(*p + sz > end){
+        *p = end;
+        return 0;
+    }
+
+    uint64_t value = 0;
+    memcpy(&value, *p, sz);
+    *p += sz;
+
+    return value;
+}
+
+static int find_section(struct accel *ac, const char *name,
+        struct section *out){
+    return obj_find_section(ac->ac_map, ac->ac_mapsize, name,
+            &out->s_data, &out->s_size);
+}
+
+static const char *debug_str_at(struct accel *ac, uint64_t offset){
+    if(offset >= ac->ac_debugstr.s_size)
+        return NULL;
+
+    return (const char *)ac->ac_debugstr.s_data + offset;
+}
+
+
+static int parse_apple_table(struct section *sect, struct appletable *at){
+    const uint8_t *p = sect->s_data;
+
+    /* magic, version, hash function, bucket count, hashes count,
+     * header data length, die offset base, atom count
+     */
+    if(!in_bounds(sect, p, 28))
+        return 1;
+
+    uint32_t magic, headerdatalen, numatoms;
+
+    memcpy(&magic, p, 4);
+
+    if(magic != APPLE_HASH_MAGIC)
+        return 1;
+
+    memcpy(&at->at_bucketcnt, p + 8, 4);
+    memcpy(&at->at_hashcnt, p + 12, 4);
+    memcpy(&headerdatalen, p + 16, 4);
+    memcpy(&at->at_dieoffsetbase, p + 20, 4);
+    memcpy(&numatoms, p + 24, 4);
+
+    const uint8_t *atoms = p + 28;
+
+    if(numatoms > APPLE_MAX_ATOMS || !in_bounds(sect, atoms, numatoms * 4))
+        return 1;
+
+    at->at_numatoms = numatoms;
+
+    for(uint32_t i=0; i<numatoms; i++){
+        memcpy(&at->at_atomtypes[i], atoms + (i * 4), 2);
+        memcpy(&at->at_atomforms[i], atoms + (i * 4) + 2, 2);
+    }
+
+    const uint8_t *tables = p + 20 + headerdatalen;
+    uint64_t tablesz = ((uint64_t)at->at_bucketcnt * 4) +
+        ((uint64_t)at->at_hashcnt * 8);
+
+    if(at->at_bucketcnt == 0 || !in_bounds(sect, tables, tablesz))
+        return 1;
+
+    at->at_buckets = (const uint32_t *)tables;
+    at->at_hashes = at->at_buckets + at->at_bucketcnt;
+    at->at_offsets = at->at_hashes + at->at_hashcnt;
+    at->at_sect = *sect;
+
+    return 0;
+}
+
+static void add_offset(uint64_t **offsets, int *len, uint64_t offset){
+    for(int i=0; i<*len; i++){
+        if((*offsets)[i] == offset)
+            return;
+    }
+
+    uint64_t *offsets_rea = realloc(*offsets, sizeof(uint64_t) * ++(*len));
+    *offsets = offsets_rea;
+    (*offsets)[(*len) - 1] = offset;
+}
+
+static void lookup_apple_table(struct accel *ac, struct appletable *at,
+        const char *name, uint64_t **offsets, int *len){
+    uint32_t hash = djb_hash(name, 0);
+    uint32_t bucket = hash % at->at_bucketcnt;
+    uint32_t idx = at->at_buckets[bucket];
+
+    if(idx == NO_BUCKET)
+        return;
+
+    const uint8_t *end = at->at_sect.s_data + at->at_sect.s_size;
+
+    for(; idx < at->at_hashcnt; idx++){
+        uint32_t curhash = at->at_hashes[idx];
+
+        if(curhash % at->at_bucketcnt != bucket)
+            return;
+
+        if(curhash != hash)
+            continue;
+
+        const uint8_t *p = at->at_sect.s_data + at->at_offsets[idx];
+
+        /* Each hash's data is a list of (name, DIE count, DIEs),
+         * ending with a zero string offset.
+         */
+        while(in_bounds(&at->at_sect, p, 8)){
+            uint32_t stroff, diecnt;
+
+            memcpy(&stroff, p, 4);
+
+            if(stroff == 0)
+                break;
+
+            memcpy(&diecnt, p + 4, 4);
+            p += 8;
+
+            const char *curname = debug_str_at(ac, stroff);
+            int matches = curname && strcmp(curname, name) == 0;
+
+            for(uint32_t i=0; i<diecnt && p < end; i++){
+                for(int j=0; j<at->at_numatoms; j++){
+                    uint64_t value = read_form(&p, end, at->at_atomforms[j]);
+
+                    if(matches &&
+                            at->at_atomtypes[j] == APPLE_ATOM_DIE_OFFSET){
+                        add_offset(offsets, len,
+                                value + at->at_dieoffsetbase);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Parse every name index in .debug_names. Only 32 bit DWARF. */
+static void parse_debug_names(struct accel *ac, struct section *sect){
+    const uint8_t *p = sect->s_data;
+    const uint8_t *sectend = p + sect->s_size;
+
+    while(in_bounds(sect, p, 36)){
+        uint32_t unitlen;
+        memcpy(&unitlen, p, 4);
+
+        if(unitlen >= 0xfffffff0)
+            return;
+
+        const uint8_t *unitend = p + 4 + unitlen;
+
+        if(unitend > sectend)
+            return;
+
+        struct dnindex dn = {0};
+        uint32_t localtucnt, foreigntucnt, abbrevsz, augsz;
+
+        memcpy(&dn.dn_cucnt, p + 8, 4);
+        memcpy(&localtucnt, p + 12, 4);
+        memcpy(&foreigntucnt, p + 16, 4);
+        memcpy(&dn.dn_bucketcnt, p + 20, 4);
+        memcpy(&dn.dn_namecnt, p + 24, 4);
+        memcpy(&abbrevsz, p + 28, 4);
+        memcpy(&augsz, p + 32, 4);
+
+        const uint8_t *q = p + 36 + ((augsz + 3) & ~3);
+
+        dn.dn_cuoffsets = (const uint32_t *)q;
+        q += (uint64_t)dn.dn_cucnt * 4;
+        q += (uint64_t)localtucnt * 4;
+        q += (uint64_t)foreigntucnt * 8;
+
+        dn.dn_buckets = (const uint32_t *)q;
+        q += (uint64_t)dn.dn_bucketcnt * 4;
+
+        if(dn.dn_bucketcnt > 0){
+            dn.dn_hashes = (const uint32_t *)q;
+            q += (uint64_t)dn.dn_namecnt * 4;
+        }
+
+        dn.dn_stroffsets = (const uint32_t *)q;
+        q += (uint64_t)dn.dn_namecnt * 4;
+        dn.dn_entryoffsets = (const uint32_t *)q;
+        q += (uint64_t)dn.dn_namecnt * 4;
+
+        const uint8_t *abbrevend = q + abbrevsz;
+
+        if(abbrevend > unitend){
+            p = unitend;
+            continue;
+        }
+
+        while(q < abbrevend){
+            uint64_t code = read_uleb(&q, abbrevend);
+
+            if(code == 0)
+                break;
+
+            struct dnabbrev *abbrevs_rea = realloc(dn.dn_abbrevs,
+                    sizeof(struct dnabbrev) * ++dn.dn_numabbrevs);
+            dn.dn_abbrevs = abbrevs_rea;
+
+            struct dnabbrev *abbrev = &dn.dn_abbrevs[dn.dn_numabbrevs - 1];
+            memset(abbrev, 0, sizeof(*abbrev));
+
+            abbrev->dna_code = code;
+
+            /* tag */
+            read_uleb(&q, abbrevend);
+
+            for(;;){
+                uint64_t idx = read_uleb(&q, abbrevend);
+                uint64_t form = read_uleb(&q, abbrevend);
+
+                if((idx == 0 && form == 0) || q >= abbrevend)
+                    break;
+
+                if(abbrev->dna_numattrs < DEBUG_NAMES_MAX_ABBREV_ATTRS){
+                    abbrev->dna_idx[abbrev->dna_numattrs] = idx;
+                    abbrev->dna_form[abbrev->dna_numattrs] = form;
+                    abbrev->dna_numattrs++;
+                }
+            }
+        }
+
+        dn.dn_entrypool = abbrevend;
+        dn.dn_end = unitend;
+
+        struct dnindex *dnindexes_rea = realloc(ac->ac_dnindexes,
+                sizeof(struct dnindex) * ++ac->ac_numdnindexes);
+        ac->ac_dnindexes = dnindexes_rea;
+        ac->ac_dnindexes[ac->ac_numdnindexes - 1] = dn;
+
+        p = unitend;
+    }
+}
+
+static struct dnabbrev *find_dnabbrev(struct dnindex *dn, uint64_t code){
+    for(int i=0; i<dn->dn_numabbrevs; i++){
+        if(dn->dn_abbrevs[i].dna_code == code)
+            return &dn->dn_abbrevs[i];
+    }
+
+    return NULL;
+}
+
+/* nameidx is one based */
+static void collect_dnindex_entries(struct dnindex *dn, uint32_t nameidx,
+        uint64_t **offsets, int *len){
+    const uint8_t *p = dn->dn_entrypool + dn->dn_entryoffsets[nameidx - 1];
+
+    while(p < dn->dn_end){
+        uint64_t code = read_uleb(&p, dn->dn_end);
+
+        if(code == 0)
+            return;
+
+        struct dnabbrev *abbrev = find_dnabbrev(dn, code);
+
+        if(!abbrev)
+            return;
+
+        uint64_t cuidx = 0, dieoffset = 0;
+        int hasdieoffset = 0;
+
+        for(int i=0; i<abbrev->dna_numattrs; i++){
+            uint64_t value = read_form(&p, dn->dn_end, abbrev->dna_form[i]);
+
+            if(abbrev->dna_idx[i] == DW_IDX_compile_unit)
+                cuidx = value;
+            else if(abbrev->dna_idx[i] == DW_IDX_die_offset){
+                dieoffset = value;
+                hasdieoffset = 1;
+            }
+        }
+
+        /* DIE offsets are relative to their compilation unit */
+        if(hasdieoffset && cuidx < dn->dn_cucnt)
+            add_offset(offsets, len, dn->dn_cuoffsets[cuidx] + dieoffset);
+    }
+}
+
+static void lookup_dnindex(struct accel *ac, struct dnindex *dn,
+        const char *name, uint64_t **offsets, int *len){
+    if(dn->dn_bucketcnt == 0){
+        /* No hash table, every name has to be checked */
+        for(uint32_t i=1; i<=dn->dn_namecnt; i++){
+            const char *curname = debug_str_at(ac, dn->dn_stroffsets[i - 1]);
+
+            if(curname && strcmp(curname, name) == 0)
+                collect_dnindex_entries(dn, i, offsets, len);
+        }
+
+        return;
+    }
+
+    uint32_t hash = djb_hash(name, 1);
+    uint32_t bucket = hash % dn->dn_bucketcnt;
+
+    for(uint32_t i=dn->dn_buckets[bucket]; i && i<=dn->dn_namecnt; i++){
+        uint32_t curhash = dn->dn_hashes[i - 1];
+
+        if(curhash % dn->dn_bucketcnt != bucket)
+            return;
+
+        if(curhash != hash)
+            continue;
+
+        const char *curname = debug_str_at(ac, dn->dn_stroffsets[i - 1]);
+
+        if(curname && strcmp(curname, name) == 0)
+            collect_dnindex_entries(dn, i, offsets, len);
+    }
+}
+
+static int should_index_die(Dwarf_Half tag, int level){
+    switch(tag){
+        case DW_TAG_subprogram:
+        case DW_TAG_base_type:
+        case DW_TAG_class_type:
+        case DW_TAG_enumeration_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_typedef:
+        case DW_TAG_union_type:
+            return 1;
+        /* Only globals, not locals */
+        case DW_TAG_variable:
+            return level == 0;
+        default:
+            return 0;
+    }
+}
+
+static void add_fallback_name(struct accel *ac, const char *name,
+        uint64_t dieoffset, int *capacity){
+    if(ac->ac_numfallbacknames == *capacity){
+        *capacity = *capacity ? *capacity * 2 : 1024;
+
+        struct accelname *names_rea = realloc(ac->ac_fallbacknames,
+                sizeof(struct accelname) * *capacity);
+        ac->ac_fallbacknames = names_rea;
+    }
+
+    int idx = ac->ac_numfallbacknames++;
+    struct accelname *an = &ac->ac_fallbacknames[idx];
+
+    an->an_dieoffset = dieoffset;
+    an->an_next = -1;
+
+    unsigned long key = hashtable_strhash(name);
+    void *head = NULL;
+
+    /* Values are stored as index + 1, since zero would be NULL */
+    if(hashtable_get(ac->ac_fallback, key, &head) == HASHTABLE_OK)
+        an->an_next = (int)((uintptr_t)head - 1);
+
+    hashtable_insert(ac->ac_fallback, key, (void *)(uintptr_t)(idx + 1));
+}
+
+static void index_die_children(struct accel *ac, Dwarf_Die parent,
+        int level, int *capacity){
+    Dwarf_Debug dbg = cu_get_dwarf_debug(ac->ac_dwarfinfo);
+    Dwarf_Error d_error = NULL;
+    Dwarf_Die cur = NULL;
+    int is_info = 1;
+
+    if(dwarf_child(parent, &cur, &d_error) != DW_DLV_OK)
+        return;
+
+    while(cur){
+        Dwarf_Half tag = 0;
+        dwarf_tag(cur, &tag, &d_error);
+
+        if(should_index_die(tag, level)){
+            char *name = NULL;
+            Dwarf_Off offset = 0;
+
+            if(dwarf_diename(cur, &name, &d_error) == DW_DLV_OK &&
+                    dwarf_dieoffset(cur, &offset, &d_error) == DW_DLV_OK){
+                add_fallback_name(ac, name, offset, capacity);
+            }
+        }
+
+        /* Types and functions can be nested in namespaces */
+        if(tag == DW_TAG_namespace)
+            index_die_children(ac, cur, level, capacity);
+
+        Dwarf_Die sibling = NULL;
+        int ret = dwarf_siblingof_b(dbg, cur, is_info, &sibling, &d_error);
+
+        dwarf_dealloc(dbg, cur, DW_DLA_DIE);
+
+        if(ret != DW_DLV_OK)
+            break;
+
+        cur = sibling;
+    }
+}
+
+/* Walk .debug_info once, only as far down as names we care about
+ * can be.
+ */
+static void build_fallback_index(struct accel *ac){
+    dwarfinfo_t *dwarfinfo = ac->ac_dwarfinfo;
+    Dwarf_Debug dbg = cu_get_dwarf_debug(dwarfinfo);
+    int capacity = 0;
+
+    ac->ac_fallbackbuilt = 1;
+    ac->ac_fallback = hashtable_new();
+
+    if(!dbg)
+        return;
+
+    LL_FOREACH(dwarfinfo->di_compunits, current){
+        uint64_t rootoffset = 0;
+
+        if(cu_get_root_die_offset(current->data, &rootoffset, NULL))
+            continue;
+
+        Dwarf_Die cudie = NULL;
+        Dwarf_Error d_error = NULL;
+        int is_info = 1;
+
+        if(dwarf_offdie_b(dbg, rootoffset, is_info, &cudie,
+                    &d_error) != DW_DLV_OK){
+            continue;
+        }
+
+        index_die_children(ac, cudie, 0, &capacity);
+        dwarf_dealloc(dbg, cudie, DW_DLA_DIE);
+    }
+}
+
+static void lookup_fallback(struct accel *ac, const char *name,
+        uint64_t **offsets, int *len){
+    if(!ac->ac_fallbackbuilt)
+        build_fallback_index(ac);
+
+    Dwarf_Debug dbg = cu_get_dwarf_debug(ac->ac_dwarfinfo);
+    void *head = NULL;
+
+    if(hashtable_get(ac->ac_fallback, hashtable_strhash(name), &head) !=
+            HASHTABLE_OK){
+        return;
+    }
+
+    for(int idx = (int)((uintptr_t)head - 1); idx != -1;
+            idx = ac->ac_fallbacknames[idx].an_next){
+        struct accelname *an = &ac->ac_fallbacknames[idx];
+        Dwarf_Die die = NULL;
+        Dwarf_Error d_error = NULL;
+        char *diename = NULL;
+        int is_info = 1;
+
+        if(dwarf_offdie_b(dbg, an->an_dieoffset, is_info, &die,
+                    &d_error) != DW_DLV_OK){
+            continue;
+        }
+
+        /* Make sure this isn't a hash collision */
+        if(dwarf_diename(die, &diename, &d_error) == DW_DLV_OK &&
+                strcmp(diename, name) == 0){
+            add_offset(offsets, len, an->an_dieoffset);
+        }
+
+        dwarf_dealloc(dbg, die, DW_DLA_DIE);
+    }
+}
+
+/* Returns every DIE offset with the name name. */
+int accel_find_die_offsets_by_name(struct accel *ac, const char *name,
+        uint64_t **offsetsout, int *lenout){
+    if(!ac || !name || !offsetsout || !lenout)
+        return 1;
+
+    *offsetsout = NULL;
+    *lenout = 0;
+
+    if(ac->ac_numappletables > 0 || ac->ac_numdnindexes > 0){
+        for(int i=0; i<ac->ac_numappletables; i++){
+            lookup_apple_table(ac, &ac->ac_appletables[i], name,
+                    offsetsout, lenout);
+        }
+
+        for(int i=0; i<ac->ac_numdnindexes; i++){
+            lookup_dnindex(ac, &ac->ac_dnindexes[i], name, offsetsout,
+                    lenout);
+        }
+    }
+    else{
+        /* This one reads the DWARF file with libdwarf */
+        pthread_mutex_lock(&ac->ac_dwarfinfo->di_lock);
+        lookup_fallback(ac, name, offsetsout, lenout);
+        pthread_mutex_unlock(&ac->ac_dwarfinfo->di_lock);
+    }
+
+    return *lenout == 0;
+}
+
+void accel_free(struct accel *ac){
+    if(!ac)
+        return;
+
+    if(ac->ac_map)
+        munmap(ac->ac_map, ac->ac_mapsize);
+
+    for(int i=0; i<ac->ac_numdnindexes; i++)
+        free(ac->ac_dnindexes[i].dn_abbrevs);
+
+    free(ac->ac_dnindexes);
+
+    hashtable_destroy(&ac->ac_fallback);
+    free(ac->ac_fallbacknames);
+    free(ac);
+}
+
+/* Hands out any section of the DWARF file, since we have it mapped */
+int accel_get_section(struct accel *ac, const char *name,
+        const uint8_t **dataout, uint64_t *sizeout){
+    struct section sect;
+
+    if(!ac || find_section(ac, name, &sect))
+        return 1;
+
+    *dataout = sect.s_data;
+    *sizeout = sect.s_size;
+
+    return 0;
+}
+
+/* Never fails. If the DWARF file has no accelerator tables, or can't
+ * be mapped, lookups fall back to an index we build ourselves.
+ */
+struct accel *accel_load(dwarfinfo_t *dwarfinfo){
+    struct accel *ac = calloc(1, sizeof(struct accel));
+    ac->ac_dwarfinfo = dwarfinfo;
+
+    struct stat st;
+
+    if(fstat(dwarfinfo->di_fd, &st) == -1 || st.st_size == 0)
+        return ac;
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+            dwarfinfo->di_fd, 0);
+
+    if(map == MAP_FAILED)
+        return ac;
+
+    ac->ac_map = map;
+    ac->ac_mapsize = st.st_size;
+
+    if(find_section(ac, "debug_str", &ac->ac_debugstr))
+        return ac;
+
+    const char *applenames[] = { "apple_names", "apple_types", "apple_objc" };
+
+    for(int i=0; i<sizeof(applenames) / sizeof(*applenames); i++){
+        struct section sect;
+
+        if(find_section(ac, applenames[i], &sect))
+            continue;
+
+        struct appletable *at = &ac->ac_appletables[ac->ac_numappletables];
+
+        if(parse_apple_table(&sect, at) == 0)
+            ac->ac_numappletables++;
+    }
+
+    struct section debugnames;
+
+    if(find_section(ac, "debug_names", &debugnames) == 0)
+        parse_debug_names(ac, &debugnames);
+
+    return ac;
+}
@@ -0,0 +1,9 @@
+#ifndef _ACCEL_H_
+#define _ACCEL_H_
+
+int accel_find_die_offsets_by_name(void *, const char *, uint64_t **, int *);
+void accel_free(void *);
+int accel_get_section(void *, const char *, const uint8_t **, uint64_t *);
+void *accel_load(void *);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+/* A bump allocator. Everything allocated from an arena is released
+ * at once with arena_free, nothing can be freed on its own.
+ */
+
+#define ARENA_CHUNK_SZ (64 * 1024)
+#define ARENA_ALIGN (2 * sizeof(void *))
+
+struct arenachunk {
+    struct arenachunk *ac_next;
+    size_t ac_used;
+    size_t ac_size;
+    char *ac_data;
+};
+
+struct arena {
+    /* The first chunk is the one being bumped */
+    struct arenachunk *a_chunks;
+
+    /* Every byte this arena has asked malloc for */
+    uint64_t a_bytes;
+};
+
+static struct arenachunk *new_chunk(struct arena *a, size_t sz){
+    struct arenachunk *chunk = calloc(1, sizeof(struct arenachunk) + sz);
+    chunk->ac_size = sz;
+    chunk->ac_data = (char *)(chunk + 1);
+
+    a->a_bytes += sizeof(struct arenachunk) + sz;
+
+    return chunk;
+}
+
+/* Memory returned is zeroed. */
+void *arena_alloc(struct arena *a, size_t sz){
+    if(!a)
+        return NULL;
+
+    sz = (sz + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    /* Big allocations get a chunk of their own, behind the current
+     * one, so what's left of the current chunk isn't thrown away.
+     */
+    if(sz > ARENA_CHUNK_SZ / 4){
+        struct arenachunk *chunk = new_chunk(a, sz);
+        chunk->ac_used = sz;
+
+        if(a->a_chunks){
+            chunk->ac_next = a->a_chunks->ac_next;
+            a->a_chunks->ac_next = chunk;
+        }
+        else{
+            a->a_chunks = chunk;
+        }
+
+        return chunk->ac_data;
+    }
+
+    struct arenachunk *current = a->a_chunks;
+
+    if(!current || current->ac_size - current->ac_used < sz){
+        current = new_chunk(a, ARENA_CHUNK_SZ);
+        current->ac_next = a->a_chunks;
+        a->a_chunks = current;
+    }
+
+    void *p = current->ac_data + current->ac_used;
+    current->ac_used += sz;
+
+    return p;
+}
+
+void arena_free(struct arena *a){
+    if(!a)
+        return;
+
+    struct arenachunk *current = a->a_chunks;
+
+    while(current){
+        struct arenachunk *next = current->ac_next;
+        free(current);
+        current = next;
+    }
+
+    free(a);
+}
+
+uint64_t arena_get_size(struct arena *a){
+    if(!a)
+        return 0;
+
+    return sizeof(struct arena) + a->a_bytes;
+}
+
+struct arena *arena_new(void){
+    return calloc(1, sizeof(struct arena));
+}
@@ -0,0 +1,9 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+void *arena_alloc(void *, size_t);
+void arena_free(void *);
+uint64_t arena_get_size(void *);
+void *arena_new(void);
+
+#endif
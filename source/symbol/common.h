@@ -1,18 +1,193 @@
 #ifndef _COMMON_H_
 #define _COMMON_H_
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include <libdwarf.h>
 
+struct compunit;
+struct cu_arange;
+struct dwarfhandle;
+struct hashtable;
+
 typedef struct {
     /* Our DWARF file */
     int di_fd;
+    char *di_path;
 
+    /* When everything else came from the symbol cache, this isn't
+     * opened until something needs libdwarf, so use cu_get_dwarf_debug
+     */
     Dwarf_Debug di_dbg;
 
     struct linkedlist *di_compunits;
     int di_numcompunits;
+
+    /* Same as di_compunits, but as an array. Compilation units are
+     * loaded in .debug_info order, so this is sorted by offset.
+     */
+    struct compunit **di_cus;
+
+    /* Address ranges of every compilation unit, sorted by low PC, so
+     * the compilation unit a PC belongs to can be binary searched.
+     */
+    struct cu_arange *di_cuaranges;
+    int di_numcuaranges;
+
+    /* Compilation units keyed by the hash of their file's base name */
+    struct hashtable *di_cunameidx;
+
+    /* Global name index, see accel.c */
+    void *di_accel;
+
+    /* (file, line) -> PC index, see lineidx.c. NULL until the first
+     * source line lookup.
+     */
+    void *di_lineidx;
+
+    /* Every DIE name and data type string, see strpool.c */
+    void *di_strpool;
+
+    /* Every data type layout resolved so far, see typecache.c */
+    void *di_typecache;
+
+    /* Mapped symbol cache, see symcache.c. NULL if we didn't load
+     * from one.
+     */
+    void *di_symcache;
+
+    /* Whether the symbol cache on disk has every line table yet */
+    int di_symcachecomplete;
+
+    /* A compilation unit's DIE tree is only built the first time
+     * something needs it. If di_dietreecap is non-zero, the least
+     * recently used trees are discarded once all the trees together
+     * take up more than di_dietreecap bytes.
+     */
+    uint64_t di_dietreecap;
+    uint64_t di_dietreebytes;
+    uint64_t di_cuusecnt;
+
+    /* libdwarf handles opened for the threads which built DIE trees
+     * in parallel. They live as long as the trees they built.
+     */
+    struct dwarfhandle *di_workerhandles;
+    int di_numworkerhandles;
+
+    /* More than one thread asks about the same file: the exception
+     * thread, the symbol loader, and the main thread. This is held
+     * while di_dbg is used, while DIE trees are built, discarded, or
+     * walked, and by sym_lock. It's recursive so sym_* functions can
+     * be called with it held.
+     */
+    pthread_mutex_t di_lock;
 } dwarfinfo_t;
 
+struct dwarfhandle {
+    int dh_fd;
+    Dwarf_Debug dh_dbg;
+};
+
+struct cu_arange {
+    uint64_t ar_lopc;
+    uint64_t ar_hipc;
+    struct compunit *ar_cu;
+};
+
+/* What the symbol cache keeps about a compilation unit: its header,
+ * and enough of its root DIE to find it by PC or name without libdwarf.
+ * cs_name isn't owned by the summary.
+ */
+struct cusummary {
+    uint64_t cs_headerlen;
+    uint64_t cs_abbrevoffset;
+    uint64_t cs_nextheaderoffset;
+    uint64_t cs_rootdieoffset;
+    uint64_t cs_lowpc;
+    uint64_t cs_highpc;
+    const char *cs_name;
+    uint16_t cs_addrsize;
+    uint16_t cs_tag;
+    uint16_t cs_haschildren;
+};
+
+struct pcrange {
+    uint64_t pr_lopc;
+    uint64_t pr_hipc;
+};
+
+/* One operation of a location expression, as libdwarf gives it to us.
+ * See locexpr.c.
+ */
+struct locrawop {
+    uint8_t lr_op;
+    uint64_t lr_opd1;
+    uint64_t lr_opd2;
+    uint64_t lr_opd3;
+    /* Byte offset of this operation in the expression */
+    uint64_t lr_offset;
+};
+
+/* What evaluating a location expression can come back with */
+enum {
+    LOC_OK = 0,
+    /* The expression uses an operation we don't implement,
+     * see loc_get_unsupported_op.
+     */
+    LOC_UNSUPPORTED,
+    /* Stack underflow or overflow, division by zero, a branch to
+     * somewhere that isn't an operation, or an expression that never
+     * finishes.
+     */
+    LOC_BAD_EXPR,
+    LOC_BAD_READ,
+    LOC_BAD_REGISTER,
+    /* DW_OP_fbreg was used without a frame base */
+    LOC_NO_FRAME_BASE,
+    /* The variable has no location at this PC */
+    LOC_OPTIMIZED_OUT
+};
+
+/* Where the location expressions being evaluated get register values
+ * and memory from.
+ */
+struct locctx {
+    /* Returns non-zero if DWARF register regno can't be read */
+    int (*lc_getreg)(void *, int, uint64_t *);
+
+    /* Reads len bytes at addr into buf, returns non-zero if it can't.
+     * Everything the expressions being evaluated need next is sorted
+     * and whatever overlaps or sits close together is merged before it
+     * gets here, so this is called once per stretch of memory instead
+     * of once per read.
+     */
+    int (*lc_readmem)(void *, uint64_t, void *, size_t);
+
+    /* How many times lc_readmem has been called */
+    unsigned long lc_numreads;
+
+    void *lc_arg;
+};
+
+/* One variable of a frame, see loc_evaluate_frame */
+struct framevar {
+    /* One of the LOC_* values */
+    int fv_status;
+
+    /* Non-zero if the variable doesn't live in memory: it's in a
+     * register, or its expression computed it. fv_addr is then the
+     * value itself instead of where it is.
+     */
+    int fv_isvalue;
+    uint64_t fv_addr;
+
+    uint64_t fv_size;
+    /* fv_size bytes of the variable, NULL if they couldn't be read */
+    uint8_t *fv_data;
+};
+
 #define LL_FOREACH(list, var) \
     for(struct node *var = list->front; \
             var; \
@@ -21,7 +196,9 @@ typedef struct {
 enum {
     DIE_SEARCH_IF_NAME_MATCHES,
     DIE_SEARCH_FUNCTION_BY_PC,
-    DIE_SEARCH_IF_DIE_OFFSET_MATCHES
+    DIE_SEARCH_IF_DIE_OFFSET_MATCHES,
+    /* data must come from the dwarfinfo's string pool */
+    DIE_SEARCH_IF_POOLED_NAME_IS
 };
 
 enum {
@@ -1,24 +1,277 @@
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <libdwarf.h>
 
+#include "../hashtable.h"
 #include "../linkedlist.h"
 
 #include "common.h"
 #include "die.h"
+#include "linetable.h"
 #include "symerr.h"
 
-typedef struct {
+typedef struct compunit {
     Dwarf_Unsigned cu_header_len;
     Dwarf_Unsigned cu_abbrev_offset;
     Dwarf_Half cu_address_size;
     Dwarf_Unsigned cu_next_header_offset;
 
+    /* Offset of this compilation unit's root DIE in .debug_info */
+    Dwarf_Unsigned cu_rootdieoffset;
+
     void *cu_root_die;
+
+    dwarfinfo_t *cu_dwarfinfo;
+
+    /* Whether the rest of the DIE tree under cu_root_die was built */
+    int cu_treeloaded;
+    /* The libdwarf handle the DIEs in that tree came from */
+    Dwarf_Debug cu_treedbg;
+    uint64_t cu_treesize;
+    /* Value of di_cuusecnt the last time this tree was used */
+    uint64_t cu_lastused;
+
+    /* Next compilation unit whose base name hashes the same */
+    struct compunit *cu_nextsamename;
 } compunit_t;
 
+static const char *path_basename(const char *path){
+    const char *slash = strrchr(path, '/');
+
+    return slash ? slash + 1 : path;
+}
+
+static void discard_tree(compunit_t *cu){
+    dwarfinfo_t *dwarfinfo = cu->cu_dwarfinfo;
+
+    die_tree_discard(cu->cu_treedbg, cu->cu_root_die);
+
+    dwarfinfo->di_dietreebytes -= cu->cu_treesize;
+
+    cu->cu_treeloaded = 0;
+    cu->cu_treedbg = NULL;
+    cu->cu_treesize = 0;
+}
+
+/* Discard the least recently used trees until we're under the cap.
+ * keep is the tree which was just asked for.
+ */
+static void enforce_die_tree_cap(dwarfinfo_t *dwarfinfo, compunit_t *keep){
+    if(dwarfinfo->di_dietreecap == 0)
+        return;
+
+    while(dwarfinfo->di_dietreebytes > dwarfinfo->di_dietreecap){
+        compunit_t *coldest = NULL;
+
+        LL_FOREACH(dwarfinfo->di_compunits, current){
+            compunit_t *cu = current->data;
+
+            if(!cu->cu_treeloaded || cu == keep)
+                continue;
+
+            if(!coldest || cu->cu_lastused < coldest->cu_lastused)
+                coldest = cu;
+        }
+
+        if(!coldest)
+            return;
+
+        discard_tree(coldest);
+    }
+}
+
+struct treeworker {
+    Dwarf_Debug tw_dbg;
+
+    compunit_t **tw_cus;
+    int tw_numcus;
+
+    /* Index of the next compilation unit to claim, shared between
+     * every worker
+     */
+    int *tw_nextcu;
+    pthread_mutex_t *tw_nextculock;
+};
+
+/* di_dbg isn't opened when everything came from the symbol cache, so
+ * anything that needs libdwarf gets it from here. NULL if the DWARF
+ * file can't be read.
+ */
+Dwarf_Debug cu_get_dwarf_debug(dwarfinfo_t *dwarfinfo){
+    pthread_mutex_lock(&dwarfinfo->di_lock);
+
+    if(!dwarfinfo->di_dbg){
+        Dwarf_Error d_error = NULL;
+
+        if(dwarf_init(dwarfinfo->di_fd, DW_DLC_READ, NULL, NULL,
+                    &dwarfinfo->di_dbg, &d_error) != DW_DLV_OK){
+            dwarfinfo->di_dbg = NULL;
+        }
+    }
+
+    Dwarf_Debug dbg = dwarfinfo->di_dbg;
+
+    pthread_mutex_unlock(&dwarfinfo->di_lock);
+
+    return dbg;
+}
+
+static void *treeworker_main(void *arg){
+    struct treeworker *tw = arg;
+
+    for(;;){
+        pthread_mutex_lock(tw->tw_nextculock);
+        int idx = (*tw->tw_nextcu)++;
+        pthread_mutex_unlock(tw->tw_nextculock);
+
+        if(idx >= tw->tw_numcus)
+            return NULL;
+
+        compunit_t *cu = tw->tw_cus[idx];
+
+        /* If this fails, cu_get_root_die will try again later */
+        if(build_die_tree_from_root_die(tw->tw_dbg, cu, cu->cu_root_die,
+                    &cu->cu_treesize, NULL) == 0){
+            cu->cu_treedbg = tw->tw_dbg;
+        }
+    }
+}
+
+static int open_dwarf_handle(const char *path, struct dwarfhandle *dh){
+    dh->dh_fd = open(path, O_RDONLY);
+
+    if(dh->dh_fd < 0)
+        return 1;
+
+    Dwarf_Error d_error = NULL;
+    int ret = dwarf_init(dh->dh_fd, DW_DLC_READ, NULL, NULL, &dh->dh_dbg,
+            &d_error);
+
+    if(ret != DW_DLV_OK){
+        close(dh->dh_fd);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Build every DIE tree that hasn't been built yet on a pool of
+ * numworkers threads, or one per CPU if numworkers is zero. A libdwarf
+ * handle can't be used from more than one thread at once, so each
+ * worker gets its own. di_lock is held the whole time, so nobody else
+ * builds or discards a tree the workers are on.
+ */
+int cu_build_all_die_trees(dwarfinfo_t *dwarfinfo, int numworkers,
+        sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    pthread_mutex_lock(&dwarfinfo->di_lock);
+
+    compunit_t **cus = malloc(sizeof(compunit_t *) *
+            (dwarfinfo->di_numcompunits + 1));
+    int numcus = 0;
+
+    LL_FOREACH(dwarfinfo->di_compunits, current){
+        compunit_t *cu = current->data;
+
+        if(!cu->cu_treeloaded)
+            cus[numcus++] = cu;
+    }
+
+    if(numworkers <= 0)
+        numworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(numworkers > numcus)
+        numworkers = numcus;
+
+    /* Handles from an earlier call are reused */
+    if(dwarfinfo->di_numworkerhandles < numworkers && dwarfinfo->di_path){
+        struct dwarfhandle *handles_rea = realloc(dwarfinfo->di_workerhandles,
+                sizeof(struct dwarfhandle) * numworkers);
+        dwarfinfo->di_workerhandles = handles_rea;
+
+        while(dwarfinfo->di_numworkerhandles < numworkers){
+            struct dwarfhandle *dh =
+                &dwarfinfo->di_workerhandles[dwarfinfo->di_numworkerhandles];
+
+            if(open_dwarf_handle(dwarfinfo->di_path, dh))
+                break;
+
+            dwarfinfo->di_numworkerhandles++;
+        }
+    }
+
+    if(numworkers > dwarfinfo->di_numworkerhandles)
+        numworkers = dwarfinfo->di_numworkerhandles;
+
+    int nextcu = 0;
+    pthread_mutex_t nextculock = PTHREAD_MUTEX_INITIALIZER;
+
+    if(numworkers == 0){
+        /* Couldn't open any more handles, do it all on this thread */
+        struct treeworker tw = { cu_get_dwarf_debug(dwarfinfo), cus, numcus,
+            &nextcu, &nextculock };
+
+        treeworker_main(&tw);
+    }
+    else{
+        struct treeworker *workers =
+            malloc(sizeof(struct treeworker) * numworkers);
+        pthread_t *threads = malloc(sizeof(pthread_t) * numworkers);
+
+        for(int i=0; i<numworkers; i++){
+            struct treeworker *tw = &workers[i];
+
+            tw->tw_dbg = dwarfinfo->di_workerhandles[i].dh_dbg;
+            tw->tw_cus = cus;
+            tw->tw_numcus = numcus;
+            tw->tw_nextcu = &nextcu;
+            tw->tw_nextculock = &nextculock;
+
+            pthread_create(&threads[i], NULL, treeworker_main, tw);
+        }
+
+        for(int i=0; i<numworkers; i++)
+            pthread_join(threads[i], NULL);
+
+        free(threads);
+        free(workers);
+    }
+
+    pthread_mutex_destroy(&nextculock);
+
+    /* Account for the new trees in the order the compilation
+     * units were loaded, not the order the workers finished in.
+     */
+    for(int i=0; i<numcus; i++){
+        compunit_t *cu = cus[i];
+
+        if(!cu->cu_treedbg)
+            continue;
+
+        cu->cu_treeloaded = 1;
+        cu->cu_lastused = ++dwarfinfo->di_cuusecnt;
+
+        dwarfinfo->di_dietreebytes += cu->cu_treesize;
+    }
+
+    free(cus);
+
+    enforce_die_tree_cap(dwarfinfo, NULL);
+
+    pthread_mutex_unlock(&dwarfinfo->di_lock);
+
+    return 0;
+}
+
 int cu_display_compilation_units(dwarfinfo_t *dwarfinfo, sym_error_t *e){
     if(!dwarfinfo){
         errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
@@ -48,6 +301,43 @@ int cu_display_compilation_units(dwarfinfo_t *dwarfinfo, sym_error_t *e){
     return 0;
 }
 
+/* Find the compilation unit the DIE at offset belongs to */
+int cu_find_compilation_unit_by_die_offset(dwarfinfo_t *dwarfinfo,
+        compunit_t **cuout, uint64_t offset, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    if(!cuout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    /* Find the last compilation unit which starts at or before offset */
+    int lo = 0, hi = dwarfinfo->di_numcompunits - 1, found = -1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(dwarfinfo->di_cus[mid]->cu_rootdieoffset <= offset){
+            found = mid;
+            lo = mid + 1;
+        }
+        else{
+            hi = mid - 1;
+        }
+    }
+
+    if(found == -1){
+        errset(e, CU_ERROR_KIND, CU_CU_NOT_FOUND);
+        return 1;
+    }
+
+    *cuout = dwarfinfo->di_cus[found];
+    return 0;
+}
+
 int cu_find_compilation_unit_by_name(dwarfinfo_t *dwarfinfo,
         compunit_t **cuout, char *name, sym_error_t *e){
     if(!dwarfinfo){
@@ -60,13 +350,15 @@ int cu_find_compilation_unit_by_name(dwarfinfo_t *dwarfinfo,
         return 1;
     }
 
-    LL_FOREACH(dwarfinfo->di_compunits, current){
-        compunit_t *cu = current->data;
+    compunit_t *cu = NULL;
+    hashtable_get(dwarfinfo->di_cunameidx,
+            hashtable_strhash(path_basename(name)), (void **)&cu);
 
+    for(; cu; cu = cu->cu_nextsamename){
         char *cuname = NULL;
         die_get_name(cu->cu_root_die, &cuname, NULL);
 
-        if(strcmp(cuname, name) == 0){
+        if(cuname && is_same_srcfile(cuname, name)){
             *cuout = cu;
             return 0;
         }
@@ -88,21 +380,29 @@ int cu_find_compilation_unit_by_pc(dwarfinfo_t *dwarfinfo,
         return 1;
     }
 
-    LL_FOREACH(dwarfinfo->di_compunits, current){
-        compunit_t *cu = current->data;
+    /* Find the last range which starts at or before pc */
+    struct cu_arange *aranges = dwarfinfo->di_cuaranges;
+    int lo = 0, hi = dwarfinfo->di_numcuaranges - 1, found = -1;
 
-        Dwarf_Unsigned lpc = 0, hpc = 0;
-        die_get_low_pc(cu->cu_root_die, &lpc, NULL);
-        die_get_high_pc(cu->cu_root_die, &hpc, NULL);
-        
-        if(pc >= lpc && pc < hpc){
-            *cuout = cu;
-            return 0;
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(aranges[mid].ar_lopc <= pc){
+            found = mid;
+            lo = mid + 1;
+        }
+        else{
+            hi = mid - 1;
         }
     }
 
-    errset(e, CU_ERROR_KIND, CU_CU_NOT_FOUND);
-    return 1;
+    if(found == -1 || pc >= aranges[found].ar_hipc){
+        errset(e, CU_ERROR_KIND, CU_CU_NOT_FOUND);
+        return 1;
+    }
+
+    *cuout = aranges[found].ar_cu;
+    return 0;
 }
 
 int cu_free(compunit_t *cu, sym_error_t *e){
@@ -111,6 +411,11 @@ int cu_free(compunit_t *cu, sym_error_t *e){
         return 1;
     }
 
+    dwarfinfo_t *dwarfinfo = cu->cu_dwarfinfo;
+
+    die_tree_discard(cu->cu_treedbg, cu->cu_root_die);
+    die_tree_free(dwarfinfo->di_dbg, cu->cu_root_die, 0);
+
     free(cu->cu_root_die);
     free(cu);
 
@@ -128,16 +433,325 @@ int cu_get_address_size(compunit_t *cu, Dwarf_Half *addrsize,
     return 0;
 }
 
+int cu_get_dwarfinfo(compunit_t *cu, dwarfinfo_t **dwarfinfoout,
+        sym_error_t *e){
+    if(!cu){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_CU_POINTER);
+        return 1;
+    }
+
+    *dwarfinfoout = cu->cu_dwarfinfo;
+    return 0;
+}
+
+int cu_get_root_die_offset(compunit_t *cu, uint64_t *offsetout,
+        sym_error_t *e){
+    if(!cu){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_CU_POINTER);
+        return 1;
+    }
+
+    *offsetout = cu->cu_rootdieoffset;
+    return 0;
+}
+
+/* Returns the root DIE without building the rest of its tree. Enough
+ * for anything that only needs the line table or the root DIE's
+ * attributes.
+ */
+int cu_get_root_die_no_tree(compunit_t *cu, void **dieout, sym_error_t *e){
+    if(!cu){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_CU_POINTER);
+        return 1;
+    }
+
+    *dieout = cu->cu_root_die;
+    return 0;
+}
+
+/* Builds this compilation unit's DIE tree if that hasn't been done yet.
+ * With a cap set, DIEs from another compilation unit's tree could be
+ * freed by this, so hold di_lock for as long as you use the DIEs.
+ */
 int cu_get_root_die(compunit_t *cu, void **dieout, sym_error_t *e){
     if(!cu){
         errset(e, GENERIC_ERROR_KIND, GE_INVALID_CU_POINTER);
         return 1;
     }
 
+    dwarfinfo_t *dwarfinfo = cu->cu_dwarfinfo;
+
+    pthread_mutex_lock(&dwarfinfo->di_lock);
+
+    if(!cu->cu_treeloaded){
+        Dwarf_Debug dbg = cu_get_dwarf_debug(dwarfinfo);
+
+        if(build_die_tree_from_root_die(dbg, cu, cu->cu_root_die,
+                    &cu->cu_treesize, e)){
+            pthread_mutex_unlock(&dwarfinfo->di_lock);
+            return 1;
+        }
+
+        cu->cu_treeloaded = 1;
+        cu->cu_treedbg = dbg;
+        dwarfinfo->di_dietreebytes += cu->cu_treesize;
+    }
+
+    cu->cu_lastused = ++dwarfinfo->di_cuusecnt;
+
+    enforce_die_tree_cap(dwarfinfo, cu);
+
+    pthread_mutex_unlock(&dwarfinfo->di_lock);
+
     *dieout = cu->cu_root_die;
     return 0;
 }
 
+int cu_set_die_tree_cap(dwarfinfo_t *dwarfinfo, uint64_t cap,
+        sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    pthread_mutex_lock(&dwarfinfo->di_lock);
+
+    dwarfinfo->di_dietreecap = cap;
+
+    enforce_die_tree_cap(dwarfinfo, NULL);
+
+    pthread_mutex_unlock(&dwarfinfo->di_lock);
+
+    return 0;
+}
+
+static void add_cu_arange(dwarfinfo_t *dwarfinfo, int *capacity,
+        uint64_t lopc, uint64_t hipc, compunit_t *cu){
+    if(hipc <= lopc)
+        return;
+
+    if(dwarfinfo->di_numcuaranges >= *capacity){
+        *capacity = *capacity ? *capacity * 2 : 64;
+
+        struct cu_arange *aranges_rea = realloc(dwarfinfo->di_cuaranges,
+                sizeof(struct cu_arange) * (*capacity));
+        dwarfinfo->di_cuaranges = aranges_rea;
+    }
+
+    struct cu_arange *ar =
+        &dwarfinfo->di_cuaranges[dwarfinfo->di_numcuaranges++];
+
+    ar->ar_lopc = lopc;
+    ar->ar_hipc = hipc;
+    ar->ar_cu = cu;
+}
+
+static int cu_arange_cmp(const void *a, const void *b){
+    const struct cu_arange *ara = a;
+    const struct cu_arange *arb = b;
+
+    if(ara->ar_lopc < arb->ar_lopc)
+        return -1;
+    else if(ara->ar_lopc == arb->ar_lopc)
+        return 0;
+    else
+        return 1;
+}
+
+/* Compilation units are loaded in .debug_info order, so cus is already
+ * sorted by root DIE offset.
+ */
+static int find_cu_idx_by_root_die_offset(compunit_t **cus, int len,
+        Dwarf_Off off){
+    int lo = 0, hi = len - 1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+        Dwarf_Unsigned midoff = cus[mid]->cu_rootdieoffset;
+
+        if(midoff == off)
+            return mid;
+        else if(midoff < off)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return -1;
+}
+
+/* Build the sorted address range index cu_find_compilation_unit_by_pc
+ * searches. .debug_aranges is used when present. Any compilation unit
+ * it doesn't describe falls back to the root DIE's DW_AT_ranges or
+ * low/high PC. Not done by cu_load_compilation_units, since the index
+ * may come from the symbol cache instead.
+ */
+int cu_build_arange_index(dwarfinfo_t *dwarfinfo, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    Dwarf_Debug dbg = cu_get_dwarf_debug(dwarfinfo);
+    int numcus = dwarfinfo->di_numcompunits;
+
+    if(numcus == 0)
+        return 0;
+
+    compunit_t **cus = dwarfinfo->di_cus;
+    int *covered = calloc(numcus, sizeof(int));
+    int capacity = 0;
+
+    Dwarf_Arange *aranges = NULL;
+    Dwarf_Signed arangescnt = 0;
+    Dwarf_Error d_error = NULL;
+
+    int ret = dwarf_get_aranges(dbg, &aranges, &arangescnt, &d_error);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+    if(ret == DW_DLV_OK){
+        for(Dwarf_Signed i=0; i<arangescnt; i++){
+            Dwarf_Unsigned segment = 0, segment_entry_size = 0, length = 0;
+            Dwarf_Addr start = 0;
+            Dwarf_Off cu_die_offset = 0;
+
+            ret = dwarf_get_arange_info_b(aranges[i], &segment,
+                    &segment_entry_size, &start, &length, &cu_die_offset,
+                    &d_error);
+
+            if(ret == DW_DLV_ERROR)
+                dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+            else if(ret == DW_DLV_OK){
+                int cuidx = find_cu_idx_by_root_die_offset(cus, numcus,
+                        cu_die_offset);
+
+                if(cuidx != -1){
+                    add_cu_arange(dwarfinfo, &capacity, start, start + length,
+                            cus[cuidx]);
+                    covered[cuidx] = 1;
+                }
+            }
+
+            dwarf_dealloc(dbg, aranges[i], DW_DLA_ARANGE);
+        }
+
+        dwarf_dealloc(dbg, aranges, DW_DLA_LIST);
+    }
+
+    for(int i=0; i<numcus; i++){
+        if(covered[i])
+            continue;
+
+        struct pcrange *ranges = NULL;
+        int rangescnt = 0;
+
+        if(die_get_pc_ranges(dbg, cus[i]->cu_root_die, &ranges, &rangescnt,
+                    NULL)){
+            continue;
+        }
+
+        for(int j=0; j<rangescnt; j++){
+            add_cu_arange(dwarfinfo, &capacity, ranges[j].pr_lopc,
+                    ranges[j].pr_hipc, cus[i]);
+        }
+
+        free(ranges);
+    }
+
+    qsort(dwarfinfo->di_cuaranges, dwarfinfo->di_numcuaranges,
+            sizeof(struct cu_arange), cu_arange_cmp);
+
+    free(covered);
+
+    return 0;
+}
+
+/* What the symbol cache keeps about cu */
+int cu_get_summary(compunit_t *cu, struct cusummary *csout, sym_error_t *e){
+    if(!cu){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_CU_POINTER);
+        return 1;
+    }
+
+    get_root_die_summary(cu->cu_root_die, csout);
+
+    csout->cs_headerlen = cu->cu_header_len;
+    csout->cs_abbrevoffset = cu->cu_abbrev_offset;
+    csout->cs_nextheaderoffset = cu->cu_next_header_offset;
+    csout->cs_addrsize = cu->cu_address_size;
+
+    return 0;
+}
+
+static void add_cu_to_name_index(dwarfinfo_t *dwarfinfo, compunit_t *cu){
+    char *cuname = NULL;
+    die_get_name(cu->cu_root_die, &cuname, NULL);
+
+    if(!cuname)
+        return;
+
+    unsigned long key = hashtable_strhash(path_basename(cuname));
+    compunit_t *head = NULL;
+
+    /* keep compilation units in the order they were loaded */
+    if(hashtable_get(dwarfinfo->di_cunameidx, key, (void **)&head)
+            == HASHTABLE_OK){
+        while(head->cu_nextsamename)
+            head = head->cu_nextsamename;
+
+        head->cu_nextsamename = cu;
+        return;
+    }
+
+    hashtable_insert(dwarfinfo->di_cunameidx, key, cu);
+}
+
+static void build_cu_array(dwarfinfo_t *dwarfinfo){
+    dwarfinfo->di_cus = malloc(sizeof(compunit_t *) *
+            (dwarfinfo->di_numcompunits + 1));
+
+    int idx = 0;
+
+    LL_FOREACH(dwarfinfo->di_compunits, current)
+        dwarfinfo->di_cus[idx++] = current->data;
+}
+
+/* Like cu_load_compilation_units, but from what the symbol cache kept
+ * about each one, so libdwarf isn't used. summaries has to be in
+ * .debug_info order.
+ */
+int cu_load_cached_compilation_units(dwarfinfo_t *dwarfinfo,
+        struct cusummary *summaries, int numsummaries, sym_error_t *e){
+    for(int i=0; i<numsummaries; i++){
+        struct cusummary *cs = &summaries[i];
+        compunit_t *cu = calloc(1, sizeof(compunit_t));
+
+        void *root_die = NULL;
+        if(initialize_root_die_from_summary(dwarfinfo, cs, &root_die, e)){
+            free(cu);
+            return 1;
+        }
+
+        cu->cu_header_len = cs->cs_headerlen;
+        cu->cu_abbrev_offset = cs->cs_abbrevoffset;
+        cu->cu_address_size = cs->cs_addrsize;
+        cu->cu_next_header_offset = cs->cs_nextheaderoffset;
+        cu->cu_rootdieoffset = cs->cs_rootdieoffset;
+        cu->cu_root_die = root_die;
+        cu->cu_dwarfinfo = dwarfinfo;
+        linkedlist_add(dwarfinfo->di_compunits, cu);
+        add_cu_to_name_index(dwarfinfo, cu);
+
+        dwarfinfo->di_numcompunits++;
+    }
+
+    build_cu_array(dwarfinfo);
+
+    return 0;
+}
+
 int cu_load_compilation_units(dwarfinfo_t *dwarfinfo, sym_error_t *e){
     for(;;){
         compunit_t *cu = calloc(1, sizeof(compunit_t));
@@ -162,18 +776,22 @@ int cu_load_compilation_units(dwarfinfo_t *dwarfinfo, sym_error_t *e){
 
         if(ret == DW_DLV_NO_ENTRY){
             free(cu);
+            build_cu_array(dwarfinfo);
             return 0;
         }
 
+        /* The rest of the tree is built on demand, see cu_get_root_die */
         void *root_die = NULL;
-        if(initialize_and_build_die_tree_from_root_die(dwarfinfo, cu,
-                &root_die, e)){
+        if(initialize_root_die(dwarfinfo, cu, &root_die, e)){
             free(cu);
             return 1;
         }
 
         cu->cu_root_die = root_die;
+        cu->cu_dwarfinfo = dwarfinfo;
+        die_get_offset(root_die, &cu->cu_rootdieoffset, NULL);
         linkedlist_add(dwarfinfo->di_compunits, cu);
+        add_cu_to_name_index(dwarfinfo, cu);
 
         dwarfinfo->di_numcompunits++;
     }
@@ -1,12 +1,26 @@
 #ifndef _COMPUNIT_H_
 #define _COMPUNIT_H_
 
+struct cusummary;
+
+int cu_build_all_die_trees(void *, int, void *);
+int cu_build_arange_index(void *, void *);
 int cu_display_compilation_units(void *, void *);
+int cu_find_compilation_unit_by_die_offset(void *, void **, uint64_t,
+        void *);
 int cu_find_compilation_unit_by_name(void *, void **, char *, void *);
 int cu_find_compilation_unit_by_pc(void *, void **, uint64_t, void *);
 int cu_free(void *, void *);
 int cu_get_address_size(void *, unsigned short *, void *);
+void *cu_get_dwarf_debug(void *);
+int cu_get_dwarfinfo(void *, void **, void *);
 int cu_get_root_die(void *, void **, void *);
+int cu_get_root_die_no_tree(void *, void **, void *);
+int cu_get_root_die_offset(void *, uint64_t *, void *);
+int cu_get_summary(void *, struct cusummary *, void *);
+int cu_load_cached_compilation_units(void *, struct cusummary *, int,
+        void *);
 int cu_load_compilation_units(void *, void *); 
+int cu_set_die_tree_cap(void *, uint64_t, void *);
 
 #endif
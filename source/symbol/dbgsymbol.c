@@ -4,7 +4,9 @@
 #include <string.h>
 
 #include "dbgsymbol.h"
+#include "dwarfreg.h"
 #include "sym.h"
+#include "symtable.h"
 
 #include "../debuggee.h"
 #include "../memutils.h"
@@ -12,26 +14,53 @@
 
 static int UNNAMED_SYM_CNT = 1;
 
-/* arg1 represents strtabidx or unnamed_sym_num depending on kind */
+/* Make room for n more symbols in entry */
+void reserve_symbols(struct dbg_sym_entry *entry, unsigned int n){
+    if(entry->numsyms + n <= entry->symcapacity)
+        return;
+
+    entry->symcapacity = entry->numsyms + n;
+    entry->sym_starts = realloc(entry->sym_starts,
+            entry->symcapacity * sizeof(uint32_t));
+    entry->sym_lens = realloc(entry->sym_lens,
+            entry->symcapacity * sizeof(uint32_t));
+    entry->sym_names = realloc(entry->sym_names,
+            entry->symcapacity * sizeof(uint32_t));
+}
+
+/* arg1 is the symbol's string table index if kind is NAMED_SYM, and
+ * symname is its name if entry is from the shared cache. Unnamed
+ * symbols don't get their number until number_unnamed_symbols.
+ */
 void add_symbol_to_entry(struct dbg_sym_entry *entry, int arg1,
         unsigned long vmaddr_start, unsigned int fxnlen, int kind,
         char *symname){
-    struct sym *sym = malloc(sizeof(struct sym));
+    if(entry->numsyms == entry->symcapacity)
+        reserve_symbols(entry, entry->numsyms ? entry->numsyms : 16);
 
-    if(symname)
-        sym->dsc_symname = symname;
+    uint32_t name = 0;
 
-    if(kind == NAMED_SYM)
-        sym->strtabidx = arg1;
-    else if(kind == UNNAMED_SYM){
-        sym->dsc_symname = UNNAMED_SYMBOL;
-        sym->unnamed_sym_num = UNNAMED_SYM_CNT++;
+    if(kind == NAMED_SYM && symname){
+        unsigned long off = (unsigned long)(symname - (char *)DSCDATA);
+
+        /* Only a cache well over what any device has would do this */
+        if(off >= SYM_UNNAMED)
+            kind = UNNAMED_SYM;
+
+        name = (uint32_t)off;
+    }
+    else if(kind == NAMED_SYM){
+        name = (uint32_t)arg1;
     }
 
-    sym->sym_func_start = vmaddr_start;
-    sym->sym_func_len = fxnlen;
+    if(kind == UNNAMED_SYM)
+        name = SYM_UNNAMED;
 
-    array_insert(entry->syms, sym);
+    unsigned int idx = entry->numsyms++;
+
+    entry->sym_starts[idx] = (uint32_t)(vmaddr_start - entry->load_addr);
+    entry->sym_lens[idx] = fxnlen;
+    entry->sym_names[idx] = name;
 }
 
 void create_frame_string(unsigned long vmaddr, char **frstr){
@@ -45,7 +74,7 @@ void create_frame_string(unsigned long vmaddr, char **frstr){
     /* If we can't get the symbol name, there's no need to continue
      * and try to get line of the source file we're at.
      */
-    if(get_symbol_info_from_address(debuggee->symbols,
+    if(get_symbol_info_from_address(debuggee->symtable,
             vmaddr, &imgname, &symname, &symdist)){
         return;
     }
@@ -57,28 +86,26 @@ void create_frame_string(unsigned long vmaddr, char **frstr){
 
     /* second, see if we can figure out the line number we're at */
     /* if we can't, then we substitute that for how far we are into the fxn */
-    if(!debuggee->has_dwarf_debug_info()){
-        if(symdist > 0)
-            concat(frstr, " + %#lx", symdist);
-
-        return;
-    }
-
     char *pc_srcfile = NULL, *pc_srcfunc = NULL;
-    uint64_t pc_srcfileline = 0;
-    void *root_die = NULL;
+    uint64_t pc_srcfileline = 0, slide = 0;
+    void *dwarfinfo = NULL, *root_die = NULL;
 
-    if(sym_get_line_info_from_pc(debuggee->dwarfinfo,
-                vmaddr - debuggee->aslr_slide, &pc_srcfile, &pc_srcfunc,
-                &pc_srcfileline, &root_die, NULL)){
+    if(dwarfreg_find_by_pc(vmaddr, &dwarfinfo, &slide) ||
+            sym_get_line_info_from_pc(dwarfinfo, vmaddr - slide,
+                &pc_srcfile, &pc_srcfunc, &pc_srcfileline, &root_die,
+                NULL)){
         if(symdist > 0)
             concat(frstr, " + %#lx", symdist);
 
+        dwarfreg_release(dwarfinfo);
+
         return;
     }
 
-    if(!pc_srcfile)
+    if(!pc_srcfile){
+        dwarfreg_release(dwarfinfo);
         return;
+    }
 
     /* we only care about what's after the last slash */
     char *pcsf = pc_srcfile;
@@ -89,196 +116,181 @@ void create_frame_string(unsigned long vmaddr, char **frstr){
 
     concat(frstr, " at %s:%lld", pcsf, pc_srcfileline);
 
-    free(pc_srcfile);
-    free(pc_srcfunc);
+    /* pc_srcfile belongs to dwarfinfo */
+    dwarfreg_release(dwarfinfo);
 }
 
-struct dbg_sym_entry *create_sym_entry(unsigned long strtab_vmaddr,
-        unsigned long strtab_fileaddr, int from_dsc){
-    struct dbg_sym_entry *entry = malloc(sizeof(struct dbg_sym_entry));
+static const char *basename_of(const char *path){
+    const char *lastslash = strrchr(path, '/');
 
-    entry->strtab_vmaddr = strtab_vmaddr;
-    entry->syms = array_new();
-    entry->from_dsc = from_dsc;
-
-    return entry;
+    return lastslash ? lastslash + 1 : path;
 }
 
-void destroy_all_symbol_entries(void){
-    if(!debuggee->symbols)
-        return;
+/* Like create_frame_string, but if vmaddr is in code which was inlined,
+ * there's a frame for every inlined function it's in, innermost first,
+ * and one for the function they were inlined into.
+ */
+void create_frame_strings(unsigned long vmaddr, char ***frstrs, int *len){
+    *frstrs = NULL;
+    *len = 0;
+
+    void **stack = NULL;
+    int stacklen = 0;
+
+    void *dwarfinfo = NULL;
+    uint64_t slide = 0;
+    int locked = 0;
+
+    if(debuggee->symbols &&
+            dwarfreg_find_by_pc(vmaddr, &dwarfinfo, &slide) == 0){
+        /* Keeps the DIEs in stack from being discarded while we use them */
+        sym_lock(dwarfinfo);
+        locked = 1;
+
+        if(sym_get_inline_stack_by_pc(dwarfinfo, vmaddr - slide, &stack,
+                    &stacklen, NULL) || stacklen < 2){
+            sym_unlock(dwarfinfo);
+            locked = 0;
+        }
+    }
 
-    struct node *current = debuggee->symbols->front;
+    if(!locked){
+        dwarfreg_release(dwarfinfo);
+        free(stack);
 
-    while(current){
-        struct dbg_sym_entry *entry = current->data;
+        *frstrs = malloc(sizeof(char *));
+        (*frstrs)[0] = NULL;
+        *len = 1;
 
-        free(entry->imagename);
-        entry->imagename = NULL;
+        create_frame_string(vmaddr, &(*frstrs)[0]);
 
-        for(int i=0; i<entry->syms->len; i++){
-            free(entry->syms->items[i]);
-            entry->syms->items[i] = NULL;
-        }
+        return;
+    }
 
-        array_destroy(&entry->syms);
+    char *imgname = NULL, *symname = NULL;
+    unsigned int symdist = 0;
 
-        current = current->next;
+    get_symbol_info_from_address(debuggee->symtable, vmaddr, &imgname,
+            &symname, &symdist);
 
-        free(entry);
-        entry = NULL;
-    }
-}
+    char *srcfile = NULL, *srcfunc = NULL;
+    uint64_t srcline = 0;
+    void *root_die = NULL;
 
-enum { SYM = 0, GC };
+    sym_get_line_info_from_pc(dwarfinfo, vmaddr - slide, &srcfile,
+            &srcfunc, &srcline, &root_die, NULL);
 
-struct goodcombo {
-    struct dbg_sym_entry *entry;
-    struct sym *sym;
-};
+    *frstrs = calloc(stacklen, sizeof(char *));
+    *len = stacklen;
 
-/* find the symbol with the closest function that starts before vmaddr */
-int bsearch_lc(struct array *arg0, unsigned long vmaddr, int lo, int hi, int which){
-    if(lo == hi){
-        unsigned long val = ((struct sym *)(arg0->items[lo]))->sym_func_start;
+    for(int i=0; i<stacklen; i++){
+        char *fxnname = NULL;
+        sym_get_die_name(stack[i], &fxnname, NULL);
 
-        if(which == GC)
-            val = ((struct goodcombo *)(arg0->items[lo]))->sym->sym_func_start;
+        /* The outermost function should match the symbol table */
+        if(i == stacklen - 1 && symname)
+            fxnname = symname;
 
-        return val > vmaddr ? -1 : lo;
-    }
+        concat(&(*frstrs)[i], "%s`%s", imgname ? imgname : "??",
+                fxnname ? fxnname : "??");
 
-    if((hi - 1) == lo){
-        unsigned long hival = ((struct sym *)(arg0->items[hi]))->sym_func_start;
-        unsigned long loval = ((struct sym *)(arg0->items[lo]))->sym_func_start;
+        if(i < stacklen - 1)
+            concat(&(*frstrs)[i], " [inlined]");
 
-        if(which == GC){
-            hival = ((struct goodcombo *)(arg0->items[hi]))->sym->sym_func_start;
-            loval = ((struct goodcombo *)(arg0->items[lo]))->sym->sym_func_start;
+        /* Every frame past the innermost one is stopped where the
+         * frame before it was inlined.
+         */
+        if(i > 0){
+            srcfile = NULL;
+            srcline = 0;
+            sym_get_die_call_site(stack[i - 1], &srcfile, &srcline, NULL);
         }
 
-        if(vmaddr >= hival)
-            return hi;
-        else if(vmaddr >= loval)
-            return lo;
-
-        return -1;
+        if(srcfile){
+            concat(&(*frstrs)[i], " at %s:%lld", basename_of(srcfile),
+                    srcline);
+        }
     }
 
-    int mid = (lo + hi) / 2;
-    unsigned long midval = ((struct sym *)(arg0->items[mid]))->sym_func_start;
-
-    if(which == GC)
-        midval = ((struct goodcombo *)(arg0->items[mid]))->sym->sym_func_start;
+    sym_unlock(dwarfinfo);
+    dwarfreg_release(dwarfinfo);
 
-    if(vmaddr < midval)
-        return bsearch_lc(arg0, vmaddr, lo, mid - 1, which);
-
-    return bsearch_lc(arg0, vmaddr, mid, hi, which);
+    free(imgname);
+    free(symname);
+    free(stack);
 }
 
-static int goodcombocmp(const void *a, const void *b){
-    struct goodcombo *gca = *(struct goodcombo **)a;
-    struct goodcombo *gcb = *(struct goodcombo **)b;
-
-    if(!gca || !gcb)
-        return 0;
+struct dbg_sym_entry *create_sym_entry(unsigned long strtab_vmaddr,
+        unsigned long strtab_fileaddr, int from_dsc){
+    struct dbg_sym_entry *entry = malloc(sizeof(struct dbg_sym_entry));
 
-    /* we could overflow if we just return gcasf - gcbsf */
-    long gcasf = (long)gca->sym->sym_func_start;
-    long gcbsf = (long)gcb->sym->sym_func_start;
+    entry->strtab_vmaddr = strtab_vmaddr;
+    entry->numsyms = 0;
+    entry->symcapacity = 0;
+    entry->sym_starts = NULL;
+    entry->sym_lens = NULL;
+    entry->sym_names = NULL;
+    entry->strtab = NULL;
+    entry->strtabsize = 0;
+    entry->from_dsc = from_dsc;
 
-    if(gcasf < gcbsf)
-        return -1;
-    else if(gcasf == gcbsf)
-        return 0;
-    else
-        return 1;
+    return entry;
 }
 
-int get_symbol_info_from_address(struct linkedlist *symlist,
-        unsigned long vmaddr, char **imgnameout, char **symnameout,
-        unsigned int *distfromsymstartout){
-    struct array *good_combos = array_new();
-
-    for(struct node *current = symlist->front;
-            current;
-            current = current->next){
-        struct dbg_sym_entry *entry = current->data;
+void destroy_all_symbol_entries(void){
+    /* It points into every entry */
+    symtable_free(debuggee->symtable);
+    debuggee->symtable = NULL;
 
-        if(entry->syms->len == 0 || vmaddr < entry->load_addr)
-            continue;
+    if(!debuggee->symbols)
+        return;
 
-        if(entry->syms->len == 1){
-            struct goodcombo *gc = malloc(sizeof(struct goodcombo));
-            gc->entry = entry;
-            gc->sym = (struct sym *)entry->syms->items[0];
+    struct node *current = debuggee->symbols->front;
 
-            array_insert(good_combos, gc);
+    while(current){
+        struct dbg_sym_entry *entry = current->data;
 
-            continue;
-        }
+        free(entry->imagename);
+        entry->imagename = NULL;
 
-        /* figure out the closest symbol to vmaddr for each entry */
-        int lo = 0, hi = entry->syms->len - 1;
-        int bestsymidx = bsearch_lc(entry->syms, vmaddr, lo, hi, SYM);
+        free(entry->sym_starts);
+        free(entry->sym_lens);
+        free(entry->sym_names);
+        free(entry->strtab);
 
-        if(bestsymidx != -1){
-            struct goodcombo *gc = malloc(sizeof(struct goodcombo));
-            gc->entry = entry;
-            gc->sym = (struct sym *)entry->syms->items[bestsymidx];
+        current = current->next;
 
-            array_insert(good_combos, gc);
-        }
+        free(entry);
+        entry = NULL;
     }
+}
+
+int get_symbol_info_from_address(struct symtable *symtable,
+        unsigned long vmaddr, char **imgnameout, char **symnameout,
+        unsigned int *distfromsymstartout){
+    struct dbg_sym_entry *best_entry = NULL;
+    unsigned int best_sym = 0;
 
     /* could happen if a thread is stopped at a bad address */
-    if(good_combos->len == 0)
+    if(symtable_lookup(symtable, vmaddr, &best_entry, &best_sym))
         return 1;
 
-    /* Prep good combo array for binary search */
-    array_qsort(good_combos, goodcombocmp);
-
-    /* out of all the candidates we have, which is the closest to vmaddr? */
-    int bestcomboidx = bsearch_lc(good_combos, vmaddr, 0, good_combos->len - 1, GC);
-
-    struct goodcombo *bestcombo =
-        (struct goodcombo *)good_combos->items[bestcomboidx];
-
-    struct dbg_sym_entry *best_entry = bestcombo->entry;
-    struct sym *best_sym = bestcombo->sym;
-
     char *symname = NULL;
+    uint32_t name = best_entry->sym_names[best_sym];
 
-    if(best_entry->from_dsc){
-        if(!IS_UNNAMED_SYMBOL(best_sym))
-            concat(&symname, "%s", best_sym->dsc_symname);
-        else{
-            concat(&symname, "iosdbg_unnamed_symbol%d",
-                    best_sym->unnamed_sym_num);
-        }
+    if(name & SYM_UNNAMED){
+        concat(&symname, "iosdbg_unnamed_symbol%d", name & ~SYM_UNNAMED);
+    }
+    else if(best_entry->from_dsc){
+        concat(&symname, "%s", (char *)DSCDATA + name);
+    }
+    else if(name < best_entry->strtabsize){
+        concat(&symname, "%s", best_entry->strtab + name);
     }
     else{
-        if(!IS_UNNAMED_SYMBOL(best_sym)){
-            int maxlen = 512;
-            symname = malloc(maxlen);
-
-            unsigned long stroff = best_entry->strtab_vmaddr + best_sym->strtabidx;
-            read_memory_at_location(stroff, symname, maxlen);
-        }
-        else{
-            concat(&symname, "iosdbg_unnamed_symbol%d",
-                    best_sym->unnamed_sym_num);
-        }
+        concat(&symname, "iosdbg_bad_symbol_name");
     }
 
-    int num_good_combos = good_combos->len;
-
-    for(int i=0; i<num_good_combos; i++)
-        free(good_combos->items[i]);
-
-    array_destroy(&good_combos);
-
     if(imgnameout)
         *imgnameout = strdup(best_entry->imagename);
     
@@ -288,11 +300,53 @@ int get_symbol_info_from_address(struct linkedlist *symlist,
         free(symname);
 
     if(distfromsymstartout)
-        *distfromsymstartout = vmaddr - best_sym->sym_func_start;
+        *distfromsymstartout = vmaddr - (best_entry->load_addr +
+                best_entry->sym_starts[best_sym]);
 
     return 0;
 }
 
+/* How many images and symbols there are, and how much memory their
+ * symbol tables and the address table take up.
+ */
+void get_symbol_memory_usage(unsigned long *numimagesout,
+        unsigned long *numsymsout, size_t *bytesout){
+    unsigned long numimages = 0, numsyms = 0;
+    size_t bytes = 0;
+
+    if(debuggee->symbols){
+        for(struct node *current = debuggee->symbols->front;
+                current;
+                current = current->next){
+            struct dbg_sym_entry *entry = current->data;
+
+            numimages++;
+            numsyms += entry->numsyms;
+            bytes += sizeof(struct dbg_sym_entry) +
+                (entry->symcapacity * 3 * sizeof(uint32_t)) +
+                entry->strtabsize;
+        }
+    }
+
+    size_t tablebytes = 0;
+    symtable_get_usage(debuggee->symtable, NULL, &tablebytes);
+
+    *numimagesout = numimages;
+    *numsymsout = numsyms;
+    *bytesout = bytes + tablebytes;
+}
+
+/* Images are built in parallel, so unnamed symbols are numbered
+ * afterwards, one image at a time in dyld's order. That way
+ * iosdbg_unnamed_symbol<number> is the same every time.
+ */
+void number_unnamed_symbols(struct dbg_sym_entry *entry){
+    for(unsigned int i=0; i<entry->numsyms; i++){
+        if(entry->sym_names[i] & SYM_UNNAMED)
+            entry->sym_names[i] = SYM_UNNAMED | UNNAMED_SYM_CNT++;
+    }
+}
+
 void reset_unnamed_sym_cnt(void){
     UNNAMED_SYM_CNT = 1;
 }
@@ -1,6 +1,9 @@
 #ifndef _DBGSYMBOL_H_
 #define _DBGSYMBOL_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "../array.h"
 #include "../linkedlist.h"
 
@@ -35,43 +38,38 @@ struct dsc_mapping_info {
     char pad[8];
 };
 
-/* If the symbol isn't named, we'll make dsc_symname a special value to save
- * memory. This applies for non-DSC symbols as well. The following macro
- * serves to ease confusion that will come about from implementing it
- * this way. But better that than wasting hundreds of MB of memory by adding
- * another member to struct sym.
+/* sym_names of an unnamed symbol is its number with this set, so it
+ * can be called iosdbg_unnamed_symbol<number>. A named symbol's is
+ * where its name is: an index into the image's string table, or for
+ * images in the dyld shared cache, an offset into DSCDATA.
  */
-#define UNNAMED_SYMBOL ((char *)1)
-#define IS_UNNAMED_SYMBOL(x) (x->dsc_symname == UNNAMED_SYMBOL)
-
-struct sym {
-    /* pointer into debuggee's address space, the start of this function */
-    unsigned long sym_func_start;
-
-    char *dsc_symname;
-
-    /* When a symbol is unnamed, unnamed_sym_num is used.
-     * When a symbol is named, strtabidx is used.
-     * Using a union saves memory.
-     */
-    union {
-        int strtabidx;
-        int unnamed_sym_num;
-    };
-
-    unsigned int sym_func_len;
-};
+#define SYM_UNNAMED (0x80000000u)
 
 struct dbg_sym_entry {
     char *imagename;
 
-    struct array *syms;
+    /* This image's symbols, sorted by address. They're kept as arrays
+     * of 32 bit values instead of one allocation per symbol, because
+     * the shared cache has millions of them. Starts are offsets
+     * from load_addr.
+     */
+    unsigned int numsyms;
+    unsigned int symcapacity;
+    uint32_t *sym_starts;
+    uint32_t *sym_lens;
+    uint32_t *sym_names;
 
     unsigned long load_addr;
 
     /* pointer into debuggee's address space */
     unsigned long strtab_vmaddr;
 
+    /* This image's whole string table, read in once when its symbols
+     * were. NULL for shared cache images, their names are in DSCDATA.
+     */
+    char *strtab;
+    unsigned long strtabsize;
+
     /* unfortunate... */
     char from_dsc;
 };
@@ -80,13 +78,19 @@ enum {
     UNNAMED_SYM = 0, NAMED_SYM = 1
 };
 
+struct symtable;
+
 void add_symbol_to_entry(struct dbg_sym_entry *, int, unsigned long,
         unsigned int, int, char *);
 void create_frame_string(unsigned long, char **);
+void create_frame_strings(unsigned long, char ***, int *);
 struct dbg_sym_entry *create_sym_entry(unsigned long, unsigned long, int);
 void destroy_all_symbol_entries(void);
-int get_symbol_info_from_address(struct linkedlist *, unsigned long, char **,
+void get_symbol_memory_usage(unsigned long *, unsigned long *, size_t *);
+int get_symbol_info_from_address(struct symtable *, unsigned long, char **,
         char **, unsigned int *);
+void number_unnamed_symbols(struct dbg_sym_entry *);
+void reserve_symbols(struct dbg_sym_entry *, unsigned int);
 void reset_unnamed_sym_cnt(void);
 
 #endif
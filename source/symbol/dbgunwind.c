@@ -0,0 +1,343 @@
+#include <mach/mach.h>
+#include <mach-o/loader.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbgsymbol.h"
+#include "dbgunwind.h"
+#include "dwarfreg.h"
+#include "sym.h"
+#include "unwind.h"
+
+#include "../debuggee.h"
+#include "../memutils.h"
+#include "../thread.h"
+
+/* Images are added the first time a pc lands in one, and plans are
+ * kept from one backtrace to the next. Both go away on detach.
+ */
+static struct unwinder *UNWINDER = NULL;
+
+/* The stack is read a page at a time and kept for the rest of the
+ * backtrace, so a deep stack is a handful of reads instead of one
+ * for every frame.
+ */
+enum { STACK_PAGE_SIZE = 0x4000, MAX_STACK_PAGES = 64 };
+
+struct stackcache {
+    uint64_t sc_addrs[MAX_STACK_PAGES];
+    uint8_t *sc_pages[MAX_STACK_PAGES];
+    int sc_numpages;
+};
+
+/* Most frames a backtrace will show */
+enum { MAX_FRAMES = 8192 };
+
+static uint8_t *get_stack_page(struct stackcache *sc, uint64_t pageaddr){
+    for(int i=0; i<sc->sc_numpages; i++){
+        if(sc->sc_addrs[i] == pageaddr)
+            return sc->sc_pages[i];
+    }
+
+    if(sc->sc_numpages == MAX_STACK_PAGES)
+        return NULL;
+
+    uint8_t *page = malloc(STACK_PAGE_SIZE);
+
+    if(read_memory_at_location(pageaddr, page, STACK_PAGE_SIZE)){
+        free(page);
+        return NULL;
+    }
+
+    sc->sc_addrs[sc->sc_numpages] = pageaddr;
+    sc->sc_pages[sc->sc_numpages] = page;
+    sc->sc_numpages++;
+
+    return page;
+}
+
+static int read_stack(void *arg, uint64_t addr, void *buf, size_t len){
+    struct stackcache *sc = arg;
+    uint8_t *out = buf;
+
+    while(len > 0){
+        uint64_t pageaddr = addr & ~((uint64_t)STACK_PAGE_SIZE - 1);
+        uint64_t pageoff = addr - pageaddr;
+        size_t chunk = STACK_PAGE_SIZE - pageoff;
+
+        if(chunk > len)
+            chunk = len;
+
+        uint8_t *page = get_stack_page(sc, pageaddr);
+
+        if(page)
+            memcpy(out, page + pageoff, chunk);
+        else if(read_memory_at_location(addr, out, chunk))
+            return 1;
+
+        addr += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+
+    return 0;
+}
+
+static void free_stack_cache(struct stackcache *sc){
+    for(int i=0; i<sc->sc_numpages; i++)
+        free(sc->sc_pages[i]);
+
+    sc->sc_numpages = 0;
+}
+
+static struct dbg_sym_entry *find_sym_entry(uint64_t pc){
+    if(!debuggee->symbols)
+        return NULL;
+
+    struct node *current = debuggee->symbols->front;
+
+    while(current){
+        struct dbg_sym_entry *entry = current->data;
+        current = current->next;
+
+        if(entry->numsyms == 0)
+            continue;
+
+        unsigned int last = entry->numsyms - 1;
+        unsigned long lo = entry->load_addr + entry->sym_starts[0];
+        unsigned long hi = entry->load_addr + entry->sym_starts[last] +
+            entry->sym_lens[last];
+
+        if(pc >= lo && pc < hi)
+            return entry;
+    }
+
+    return NULL;
+}
+
+static uint8_t *read_section(const struct section_64 *sect,
+        uint64_t slide){
+    if(!sect || sect->size == 0)
+        return NULL;
+
+    uint8_t *data = malloc(sect->size);
+
+    if(read_memory_at_location(sect->addr + slide, data, sect->size)){
+        free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+/* uc_findimage: adds whichever image has pc in it. Compact unwind and
+ * .eh_frame come from the image as the debuggee has it mapped, and
+ * .debug_frame from its dSYM, if it has one.
+ */
+static int add_image_for_pc(void *arg, struct unwinder *uw, uint64_t pc){
+    struct dbg_sym_entry *entry = find_sym_entry(pc);
+
+    if(!entry)
+        return 1;
+
+    struct mach_header_64 hdr;
+
+    if(read_memory_at_location(entry->load_addr, &hdr, sizeof(hdr)))
+        return 1;
+
+    uint8_t *cmds = malloc(hdr.sizeofcmds);
+
+    if(read_memory_at_location(entry->load_addr + sizeof(hdr), cmds,
+                hdr.sizeofcmds)){
+        free(cmds);
+        return 1;
+    }
+
+    struct unwsects us = {0};
+    struct section_64 *unwindinfo = NULL, *ehframe = NULL;
+    uint8_t *cmd = cmds;
+
+    for(int i=0; i<hdr.ncmds; i++){
+        struct load_command *lc = (struct load_command *)cmd;
+
+        if(lc->cmdsize == 0 || cmd + lc->cmdsize > cmds + hdr.sizeofcmds)
+            break;
+
+        if(lc->cmd == LC_SEGMENT_64){
+            struct segment_command_64 *seg = (struct segment_command_64 *)lc;
+
+            if(strncmp(seg->segname, "__TEXT", sizeof(seg->segname)) == 0){
+                us.us_textlo = seg->vmaddr;
+                us.us_texthi = seg->vmaddr + seg->vmsize;
+
+                struct section_64 *sects = (struct section_64 *)(seg + 1);
+
+                for(int j=0; j<seg->nsects; j++){
+                    if(strncmp(sects[j].sectname, "__unwind_info",
+                                sizeof(sects[j].sectname)) == 0){
+                        unwindinfo = &sects[j];
+                    }
+                    else if(strncmp(sects[j].sectname, "__eh_frame",
+                                sizeof(sects[j].sectname)) == 0){
+                        ehframe = &sects[j];
+                    }
+                }
+            }
+        }
+
+        cmd += lc->cmdsize;
+    }
+
+    us.us_slide = entry->load_addr - us.us_textlo;
+
+    uint8_t *unwindinfodata = read_section(unwindinfo, us.us_slide);
+    uint8_t *ehframedata = read_section(ehframe, us.us_slide);
+
+    us.us_unwindinfo = unwindinfodata;
+    us.us_unwindinfosz = unwindinfodata ? unwindinfo->size : 0;
+
+    us.us_ehframe = ehframedata;
+    us.us_ehframeaddr = ehframedata ? ehframe->addr : 0;
+    us.us_ehframesz = ehframedata ? ehframe->size : 0;
+
+    void *dwarfinfo = NULL;
+
+    if(dwarfreg_find_by_pc(entry->load_addr, &dwarfinfo, NULL) == 0){
+        sym_get_section_data(dwarfinfo, "debug_frame", &us.us_debugframe,
+                &us.us_debugframesz, NULL);
+    }
+
+    /* This copies __debug_frame, so the dwarfinfo can go after */
+    int ret = unw_add_image(uw, &us);
+
+    dwarfreg_release(dwarfinfo);
+
+    free(unwindinfodata);
+    free(ehframedata);
+    free(cmds);
+
+    return ret;
+}
+
+static void regs_from_thread(struct machthread *t, struct unwregs *regs){
+    memset(regs, 0, sizeof(*regs));
+
+    for(int i=0; i<UNW_FP; i++)
+        regs->ur_regs[i] = t->thread_state.__x[i];
+
+    regs->ur_regs[UNW_FP] = t->thread_state.__fp;
+    regs->ur_regs[UNW_LR] = t->thread_state.__lr;
+    regs->ur_regs[UNW_SP] = t->thread_state.__sp;
+    regs->ur_pc = t->thread_state.__pc;
+    regs->ur_valid = 0xffffffff;
+}
+
+/* Gives back the pc of every frame, innermost first, and how far up
+ * the stack the unwind went. Returns how it stopped.
+ */
+static int walk_stack(struct machthread *t, struct stackcache *sc,
+        unsigned long **pcsout, int *numpcsout, uint64_t *stackhiout){
+    if(!UNWINDER)
+        UNWINDER = unw_new();
+
+    struct unwctx ctx = {
+        .uc_readmem = read_stack,
+        .uc_findimage = add_image_for_pc,
+        .uc_arg = sc
+    };
+
+    struct unwregs regs;
+    regs_from_thread(t, &regs);
+
+    unsigned long *pcs = NULL;
+    int numpcs = 0;
+    uint64_t stackhi = regs.ur_regs[UNW_SP];
+    int status = UNW_OK;
+
+    /* Without the symbol tables, no image can be added, and every pc
+     * gets the frame pointer plan. Don't keep those around once the
+     * symbol loader is done.
+     */
+    int symbolsready = debuggee->symbols != NULL;
+
+    while(status == UNW_OK && numpcs < MAX_FRAMES){
+        if(numpcs % 64 == 0)
+            pcs = realloc(pcs, sizeof(unsigned long) * (numpcs + 64));
+
+        pcs[numpcs++] = regs.ur_pc;
+
+        status = unw_step(UNWINDER, &regs, numpcs == 1, &ctx);
+
+        if(status == UNW_OK && regs.ur_regs[UNW_SP] > stackhi)
+            stackhi = regs.ur_regs[UNW_SP];
+    }
+
+    if(!symbolsready)
+        unw_flush_plans(UNWINDER);
+
+    *pcsout = pcs;
+    *numpcsout = numpcs;
+
+    if(stackhiout)
+        *stackhiout = stackhi;
+
+    return status;
+}
+
+/* Writes t's registers, the part of its stack a backtrace covers, and
+ * the unwind info of every image it went through to path, for
+ * unw_load_snapshot. t's thread state has to be current.
+ */
+int save_unwind_snapshot(struct machthread *t, const char *path){
+    struct stackcache sc = {0};
+    unsigned long *pcs = NULL;
+    int numpcs = 0;
+    uint64_t stackhi = 0;
+
+    walk_stack(t, &sc, &pcs, &numpcs, &stackhi);
+    free(pcs);
+
+    struct unwregs regs;
+    regs_from_thread(t, &regs);
+
+    /* Whatever the outermost frame saved is above where it stopped,
+     * so take the rest of that page too, if it's there.
+     */
+    uint64_t stacklo = regs.ur_regs[UNW_SP];
+    uint64_t pageend = (stackhi | (STACK_PAGE_SIZE - 1)) + 1;
+    uint64_t stacksz = pageend - stacklo;
+    uint8_t *stack = malloc(stacksz);
+
+    if(read_stack(&sc, stacklo, stack, stacksz))
+        stacksz = stackhi - stacklo;
+
+    int err = read_stack(&sc, stacklo, stack, stacksz) ||
+        unw_save_snapshot(UNWINDER, &regs, stacklo, stack, stacksz, path);
+
+    free(stack);
+    free_stack_cache(&sc);
+
+    return err;
+}
+
+/* Gives back the pc of every frame on t's stack, innermost first.
+ * Free the array when you're done with it. Returns non-zero if the
+ * unwind stopped somewhere other than the outermost frame. t's thread
+ * state has to be current.
+ */
+int unwind_thread(struct machthread *t, unsigned long **pcsout,
+        int *numpcsout){
+    struct stackcache sc = {0};
+
+    int status = walk_stack(t, &sc, pcsout, numpcsout, NULL);
+
+    free_stack_cache(&sc);
+
+    return status != UNW_END;
+}
+
+void unwinder_end(void){
+    unw_free(UNWINDER);
+    UNWINDER = NULL;
+}
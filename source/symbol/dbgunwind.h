@@ -0,0 +1,10 @@
+#ifndef _DBGUNWIND_H_
+#define _DBGUNWIND_H_
+
+#include "../thread.h"
+
+int save_unwind_snapshot(struct machthread *, const char *);
+int unwind_thread(struct machthread *, unsigned long **, int *);
+void unwinder_end(void);
+
+#endif
@@ -5,34 +5,12 @@
 
 #include <dwarf.h>
 
-#include "../expr.h"
 #include "../memutils.h"
 #include "../strext.h"
 #include "../thread.h"
 
 #include "common.h"
-
-struct dwarf_locdesc {
-    uint64_t locdesc_lopc;
-    uint64_t locdesc_hipc;
-    int locdesc_bounded;
-    Dwarf_Small locdesc_op;
-    Dwarf_Unsigned locdesc_opd1;
-    Dwarf_Unsigned locdesc_opd2;
-    Dwarf_Unsigned locdesc_opd3;
-    Dwarf_Unsigned locdesc_offsetforbranch;
-
-    struct dwarf_locdesc *locdesc_prev;
-    struct dwarf_locdesc *locdesc_next;
-};
-
-int is_locdesc_in_bounds(struct dwarf_locdesc *locdesc,
-        uint64_t pc){
-    if(!locdesc->locdesc_bounded)
-        return 1;
-
-    return pc >= locdesc->locdesc_lopc && pc < locdesc->locdesc_hipc;
-}
+#include "locexpr.h"
 
 /* #define\s+(DW_OP_\w+)\s*0x[[:xdigit:]]+ */
 static const char *get_op_name(Dwarf_Small op){
@@ -370,751 +348,96 @@ static const char *get_op_name(Dwarf_Small op){
     };
 }
 
-static char *get_register_name(Dwarf_Half op){
-    char regstr[8] = {0};
-
-    if(op < 29)
-        snprintf(regstr, sizeof(regstr), "$x%d", op);
-    else if(op == 29)
-        strcat(regstr, "$fp");
-    else if(op == 30)
-        strcat(regstr, "$lr");
-    else if(op == 31)
-        strcat(regstr, "$sp");
-
-    return strdup(regstr);
-}
+/* DWARF register numbers 0-28 are x0-x28, then fp, lr, and sp */
+static int get_register_value(void *arg, int rn, uint64_t *valout){
+    struct machthread *thread = arg;
 
-static uint64_t get_register_value(int rn){
     if(rn < 0 || rn > 31)
-        return 0;
-
-    struct machthread *focused = get_focused_thread();
+        return 1;
 
     if(rn < 29)
-        return focused->thread_state.__x[rn];
+        *valout = thread->thread_state.__x[rn];
     else if(rn == 29)
-        return focused->thread_state.__fp;
+        *valout = thread->thread_state.__fp;
     else if(rn == 30)
-        return focused->thread_state.__lr;
+        *valout = thread->thread_state.__lr;
     else
-        return focused->thread_state.__sp;
-}
-
-void add_additional_location_description(Dwarf_Half whichattr,
-        struct dwarf_locdesc **locs, struct dwarf_locdesc *add,
-        int idx){
-    struct dwarf_locdesc *current = locs[idx];
+        *valout = thread->thread_state.__sp;
 
-    while(current->locdesc_next)
-        current = current->locdesc_next;
-
-    current->locdesc_next = add;
-    add->locdesc_prev = current;
+    return 0;
 }
 
-static struct dwarf_locdesc *create_new_locdesc(int bounded,
-        uint64_t locdesc_lopc, uint64_t locdesc_hipc, Dwarf_Small op,
-        Dwarf_Unsigned opd1, Dwarf_Unsigned opd2, Dwarf_Unsigned opd3,
-        Dwarf_Unsigned offsetforbranch){
-    struct dwarf_locdesc *locdesc = calloc(1, sizeof(struct dwarf_locdesc));
-
-    if(bounded){
-        locdesc->locdesc_bounded = 1;
-
-        locdesc->locdesc_lopc = locdesc_lopc;
-        locdesc->locdesc_hipc = locdesc_hipc;
-    }
-
-    locdesc->locdesc_op = op;
-    locdesc->locdesc_opd1 = opd1;
-    locdesc->locdesc_opd2 = opd2;
-    locdesc->locdesc_opd3 = opd3;
-    locdesc->locdesc_offsetforbranch = offsetforbranch;
-
-    return locdesc;
+static int read_debuggee_memory(void *arg, uint64_t addr, void *buf,
+        size_t len){
+    return read_memory_at_location(addr, buf, len) != KERN_SUCCESS;
 }
 
-struct dwarf_locdesc *copy_locdesc(struct dwarf_locdesc *based_on){
-    if(!based_on)
-        return NULL;
-
-    struct dwarf_locdesc *root = create_new_locdesc(based_on->locdesc_bounded,
-            based_on->locdesc_lopc, based_on->locdesc_hipc,
-            based_on->locdesc_op, based_on->locdesc_opd1,
-            based_on->locdesc_opd2, based_on->locdesc_opd3,
-            based_on->locdesc_offsetforbranch);
-
-    struct dwarf_locdesc *paramcurrent = based_on->locdesc_next;
-    struct dwarf_locdesc *rootcurrent = root;
-
-    while(paramcurrent){
-        struct dwarf_locdesc *copied =
-            create_new_locdesc(paramcurrent->locdesc_bounded,
-                paramcurrent->locdesc_lopc, paramcurrent->locdesc_hipc,
-                paramcurrent->locdesc_op, paramcurrent->locdesc_opd1,
-                paramcurrent->locdesc_opd2, paramcurrent->locdesc_opd3,
-                paramcurrent->locdesc_offsetforbranch);
-        
-        rootcurrent->locdesc_next = copied;
-        copied->locdesc_prev = rootcurrent;
+/* Evaluate a compiled location expression against the focused thread.
+ * Anything that went wrong is described in outbuffer.
+ */
+int decode_location_description(void *framebase, void *locexpr,
+        uint64_t pc, char **outbuffer, int64_t *resultout){
+    struct machthread *focused = get_focused_thread();
 
-        rootcurrent = rootcurrent->locdesc_next;
-        paramcurrent = paramcurrent->locdesc_next;
+    if(!focused){
+        concat(outbuffer, "warning: no focused thread\n");
+        return 1;
     }
 
-    return root;
-}
-
-void *create_location_description(Dwarf_Small loclist_source,
-        uint64_t locdesc_lopc, uint64_t locdesc_hipc,
-        Dwarf_Small op, Dwarf_Unsigned opd1,
-        Dwarf_Unsigned opd2, Dwarf_Unsigned opd3,
-        Dwarf_Unsigned offsetforbranch){
-    int bounded = 0;
-
-    if(loclist_source == LOCATION_LIST_ENTRY)
-        bounded = 1;
-    
-    return create_new_locdesc(bounded, locdesc_lopc, locdesc_hipc,
-            op, opd1, opd2, opd3, offsetforbranch);
-}
-
-/* Returns the register DW_AT_frame_base represents */
-static char *evaluate_frame_base(struct dwarf_locdesc *framebaselocdesc){
-    Dwarf_Small op = framebaselocdesc->locdesc_op;
+    struct locctx ctx = {
+        .lc_getreg = get_register_value,
+        .lc_readmem = read_debuggee_memory,
+        .lc_arg = focused
+    };
 
-    switch(op){
-        case DW_OP_reg0...DW_OP_reg31:
-            return get_register_name(op - DW_OP_reg0);
-        case DW_OP_regx:
-            return get_register_name(framebaselocdesc->locdesc_opd1);
+    int status = loc_evaluate(locexpr, framebase, &ctx, resultout);
+
+    switch(status){
+        case LOC_OK:
+            return 0;
+        case LOC_UNSUPPORTED:
+            concat(outbuffer, "%s not implemented\n",
+                    get_op_name(loc_get_unsupported_op(locexpr)));
+            break;
+        case LOC_BAD_READ:
+            concat(outbuffer, "warning: could not read memory for"
+                    " DW_OP_deref\n");
+            break;
+        case LOC_BAD_REGISTER:
+            concat(outbuffer, "warning: location description uses a"
+                    " register we don't know about\n");
+            break;
+        case LOC_NO_FRAME_BASE:
+            concat(outbuffer, "warning: DW_OP_fbreg used without a"
+                    " frame base\n");
+            break;
         default:
-            return NULL;
+            concat(outbuffer, "warning: malformed location description\n");
+            break;
     };
-}
-
-// XXX with the help of my expression evaluator, this will evaluate DWARF
-// location descriptions
-// XXX TODO when added inside iosdbg, this will not create a string for my expression
-// evaluator, will return a computed location
-int decode_location_description(struct dwarf_locdesc *framebaselocdesc,
-        struct dwarf_locdesc *locdesc, uint64_t pc, char **outbuffer,
-        int64_t *resultout){
-    char exprstr[1024] = {0};
-
-    /* 512 to support extreme operands of DW_OP_pick */
-    intptr_t stack[512] = {0};
-    unsigned sp = 0;
-
-    struct dwarf_locdesc *ld = locdesc;
-
-    while(ld){
-        Dwarf_Small op = ld->locdesc_op;
-        Dwarf_Unsigned opd1 = ld->locdesc_opd1,
-                       opd2 = ld->locdesc_opd2,
-                       opd3 = ld->locdesc_opd3;
-
-        char operatorbuf[64] = {0};
-        char operandbuf[64] = {0};
-
-        switch(op){
-            case DW_OP_addr:
-                {
-                    //snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    snprintf(operandbuf, sizeof(operandbuf), "%#llx", opd1);
-
-                    stack[++sp] = opd1;
-
-                    break;
-                }
-            case DW_OP_deref:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), " %s", get_op_name(ld->locdesc_op));
-
-                    intptr_t addr = stack[sp];
-                    intptr_t data = 0;
-
-                    if(read_memory_at_location(addr, &data, sizeof(data))){
-                        concat(outbuffer, "warning: could not read memory at"
-                                " %#llx for DW_OP_deref\n", addr);
-                    }
-
-                    stack[++sp] = data;
-
-                    break;
-                } 
-            case DW_OP_const1u:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (uint8_t)opd1);
-                    stack[++sp] = (uint8_t)opd1;
-                    break;
-                }
-            case DW_OP_const1s:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (int8_t)opd1);
-                    stack[++sp] = (int8_t)opd1;
-                    break;
-                }
-            case DW_OP_const2u:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (uint16_t)opd1);
-                    stack[++sp] = (uint16_t)opd1;
-                    break;
-                }
-            case DW_OP_const2s:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (int16_t)opd1);
-                    stack[++sp] = (int16_t)opd1;
-                    break;
-                }
-            case DW_OP_const4u:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (uint32_t)opd1);
-                    stack[++sp] = (uint32_t)opd1;
-                    break;
-                }
-            case DW_OP_const4s:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (int32_t)opd1);
-                    stack[++sp] = (int32_t)opd1;
-                    break;
-                }
-            case DW_OP_const8u:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%lld", (uint64_t)opd1);
-                    stack[++sp] = (uint64_t)opd1;
-                    break;
-                }
-            case DW_OP_const8s:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%lld", (int64_t)opd1);
-                    stack[++sp] = (int64_t)opd1;
-                    break;
-                }
-            case DW_OP_constu:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%lld", (uint64_t)opd1);
-                    stack[++sp] = (uint64_t)opd1;
-
-                    break;
-                }
-            case DW_OP_consts:
-                {
-                    snprintf(operandbuf, sizeof(operandbuf), "%lld", (int64_t)opd1);
-                    stack[++sp] = (int64_t)opd1;
-                    break;
-                }
-            case DW_OP_dup:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    stack[sp + 1] = stack[sp];
-                    sp++;
-                    break;
-                }
-            case DW_OP_drop:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    sp--;
-                    break;
-                }
-            case DW_OP_over:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    stack[sp + 1] = stack[sp - 1];
-                    sp++;
-                    break;
-                }
-            case DW_OP_pick:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    snprintf(operandbuf, sizeof(operandbuf), "%d", (uint8_t)opd1);
-
-                    stack[sp + 1] = stack[sp - (uint8_t)opd1];
-                    sp++;
-
-                    break;
-                }
-            case DW_OP_swap:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    intptr_t t = stack[sp];
-                    stack[sp] = stack[sp - 1];
-                    stack[sp - 1] = t;
-
-                    break;
-                }
-            case DW_OP_rot:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    intptr_t t = stack[sp];
-                    stack[sp] = stack[sp - 1];
-                    stack[sp - 1] = stack[sp - 2];
-                    stack[sp - 2] = t;
-
-                    break;
-                }
-            case DW_OP_xderef:
-                {
-                    break;
-                }
-            case DW_OP_abs:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp] = llabs(stack[sp]);
-
-                    break;
-                }
-            case DW_OP_and:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] &= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_div:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] /= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_minus:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] -= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_mod:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] %= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_mul:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] *= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_neg:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp] = -stack[sp];
-
-                    break;
-                }
-            case DW_OP_not:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp] = ~stack[sp];
-
-                    break;
-                }
-            case DW_OP_or:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
 
-                    stack[sp - 1] |= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_plus:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] += stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_plus_uconst:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    snprintf(operandbuf, sizeof(operandbuf), " %ld", (intptr_t)opd1);
-
-                    stack[sp] += (intptr_t)opd1;
-
-                    break;
-                }
-            case DW_OP_shl:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] <<= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_shr:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] >>= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_shra:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] /= (1 << stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_xor:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] ^= stack[sp];
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_bra:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    int16_t skip = (int16_t)opd1;
-                    snprintf(operandbuf, sizeof(operandbuf), " %d", skip);
-
-                    intptr_t val = stack[sp];
-
-                    if(!val)
-                        break;
-
-                    if(skip < 0){
-                        while(++skip)
-                            ld = ld->locdesc_prev;
-                    }
-                    else{
-                        for(int16_t i=0; i<skip; i++)
-                            ld = ld->locdesc_next;
-                    }
-
-                    continue;
-                }
-            case DW_OP_eq:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] = (stack[sp - 1] == stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_ge:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] = (stack[sp - 1] >= stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_gt:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] = (stack[sp - 1] > stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_le:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] = (stack[sp - 1] <= stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_lt:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] = (stack[sp - 1] < stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_ne:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    stack[sp - 1] = (stack[sp - 1] != stack[sp]);
-                    sp--;
-
-                    break;
-                }
-            case DW_OP_skip:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-
-                    int16_t skip = (int16_t)opd1;
-                    snprintf(operandbuf, sizeof(operandbuf), " %d", skip);
-
-                    if(skip < 0){
-                        while(++skip)
-                            ld = ld->locdesc_prev;
-                    }
-                    else{
-                        for(int16_t i=0; i<skip; i++)
-                            ld = ld->locdesc_next;
-                    }
-
-                    continue;
-                }
-            case DW_OP_lit0...DW_OP_lit31:
-                {
-                    stack[++sp] = op - DW_OP_lit0;
-                    break;
-                }
-            case DW_OP_reg0...DW_OP_reg31:
-                {
-                    char *regname = get_register_name(op - DW_OP_reg0);
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", regname);
-                    free(regname);
-
-                    stack[++sp] = get_register_value(op - DW_OP_reg0);
-
-                    break;
-                }
-            case DW_OP_breg0...DW_OP_breg31:
-                {
-                    char *regname = get_register_name(op - DW_OP_breg0);
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", regname);
-                    free(regname);
-
-                    snprintf(operandbuf, sizeof(operandbuf), "%+lld", (Dwarf_Signed)opd1);
-
-                    stack[++sp] = get_register_value(op - DW_OP_breg0) +
-                        (Dwarf_Signed)opd1;
-
-                    break;
-                }
-            case DW_OP_regx:
-                {
-                    char *regname = get_register_name(opd1);
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", regname);
-                    free(regname);
-
-                    stack[++sp] = get_register_value(opd1);
-
-                    break;
-                }
-            case DW_OP_fbreg:
-                {
-                    // XXX why is this here again?
-                    memset(operatorbuf, 0, sizeof(operatorbuf));
-
-                    /* Fetch what fbreg actually is */
-                    char *fbregexpr = evaluate_frame_base(framebaselocdesc);
-
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", fbregexpr);
-                    snprintf(operandbuf, sizeof(operandbuf), "%+lld", opd1);
-
-                    char *expr = NULL, *e = NULL;
-                    concat(&expr, "%s%+lld", fbregexpr, (Dwarf_Signed)opd1);
-
-                    free(fbregexpr);
-
-                    intptr_t result = eval_expr(expr, &e);
-
-                    if(e){
-                        concat(outbuffer, "warning: could not evaluate"
-                                " '%s' for DW_OP_fbreg\n", expr);
-                    }
-
-                    free(e);
-                    free(expr);
-
-                    stack[++sp] = result;
-
-                    break;
-                }
-            case DW_OP_bregx:
-                {
-                    char *regname = get_register_name(opd1);
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", regname);
-                    free(regname);
-                    
-                    snprintf(operandbuf, sizeof(operandbuf), "%+lld", (Dwarf_Signed)opd2);
-
-                    stack[++sp] = get_register_value(opd1) + (Dwarf_Signed)opd2;
-
-                    break;
-                }
-            case DW_OP_piece:
-                {
-                    concat(outbuffer, "DW_OP_piece not implemented\n");
-                    break;
-                }
-            case DW_OP_deref_size:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    uint8_t deref_size = (uint8_t)opd1;
-
-                    snprintf(operandbuf, sizeof(operandbuf), " %d", deref_size);
-
-                    intptr_t addr = stack[sp];
-                    intptr_t data = 0;
-
-                    if(read_memory_at_location(addr, &data, sizeof(data))){
-                        concat(outbuffer, "warning: could not read memory at"
-                                " %#llx for DW_OP_deref_size\n", addr);
-                    }
-
-                    switch(deref_size){
-                        case 1:
-                            stack[++sp] = *(uint8_t *)&data;
-                            break;
-                        case 2:
-                            stack[++sp] = *(uint16_t *)&data;
-                            break;
-                        case 3:
-                            stack[++sp] = data & 0xffffff;
-                            break;
-                        case 4:
-                            stack[++sp] = *(uint32_t *)&data;
-                            break;
-                        case 5:
-                            stack[++sp] = data & 0xffffffffffULL;
-                            break;
-                        case 6:
-                            stack[++sp] = data & 0xffffffffffffULL;
-                            break;
-                        case 7:
-                            stack[++sp] = data & 0xffffffffffffffULL;
-                            break;
-                        case 8:
-                            stack[++sp] = data;
-                            break;
-                        default:
-                            {
-                                concat(outbuffer, "warning: second operand for"
-                                        " DW_OP_deref_size is 0\n");
-                                break;
-                            }
-                    };
-
-                    break;
-                }
-            case DW_OP_xderef_size:
-                {
-                    concat(outbuffer, "DW_OP_xderef_size not implemented\n");
-                    break;
-                }
-            case DW_OP_nop:
-                {
-                    break;
-                }
-            case DW_OP_push_object_address:
-                {
-                    concat(outbuffer, "DW_OP_push_object_address not implemented\n");
-                    break;
-                }
-            case DW_OP_call2:
-                {
-                    concat(outbuffer, "DW_OP_call2 not implemented\n");
-                    break;
-                }
-            case DW_OP_call4:
-                {
-                    concat(outbuffer, "DW_OP_call4 not implemented\n");
-                    break;
-                }
-            case DW_OP_call_ref:
-                {
-                    concat(outbuffer, "DW_OP_call_ref not implemented\n");
-                    break;
-                }
-            case DW_OP_form_tls_address:
-                {
-                    concat(outbuffer, "DW_OP_form_tls_address not implemented\n");
-                    break;
-                }
-            case DW_OP_call_frame_cfa:
-                {
-                    concat(outbuffer, "DW_OP_call_frame_cfa not implemented\n");
-                    break;
-                }
-            case DW_OP_bit_piece:
-                {
-                    concat(outbuffer, "DW_OP_bit_piece not implemented\n");
-                    break;
-                }
-            case DW_OP_implicit_value:
-                {
-                    concat(outbuffer, "DW_OP_implicit_value not implemented\n");
-                    break;
-                }
-            case DW_OP_stack_value:
-                {
-                    snprintf(operatorbuf, sizeof(operatorbuf), "%s", get_op_name(ld->locdesc_op));
-                    goto done;
-                }
-            default:
-                {
-                    concat(outbuffer, "Unhanded DWARF operation %#x\n", op);
-                    break;
-                }
-        };
-
-        strcat(exprstr, operatorbuf);
-        strcat(exprstr, operandbuf);
-
-        ld = ld->locdesc_next;
-        continue;
-done:
-        break;
-    }
-
-    *resultout = stack[sp];
-
-    return 0;
+    return 1;
 }
 
-void *get_next_location_description(struct dwarf_locdesc *ld){
-    if(!ld)
-        return NULL;
+/* Evaluate the location of every variable in a frame of the focused
+ * thread and read their values, see loc_evaluate_frame.
+ */
+int decode_frame_variables(void **framebases, void **locexprs,
+        int numvars, char **outbuffer, struct framevar *vars){
+    struct machthread *focused = get_focused_thread();
 
-    return ld->locdesc_next;
-}
+    if(!focused){
+        concat(outbuffer, "warning: no focused thread\n");
+        return 1;
+    }
 
-void initialize_die_loclists(struct dwarf_locdesc ***locdescs,
-        Dwarf_Unsigned lcount){
-    *locdescs = calloc(lcount, sizeof(struct dwarf_locdesc));
-}
+    struct locctx ctx = {
+        .lc_getreg = get_register_value,
+        .lc_readmem = read_debuggee_memory,
+        .lc_arg = focused
+    };
 
-void loc_free(struct dwarf_locdesc *locdesc){
-    struct dwarf_locdesc *current = locdesc;
+    loc_evaluate_frame(locexprs, framebases, numvars, &ctx, vars);
 
-    while(current){
-        struct dwarf_locdesc *f = current;
-        current = current->locdesc_next;
-        free(f);
-    }
+    return 0;
 }
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,12 +6,18 @@
 #include <dwarf.h>
 #include <libdwarf.h>
 
+#include "../hashtable.h"
 #include "../strext.h"
 
+#include "arena.h"
 #include "common.h"
 #include "compunit.h"
 #include "dexpr.h"
+#include "linetable.h"
+#include "locexpr.h"
+#include "strpool.h"
 #include "symerr.h"
+#include "typecache.h"
 
 typedef struct die die_t;
 
@@ -29,89 +36,165 @@ struct arrdim {
     unsigned int sz;
 };
 
-struct die {
-    Dwarf_Die die_dwarfdie;
-    Dwarf_Unsigned die_dieoffset;
+/* A PC range covered by a subprogram, inlined subroutine, or lexical
+ * block. A compilation unit keeps every one of these sorted by low PC
+ * so the innermost scope holding a PC can be binary searched. Scopes
+ * nest, so if the closest one starting at or before a PC doesn't hold
+ * it, the one that does has to be one of the scopes enclosing it.
+ */
+struct scope {
+    uint64_t sc_lopc;
+    uint64_t sc_hipc;
+    die_t *sc_die;
+    /* Index of the closest scope enclosing this one, or -1 */
+    int sc_outer;
+    /* How deep sc_die is in the tree */
+    int sc_depth;
+};
 
-    /* If this DIE represents a compilation unit, the following
-     * two are non-NULL.
+/* How a data type is laid out. Resolved once per type DIE offset and
+ * shared by every variable and parameter of that type, see
+ * typecache.c. Never freed while the dwarfinfo is around.
+ */
+struct typelayout {
+    Dwarf_Unsigned tl_basedieoffset;
+    Dwarf_Half tl_tag;
+    /* DW_ATE_* */
+    Dwarf_Half tl_encoding;
+    Dwarf_Unsigned tl_bytesize;
+    char *tl_name;
+    /* If we have an array, we need to know the size of each element,
+     * not just the overall size of the array.
      */
-    Dwarf_Line *die_srclines;
-    Dwarf_Signed die_srclinescnt;
-
-    Dwarf_Half die_tag;
-    char *die_tagname;
+    Dwarf_Unsigned tl_arrmembsz;
+    /* Array of array dimensions */
+    struct arrdim **tl_arrdims;
+    int tl_arrdimslen;
+    /* High level data type classification. Really, we are only interested
+     * in if this data type DIE represents a pointer, struct, union,
+     * array, or base type.
+     */
+    unsigned int tl_class : 5;
+};
 
-    /* If this DIE represents an anonymous type. */
-    int die_anon;
+/* Never written to */
+static struct typelayout notype;
 
-    /* If this DIE represents a lexical block. */
-    int die_lexblock;
+/* One entry of a DIE's location list. A DIE with a single location
+ * expression has one entry covering every PC.
+ */
+struct loclistent {
+    uint64_t ll_lopc;
+    uint64_t ll_hipc;
+    void *ll_expr;
+};
 
-    char *die_diename;
+/* Everything about a DIE that only matters once we're looking at that
+ * DIE in particular. Most DIEs in the tree are never looked at past
+ * their tag, name, PC range, and children, so this is kept out of
+ * struct die, and DIEs that have nothing to put here share nocold.
+ */
+struct diecold {
+    /* If this DIE represents a compilation unit, this is its decoded
+     * line number program.
+     */
+    void *dc_linetable;
 
-    Dwarf_Half die_haschildren;
+    /* If this DIE represents a compilation unit, this maps the offset
+     * of every DIE in its tree to that DIE.
+     */
+    struct hashtable *dc_offsetidx;
 
-    /* non-NULL when this die is a parent */
-    /* NULL terminated array of children */
-    die_t **die_children;
-    int die_numchildren;
+    /* If this DIE represents a compilation unit, every other DIE in
+     * its tree, along with their children arrays, array dimensions,
+     * location descriptions, and cold records, is allocated from
+     * this arena.
+     */
+    void *dc_arena;
 
-    /* non-NULL when this die is a child */
-    die_t *die_parent;
+    /* If this DIE represents a compilation unit, every PC range of every
+     * subprogram, inlined subroutine, and lexical block in its tree,
+     * see struct scope. Allocated from dc_arena.
+     */
+    struct scope *dc_scopes;
+    int dc_numscopes;
 
     /* If this DIE describes any sort of variable/parameter in the
-     * debugged program, the following ten are initialized.
+     * debugged program, these are initialized. Never NULL, DIEs
+     * without a data type point to notype.
      */
-    Dwarf_Unsigned die_datatypedieoffset;
-    Dwarf_Unsigned die_basedatatypedieoffset;
-    Dwarf_Die die_datatypedie;
-    Dwarf_Half die_datatypedietag;
-    /* DW_ATE_* */
-    Dwarf_Half die_datatypeencoding;
-    Dwarf_Unsigned die_databytessize;
-    char *die_datatypename;
-    /* If we have an array, we need to know the size of each element,
-     * not just the overall size of the array.
+    Dwarf_Unsigned dc_datatypedieoffset;
+    struct typelayout *dc_type;
+
+    /* If this DIE represents an inlined subroutine, or the out of line
+     * copy of an inlined function, this is initialized
      */
-    Dwarf_Unsigned die_arrmembsz;
-    /* Array of array dimensions */
-    struct arrdim **die_arrdims;
-    int die_arrdimslen;
-    /* High level data type classification. Really, we are only interested
-     * in if this data type DIE represents a pointer, struct, union,
-     * array, or base type.
+    Dwarf_Unsigned dc_aboriginoff;
+
+    /* If this DIE represents an inlined subroutine, where it was
+     * inlined. dc_callfile comes from the string pool.
      */
-    unsigned int die_datatypeclass : 5;
+    char *dc_callfile;
+    Dwarf_Unsigned dc_callline;
+
+    /* Where a member is in a structure, union, etc */
+    Dwarf_Unsigned dc_memb_off;
 
-    /* If this DIE represents an inlined subroutine, the following
-     * two are initialized.
+    /* If this DIE has the attribute DW_AT_location, the following
+     * two are initialized. Entries are sorted by low PC and their
+     * PCs are absolute, so the one for a PC can be binary searched.
      */
-    int die_inlinedsub;
-    Dwarf_Unsigned die_aboriginoff;
+    Dwarf_Unsigned dc_loclistcnt;
+    struct loclistent *dc_loclists;
+
+    /* If this DIE's tag is DW_TAG_subprogram, this will be initialized */
+    void *dc_framebaselocdesc;
+};
+
+/* Never written to */
+static struct diecold nocold = { .dc_type = &notype };
 
+struct die {
     /* Where a subroutine, lexical block, etc starts and ends */
     Dwarf_Unsigned die_low_pc;
     Dwarf_Unsigned die_high_pc;
 
-    /* Where a member is in a structure, union, etc */
-    Dwarf_Unsigned die_memb_off;
+    char *die_diename;
 
-    /* If this DIE has the attribute DW_AT_location, the following
-     * two are initialized.
-     */
-    Dwarf_Unsigned die_loclistcnt;
+    /* non-NULL when this die is a parent */
+    /* NULL terminated array of children */
+    die_t **die_children;
+    int die_numchildren;
+
+    Dwarf_Half die_tag;
+    Dwarf_Half die_haschildren;
 
-    /* Will have die_loclistcnt elements */
-    void **die_loclists;
+    /* If this DIE represents an anonymous type. */
+    unsigned int die_anon : 1;
 
-    /* If this DIE's tag is DW_TAG_subprogram, this will be initialized */
-    void *die_framebaselocdesc;
+    /* If this DIE represents a lexical block. */
+    unsigned int die_lexblock : 1;
+
+    /* If this DIE represents an inlined subroutine. */
+    unsigned int die_inlinedsub : 1;
+
+    /* If this DIE was allocated from its compilation unit's arena */
+    unsigned int die_inarena : 1;
+
+    /* non-NULL when this die is a child */
+    die_t *die_parent;
+
+    Dwarf_Unsigned die_dieoffset;
+    Dwarf_Die die_dwarfdie;
+
+    /* Never NULL, see struct diecold */
+    struct diecold *die_cold;
 };
 
 int die_get_members(die_t *, die_t *, die_t ***, int *, sym_error_t *);
 int die_pc_to_lineno(Dwarf_Debug, die_t *, uint64_t, uint64_t *, sym_error_t *);
 int die_search(die_t *, void *, int, die_t **, sym_error_t *);
+static struct scope *find_innermost_scope(die_t *, uint64_t);
 
 static int is_anonymous_type(die_t *die){
     return (die->die_tag == DW_TAG_structure_type ||
@@ -323,26 +406,92 @@ struct arrdim *create_arrdim(unsigned dim, unsigned sz){
 
 #define NON_COMPILE_TIME_CONSTANT_SIZE ((Dwarf_Unsigned)-1)
 
-static int lex_block_count = 0, anon_struct_count = 0, anon_union_count = 0,
-           anon_enum_count = 0, IS_POINTER = 0;
+/* Everything construct_die_tree keeps track of while it builds one
+ * compilation unit's tree. Each build gets its own, so more than one
+ * tree can be built at a time.
+ */
+struct dtbuild {
+    Dwarf_Debug db_dbg;
+
+    /* The closest parent DIE seen at each level */
+    die_t *db_parents[100];
+
+    /* How many DIEs the tree holds */
+    uint64_t db_numdies;
+
+    /* The root DIE's dc_offsetidx */
+    struct hashtable *db_offsetidx;
+
+    /* The root DIE's dc_arena */
+    void *db_arena;
+
+    /* The dwarfinfo's di_strpool */
+    void *db_strpool;
+
+    /* The dwarfinfo's di_typecache */
+    void *db_typecache;
+
+    /* Used to name lexical blocks and anonymous types */
+    int db_lexblockcnt;
+    int db_anonstructcnt;
+    int db_anonunioncnt;
+    int db_anonenumcnt;
+
+    /* See generate_data_type_info */
+    int db_ispointer;
+
+    /* The compilation unit's source files, for DW_AT_call_file. Only
+     * fetched once an inlined subroutine needs them.
+     */
+    Dwarf_Die db_cudie;
+    char **db_srcfiles;
+    Dwarf_Signed db_numsrcfiles;
+    int db_fetchedsrcfiles;
+    /* DWARF 5 file indexes start at 0, earlier versions at 1 */
+    int db_srcfilesbase;
+};
+
+/* Names and data type strings are kept in the dwarfinfo's string
+ * pool. These trade the copy we were given for the pooled one.
+ */
+static char *pool_dwarf_string(struct dtbuild *db, char *str){
+    if(!str)
+        return NULL;
+
+    char *pooled = (char *)strpool_add(db->db_strpool, str);
+    dwarf_dealloc(db->db_dbg, str, DW_DLA_STRING);
+
+    return pooled;
+}
+
+static char *pool_string(struct dtbuild *db, char *str){
+    if(!str)
+        return NULL;
+
+    char *pooled = (char *)strpool_add(db->db_strpool, str);
+    free(str);
+
+    return pooled;
+}
 
-static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
+static void generate_data_type_info(struct dtbuild *db, void *compile_unit,
         Dwarf_Die die, char **outtype, Dwarf_Unsigned *outsize,
         Dwarf_Half *base_tag, Dwarf_Die *base_die,
         Dwarf_Half *base_die_encoding, Dwarf_Unsigned *base_data_type_offset,
         Dwarf_Unsigned *arrmembsz, Dwarf_Half *arrmembencoding,
         unsigned int *classification, struct arrdim ***dims,
         int *dimslen, int level){
+    Dwarf_Debug dbg = db->db_dbg;
     char *die_name = get_die_name_raw(dbg, die);
     Dwarf_Half die_tag = get_die_tag_raw(dbg, die);
 
-    /* This has to be done with a global variable...
-     * This variable is used to calculate data size.
+    /* This has to be kept outside of this function...
+     * db_ispointer is used to calculate data size.
      * Once we see a pointer, we cannot disregard that fact when
      * recursing/returning.
      */
     if(die_tag == DW_TAG_pointer_type){
-        IS_POINTER = 1;
+        db->db_ispointer = 1;
 
         /* Unlikely, but prevent setting outsize after it has been set once. */
         if(*outsize == 0 && *outsize != NON_COMPILE_TIME_CONSTANT_SIZE)
@@ -354,7 +503,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
     if(die_tag == DW_TAG_formal_parameter){
         Dwarf_Die typedie = get_type_die(dbg, die);
 
-        generate_data_type_info(dbg, compile_unit, typedie,
+        generate_data_type_info(db, compile_unit, typedie,
                 outtype, outsize, base_tag, base_die, base_die_encoding,
                 base_data_type_offset, arrmembsz, arrmembencoding,
                 classification, dims, dimslen, level+1);
@@ -367,14 +516,14 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
 
     /* Function pointer */
     if(die_tag == DW_TAG_subroutine_type){
-        IS_POINTER = 1;
+        db->db_ispointer = 1;
 
         Dwarf_Die typedie = get_type_die(dbg, die);
 
         if(!typedie)
             concat(outtype, "void");
         else{
-            generate_data_type_info(dbg, compile_unit, typedie,
+            generate_data_type_info(db, compile_unit, typedie,
                     outtype, outsize, base_tag, base_die, base_die_encoding,
                     base_data_type_offset, arrmembsz, arrmembencoding,
                     classification, dims, dimslen, level+1);
@@ -394,7 +543,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
         }
 
         for(;;){
-            generate_data_type_info(dbg, compile_unit, parameter_die,
+            generate_data_type_info(db, compile_unit, parameter_die,
                     outtype, outsize, base_tag, base_die, base_die_encoding,
                     base_data_type_offset, arrmembsz, arrmembencoding,
                     classification, dims, dimslen, level+1);
@@ -425,7 +574,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
         *base_die = die;
         *base_data_type_offset = get_die_offset(dbg, die);
 
-        if(die_tag == DW_TAG_base_type && !IS_POINTER){
+        if(die_tag == DW_TAG_base_type && !db->db_ispointer){
             Dwarf_Unsigned off = get_die_offset(dbg, die);
             Dwarf_Attribute dw_at_encoding_attr = NULL;
 
@@ -447,7 +596,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
         if(die_name)
             concat(outtype, die_name);
 
-        if(!IS_POINTER){
+        if(!db->db_ispointer){
             Dwarf_Error d_error = NULL;
             int ret = dwarf_bytesize(die, outsize, &d_error);
 
@@ -491,7 +640,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
 
     Dwarf_Die typedie = get_type_die(dbg, die);
 
-    generate_data_type_info(dbg, compile_unit, typedie,
+    generate_data_type_info(db, compile_unit, typedie,
             outtype, outsize, base_tag, base_die, base_die_encoding,
             base_data_type_offset, arrmembsz, arrmembencoding,
             classification, dims, dimslen, level+1);
@@ -522,7 +671,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
                 Dwarf_Half membencoding = 0;
                 struct arrdim **dims_unused = NULL;
                 int dimslen_unused = 0;
-                generate_data_type_info(dbg, compile_unit, subrange_typedie,
+                generate_data_type_info(db, compile_unit, subrange_typedie,
                         &unused_outtype, &membsz, &unused_base_tag,
                         &unused_base_die, &membencoding,
                         &unused_base_data_type_offset, arrmembsz,
@@ -646,7 +795,7 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
         *outtype = outtype_rea;
 
         memset(*outtype + replaceat, 0, replacelen * sizeof(char));
-        strlcat(*outtype + replaceat, die_name, newlen);
+        strncat(*outtype + replaceat, die_name, newlen - replaceat - 1);
 
         return;
     }
@@ -660,41 +809,30 @@ static void generate_data_type_info(Dwarf_Debug dbg, void *compile_unit,
     concat(outtype, type_tag_string);
 }
 
-static void get_die_data_type_info(dwarfinfo_t *dwarfinfo, void *compile_unit,
-        die_t **die, int level){
-    Dwarf_Debug dbg = dwarfinfo->di_dbg;
+/* Resolve the layout of the type DIE at typeoffset and add it to the
+ * type cache.
+ */
+static struct typelayout *resolve_type_layout(struct dtbuild *db,
+        void *compile_unit, Dwarf_Unsigned typeoffset){
+    Dwarf_Debug dbg = db->db_dbg;
     Dwarf_Error d_error = NULL;
-    Dwarf_Attribute attr = NULL;
+    Dwarf_Die typedie = NULL;
 
-    int ret = dwarf_attr((*die)->die_dwarfdie, DW_AT_type, &attr, &d_error);
+    int ret = dwarf_offdie(dbg, typeoffset, &typedie, &d_error);
 
     if(ret == DW_DLV_ERROR)
         dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
 
     if(ret != DW_DLV_OK)
-        return;
-
-    ret = dwarf_global_formref(attr, &((*die)->die_datatypedieoffset),
-            &d_error);
-
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
-
-    dwarf_dealloc(dbg, attr, DW_DLA_ATTR);
-
-    ret = dwarf_offdie(dwarfinfo->di_dbg, (*die)->die_datatypedieoffset,
-            &((*die)->die_datatypedie), &d_error);
-
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        return NULL;
 
-    if(ret != DW_DLV_OK)
-        return;
+    struct typelayout tl = {0};
+    struct arrdim **dims = NULL;
+    int dimslen = 0;
 
-    dwarf_tag((*die)->die_datatypedie,
-            &((*die)->die_datatypedietag), &d_error);
+    dwarf_tag(typedie, &tl.tl_tag, &d_error);
 
-    Dwarf_Half tag = (*die)->die_datatypedietag;
+    Dwarf_Half tag = tl.tl_tag;
     Dwarf_Half base_tag = 0, base_die_encoding = 0;
     Dwarf_Die base_die = NULL;
 
@@ -704,34 +842,34 @@ static void get_die_data_type_info(dwarfinfo_t *dwarfinfo, void *compile_unit,
      * or an enum, we're done.
      */
     if(tag == DW_TAG_base_type || tag == DW_TAG_enumeration_type){
-        ret = dwarf_diename((*die)->die_datatypedie, &((*die)->die_datatypename),
-                &d_error);
+        ret = dwarf_diename(typedie, &tl.tl_name, &d_error);
 
         if(ret == DW_DLV_ERROR)
             dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        else if(ret == DW_DLV_OK)
+            tl.tl_name = pool_dwarf_string(db, tl.tl_name);
 
-        ret = dwarf_bytesize((*die)->die_datatypedie, &((*die)->die_databytessize),
-                &d_error);
+        ret = dwarf_bytesize(typedie, &tl.tl_bytesize, &d_error);
 
         if(ret == DW_DLV_ERROR)
             dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
 
         /* For some reason calling dwarf_formsdata with this attribute
-         * wipes die->die_databytessize...
+         * wipes tl.tl_bytesize...
          */
-        Dwarf_Unsigned sz = (*die)->die_databytessize;
+        Dwarf_Unsigned sz = tl.tl_bytesize;
 
         Dwarf_Attribute dw_at_encoding_attr = NULL;
 
         /* this will fail for DW_TAG_enumeration_type, who cares */
-        get_die_attribute(dbg, (*die)->die_datatypedie, DW_AT_encoding,
+        get_die_attribute(dbg, typedie, DW_AT_encoding,
                 &dw_at_encoding_attr);
 
         if(dw_at_encoding_attr){
             get_form_data_from_attr(dbg, dw_at_encoding_attr,
-                    &((*die)->die_datatypeencoding), FORMSDATA);
+                    &tl.tl_encoding, FORMSDATA);
             dwarf_dealloc(dbg, dw_at_encoding_attr, DW_DLA_ATTR);
-            (*die)->die_databytessize = sz;
+            tl.tl_bytesize = sz;
         }
     }
     else{
@@ -749,29 +887,26 @@ static void get_die_data_type_info(dwarfinfo_t *dwarfinfo, void *compile_unit,
         Dwarf_Unsigned arrmembsz = 0;
         Dwarf_Half arrmembencoding = 0;
 
-        struct arrdim **dims = NULL;
-        int dimslen = 0;
-
-        generate_data_type_info(dwarfinfo->di_dbg, compile_unit,
-                (*die)->die_datatypedie, &name, &size, &base_tag,
+        generate_data_type_info(db, compile_unit,
+                typedie, &name, &size, &base_tag,
                 &base_die, &base_die_encoding, &base_data_type_die_offset,
                 &arrmembsz, &arrmembencoding, &classification,
                 &dims, &dimslen, 0);
 
-        if(IS_POINTER)
+        if(db->db_ispointer)
             classification |= DTC_POINTER;
 
-        IS_POINTER = 0;
+        db->db_ispointer = 0;
 
-        (*die)->die_databytessize = size;
-        (*die)->die_datatypename = name;
-        (*die)->die_datatypeencoding = base_die_encoding;
-        (*die)->die_basedatatypedieoffset = base_data_type_die_offset;
-        (*die)->die_arrmembsz = arrmembsz;
-        (*die)->die_arrdims = dims;
-        (*die)->die_arrdimslen = dimslen;
+        tl.tl_bytesize = size;
+        tl.tl_name = pool_string(db, name);
+        tl.tl_encoding = base_die_encoding;
+        tl.tl_basedieoffset = base_data_type_die_offset;
+        tl.tl_arrmembsz = arrmembsz;
     }
 
+    dwarf_dealloc(dbg, typedie, DW_DLA_DIE);
+
     unsigned int c = classification;
 
     if(!(c & DTC_POINTER) && !(c & DTC_STRUCT) &&
@@ -779,31 +914,200 @@ static void get_die_data_type_info(dwarfinfo_t *dwarfinfo, void *compile_unit,
         classification |= DTC_OTHER;
     }
 
-    (*die)->die_datatypeclass = classification;
+    tl.tl_class = classification;
+
+    /* Pointers to the dimensions, then the dimensions they point to */
+    struct typelayout *cached = typecache_alloc(db->db_typecache,
+            sizeof(struct typelayout) +
+            dimslen * (sizeof(struct arrdim *) + sizeof(struct arrdim)));
+
+    *cached = tl;
+
+    if(dims){
+        struct arrdim **cacheddims = (struct arrdim **)(cached + 1);
+        struct arrdim *cacheddim = (struct arrdim *)(cacheddims + dimslen);
+
+        for(int i=0; i<dimslen; i++){
+            cacheddim[i] = *dims[i];
+            cacheddims[i] = &cacheddim[i];
+            free(dims[i]);
+        }
+
+        free(dims);
+
+        cached->tl_arrdims = cacheddims;
+        cached->tl_arrdimslen = dimslen;
+    }
+
+    return typecache_insert(db->db_typecache, typeoffset, cached);
 }
 
-static die_t *CUR_PARENTS[100] = {0};
+/* attr is the DIE's DW_AT_type */
+static void get_die_data_type_info(struct dtbuild *db, void *compile_unit,
+        die_t **die, Dwarf_Attribute attr, int level){
+    struct diecold *cold = (*die)->die_cold;
+    Dwarf_Debug dbg = db->db_dbg;
+    Dwarf_Error d_error = NULL;
 
-static void copy_location_lists(Dwarf_Debug dbg, die_t **die,
-        Dwarf_Half whichattr, int level){
-    Dwarf_Attribute attr = NULL;
-    get_die_attribute(dbg, (*die)->die_dwarfdie, whichattr, &attr);
+    int ret = dwarf_global_formref(attr, &(cold->dc_datatypedieoffset),
+            &d_error);
 
-    if(!attr)
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+    if(ret != DW_DLV_OK)
         return;
 
+    /* The same types are used over and over, only resolve them once */
+    struct typelayout *tl = typecache_find(db->db_typecache,
+            cold->dc_datatypedieoffset);
+
+    if(!tl){
+        tl = resolve_type_layout(db, compile_unit,
+                cold->dc_datatypedieoffset);
+    }
+
+    if(tl)
+        cold->dc_type = tl;
+}
+
+static int loclistent_cmp(const void *a, const void *b){
+    const struct loclistent *la = a;
+    const struct loclistent *lb = b;
+
+    if(la->ll_lopc != lb->ll_lopc)
+        return la->ll_lopc < lb->ll_lopc ? -1 : 1;
+
+    if(la->ll_hipc != lb->ll_hipc)
+        return la->ll_hipc < lb->ll_hipc ? -1 : 1;
+
+    return 0;
+}
+
+static int addr_from_index(struct dtbuild *db, Dwarf_Unsigned idx,
+        uint64_t *addrout){
+    Dwarf_Addr addr = 0;
+    Dwarf_Error d_error = NULL;
+
+    if(!db->db_cudie)
+        return 1;
+
+    int ret = dwarf_debug_addr_index_to_addr(db->db_cudie, idx, &addr,
+            &d_error);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(db->db_dbg, d_error, DW_DLA_ERROR);
+
+    if(ret != DW_DLV_OK)
+        return 1;
+
+    *addrout = addr;
+    return 0;
+}
+
+/* Figures out which PCs a location list entry covers. libdwarf hands
+ * back the entry's raw operands: .debug_loc entries are offsets from
+ * the base address, split DWARF 4 and DWARF 5 entries are decoded by
+ * their kind. DW_LLEX_* and DW_LLE_* agree on kinds 0 through 4.
+ * Returns 1 for entries that don't cover any PC, like the ones that
+ * only change the base address.
+ */
+static int loclist_entry_bounds(struct dtbuild *db, Dwarf_Small source,
+        Dwarf_Small lle_value, Dwarf_Addr lopc, Dwarf_Addr hipc,
+        uint64_t *base, uint64_t *lopcout, uint64_t *hipcout){
+    uint64_t lo = 0, hi = 0;
+
+    if(source == LOCATION_LIST_ENTRY){
+        /* Base address selection */
+        if(lopc == UINT64_MAX || lopc == UINT32_MAX){
+            *base = hipc;
+            return 1;
+        }
+
+        lo = *base + lopc;
+        hi = *base + hipc;
+    }
+    else{
+        switch(lle_value){
+            case DW_LLE_base_addressx:
+                addr_from_index(db, lopc, base);
+                return 1;
+            case DW_LLE_base_address:
+                *base = lopc;
+                return 1;
+            case DW_LLE_startx_endx:
+                if(addr_from_index(db, lopc, &lo) ||
+                        addr_from_index(db, hipc, &hi)){
+                    return 1;
+                }
+
+                break;
+            case DW_LLE_startx_length:
+                if(addr_from_index(db, lopc, &lo))
+                    return 1;
+
+                hi = lo + hipc;
+                break;
+            case DW_LLE_offset_pair:
+                lo = *base + lopc;
+                hi = *base + hipc;
+                break;
+            case DW_LLE_start_end:
+                lo = lopc;
+                hi = hipc;
+                break;
+            case DW_LLE_start_length:
+                lo = lopc;
+                hi = lopc + hipc;
+                break;
+            /* End of list, and DW_LLE_default_location, which would
+             * overlap every other entry.
+             */
+            default:
+                return 1;
+        }
+    }
+
+    if(hi <= lo)
+        return 1;
+
+    *lopcout = lo;
+    *hipcout = hi;
+
+    return 0;
+}
+
+/* attr is the DIE's DW_AT_location or DW_AT_frame_base, whichattr
+ * says which.
+ */
+static void copy_location_lists(struct dtbuild *db, die_t **die,
+        Dwarf_Attribute attr, Dwarf_Half whichattr){
+    struct diecold *cold = (*die)->die_cold;
+    Dwarf_Debug dbg = db->db_dbg;
     Dwarf_Error d_error = NULL;
     Dwarf_Loc_Head_c loclisthead = NULL;
 
-    int lret = dwarf_get_loclist_c(attr, &loclisthead,
-            &((*die)->die_loclistcnt), &d_error);
+    Dwarf_Unsigned lcount = 0;
+    int lret = dwarf_get_loclist_c(attr, &loclisthead, &lcount, &d_error);
 
-    dwarf_dealloc(dbg, attr, DW_DLA_ATTR);
+    void *arena = (*die)->die_inarena ? db->db_arena : NULL;
 
     if(lret == DW_DLV_OK){
-        Dwarf_Unsigned lcount = (*die)->die_loclistcnt;
+        struct loclistent *ents = NULL;
+        int numents = 0;
+
+        if(whichattr == DW_AT_location)
+            ents = malloc(lcount * sizeof(struct loclistent));
+
+        /* Location list entries are usually offsets from a base
+         * address, which starts as the compilation unit's low PC and
+         * can be changed by the list itself.
+         */
+        die_t *cudie = db->db_parents[0];
+        uint64_t base = cudie ? cudie->die_low_pc : 0;
 
-        initialize_die_loclists(&((*die)->die_loclists), lcount);
+        struct locrawop *raw = NULL;
+        int rawcapacity = 0;
 
         for(Dwarf_Unsigned i=0; i<lcount; i++){
             Dwarf_Small loclist_source = 0, lle_value = 0;
@@ -818,148 +1122,381 @@ static void copy_location_lists(Dwarf_Debug dbg, die_t **die,
                     i, &lle_value, &lopc, &hipc, &ulocentry_count,
                     &locentry, &loclist_source, &section_offset,
                     &locdesc_offset, &d_error);
-            if(lret == DW_DLV_OK){
-                for(Dwarf_Unsigned j=0; j<ulocentry_count; j++){
-                    Dwarf_Small op = 0;
-                    Dwarf_Unsigned opd1 = 0, opd2 = 0, opd3 = 0,
-                                   offsetforbranch = 0;
-
-                    /* d_error is still NULL */
-
-                    int opret = dwarf_get_location_op_value_c(locentry,
-                            j, &op, &opd1, &opd2, &opd3, &offsetforbranch,
-                            &d_error);
-
-                    if(opret == DW_DLV_OK){
-                        uint64_t cudie_lopc = 0, cudie_hipc = 0;
-
-                        /* Low and high PC values here are based off the
-                         * compilation unit's (or root DIE) low PC value when
-                         * loclist_source == LOCATION_LIST_ENTRY. Otherwise,
-                         * lle_value, lopc, and hipc aren't of any use to us.
-                         */
-                        if(loclist_source == LOCATION_LIST_ENTRY){
-                            die_t *cudie = CUR_PARENTS[0];
-
-                            cudie_lopc = cudie->die_low_pc;
-                            cudie_hipc = cudie->die_high_pc;
-                        }
-
-                        uint64_t locdesc_lopc = lopc + cudie_lopc;
-                        uint64_t locdesc_hipc = hipc + cudie_lopc;
-
-                        void *locdesc =
-                            create_location_description(loclist_source,
-                                    locdesc_lopc, locdesc_hipc, op, opd1,
-                                    opd2, opd3, offsetforbranch);
-
-                        if(j > 0){
-                            add_additional_location_description(whichattr,
-                                    (*die)->die_loclists, locdesc, i);
-                        }
-                        else{
-                            if(whichattr == DW_AT_location)
-                                (*die)->die_loclists[i] = locdesc;
-                            else if(whichattr == DW_AT_frame_base)
-                                (*die)->die_framebaselocdesc = locdesc;
-                        }
-                    }
-                    else{
-                        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
-                    }
-                }
-            }
-            else{
+
+            if(lret != DW_DLV_OK){
                 dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+                continue;
             }
-        }
-    }
 
-    dwarf_loc_head_c_dealloc(loclisthead);
+            /* Only a lone location expression covers every PC */
+            uint64_t entlopc = 0, enthipc = UINT64_MAX;
 
-    /* If this DIE is the child of a subroutine DIE, initialize its
-     * frame base location description.
-     */
-    if((*die)->die_tag != DW_TAG_subprogram && level > 0){
-        int pos = level;
-        die_t *curparent = CUR_PARENTS[pos];
+            if(loclist_source != LOCATION_EXPRESSION &&
+                    loclist_entry_bounds(db, loclist_source, lle_value,
+                        lopc, hipc, &base, &entlopc, &enthipc)){
+                continue;
+            }
 
-        while(pos >= 0 &&
-                (!curparent || curparent->die_tag != DW_TAG_subprogram)){
-            curparent = CUR_PARENTS[pos--];
-        }
+            if(ulocentry_count > rawcapacity){
+                rawcapacity = ulocentry_count;
+                raw = realloc(raw, rawcapacity * sizeof(struct locrawop));
+            }
 
-        if(curparent->die_tag == DW_TAG_subprogram){
-            (*die)->die_framebaselocdesc =
-                copy_locdesc(curparent->die_framebaselocdesc);
-        }
-    }
-}
+            int numraw = 0;
 
-static int copy_die_info(dwarfinfo_t *dwarfinfo, void *compile_unit,
-        die_t **die, int level){
-    Dwarf_Debug dbg = dwarfinfo->di_dbg;
-    Dwarf_Error d_error = NULL;
+            for(Dwarf_Unsigned j=0; j<ulocentry_count; j++){
+                Dwarf_Small op = 0;
+                Dwarf_Unsigned opd1 = 0, opd2 = 0, opd3 = 0,
+                               offsetforbranch = 0;
 
-    int ret = dwarf_diename((*die)->die_dwarfdie, &((*die)->die_diename),
-            &d_error);
+                /* d_error is still NULL */
 
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+                int opret = dwarf_get_location_op_value_c(locentry,
+                        j, &op, &opd1, &opd2, &opd3, &offsetforbranch,
+                        &d_error);
 
-    ret = dwarf_dieoffset((*die)->die_dwarfdie, &((*die)->die_dieoffset),
-            &d_error);
+                if(opret != DW_DLV_OK){
+                    dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+                    continue;
+                }
 
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+                raw[numraw].lr_op = op;
+                raw[numraw].lr_opd1 = opd1;
+                raw[numraw].lr_opd2 = opd2;
+                raw[numraw].lr_opd3 = opd3;
+                raw[numraw].lr_offset = offsetforbranch;
+                numraw++;
+            }
 
-    dwarf_tag((*die)->die_dwarfdie, &((*die)->die_tag), &d_error);
+            /* Compiled once here so evaluating it never has to
+             * decode anything, see locexpr.c.
+             */
+            void *locexpr = loc_compile(arena, raw, numraw);
 
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+            if(whichattr == DW_AT_location){
+                ents[numents].ll_lopc = entlopc;
+                ents[numents].ll_hipc = enthipc;
+                ents[numents].ll_expr = locexpr;
+                numents++;
+            }
+            else if(whichattr == DW_AT_frame_base &&
+                    !cold->dc_framebaselocdesc){
+                cold->dc_framebaselocdesc = locexpr;
+            }
+            else if(!arena){
+                loc_free(locexpr);
+            }
+        }
 
-    if(is_anonymous_type(*die)){
-        (*die)->die_anon = 1;
+        free(raw);
 
-        const char *type = "STRUCT";
-        int *cnter = &anon_struct_count;
+        if(whichattr == DW_AT_location){
+            qsort(ents, numents, sizeof(struct loclistent), loclistent_cmp);
 
-        if((*die)->die_tag == DW_TAG_union_type){
-            type = "UNION";
-            cnter = &anon_union_count;
-        }
-        else if((*die)->die_tag == DW_TAG_enumeration_type){
-            type = "ENUM";
-            cnter = &anon_enum_count;
-        }
+            cold->dc_loclistcnt = numents;
 
-        concat(&((*die)->die_diename), "ANON_%s_%d", type, (*cnter)++);
+            if(arena){
+                size_t sz = numents * sizeof(struct loclistent);
+
+                cold->dc_loclists = arena_alloc(arena, sz);
+                memcpy(cold->dc_loclists, ents, sz);
+                free(ents);
+            }
+            else{
+                cold->dc_loclists = ents;
+            }
+        }
     }
-    else if(is_inlined_subroutine(*die)){
-        (*die)->die_inlinedsub = 1;
 
-        Dwarf_Attribute typeattr = NULL;
-        int ret = dwarf_attr((*die)->die_dwarfdie, DW_AT_abstract_origin,
-                &typeattr, &d_error);
+    dwarf_loc_head_c_dealloc(loclisthead);
+}
+
+/* If this DIE is the child of a subroutine DIE, initialize its frame
+ * base location description.
+ */
+static void inherit_frame_base(struct dtbuild *db, die_t **die, int level){
+    struct diecold *cold = (*die)->die_cold;
+    void *arena = (*die)->die_inarena ? db->db_arena : NULL;
 
-        if(ret == DW_DLV_OK){
-            ret = dwarf_global_formref(typeattr, &((*die)->die_aboriginoff),
-                    &d_error);
+    if((*die)->die_tag != DW_TAG_subprogram && level > 0 &&
+            !cold->dc_framebaselocdesc){
+        int pos = level;
+        die_t *curparent = db->db_parents[pos];
 
-            if(ret == DW_DLV_ERROR)
-                dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        while(pos >= 0 &&
+                (!curparent || curparent->die_tag != DW_TAG_subprogram)){
+            curparent = db->db_parents[pos--];
+        }
 
-            dwarf_dealloc(dbg, typeattr, DW_DLA_ATTR);
+        /* Both are freed with the arena, so this DIE can share its
+         * subroutine's frame base.
+         */
+        if(curparent && curparent->die_tag == DW_TAG_subprogram){
+            if(arena){
+                cold->dc_framebaselocdesc =
+                    curparent->die_cold->dc_framebaselocdesc;
+            }
+            else{
+                cold->dc_framebaselocdesc =
+                    loc_copy(curparent->die_cold->dc_framebaselocdesc);
+            }
         }
     }
+}
 
-    dwarf_get_TAG_name((*die)->die_tag, (const char **)&((*die)->die_tagname));
+/* The attributes copy_die_info looks at, picked out of a DIE's
+ * attribute list in one pass. Any of them can be NULL.
+ */
+struct dieattrs {
+    Dwarf_Attribute da_name;
+    Dwarf_Attribute da_lowpc;
+    Dwarf_Attribute da_highpc;
+    Dwarf_Attribute da_type;
+    Dwarf_Attribute da_location;
+    Dwarf_Attribute da_framebase;
+    Dwarf_Attribute da_aborigin;
+    Dwarf_Attribute da_membloc;
+    Dwarf_Attribute da_callline;
+    Dwarf_Attribute da_callfile;
+};
+
+static void sort_die_attrs(Dwarf_Debug dbg, Dwarf_Attribute *attrlist,
+        Dwarf_Signed attrcnt, struct dieattrs *da){
+    for(Dwarf_Signed i=0; i<attrcnt; i++){
+        Dwarf_Half whichattr = 0;
+        Dwarf_Error d_error = NULL;
+
+        if(dwarf_whatattr(attrlist[i], &whichattr, &d_error) != DW_DLV_OK){
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+            continue;
+        }
+
+        switch(whichattr){
+            case DW_AT_name:
+                da->da_name = attrlist[i];
+                break;
+            case DW_AT_low_pc:
+                da->da_lowpc = attrlist[i];
+                break;
+            case DW_AT_high_pc:
+                da->da_highpc = attrlist[i];
+                break;
+            case DW_AT_type:
+                da->da_type = attrlist[i];
+                break;
+            case DW_AT_location:
+                da->da_location = attrlist[i];
+                break;
+            case DW_AT_frame_base:
+                da->da_framebase = attrlist[i];
+                break;
+            case DW_AT_abstract_origin:
+                da->da_aborigin = attrlist[i];
+                break;
+            case DW_AT_data_member_location:
+                da->da_membloc = attrlist[i];
+                break;
+            case DW_AT_call_line:
+                da->da_callline = attrlist[i];
+                break;
+            case DW_AT_call_file:
+                da->da_callfile = attrlist[i];
+                break;
+            default:
+                break;
+        };
+    }
+}
+
+/* Only DIEs with one of these attributes, and compilation units, get
+ * a cold record of their own.
+ */
+static int needs_cold_record(die_t *die, struct dieattrs *da){
+    return die->die_tag == DW_TAG_compile_unit || da->da_type ||
+        da->da_location || da->da_framebase || da->da_aborigin ||
+        da->da_membloc;
+}
+
+static int is_address_form(Dwarf_Half form){
+    return form == DW_FORM_addr || form == DW_FORM_addrx ||
+        form == DW_FORM_addrx1 || form == DW_FORM_addrx2 ||
+        form == DW_FORM_addrx3 || form == DW_FORM_addrx4 ||
+        form == DW_FORM_GNU_addr_index;
+}
+
+static Dwarf_Addr get_addr_from_attr(Dwarf_Debug dbg, Dwarf_Attribute attr){
+    Dwarf_Addr addr = 0;
+    Dwarf_Error d_error = NULL;
+
+    if(dwarf_formaddr(attr, &addr, &d_error) == DW_DLV_ERROR){
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        return 0;
+    }
+
+    return addr;
+}
+
+static void fetch_srcfiles(struct dtbuild *db){
+    db->db_fetchedsrcfiles = 1;
+
+    if(!db->db_cudie)
+        return;
+
+    Dwarf_Error d_error = NULL;
+
+    int ret = dwarf_srcfiles(db->db_cudie, &db->db_srcfiles,
+            &db->db_numsrcfiles, &d_error);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(db->db_dbg, d_error, DW_DLA_ERROR);
+
+    if(ret != DW_DLV_OK){
+        db->db_srcfiles = NULL;
+        db->db_numsrcfiles = 0;
+        return;
+    }
+
+    Dwarf_Half version = 0, offsetsz = 0;
+    dwarf_get_version_of_die(db->db_cudie, &version, &offsetsz);
+
+    db->db_srcfilesbase = version >= 5 ? 0 : 1;
+}
+
+static void free_srcfiles(struct dtbuild *db){
+    for(Dwarf_Signed i=0; i<db->db_numsrcfiles; i++)
+        dwarf_dealloc(db->db_dbg, db->db_srcfiles[i], DW_DLA_STRING);
+
+    if(db->db_srcfiles)
+        dwarf_dealloc(db->db_dbg, db->db_srcfiles, DW_DLA_LIST);
+
+    db->db_srcfiles = NULL;
+    db->db_numsrcfiles = 0;
+}
+
+/* Where an inlined subroutine was inlined, so the frame it was
+ * inlined into can say what line it's on.
+ */
+static void get_call_site(struct dtbuild *db, die_t *die,
+        struct dieattrs *da){
+    Dwarf_Debug dbg = db->db_dbg;
+
+    if(da->da_callline){
+        get_form_data_from_attr(dbg, da->da_callline,
+                &die->die_cold->dc_callline, FORMUDATA);
+    }
+
+    if(!da->da_callfile)
+        return;
+
+    Dwarf_Unsigned fileno = 0;
+    get_form_data_from_attr(dbg, da->da_callfile, &fileno, FORMUDATA);
+
+    if(!db->db_fetchedsrcfiles)
+        fetch_srcfiles(db);
+
+    if(fileno < db->db_srcfilesbase)
+        return;
+
+    fileno -= db->db_srcfilesbase;
+
+    if(fileno >= db->db_numsrcfiles)
+        return;
+
+    die->die_cold->dc_callfile = (char *)strpool_add(db->db_strpool,
+            db->db_srcfiles[fileno]);
+}
+
+/* Every attribute we want comes out of one dwarf_attrlist, instead of
+ * a dwarf_attr or dwarf_lowpc for each that searches the DIE's
+ * abbreviation all over again.
+ */
+static int copy_die_info(struct dtbuild *db, void *compile_unit,
+        die_t **die, Dwarf_Half tag, int level){
+    Dwarf_Debug dbg = db->db_dbg;
+    Dwarf_Error d_error = NULL;
+
+    (*die)->die_tag = tag;
+
+    int ret = dwarf_dieoffset((*die)->die_dwarfdie, &((*die)->die_dieoffset),
+            &d_error);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+    Dwarf_Attribute *attrlist = NULL;
+    Dwarf_Signed attrcnt = 0;
+    struct dieattrs da = {0};
+
+    if(get_die_attrlist(dbg, (*die)->die_dwarfdie, &attrlist, &attrcnt) == 0)
+        sort_die_attrs(dbg, attrlist, attrcnt, &da);
+
+    if(da.da_name){
+        char *name = NULL;
+
+        /* Points into .debug_str, nothing to free */
+        ret = dwarf_formstring(da.da_name, &name, &d_error);
+
+        if(ret == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        else if(ret == DW_DLV_OK)
+            (*die)->die_diename = (char *)strpool_add(db->db_strpool, name);
+    }
+
+    if(needs_cold_record(*die, &da)){
+        size_t sz = sizeof(struct diecold);
+
+        if((*die)->die_inarena)
+            (*die)->die_cold = arena_alloc(db->db_arena, sz);
+        else
+            (*die)->die_cold = calloc(1, sz);
+
+        (*die)->die_cold->dc_type = &notype;
+    }
+
+    if(is_anonymous_type(*die)){
+        (*die)->die_anon = 1;
+
+        const char *type = "STRUCT";
+        int *cnter = &db->db_anonstructcnt;
+
+        if((*die)->die_tag == DW_TAG_union_type){
+            type = "UNION";
+            cnter = &db->db_anonunioncnt;
+        }
+        else if((*die)->die_tag == DW_TAG_enumeration_type){
+            type = "ENUM";
+            cnter = &db->db_anonenumcnt;
+        }
+
+        concat(&((*die)->die_diename), "ANON_%s_%d", type, (*cnter)++);
+        (*die)->die_diename = pool_string(db, (*die)->die_diename);
+    }
+    else if(is_inlined_subroutine(*die)){
+        (*die)->die_inlinedsub = 1;
+
+        if((*die)->die_cold != &nocold)
+            get_call_site(db, *die, &da);
+    }
+
+    /* Inlined subroutines and out of line copies of inlined functions
+     * are named by their abstract origin, see name_from_abstract_origins.
+     */
+    if(!(*die)->die_diename && da.da_aborigin &&
+            ((*die)->die_inlinedsub ||
+             (*die)->die_tag == DW_TAG_subprogram)){
+        ret = dwarf_global_formref(da.da_aborigin,
+                &((*die)->die_cold->dc_aboriginoff), &d_error);
+
+        if(ret == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+    }
 
     /* Label these ourselves */
     if(!(*die)->die_diename){
         if((*die)->die_tag == DW_TAG_lexical_block){
             concat(&((*die)->die_diename), "LEXICAL_BLOCK_%d",
-                    lex_block_count++);
+                    db->db_lexblockcnt++);
+            (*die)->die_diename = pool_string(db, (*die)->die_diename);
             (*die)->die_lexblock = 1;
         }
     }
@@ -967,36 +1504,54 @@ static int copy_die_info(dwarfinfo_t *dwarfinfo, void *compile_unit,
     dwarf_die_abbrev_children_flag((*die)->die_dwarfdie,
             &((*die)->die_haschildren));
 
-    get_die_data_type_info(dwarfinfo, compile_unit, die, level);
+    if(da.da_lowpc)
+        (*die)->die_low_pc = get_addr_from_attr(dbg, da.da_lowpc);
 
-    ret = dwarf_lowpc((*die)->die_dwarfdie, &((*die)->die_low_pc), &d_error);
+    (*die)->die_high_pc = (*die)->die_low_pc;
 
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+    if(da.da_highpc){
+        Dwarf_Half form = 0;
 
-    Dwarf_Half retform = 0;
-    enum Dwarf_Form_Class retformclass = 0;
-    ret = dwarf_highpc_b((*die)->die_dwarfdie, &((*die)->die_high_pc), &retform,
-            &retformclass, &d_error);
+        if(dwarf_whatform(da.da_highpc, &form, &d_error) == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
 
-    if(ret == DW_DLV_ERROR)
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        /* Since DWARF 4 this is usually an offset from the low PC */
+        if(is_address_form(form)){
+            (*die)->die_high_pc = get_addr_from_attr(dbg, da.da_highpc);
+        }
+        else{
+            Dwarf_Unsigned len = 0;
+            get_form_data_from_attr(dbg, da.da_highpc, &len, FORMUDATA);
+
+            (*die)->die_high_pc += len;
+        }
+    }
 
-    (*die)->die_high_pc += (*die)->die_low_pc;
+    if((*die)->die_cold != &nocold){
+        if(da.da_type)
+            get_die_data_type_info(db, compile_unit, die, da.da_type, level);
 
-    Dwarf_Attribute memb_attr = NULL;
-    get_die_attribute(dbg, (*die)->die_dwarfdie, DW_AT_data_member_location,
-            &memb_attr);
+        // XXX check for location list once expression evaluator is done
+        // will have to encounter this
+        if(da.da_membloc){
+            get_form_data_from_attr(dbg, da.da_membloc,
+                    &((*die)->die_cold->dc_memb_off), FORMUDATA);
+        }
+
+        if(da.da_location)
+            copy_location_lists(db, die, da.da_location, DW_AT_location);
+
+        if(da.da_framebase)
+            copy_location_lists(db, die, da.da_framebase, DW_AT_frame_base);
 
-    // XXX check for location list once expression evaluator is done
-    // will have to encounter this
-    if(memb_attr)
-        get_form_data_from_attr(dbg, memb_attr, &((*die)->die_memb_off), FORMUDATA);
+        inherit_frame_base(db, die, level);
+    }
 
-    dwarf_dealloc(dbg, memb_attr, DW_DLA_ATTR);
+    for(Dwarf_Signed i=0; i<attrcnt; i++)
+        dwarf_dealloc(dbg, attrlist[i], DW_DLA_ATTR);
 
-    copy_location_lists(dbg, die, DW_AT_location, level);
-    copy_location_lists(dbg, die, DW_AT_frame_base, level);
+    if(attrlist)
+        dwarf_dealloc(dbg, attrlist, DW_DLA_LIST);
 
     return 0;
 }
@@ -1018,13 +1573,13 @@ static int does_die_represent_what(die_t *die, int *retval, int what,
     }
 
     if(what == PTR)
-        *retval = die->die_datatypeclass & DTC_POINTER;
+        *retval = die->die_cold->dc_type->tl_class & DTC_POINTER;
     else if(what == STRUCT)
-        *retval = die->die_datatypeclass & DTC_STRUCT;
+        *retval = die->die_cold->dc_type->tl_class & DTC_STRUCT;
     else if(what == UNION)
-        *retval = die->die_datatypeclass & DTC_UNION;
+        *retval = die->die_cold->dc_type->tl_class & DTC_UNION;
     else if(what == ARRAY)
-        *retval = die->die_datatypeclass & DTC_ARRAY;
+        *retval = die->die_cold->dc_type->tl_class & DTC_ARRAY;
 
     return 0;
 }
@@ -1052,17 +1607,64 @@ static Dwarf_Half die_has_children(Dwarf_Die die){
     return result;
 }
 
-static die_t *create_new_die(dwarfinfo_t *dwarfinfo, void *compile_unit,
+static int is_tree_tag(Dwarf_Half tag){
+    const static Dwarf_Half accepted_tags[] = {
+        DW_TAG_compile_unit, DW_TAG_subprogram, DW_TAG_inlined_subroutine,
+        DW_TAG_formal_parameter, DW_TAG_enumeration_type, DW_TAG_enumerator,
+        DW_TAG_structure_type, DW_TAG_union_type, DW_TAG_member,
+        DW_TAG_variable, DW_TAG_lexical_block
+    };
+
+    size_t count = sizeof(accepted_tags) / sizeof(Dwarf_Half);
+
+    for(size_t i=0; i<count; i++){
+        if(tag == accepted_tags[i])
+            return 1;
+    }
+
+    return 0;
+}
+
+static int should_add_die_to_tree(die_t *die){
+    return is_tree_tag(die->die_tag);
+}
+
+/* DIEs which will make it into the tree come from db's arena, if it
+ * has one. Their children arrays are filled in by add_die_to_tree and
+ * moved into the arena by move_children_to_arena.
+ */
+static die_t *create_new_die(struct dtbuild *db, void *compile_unit,
         Dwarf_Die based_on, int level){
     if(!based_on)
         return NULL;
 
-    die_t *d = calloc(1, sizeof(die_t));
+    Dwarf_Half tag = 0;
+    dwarf_tag(based_on, &tag, NULL);
+
+    int accepted = is_tree_tag(tag);
+    die_t *d = NULL;
+
+    if(db->db_arena && accepted){
+        d = arena_alloc(db->db_arena, sizeof(die_t));
+        d->die_inarena = 1;
+    }
+    else{
+        d = calloc(1, sizeof(die_t));
+    }
+
     d->die_dwarfdie = based_on;
+    d->die_tag = tag;
+    d->die_cold = &nocold;
 
-    copy_die_info(dwarfinfo, compile_unit, &d, level);
+    /* Most DIEs are types construct_die_tree throws away as soon as it
+     * sees their tag, so don't decode anything else about them.
+     */
+    if(!accepted)
+        return d;
 
-    if(d->die_haschildren){
+    copy_die_info(db, compile_unit, &d, tag, level);
+
+    if(d->die_haschildren && !d->die_inarena){
         d->die_children = malloc(sizeof(die_t));
         d->die_children[0] = NULL;
 
@@ -1072,53 +1674,47 @@ static die_t *create_new_die(dwarfinfo_t *dwarfinfo, void *compile_unit,
     return d;
 }
 
-static int should_add_die_to_tree(die_t *die){
-    const static Dwarf_Half accepted_tags[] = {
-        DW_TAG_compile_unit, DW_TAG_subprogram, DW_TAG_inlined_subroutine,
-        DW_TAG_formal_parameter, DW_TAG_enumeration_type, DW_TAG_enumerator,
-        DW_TAG_structure_type, DW_TAG_union_type, DW_TAG_member,
-        DW_TAG_variable, DW_TAG_lexical_block
-    };
-
-    size_t count = sizeof(accepted_tags) / sizeof(Dwarf_Half);
-
-    for(size_t i=0; i<count; i++){
-        if(die->die_tag == accepted_tags[i])
-            return 1;
-    }
+static void add_die_to_tree(struct dtbuild *db, die_t *current, int level){
+    db->db_numdies++;
 
-    return 0;
-}
+    hashtable_insert(db->db_offsetidx, current->die_dieoffset, current);
 
-static void add_die_to_tree(die_t *current, int level){
     if(level == 0){
-        CUR_PARENTS[level] = current;
+        db->db_parents[level] = current;
         return;
     }
 
     die_t *parent = NULL;
 
     if(current->die_haschildren){
-        CUR_PARENTS[level] = current;
-        parent = CUR_PARENTS[level - 1];
+        db->db_parents[level] = current;
+        parent = db->db_parents[level - 1];
     }
     else{
         int sub = 1;
-        parent = CUR_PARENTS[level - sub];
+        parent = db->db_parents[level - sub];
 
         /* Find the closest valid parent. We could be multiple levels
          * deep without seeing `level` amount of parent DIEs.
          */
         while(!parent)
-            parent = CUR_PARENTS[level - (++sub)];
+            parent = db->db_parents[level - (++sub)];
     }
 
     if(parent){
-        die_t **children = realloc(parent->die_children,
-                (++parent->die_numchildren) * sizeof(die_t));
-        parent->die_children = children;
-        parent->die_children[parent->die_numchildren - 1] = current;
-        parent->die_children[parent->die_numchildren] = NULL;
+        int n = ++parent->die_numchildren;
+
+        /* Room for n children and NULL is kept rounded up to a power
+         * of two, so wide parents don't realloc for every child.
+         */
+        if((n & (n - 1)) == 0){
+            die_t **children = realloc(parent->die_children,
+                    2 * n * sizeof(die_t *));
+            parent->die_children = children;
+        }
+
+        parent->die_children[n - 1] = current;
+        parent->die_children[n] = NULL;
 
         current->die_parent = parent;
     }
@@ -1134,58 +1730,47 @@ static void die_free(Dwarf_Debug dbg, die_t *die, int critical){
             die->die_dwarfdie = NULL;
         }
     }
-    else{
+    else if(!die->die_inarena){
         free(die->die_children);
         die->die_children = NULL;
     }
 
-    if(die->die_srclines){
-        dwarf_srclines_dealloc(dbg, die->die_srclines, die->die_srclinescnt);
-        die->die_srclines = NULL;
-    }
+    /* Names belong to the string pool */
+    die->die_diename = NULL;
 
-    if(!die->die_anon && !die->die_lexblock){
-        if(die->die_diename)
-            dwarf_dealloc(dbg, die->die_diename, DW_DLA_STRING);
-    }
-    else{
-        free(die->die_diename);
-    }
+    struct diecold *cold = die->die_cold;
 
-    die->die_diename = NULL;
+    if(cold == &nocold)
+        return;
 
-    if(die->die_datatypedie){
-        dwarf_dealloc(dbg, die->die_datatypedie, DW_DLA_DIE);
-        die->die_datatypedie = NULL;
+    if(cold->dc_linetable){
+        lt_free(cold->dc_linetable);
+        cold->dc_linetable = NULL;
     }
 
-    /* see get_die_data_type_info */
-    if(die->die_datatypedietag == DW_TAG_base_type ||
-            die->die_datatypedietag == DW_TAG_enumeration_type){
-        dwarf_dealloc(dbg, die->die_datatypename, DW_DLA_STRING);
-    }
-    else{
-        free(die->die_datatypename);
-    }
+    hashtable_destroy(&cold->dc_offsetidx);
 
-    for(int i=0; i<die->die_arrdimslen; i++)
-        free(die->die_arrdims[i]);
-    free(die->die_arrdims);
+    /* Data type layouts belong to the type cache */
+    cold->dc_type = &notype;
 
-    die->die_arrdims = NULL;
+    /* The rest goes away with the arena */
+    if(die->die_inarena)
+        return;
 
-    for(Dwarf_Unsigned i=0; i<die->die_loclistcnt; i++)
-        loc_free(die->die_loclists[i]);
+    for(Dwarf_Unsigned i=0; i<cold->dc_loclistcnt; i++)
+        loc_free(cold->dc_loclists[i].ll_expr);
 
-    if(die->die_loclists){
-        free(die->die_loclists);
-        die->die_loclists = NULL;
-        die->die_loclistcnt = 0;
-    }
+    free(cold->dc_loclists);
+
+    if(cold->dc_framebaselocdesc)
+        loc_free(cold->dc_framebaselocdesc);
 
-    if(die->die_framebaselocdesc){
-        loc_free(die->die_framebaselocdesc);
-        die->die_framebaselocdesc = NULL;
+    /* A compilation unit's cold record holds its arena, die_tree_free
+     * frees both.
+     */
+    if(!cold->dc_arena){
+        free(cold);
+        die->die_cold = &nocold;
     }
 }
 
@@ -1205,7 +1790,7 @@ static void die_free(Dwarf_Debug dbg, die_t *die, int critical){
  * aspect of a DIE, and we're able to retrieve the info we need if
  * we already have a target DIE.
  */
-static void construct_die_tree(dwarfinfo_t *dwarfinfo, void *compile_unit,
+static void construct_die_tree(struct dtbuild *db, void *compile_unit,
         die_t *current, int level){
     int is_info = 1;
     Dwarf_Die child_die = NULL, cur_die = current->die_dwarfdie;
@@ -1220,9 +1805,9 @@ static void construct_die_tree(dwarfinfo_t *dwarfinfo, void *compile_unit,
     int critical = 0;
 
     if(should_add_die_to_tree(current))
-        add_die_to_tree(current, level);
+        add_die_to_tree(db, current, level);
     else{
-        die_free(dwarfinfo->di_dbg, current, critical);
+        die_free(db->db_dbg, current, critical);
         free(current);
         current = NULL;
     }
@@ -1231,36 +1816,39 @@ static void construct_die_tree(dwarfinfo_t *dwarfinfo, void *compile_unit,
         ret = dwarf_child(cur_die, &child_die, NULL);
 
         if(ret == DW_DLV_OK){
-            die_t *cd = create_new_die(dwarfinfo, compile_unit, child_die, level);
-            construct_die_tree(dwarfinfo, compile_unit, cd, level+1);
+            die_t *cd = create_new_die(db, compile_unit, child_die, level);
+            construct_die_tree(db, compile_unit, cd, level+1);
         }
 
         Dwarf_Die sibling_die = NULL;
-        ret = dwarf_siblingof_b(dwarfinfo->di_dbg, cur_die, is_info,
+        ret = dwarf_siblingof_b(db->db_dbg, cur_die, is_info,
                 &sibling_die, &d_error);
 
         if(ret == DW_DLV_ERROR)
-            dwarf_dealloc(dwarfinfo->di_dbg, d_error, DW_DLA_ERROR);
+            dwarf_dealloc(db->db_dbg, d_error, DW_DLA_ERROR);
         else if(ret == DW_DLV_NO_ENTRY){
             /* Discard the parent we were on */
-            CUR_PARENTS[level] = NULL;
+            db->db_parents[level] = NULL;
             return;
         }
 
         cur_die = sibling_die;
 
-        die_t *newdie = create_new_die(dwarfinfo, compile_unit, cur_die, level);
+        die_t *newdie = create_new_die(db, compile_unit, cur_die, level);
 
         if(should_add_die_to_tree(newdie))
-            add_die_to_tree(newdie, level);
+            add_die_to_tree(db, newdie, level);
         else{
-            die_free(dwarfinfo->di_dbg, newdie, critical);
+            die_free(db->db_dbg, newdie, critical);
             free(newdie);
             newdie = NULL;
         }
     }
 }
 
+/* Only the compilation unit's DIE isn't part of its arena. Everything
+ * else in the tree is released with one arena_free.
+ */
 void die_tree_free(Dwarf_Debug dbg, die_t *die, int level){
     if(!die)
         return;
@@ -1268,31 +1856,67 @@ void die_tree_free(Dwarf_Debug dbg, die_t *die, int level){
     int critical = 1;
     die_free(dbg, die, critical);
 
-    if(!die->die_haschildren)
-        return;
-    else{
+    void *arena = die->die_cold->dc_arena;
+
+    if(die->die_haschildren && die->die_children){
         int idx = 0;
         die_t *child = die->die_children[idx];
 
         while(child){
             die_tree_free(dbg, child, level+1);
-            free(die->die_children[idx]);
-            die->die_children[idx] = NULL;
             child = die->die_children[++idx];
         }
 
-        free(die->die_children);
+        if(!arena && !die->die_inarena)
+            free(die->die_children);
+
         die->die_children = NULL;
     }
+
+    if(arena){
+        arena_free(arena);
+
+        free(die->die_cold);
+        die->die_cold = &nocold;
+    }
+}
+
+/* Free everything under root_die, but keep root_die and its line
+ * table around. The tree can be built again later.
+ */
+void die_tree_discard(Dwarf_Debug dbg, die_t *root_die){
+    if(!root_die || !root_die->die_children)
+        return;
+
+    for(int i=0; i<root_die->die_numchildren; i++)
+        die_tree_free(dbg, root_die->die_children[i], 1);
+
+    if(root_die->die_cold->dc_arena){
+        arena_free(root_die->die_cold->dc_arena);
+        root_die->die_cold->dc_arena = NULL;
+    }
+    else{
+        free(root_die->die_children);
+    }
+
+    hashtable_destroy(&root_die->die_cold->dc_offsetidx);
+
+    /* These were in the arena */
+    root_die->die_cold->dc_scopes = NULL;
+    root_die->die_cold->dc_numscopes = 0;
+
+    root_die->die_children = malloc(sizeof(die_t));
+    root_die->die_children[0] = NULL;
+    root_die->die_numchildren = 0;
 }
 
 #define INDENT_INCRE (2)
 
 static int create_array_desc(die_t *die, char **desc, int curdimnum,
         int indent){
-    struct arrdim *curdim = die->die_arrdims[curdimnum];
+    struct arrdim *curdim = die->die_cold->dc_type->tl_arrdims[curdimnum];
 
-    if(curdimnum == die->die_arrdimslen-1){
+    if(curdimnum == die->die_cold->dc_type->tl_arrdimslen-1){
         for(int i=0; i<curdim->sz; i++)
             concat(desc, "%*s[%d] = [value here]\n", indent, "", i);
 
@@ -1313,18 +1937,18 @@ int die_create_variable_or_parameter_desc(die_t *die, void *cu_root_die,
     if(!die)
         return 0;
 
-    if(!(die->die_datatypeclass & DTC_POINTER)){
-        if(die->die_datatypeclass & DTC_STRUCT ||
-                die->die_datatypeclass & DTC_UNION){
+    if(!(die->die_cold->dc_type->tl_class & DTC_POINTER)){
+        if(die->die_cold->dc_type->tl_class & DTC_STRUCT ||
+                die->die_cold->dc_type->tl_class & DTC_UNION){
             die_t **members = NULL;
             int len = 0;
 
             die_get_members(die, cu_root_die, &members, &len, e);
 
-            char *typename = die->die_datatypename;
+            char *typename = die->die_cold->dc_type->tl_name;
             
             if(!typename){
-                if(die->die_datatypeclass & DTC_STRUCT)
+                if(die->die_cold->dc_type->tl_class & DTC_STRUCT)
                     typename = "(anonymous struct)";
                 else
                     typename = "(anonymous union)";
@@ -1347,24 +1971,50 @@ int die_create_variable_or_parameter_desc(die_t *die, void *cu_root_die,
         }
     }
 
-    if(die->die_datatypeclass & DTC_ARRAY){
+    if(die->die_cold->dc_type->tl_class & DTC_ARRAY){
         concat(desc, "%*s(%s) %s = {\n",
-                indent, "", die->die_datatypename, die->die_diename);
+                indent, "", die->die_cold->dc_type->tl_name, die->die_diename);
         create_array_desc(die, desc, 0, indent+INDENT_INCRE);
         concat(desc, "%*s}", indent, "");
 
         return 0;
     }
 
-    if(die->die_datatypeclass & DTC_POINTER ||
-            die->die_datatypeclass & DTC_OTHER){
+    if(die->die_cold->dc_type->tl_class & DTC_POINTER ||
+            die->die_cold->dc_type->tl_class & DTC_OTHER){
         concat(desc, "%*s(%s) %s = [value here]",
-                indent, "", die->die_datatypename, die->die_diename);
+                indent, "", die->die_cold->dc_type->tl_name, die->die_diename);
     }
 
     return 0;
 }
 
+/* Location list entries don't overlap in anything a compiler emits, so
+ * the last one starting at or before pc is the only one that could
+ * hold it.
+ */
+static struct loclistent *find_loclist_entry(die_t *die, uint64_t pc){
+    struct loclistent *ents = die->die_cold->dc_loclists;
+    int lo = 0, hi = (int)die->die_cold->dc_loclistcnt - 1, found = -1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(ents[mid].ll_lopc <= pc){
+            found = mid;
+            lo = mid + 1;
+        }
+        else{
+            hi = mid - 1;
+        }
+    }
+
+    if(found == -1 || pc >= ents[found].ll_hipc)
+        return NULL;
+
+    return &ents[found];
+}
+
 int die_evaluate_location_description(die_t *die, uint64_t pc,
         char **outbuffer, int64_t *resultout, sym_error_t *e){
     if(!die){
@@ -1377,18 +2027,104 @@ int die_evaluate_location_description(die_t *die, uint64_t pc,
         return 1;
     }
 
-    /* Iterate over all the location lists until we find the right one. */
-    for(Dwarf_Signed i=0; i<die->die_loclistcnt; i++){
-        void *current = die->die_loclists[i];
+    struct loclistent *ent = find_loclist_entry(die, pc);
 
-        if(current && !is_locdesc_in_bounds(current, pc))
-            continue;
+    /* Optimized out at this PC */
+    if(!ent)
+        return 0;
+
+    decode_location_description(die->die_cold->dc_framebaselocdesc,
+            ent->ll_expr, pc, outbuffer, resultout);
+
+    return 0;
+}
+
+/* Past these, a variable's bytes aren't read, and it comes back as
+ * LOC_BAD_READ. FRAMEVARS_MAX is for every variable of the frame
+ * put together.
+ */
+#define FRAMEVAR_MAX (0x10000)
+#define FRAMEVARS_MAX (0x100000)
+
+/* How many bytes of a variable's value to read, zero if we can't: its
+ * size is only known at runtime, or it's too big.
+ */
+static uint64_t frame_variable_size(die_t *die, uint64_t datasz){
+    uint64_t sz = die->die_cold->dc_type->tl_bytesize;
 
-        decode_location_description(die->die_framebaselocdesc,
-                current, pc, outbuffer, resultout);
-        break;
+    if(sz == NON_COMPILE_TIME_CONSTANT_SIZE || sz > FRAMEVAR_MAX ||
+            datasz + sz > FRAMEVARS_MAX){
+        return 0;
     }
 
+    return sz;
+}
+
+/* Evaluate every variable in dies at pc with decode_frame_variables.
+ * The returned array and the bytes of every variable are one
+ * allocation, so free it when you're done.
+ */
+int die_evaluate_frame_variables(die_t **dies, int numdies, uint64_t pc,
+        char **outbuffer, struct framevar **varsout, sym_error_t *e){
+    if(!dies || numdies < 0 || !varsout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    uint64_t datasz = 0;
+
+    for(int i=0; i<numdies; i++){
+        if(!dies[i]){
+            errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+            return 1;
+        }
+
+        datasz += frame_variable_size(dies[i], datasz);
+    }
+
+    struct framevar *vars = malloc((numdies * sizeof(struct framevar)) +
+            datasz);
+    uint8_t *data = (uint8_t *)(vars + numdies);
+    void **exprs = malloc(numdies * sizeof(void *));
+    void **framebases = malloc(numdies * sizeof(void *));
+    uint64_t used = 0;
+
+    for(int i=0; i<numdies; i++){
+        die_t *die = dies[i];
+        struct loclistent *ent = find_loclist_entry(die, pc);
+
+        exprs[i] = ent ? ent->ll_expr : NULL;
+        framebases[i] = die->die_cold->dc_framebaselocdesc;
+
+        vars[i].fv_size = frame_variable_size(die, used);
+        vars[i].fv_data = vars[i].fv_size > 0 ? data : NULL;
+
+        data += vars[i].fv_size;
+        used += vars[i].fv_size;
+    }
+
+    /* No thread to read from, which was described in outbuffer */
+    if(decode_frame_variables(framebases, exprs, numdies, outbuffer, vars)){
+        for(int i=0; i<numdies; i++){
+            vars[i].fv_status = LOC_BAD_REGISTER;
+            vars[i].fv_data = NULL;
+        }
+    }
+
+    for(int i=0; i<numdies; i++){
+        uint64_t sz = dies[i]->die_cold->dc_type->tl_bytesize;
+
+        if(vars[i].fv_status == LOC_OK && vars[i].fv_size == 0 && sz > 0){
+            vars[i].fv_status = LOC_BAD_READ;
+            vars[i].fv_data = NULL;
+        }
+    }
+
+    free(framebases);
+    free(exprs);
+
+    *varsout = vars;
+
     return 0;
 }
 
@@ -1403,7 +2139,7 @@ int die_get_array_elem_size(die_t *die, uint64_t *elemszout, sym_error_t *e){
         return 1;
     }
 
-    *elemszout = die->die_arrmembsz;
+    *elemszout = die->die_cold->dc_type->tl_arrmembsz;
     return 0;
 }
 
@@ -1419,7 +2155,34 @@ int die_get_array_size_determined_at_runtime(die_t *die, int *retval,
         return 1;
     }
 
-    *retval = die->die_databytessize == NON_COMPILE_TIME_CONSTANT_SIZE;
+    *retval = die->die_cold->dc_type->tl_bytesize ==
+        NON_COMPILE_TIME_CONSTANT_SIZE;
+    return 0;
+}
+
+/* Where an inlined subroutine DIE was inlined. The file name belongs
+ * to the string pool and must not be freed.
+ */
+int die_get_call_site(die_t *die, char **fileout, uint64_t *lineout,
+        sym_error_t *e){
+    if(!die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
+    }
+
+    if(!fileout || !lineout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    if(!die->die_inlinedsub || !die->die_cold->dc_callfile){
+        errset(e, DIE_ERROR_KIND, DIE_COULD_NOT_GET_LINE_INFO);
+        return 1;
+    }
+
+    *fileout = die->die_cold->dc_callfile;
+    *lineout = die->die_cold->dc_callline;
+
     return 0;
 }
 
@@ -1434,12 +2197,14 @@ int die_get_data_type_str(die_t *die, char **datatypeout, sym_error_t *e){
         return 1;
     }
 
-    if(!die->die_datatypename){
+    const char *datatypename = die->die_cold->dc_type->tl_name;
+
+    if(!datatypename){
         errset(e, DIE_ERROR_KIND, DIE_NO_DATA_TYPE_NAME);
         return 1;
     }
 
-    strncpy(*datatypeout, die->die_datatypename, strlen(die->die_datatypename));
+    strncpy(*datatypeout, datatypename, strlen(datatypename));
 
     return 0;
 }
@@ -1455,7 +2220,7 @@ int die_get_encoding(die_t *die, uint64_t *encodingout, sym_error_t *e){
         return 1;
     }
 
-    *encodingout = die->die_datatypeencoding;
+    *encodingout = die->die_cold->dc_type->tl_encoding;
     return 0;
 }
 
@@ -1474,55 +2239,122 @@ int die_get_high_pc(die_t *die, uint64_t *highpcout, sym_error_t *e){
     return 0;
 }
 
-static char *get_dwarf_line_filename(Dwarf_Debug dbg, Dwarf_Line line){
-    if(!line)
-        return NULL;
+/* Returns every inlined subroutine DIE pc is in, innermost first,
+ * followed by the function they were all inlined into. Caller frees
+ * the returned array, but not the DIEs in it.
+ */
+int die_get_inline_stack(die_t *die, uint64_t pc, die_t ***stackout,
+        int *lenout, sym_error_t *e){
+    if(!die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
+    }
 
-    Dwarf_Error d_error = NULL;
-    char *filename = NULL;
+    if(!stackout || !lenout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
 
-    int ret = dwarf_linesrc(line, &filename, &d_error);
+    if(die->die_tag != DW_TAG_compile_unit){
+        errset(e, DIE_ERROR_KIND, DIE_NOT_COMPILE_UNIT_DIE);
+        return 1;
+    }
 
-    if(ret == DW_DLV_ERROR){
-        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
-        return NULL;
+    struct scope *scope = NULL;
+
+    if(die->die_cold->dc_scopes)
+        scope = find_innermost_scope(die, pc);
+
+    if(!scope){
+        errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+        return 1;
+    }
+
+    die_t **stack = NULL;
+    int len = 0;
+
+    for(die_t *cur = scope->sc_die; cur; cur = cur->die_parent){
+        if(!cur->die_inlinedsub && cur->die_tag != DW_TAG_subprogram)
+            continue;
+
+        stack = realloc(stack, sizeof(die_t *) * (len + 1));
+        stack[len++] = cur;
+
+        if(cur->die_tag == DW_TAG_subprogram)
+            break;
+    }
+
+    if(len == 0){
+        errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+        return 1;
     }
 
-    return filename;
+    *stackout = stack;
+    *lenout = len;
+
+    return 0;
 }
 
-static Dwarf_Unsigned get_dwarf_line_lineno(Dwarf_Debug dbg, Dwarf_Line line){
-    if(!line)
-        return 0;
+/* Root DIEs from the symbol cache have no Dwarf_Die, one is looked up
+ * whenever libdwarf needs it. Give it back with put_dwarfdie.
+ */
+static Dwarf_Die get_dwarfdie(Dwarf_Debug dbg, die_t *die){
+    if(die->die_dwarfdie || !dbg)
+        return die->die_dwarfdie;
 
+    Dwarf_Die dwarfdie = NULL;
     Dwarf_Error d_error = NULL;
-    Dwarf_Unsigned lineno = 0;
+    int is_info = 1;
 
-    int ret = dwarf_lineno(line, &lineno, &d_error);
+    int ret = dwarf_offdie_b(dbg, die->die_dieoffset, is_info, &dwarfdie,
+            &d_error);
 
-    if(ret == DW_DLV_ERROR){
+    if(ret == DW_DLV_ERROR)
         dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
-        return 0;
-    }
 
-    return lineno;
+    return ret == DW_DLV_OK ? dwarfdie : NULL;
 }
 
-static Dwarf_Addr get_dwarf_line_virtual_addr(Dwarf_Debug dbg, Dwarf_Line line){
-    if(!line)
-        return 0;
+static void put_dwarfdie(Dwarf_Debug dbg, die_t *die, Dwarf_Die dwarfdie){
+    if(dwarfdie && dwarfdie != die->die_dwarfdie)
+        dwarf_dealloc(dbg, dwarfdie, DW_DLA_DIE);
+}
+
+/* A compilation unit's line number program is only decoded the first
+ * time something asks for it.
+ */
+static void *get_linetable(Dwarf_Debug dbg, die_t *cu_root_die){
+    if(cu_root_die->die_cold->dc_linetable)
+        return cu_root_die->die_cold->dc_linetable;
+
+    Dwarf_Die dwarfdie = get_dwarfdie(dbg, cu_root_die);
+
+    if(!dwarfdie)
+        return NULL;
 
+    Dwarf_Line *srclines = NULL;
+    Dwarf_Signed srclinescnt = 0;
     Dwarf_Error d_error = NULL;
-    Dwarf_Addr lineaddr = 0;
 
-    int ret = dwarf_lineaddr(line, &lineaddr, &d_error);
+    int ret = dwarf_srclines(dwarfdie, &srclines, &srclinescnt, &d_error);
+
+    put_dwarfdie(dbg, cu_root_die, dwarfdie);
 
     if(ret == DW_DLV_ERROR){
         dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
-        return 0;
+        return NULL;
     }
 
-    return lineaddr;
+    /* Decode the line number program once, we won't need libdwarf's
+     * copy of it after this.
+     */
+    cu_root_die->die_cold->dc_linetable =
+        lt_build(dbg, srclines, srclinescnt);
+
+    if(ret == DW_DLV_OK)
+        dwarf_srclines_dealloc(dbg, srclines, srclinescnt);
+
+    return cu_root_die->die_cold->dc_linetable;
 }
 
 int die_get_line_info_from_pc(Dwarf_Debug dbg, die_t *die, uint64_t pc,
@@ -1533,44 +2365,55 @@ int die_get_line_info_from_pc(Dwarf_Debug dbg, die_t *die, uint64_t pc,
         return 1;
     }
 
-    /* Not a compilation unit DIE */
+    /* Not a compilation unit DIE */
+    if(die->die_tag != DW_TAG_compile_unit){
+        errset(e, DIE_ERROR_KIND, DIE_NOT_COMPILE_UNIT_DIE);
+        return 1;
+    }
+
+    const char *fname = NULL;
+    uint64_t lineno = 0;
+
+    if(lt_find_row_by_pc(get_linetable(dbg, die), pc, &fname, &lineno)){
+        errset(e, DIE_ERROR_KIND, DIE_COULD_NOT_GET_LINE_INFO);
+        return 1;
+    }
+
+    die_t *fxndie = NULL;
+    if(die_search(die, (void *)pc, DIE_SEARCH_FUNCTION_BY_PC, &fxndie, e))
+        return 1;
+
+    /* These belong to the DIE tree, don't free them */
+    *srcfilename = (char *)fname;
+    *srclineno = lineno;
+    *srcfunction = fxndie->die_diename;
+
+    return 0;
+}
+
+/* Decodes die's line number program if that hasn't been done yet */
+int die_get_linetable(Dwarf_Debug dbg, die_t *die, void **ltout,
+        sym_error_t *e){
+    if(!die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
+    }
+
     if(die->die_tag != DW_TAG_compile_unit){
         errset(e, DIE_ERROR_KIND, DIE_NOT_COMPILE_UNIT_DIE);
         return 1;
     }
 
-    for(Dwarf_Signed i=0; i<die->die_srclinescnt; i++){
-        Dwarf_Line line = die->die_srclines[i];
-
-        if(pc == get_dwarf_line_virtual_addr(dbg, line)){
-            char *fname = get_dwarf_line_filename(dbg, line);
-
-            if(fname){
-                *srcfilename = strdup(fname);
-                dwarf_dealloc(dbg, fname, DW_DLA_STRING);
-            }
-
-            *srclineno = get_dwarf_line_lineno(dbg, line);
-
-            die_t *fxndie = NULL;
-            int ret = die_search(die, (void *)pc, DIE_SEARCH_FUNCTION_BY_PC,
-                    &fxndie, e);
-
-            if(ret){
-                free(*srcfilename);
-                *srcfilename = NULL;
-                *srclineno = 0;
-                return 1;
-            }
-
-            *srcfunction = strdup(fxndie->die_diename);
+    void *lt = get_linetable(dbg, die);
 
-            return 0;
-        }
+    if(!lt){
+        errset(e, DIE_ERROR_KIND, DIE_COULD_NOT_GET_LINE_INFO);
+        return 1;
     }
 
-    errset(e, DIE_ERROR_KIND, DIE_COULD_NOT_GET_LINE_INFO);
-    return 1;
+    *ltout = lt;
+
+    return 0;
 }
 
 int die_get_low_pc(die_t *die, uint64_t *lowpcout, sym_error_t *e){
@@ -1605,7 +2448,9 @@ int die_get_members(die_t *die, die_t *cu_root_die,
 
     if(tag != DW_TAG_structure_type && tag != DW_TAG_union_type){
         die_t *d = NULL;
-        if(die_search(cu_root_die, (void *)die->die_basedatatypedieoffset,
+        Dwarf_Unsigned typeoff = die->die_cold->dc_type->tl_basedieoffset;
+
+        if(die_search(cu_root_die, (void *)typeoff,
                     DIE_SEARCH_IF_DIE_OFFSET_MATCHES, &d, e)){
             errset(e, DIE_ERROR_KIND, DIE_NOT_STRUCT_OR_UNION);
             return 1;
@@ -1661,7 +2506,22 @@ int die_get_member_offset(die_t *die, uint64_t *offout, sym_error_t *e){
         return 1;
     }
 
-    *offout = die->die_memb_off;
+    *offout = die->die_cold->dc_memb_off;
+    return 0;
+}
+
+int die_get_offset(die_t *die, uint64_t *offout, sym_error_t *e){
+    if(!die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
+    }
+
+    if(!offout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    *offout = die->die_dieoffset;
     return 0;
 }
 
@@ -1738,40 +2598,120 @@ int die_get_pc_of_next_line(Dwarf_Debug dbg, die_t *die,
         return 1;
     }
 
-    uint64_t next_line = 0, start_pc_lineno = 0;
+    uint64_t start_pc_lineno = 0;
 
     if(die_pc_to_lineno(dbg, die, start_pc, &start_pc_lineno, e))
         return 1;
 
-    Dwarf_Unsigned prevlineno = start_pc_lineno;
+    if(lt_find_pc_of_next_line(get_linetable(dbg, die), start_pc, start_pc_lineno,
+                next_line_pc)){
+        errset(e, DIE_ERROR_KIND, DIE_NEXT_LINE_NOT_FOUND);
+        return 1;
+    }
+
+    return 0;
+}
 
-    /* Lines given back aren't guarenteed to be in chronological order. */
-    for(Dwarf_Signed i=0; i<die->die_srclinescnt; i++){
-        Dwarf_Line line = die->die_srclines[i];
-        Dwarf_Unsigned curlineaddr = get_dwarf_line_virtual_addr(dbg, line);
-        Dwarf_Unsigned curlineno = get_dwarf_line_lineno(dbg, line);
+static int add_pc_range(struct pcrange **ranges, int *len, uint64_t lopc,
+        uint64_t hipc){
+    /* Empty ranges can't contain any PC */
+    if(hipc <= lopc)
+        return 0;
 
-        if(curlineaddr <= start_pc || curlineno == 0 ||
-                start_pc_lineno == curlineno){
-            continue;
-        }
-        
-        uint64_t current = llabs((int64_t)(next_line - start_pc));
-        uint64_t diff = llabs((int64_t)(curlineaddr - start_pc));
+    struct pcrange *ranges_rea = realloc(*ranges,
+            sizeof(struct pcrange) * ++(*len));
+    *ranges = ranges_rea;
+
+    (*ranges)[(*len) - 1].pr_lopc = lopc;
+    (*ranges)[(*len) - 1].pr_hipc = hipc;
 
-        if(diff < current && prevlineno != curlineno)
-            next_line = curlineaddr;
+    return 0;
+}
 
-        prevlineno = curlineno;
+/* Returns every PC range this DIE covers. DW_AT_ranges is preferred
+ * over DW_AT_low_pc/DW_AT_high_pc because it can describe non-contiguous
+ * code. Caller frees the returned array.
+ */
+int die_get_pc_ranges(Dwarf_Debug dbg, die_t *die, struct pcrange **rangesout,
+        int *lenout, sym_error_t *e){
+    if(!die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
     }
 
-    /* If this is still 0, the next line's PC wasn't found. */
-    if(next_line == 0){
-        errset(e, DIE_ERROR_KIND, DIE_NEXT_LINE_NOT_FOUND);
+    if(!rangesout || !lenout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
         return 1;
     }
 
-    *next_line_pc = next_line;
+    *rangesout = NULL;
+    *lenout = 0;
+
+    Dwarf_Die dwarfdie = get_dwarfdie(dbg, die);
+    Dwarf_Attribute ranges_attr = NULL;
+
+    if(dwarfdie)
+        get_die_attribute(dbg, dwarfdie, DW_AT_ranges, &ranges_attr);
+
+    if(!ranges_attr){
+        put_dwarfdie(dbg, die, dwarfdie);
+        add_pc_range(rangesout, lenout, die->die_low_pc, die->die_high_pc);
+        return 0;
+    }
+
+    Dwarf_Error d_error = NULL;
+    Dwarf_Off rangesoff = 0;
+
+    int ret = dwarf_global_formref(ranges_attr, &rangesoff, &d_error);
+
+    dwarf_dealloc(dbg, ranges_attr, DW_DLA_ATTR);
+
+    if(ret == DW_DLV_ERROR){
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+        put_dwarfdie(dbg, die, dwarfdie);
+        return 0;
+    }
+
+    Dwarf_Ranges *ranges = NULL;
+    Dwarf_Signed rangescnt = 0;
+    Dwarf_Unsigned bytecnt = 0;
+
+    ret = dwarf_get_ranges_a(dbg, rangesoff, dwarfdie, &ranges,
+            &rangescnt, &bytecnt, &d_error);
+
+    put_dwarfdie(dbg, die, dwarfdie);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+    if(ret != DW_DLV_OK)
+        return 0;
+
+    /* Range list entries are relative to the base address of the
+     * compilation unit this DIE belongs to.
+     */
+    die_t *cudie = die;
+
+    while(cudie->die_parent)
+        cudie = cudie->die_parent;
+
+    uint64_t base = cudie->die_low_pc;
+
+    for(Dwarf_Signed i=0; i<rangescnt; i++){
+        Dwarf_Ranges *r = &ranges[i];
+
+        if(r->dwr_type == DW_RANGES_END)
+            break;
+        else if(r->dwr_type == DW_RANGES_ADDRESS_SELECTION)
+            base = r->dwr_addr2;
+        else{
+            add_pc_range(rangesout, lenout, base + r->dwr_addr1,
+                    base + r->dwr_addr2);
+        }
+    }
+
+    dwarf_ranges_dealloc(dbg, ranges, rangescnt);
+
     return 0;
 }
 
@@ -1782,22 +2722,7 @@ int die_get_pc_values_from_lineno(Dwarf_Debug dbg, die_t *die,
         return 1;
     }
 
-    *pcs = malloc(sizeof(uint64_t));
-    (*pcs)[0] = 0;
-
-    for(Dwarf_Signed i=0; i<die->die_srclinescnt; i++){
-        Dwarf_Line line = die->die_srclines[i];
-        Dwarf_Unsigned curlineaddr = get_dwarf_line_virtual_addr(dbg, line);
-        Dwarf_Unsigned curlineno = get_dwarf_line_lineno(dbg, line);
-
-        if(curlineno == lineno){
-            uint64_t *pcs_rea = realloc(*pcs, sizeof(uint64_t) * ++(*len));
-            *pcs = pcs_rea;
-            (*pcs)[(*len) - 1] = curlineaddr;
-        }
-    }
-
-    return 0;
+    return lt_get_pc_values_from_lineno(get_linetable(dbg, die), lineno, pcs, len);
 }
 
 int die_get_variables(Dwarf_Debug dbg, die_t *die, die_t ***vardies,
@@ -1844,7 +2769,7 @@ int die_get_variable_size(die_t *die, uint64_t *sizeout, sym_error_t *e){
         return 1;
     }
 
-    *sizeout = die->die_databytessize;
+    *sizeout = die->die_cold->dc_type->tl_bytesize;
     return 0;
 }
 
@@ -1873,6 +2798,10 @@ int die_is_member_of_struct_or_union(die_t *die, int *retval,
     return 0;
 }
 
+/* Like die_lineno_to_pc, but only lines from the source file filename
+ * are considered, and lines without code resolve to the next one that
+ * has some.
+ */
 int die_lineno_to_pc(Dwarf_Debug dbg, die_t *die, uint64_t *lineno,
         uint64_t *pcout, char **outbuffer, sym_error_t *e){
     if(!die){
@@ -1890,36 +2819,19 @@ int die_lineno_to_pc(Dwarf_Debug dbg, die_t *die, uint64_t *lineno,
         return 1;
     }
 
-    /* Find the closest line to lineno. Sometimes the source file does
-     * not accurately reflect the compiled program.
-     */
-    uint64_t closestlineno = 0;
-    Dwarf_Line closestline = NULL;
-
-    uint64_t linepassedin = *lineno;
-
-    for(Dwarf_Signed i=0; i<die->die_srclinescnt; i++){
-        Dwarf_Line line = die->die_srclines[i];
-        Dwarf_Unsigned curlineno = get_dwarf_line_lineno(dbg, line);
+    uint64_t linepassedin = *lineno, closestlineno = 0;
 
-        uint64_t current = llabs((int64_t)(closestlineno - linepassedin));
-        uint64_t diff = llabs((int64_t)(curlineno - linepassedin));
-
-        /* exact match */
-        if(diff == 0){
-            *pcout = get_dwarf_line_virtual_addr(dbg, line);
-            return 0;
-        }
-        else if(diff < current){
-            closestlineno = curlineno;
-            closestline = line;
-        }
+    if(lt_lineno_to_pc(get_linetable(dbg, die), linepassedin, &closestlineno,
+                pcout)){
+        errset(e, DIE_ERROR_KIND, DIE_LINE_NOT_FOUND);
+        return 1;
     }
 
-    concat(outbuffer, "Line %lld doesn't exist, auto-adjusted to line %lld\n",
-            linepassedin, closestlineno);
+    if(closestlineno != linepassedin){
+        concat(outbuffer, "Line %lld doesn't exist, auto-adjusted to line %lld\n",
+                linepassedin, closestlineno);
+    }
 
-    *pcout = get_dwarf_line_virtual_addr(dbg, closestline);
     *lineno = closestlineno;
 
     return 0;
@@ -1943,18 +2855,12 @@ int die_pc_to_lineno(Dwarf_Debug dbg, die_t *die, uint64_t target_pc,
     }
 
     /* If we're given a PC to match against, we should match exactly. */
-    for(Dwarf_Signed i=0; i<die->die_srclinescnt; i++){
-        Dwarf_Line line = die->die_srclines[i];
-        Dwarf_Unsigned curlineaddr = get_dwarf_line_virtual_addr(dbg, line);
-
-        if(target_pc == curlineaddr){
-            *lineno = get_dwarf_line_lineno(dbg, line);
-            return 0;
-        }
+    if(lt_find_row_by_pc(get_linetable(dbg, die), target_pc, NULL, lineno)){
+        errset(e, DIE_ERROR_KIND, DIE_LINE_NOT_FOUND);
+        return 1;
     }
 
-    errset(e, DIE_ERROR_KIND, DIE_LINE_NOT_FOUND);
-    return 1;
+    return 0;
 }
 
 static int die_is_func_in_range(die_t *die, void *pc){
@@ -1966,6 +2872,11 @@ static int die_name_matches(die_t *die, void *name){
     return die->die_diename && strcmp(die->die_diename, (const char *)name) == 0;
 }
 
+/* Both come from the string pool */
+static int die_pooled_name_is(die_t *die, void *name){
+    return die->die_diename == (char *)name;
+}
+
 static int die_offset_matches(die_t *die, void *offset){
     return die->die_dieoffset == (Dwarf_Unsigned)offset;
 }
@@ -1993,8 +2904,83 @@ static void die_search_internal(die_t *die, void *data,
     }
 }
 
+/* Binary search for the closest scope starting at or before pc, then
+ * go outwards until one actually holds it.
+ */
+static struct scope *find_innermost_scope(die_t *cu_root_die, uint64_t pc){
+    struct scope *scopes = cu_root_die->die_cold->dc_scopes;
+    int lo = 0, hi = cu_root_die->die_cold->dc_numscopes - 1, found = -1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(scopes[mid].sc_lopc <= pc){
+            found = mid;
+            lo = mid + 1;
+        }
+        else{
+            hi = mid - 1;
+        }
+    }
+
+    while(found != -1 && pc >= scopes[found].sc_hipc)
+        found = scopes[found].sc_outer;
+
+    return found == -1 ? NULL : &scopes[found];
+}
+
+/* Give a compilation unit DIE a line table from somewhere other than
+ * libdwarf. The DIE owns it afterwards.
+ */
+int die_set_linetable(die_t *die, void *lt, sym_error_t *e){
+    if(!die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
+    }
+
+    if(die->die_tag != DW_TAG_compile_unit){
+        errset(e, DIE_ERROR_KIND, DIE_NOT_COMPILE_UNIT_DIE);
+        return 1;
+    }
+
+    lt_free(die->die_cold->dc_linetable);
+    die->die_cold->dc_linetable = lt;
+
+    return 0;
+}
+
 int die_search(die_t *start, void *data, int way, die_t **out,
         sym_error_t *e){
+    /* Compilation unit DIEs know where every DIE in their tree is */
+    if(way == DIE_SEARCH_IF_DIE_OFFSET_MATCHES &&
+            start && start->die_cold->dc_offsetidx){
+        if(hashtable_get(start->die_cold->dc_offsetidx, (unsigned long)data,
+                    (void **)out)){
+            errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    /* They also know which scope every PC they cover is in */
+    if(way == DIE_SEARCH_FUNCTION_BY_PC &&
+            start && start->die_cold->dc_scopes){
+        struct scope *scope = find_innermost_scope(start, (uint64_t)data);
+        die_t *fxndie = scope ? scope->sc_die : NULL;
+
+        while(fxndie && fxndie->die_tag != DW_TAG_subprogram)
+            fxndie = fxndie->die_parent;
+
+        if(!fxndie){
+            errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+            return 1;
+        }
+
+        *out = fxndie;
+        return 0;
+    }
+
     int (*comparefxn)(die_t *, void *) = NULL;
 
     if(way == DIE_SEARCH_IF_NAME_MATCHES)
@@ -2003,6 +2989,8 @@ int die_search(die_t *start, void *data, int way, die_t **out,
         comparefxn = die_is_func_in_range;
     else if(way == DIE_SEARCH_IF_DIE_OFFSET_MATCHES)
         comparefxn = die_offset_matches;
+    else if(way == DIE_SEARCH_IF_POOLED_NAME_IS)
+        comparefxn = die_pooled_name_is;
 
     die_search_internal(start, data, comparefxn, out);
 
@@ -2014,8 +3002,146 @@ int die_search(die_t *start, void *data, int way, die_t **out,
     return 0;
 }
 
-int initialize_and_build_die_tree_from_root_die(dwarfinfo_t *dwarfinfo,
-        void *compile_unit, die_t **_root_die, sym_error_t *e){
+static int is_scope_tag(Dwarf_Half tag){
+    return tag == DW_TAG_subprogram || tag == DW_TAG_inlined_subroutine ||
+        tag == DW_TAG_lexical_block;
+}
+
+struct scopelist {
+    struct scope *sl_scopes;
+    int sl_len;
+    int sl_capacity;
+};
+
+static void collect_scopes(struct dtbuild *db, die_t *die, int depth,
+        struct scopelist *sl){
+    if(is_scope_tag(die->die_tag)){
+        struct pcrange *ranges = NULL;
+        int numranges = 0;
+
+        die_get_pc_ranges(db->db_dbg, die, &ranges, &numranges, NULL);
+
+        for(int i=0; i<numranges; i++){
+            if(sl->sl_len == sl->sl_capacity){
+                sl->sl_capacity = sl->sl_capacity ? sl->sl_capacity * 2 : 64;
+                sl->sl_scopes = realloc(sl->sl_scopes,
+                        sl->sl_capacity * sizeof(struct scope));
+            }
+
+            struct scope *scope = &sl->sl_scopes[sl->sl_len++];
+
+            scope->sc_lopc = ranges[i].pr_lopc;
+            scope->sc_hipc = ranges[i].pr_hipc;
+            scope->sc_die = die;
+            scope->sc_outer = -1;
+            scope->sc_depth = depth;
+        }
+
+        free(ranges);
+    }
+
+    for(int i=0; i<die->die_numchildren; i++)
+        collect_scopes(db, die->die_children[i], depth + 1, sl);
+}
+
+/* Outer scopes go before the scopes they hold */
+static int scope_cmp(const void *a, const void *b){
+    const struct scope *sa = a;
+    const struct scope *sb = b;
+
+    if(sa->sc_lopc != sb->sc_lopc)
+        return sa->sc_lopc < sb->sc_lopc ? -1 : 1;
+
+    if(sa->sc_hipc != sb->sc_hipc)
+        return sa->sc_hipc > sb->sc_hipc ? -1 : 1;
+
+    return sa->sc_depth - sb->sc_depth;
+}
+
+/* Sort every scope in root_die's tree and link each one to the scope
+ * enclosing it. The result lives in the arena.
+ */
+static void build_scope_index(struct dtbuild *db, die_t *root_die){
+    struct scopelist sl = {0};
+
+    for(int i=0; i<root_die->die_numchildren; i++)
+        collect_scopes(db, root_die->die_children[i], 1, &sl);
+
+    if(sl.sl_len == 0)
+        return;
+
+    qsort(sl.sl_scopes, sl.sl_len, sizeof(struct scope), scope_cmp);
+
+    /* Scopes which might still enclose the one we're on */
+    int *open = malloc(sl.sl_len * sizeof(int));
+    int numopen = 0;
+
+    for(int i=0; i<sl.sl_len; i++){
+        struct scope *scope = &sl.sl_scopes[i];
+
+        while(numopen > 0 &&
+                scope->sc_hipc > sl.sl_scopes[open[numopen - 1]].sc_hipc){
+            numopen--;
+        }
+
+        scope->sc_outer = numopen > 0 ? open[numopen - 1] : -1;
+        open[numopen++] = i;
+    }
+
+    free(open);
+
+    size_t sz = sl.sl_len * sizeof(struct scope);
+    struct scope *scopes = arena_alloc(db->db_arena, sz);
+    memcpy(scopes, sl.sl_scopes, sz);
+    free(sl.sl_scopes);
+
+    root_die->die_cold->dc_scopes = scopes;
+    root_die->die_cold->dc_numscopes = sl.sl_len;
+}
+
+/* Inlined subroutines, and out of line copies of inlined functions,
+ * take the name of the function they're an instance of.
+ */
+static void name_from_abstract_origins(struct dtbuild *db, die_t *die){
+    if(!die->die_diename && die->die_cold->dc_aboriginoff){
+        die_t *origin = NULL;
+
+        hashtable_get(db->db_offsetidx, die->die_cold->dc_aboriginoff,
+                (void **)&origin);
+
+        if(origin)
+            die->die_diename = origin->die_diename;
+    }
+
+    for(int i=0; i<die->die_numchildren; i++)
+        name_from_abstract_origins(db, die->die_children[i]);
+}
+
+/* Lay every children array out contiguously in the arena once the
+ * tree is done growing.
+ */
+static void move_children_to_arena(struct dtbuild *db, die_t *die){
+    if(!die->die_haschildren)
+        return;
+
+    int n = die->die_numchildren;
+    die_t **children = arena_alloc(db->db_arena, (n + 1) * sizeof(die_t *));
+
+    for(int i=0; i<n; i++){
+        children[i] = die->die_children[i];
+        move_children_to_arena(db, children[i]);
+    }
+
+    free(die->die_children);
+    die->die_children = children;
+}
+
+/* Only creates the root DIE of the compilation unit libdwarf is
+ * currently on. The rest of its tree is built by
+ * build_die_tree_from_root_die when it's first needed.
+ */
+int initialize_root_die(dwarfinfo_t *dwarfinfo, void *compile_unit,
+        die_t **_root_die, sym_error_t *e){
     int is_info = 1;
     Dwarf_Error d_error = NULL;
     Dwarf_Die cu_rootdie = NULL;
@@ -2024,26 +3150,135 @@ int initialize_and_build_die_tree_from_root_die(dwarfinfo_t *dwarfinfo,
             &cu_rootdie, &d_error);
 
     if(ret == DW_DLV_ERROR){
+        dwarf_dealloc(dwarfinfo->di_dbg, d_error, DW_DLA_ERROR);
         errset(e, SYM_ERROR_KIND, SYM_DWARF_SIBLING_OF_B_FAILED);
         return 1;
     }
 
-    die_t *root_die = create_new_die(dwarfinfo, compile_unit, cu_rootdie, 0);
-    memset(CUR_PARENTS, 0, sizeof(CUR_PARENTS));
-    CUR_PARENTS[0] = root_die;
+    struct dtbuild db = {0};
+    db.db_dbg = dwarfinfo->di_dbg;
+    db.db_strpool = dwarfinfo->di_strpool;
+    db.db_typecache = dwarfinfo->di_typecache;
 
-    construct_die_tree(dwarfinfo, compile_unit, root_die, 0);
+    *_root_die = create_new_die(&db, compile_unit, cu_rootdie, 0);
 
-    ret = dwarf_srclines(root_die->die_dwarfdie, &root_die->die_srclines,
-            &root_die->die_srclinescnt, &d_error);
-    
-    if(ret == DW_DLV_ERROR){
-        dwarf_dealloc(dwarfinfo->di_dbg, d_error, DW_DLA_ERROR);
-        errset(e, SYM_ERROR_KIND, SYM_DWARF_SRCLINES_FAILED);
+    return 0;
+}
+
+/* Makes a root DIE out of what the symbol cache kept about it, without
+ * libdwarf. It has no Dwarf_Die, see get_dwarfdie.
+ */
+int initialize_root_die_from_summary(dwarfinfo_t *dwarfinfo,
+        struct cusummary *cs, die_t **_root_die, sym_error_t *e){
+    if(!cs){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    die_t *d = calloc(1, sizeof(die_t));
+
+    d->die_tag = cs->cs_tag;
+    d->die_dieoffset = cs->cs_rootdieoffset;
+    d->die_low_pc = cs->cs_lowpc;
+    d->die_high_pc = cs->cs_highpc;
+    d->die_haschildren = cs->cs_haschildren;
+    d->die_cold = &nocold;
+
+    if(cs->cs_name)
+        d->die_diename = (char *)strpool_add(dwarfinfo->di_strpool,
+                cs->cs_name);
+
+    if(d->die_tag == DW_TAG_compile_unit){
+        d->die_cold = calloc(1, sizeof(struct diecold));
+        d->die_cold->dc_type = &notype;
+    }
+
+    if(d->die_haschildren){
+        d->die_children = malloc(sizeof(die_t));
+        d->die_children[0] = NULL;
+    }
+
+    *_root_die = d;
+
+    return 0;
+}
+
+/* The root DIE half of a struct cusummary, for the symbol cache */
+void get_root_die_summary(die_t *root_die, struct cusummary *cs){
+    cs->cs_tag = root_die->die_tag;
+    cs->cs_rootdieoffset = root_die->die_dieoffset;
+    cs->cs_lowpc = root_die->die_low_pc;
+    cs->cs_highpc = root_die->die_high_pc;
+    cs->cs_haschildren = root_die->die_haschildren;
+    cs->cs_name = root_die->die_diename;
+}
+
+/* Build the rest of root_die's tree with dbg, which doesn't need to
+ * be the handle root_die came from. Returns roughly how much memory
+ * the tree takes up through treesizeout.
+ */
+int build_die_tree_from_root_die(Dwarf_Debug dbg, void *compile_unit,
+        die_t *root_die, uint64_t *treesizeout, sym_error_t *e){
+    if(!root_die){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DIE);
+        return 1;
+    }
+
+    int is_info = 1;
+    Dwarf_Error d_error = NULL;
+    Dwarf_Die cu_rootdie = NULL;
+
+    int ret = dwarf_offdie_b(dbg, root_die->die_dieoffset, is_info,
+            &cu_rootdie, &d_error);
+
+    if(ret != DW_DLV_OK){
+        if(ret == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+        errset(e, SYM_ERROR_KIND, SYM_DWARF_OFFDIE_B_FAILED);
         return 1;
     }
 
-    *_root_die = root_die;
+    dwarfinfo_t *dwarfinfo = NULL;
+    cu_get_dwarfinfo(compile_unit, (void **)&dwarfinfo, NULL);
+
+    struct dtbuild *db = calloc(1, sizeof(struct dtbuild));
+    db->db_dbg = dbg;
+    db->db_strpool = dwarfinfo->di_strpool;
+    db->db_typecache = dwarfinfo->di_typecache;
+    db->db_arena = root_die->die_cold->dc_arena = arena_new();
+    db->db_parents[0] = root_die;
+    db->db_numdies = 1;
+
+    /* A tree that was discarded and is being rebuilt */
+    hashtable_destroy(&root_die->die_cold->dc_offsetidx);
+
+    root_die->die_cold->dc_offsetidx = hashtable_new();
+    db->db_offsetidx = root_die->die_cold->dc_offsetidx;
+    db->db_cudie = cu_rootdie;
+
+    hashtable_insert(db->db_offsetidx, root_die->die_dieoffset, root_die);
+
+    Dwarf_Die child_die = NULL;
+
+    if(dwarf_child(cu_rootdie, &child_die, NULL) == DW_DLV_OK){
+        die_t *cd = create_new_die(db, compile_unit, child_die, 0);
+        construct_die_tree(db, compile_unit, cd, 1);
+    }
+
+    free_srcfiles(db);
+    dwarf_dealloc(dbg, cu_rootdie, DW_DLA_DIE);
+
+    move_children_to_arena(db, root_die);
+    name_from_abstract_origins(db, root_die);
+    build_scope_index(db, root_die);
+
+    if(treesizeout){
+        *treesizeout = arena_get_size(db->db_arena) +
+            db->db_offsetidx->capacity * sizeof(struct hashtable_entry);
+    }
+
+    free(db);
 
     return 0;
 }
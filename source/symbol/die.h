@@ -1,24 +1,34 @@
 #ifndef _DIE_H_
 #define _DIE_H_
 
+struct cusummary;
+struct framevar;
+
 int die_create_variable_or_parameter_desc(void *, void *, char **,
         void *, int);
+int die_evaluate_frame_variables(void **, int, uint64_t, char **,
+        struct framevar **, void *);
 int die_evaluate_location_description(void *, uint64_t, char **, int64_t *,
         void *);
 int die_get_array_elem_size(void *, uint64_t *, void *);
 int die_get_array_size_determined_at_runtime(void *, int *, void *);
+int die_get_call_site(void *, char **, uint64_t *, void *);
 int die_get_data_type_str(void *, char **, void *);
 int die_get_encoding(void *, uint64_t *, void *);
 int die_get_high_pc(void *, uint64_t *, void *);
+int die_get_inline_stack(void *, uint64_t, void ***, int *, void *);
 int die_get_line_info_from_pc(void *, void *, uint64_t, char **, char **,
         uint64_t *, void *);
+int die_get_linetable(void *, void *, void **, void *);
 int die_get_low_pc(void *, uint64_t *, void *);
 int die_get_members(void *, void *, void ***, int *, void *);
 int die_get_member_offset(void *, uint64_t *, void *);
 int die_get_name(void *, char **, void *);
+int die_get_offset(void *, uint64_t *, void *);
 int die_get_parameters(void *, void ***, int *, void *);
 int die_get_parent(void *, void **, void *);
 int die_get_pc_of_next_line(void *, void *, uint64_t, uint64_t *, void *);
+int die_get_pc_ranges(void *, void *, void *, int *, void *);
 int die_get_pc_values_from_lineno(void *, void *, uint64_t, uint64_t **,
         int *, void *);
 int die_get_variables(void *, void *, void ***, int *, void *);
@@ -31,10 +41,16 @@ int die_represents_pointer(void *, int *, void *);
 int die_represents_struct(void *, int *, void *);
 int die_represents_union(void *, int *, void *);
 int die_search(void *, void *, int, void **, void *);
+int die_set_linetable(void *, void *, void *);
+void die_tree_discard(void *, void *);
 void die_tree_free(void *, void *, int);
 
 /* Internal functions */
-int initialize_and_build_die_tree_from_root_die(void *, void *, void **,
+int build_die_tree_from_root_die(void *, void *, void *, uint64_t *,
+        void *);
+void get_root_die_summary(void *, struct cusummary *);
+int initialize_root_die(void *, void *, void **, void *);
+int initialize_root_die_from_summary(void *, struct cusummary *, void **,
         void *);
 
 #endif
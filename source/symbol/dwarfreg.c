@@ -0,0 +1,1156 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <mach-o/loader.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dwarfreg.h"
+#include "objfile.h"
+#include "scache.h"
+#include "sym.h"
+#include "symerr.h"
+#include "symloader.h"
+
+#include "../dbgio.h"
+#include "../debuggee.h"
+#include "../memutils.h"
+#include "../strext.h"
+
+/* Every image the debuggee has loaded that could have a dSYM, which
+ * dSYM that is, and, once something has asked about a pc or a source
+ * file in it, its dwarfinfo. Nothing is parsed until then, so images
+ * nobody looks at cost a few stats at attach and nothing else.
+ */
+struct regimage {
+    uint8_t ri_uuid[16];
+
+    /* Where the Mach-O header is, and how far __TEXT was slid */
+    uint64_t ri_loadaddr;
+    uint64_t ri_slide;
+
+    /* Slid __TEXT */
+    uint64_t ri_textlo;
+    uint64_t ri_texthi;
+
+    char *ri_imagepath;
+
+    /* NULL if we couldn't find a dSYM with the same UUID */
+    char *ri_dsympath;
+
+    void *ri_dwarfinfo;
+    int ri_loadfailed;
+
+    /* How many dwarfreg_find_by_pc callers haven't given ri_dwarfinfo
+     * back with dwarfreg_release yet
+     */
+    int ri_users;
+
+    /* Some thread is parsing the dSYM right now */
+    int ri_loading;
+
+    /* 'symbols add' asked for this one, dwarfreg_load_wanted parses it */
+    int ri_wanted;
+
+    /* dwarfreg_build_die_trees already got to ri_dwarfinfo */
+    int ri_treesbuilt;
+};
+
+/* A file from 'symbols add', kept so it can be matched up again the
+ * next time we attach.
+ */
+struct dwarffile {
+    char *df_path;
+    uint8_t df_uuid[16];
+};
+
+static pthread_mutex_t REGISTRY_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+/* Broadcast whenever an image is done loading */
+static pthread_cond_t REGISTRY_COND = PTHREAD_COND_INITIALIZER;
+
+/* Sorted by ri_textlo. Each image is allocated on its own, so one
+ * that's being loaded stays put when an image is added.
+ */
+static struct regimage **IMAGES = NULL;
+static int NUMIMAGES = 0;
+
+/* Where dyld's image list is in the debuggee, and how many images it
+ * had the last time we looked.
+ */
+static uint64_t ALLIMAGEINFOSADDR = 0;
+static uint32_t LASTINFOCOUNT = 0;
+
+static char **SEARCHPATHS = NULL;
+static int NUMSEARCHPATHS = 0;
+
+static struct dwarffile *DWARFFILES = NULL;
+static int NUMDWARFFILES = 0;
+
+/* From 'symbols cap', given to every dwarfinfo we load. Zero is no cap. */
+static uint64_t DIETREECAP = 0;
+
+/* A dwarfinfo replaced by 'symbols add', or left over from the last
+ * attach, that some thread was still using. The last
+ * dwarfreg_release frees it.
+ */
+struct retireddwarf {
+    void *rd_dwarfinfo;
+    int rd_users;
+};
+
+static struct retireddwarf *RETIRED = NULL;
+static int NUMRETIRED = 0;
+
+static const char *basename_of(const char *path){
+    const char *lastslash = strrchr(path, '/');
+
+    return lastslash ? lastslash + 1 : path;
+}
+
+static void format_uuid(const uint8_t *uuid, char *out){
+    char *p = out;
+
+    for(int i=0; i<16; i++){
+        if(i == 4 || i == 6 || i == 8 || i == 10)
+            *p++ = '-';
+
+        p += sprintf(p, "%02X", uuid[i]);
+    }
+}
+
+static int get_file_uuid(const char *path, uint8_t *uuidout){
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+        return 1;
+
+    struct stat st;
+
+    if(fstat(fd, &st) || st.st_size == 0){
+        close(fd);
+        return 1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if(map == MAP_FAILED)
+        return 1;
+
+    int ret = obj_get_uuid(map, st.st_size, uuidout);
+
+    munmap(map, st.st_size);
+
+    return ret;
+}
+
+/* Fills in everything but the dSYM from the image's header in the
+ * debuggee. Non-zero if it has no UUID to match a dSYM against.
+ */
+static int read_image(uint64_t loadaddr, struct regimage *ri){
+    struct mach_header_64 hdr;
+
+    if(read_memory_at_location(loadaddr, &hdr, sizeof(hdr)))
+        return 1;
+
+    uint8_t *cmds = malloc(hdr.sizeofcmds);
+
+    if(read_memory_at_location(loadaddr + sizeof(hdr), cmds,
+                hdr.sizeofcmds)){
+        free(cmds);
+        return 1;
+    }
+
+    int haveuuid = 0, havetext = 0;
+    uint8_t *cmd = cmds;
+
+    for(int i=0; i<hdr.ncmds; i++){
+        struct load_command *lc = (struct load_command *)cmd;
+
+        if(lc->cmdsize == 0 || cmd + lc->cmdsize > cmds + hdr.sizeofcmds)
+            break;
+
+        if(lc->cmd == LC_UUID){
+            memcpy(ri->ri_uuid, ((struct uuid_command *)lc)->uuid, 16);
+            haveuuid = 1;
+        }
+        else if(lc->cmd == LC_SEGMENT_64){
+            struct segment_command_64 *seg = (struct segment_command_64 *)lc;
+
+            if(strncmp(seg->segname, "__TEXT", sizeof(seg->segname)) == 0){
+                ri->ri_slide = loadaddr - seg->vmaddr;
+                ri->ri_textlo = loadaddr;
+                ri->ri_texthi = loadaddr + seg->vmsize;
+                havetext = 1;
+            }
+        }
+
+        cmd += lc->cmdsize;
+    }
+
+    free(cmds);
+
+    ri->ri_loadaddr = loadaddr;
+
+    return !haveuuid || !havetext;
+}
+
+static int try_dsym(struct regimage *ri, const char *dir, const char *bundle,
+        const char *base){
+    char path[PATH_MAX];
+    struct stat st;
+    uint8_t uuid[16];
+
+    snprintf(path, sizeof(path), "%s/%s.dSYM/Contents/Resources/DWARF/%s",
+            dir, bundle, base);
+
+    if(stat(path, &st) || get_file_uuid(path, uuid) ||
+            memcmp(uuid, ri->ri_uuid, sizeof(uuid)) != 0){
+        return 1;
+    }
+
+    ri->ri_dsympath = strdup(path);
+
+    return 0;
+}
+
+static int try_dir(struct regimage *ri, const char *dir, const char *bundle,
+        const char *base){
+    if(try_dsym(ri, dir, base, base) == 0)
+        return 0;
+
+    if(!bundle)
+        return 1;
+
+    return try_dsym(ri, dir, bundle, base);
+}
+
+/* Finds the dSYM for ri. Files from 'symbols add' win, then the
+ * search path, then wherever Xcode would have left it: next to the
+ * image, or next to the bundle the image is in. Only a dSYM with the
+ * image's UUID counts.
+ */
+static void resolve_dsym(struct regimage *ri){
+    for(int i=0; i<NUMDWARFFILES; i++){
+        if(memcmp(DWARFFILES[i].df_uuid, ri->ri_uuid, 16) == 0){
+            ri->ri_dsympath = strdup(DWARFFILES[i].df_path);
+            ri->ri_wanted = 1;
+            return;
+        }
+    }
+
+    char imagedir[PATH_MAX];
+    strncpy(imagedir, ri->ri_imagepath, sizeof(imagedir) - 1);
+    imagedir[sizeof(imagedir) - 1] = '\0';
+
+    char *lastslash = strrchr(imagedir, '/');
+
+    if(!lastslash)
+        return;
+
+    *lastslash = '\0';
+
+    const char *base = basename_of(ri->ri_imagepath);
+
+    /* Foo.app/Foo, Foo.app/Frameworks/Bar.framework/Bar, and so on */
+    char *bundle = strrchr(imagedir, '/');
+    const char *ext = bundle ? strrchr(bundle, '.') : NULL;
+
+    if(ext && strcmp(ext, ".app") && strcmp(ext, ".framework") &&
+            strcmp(ext, ".appex") && strcmp(ext, ".xpc")){
+        ext = NULL;
+    }
+
+    const char *bundlename = ext ? bundle + 1 : NULL;
+
+    for(int i=0; i<NUMSEARCHPATHS; i++){
+        if(try_dir(ri, SEARCHPATHS[i], bundlename, base) == 0)
+            return;
+    }
+
+    if(try_dir(ri, imagedir, bundlename, base) == 0)
+        return;
+
+    if(bundlename){
+        *bundle = '\0';
+        try_dir(ri, imagedir, bundlename, base);
+    }
+}
+
+/* REGISTRY_LOCK has to be held. Frees ri's dwarfinfo, or if someone
+ * is still using it, leaves that to the last of them.
+ */
+static void retire_dwarfinfo(struct regimage *ri){
+    if(!ri->ri_dwarfinfo)
+        return;
+
+    if(ri->ri_users == 0)
+        sym_end(&ri->ri_dwarfinfo);
+    else{
+        RETIRED = realloc(RETIRED,
+                sizeof(struct retireddwarf) * (NUMRETIRED + 1));
+        RETIRED[NUMRETIRED].rd_dwarfinfo = ri->ri_dwarfinfo;
+        RETIRED[NUMRETIRED].rd_users = ri->ri_users;
+        NUMRETIRED++;
+    }
+
+    ri->ri_dwarfinfo = NULL;
+    ri->ri_users = 0;
+}
+
+/* REGISTRY_LOCK has to be held. It's let go while the dSYM is parsed,
+ * so only queries about this image wait for it. If another thread is
+ * already parsing it, we wait for that instead of doing it twice.
+ */
+static void *load_image_dwarf(struct regimage *ri, void *e){
+    while(ri->ri_loading)
+        pthread_cond_wait(&REGISTRY_COND, &REGISTRY_LOCK);
+
+    if(ri->ri_dwarfinfo || ri->ri_loadfailed || !ri->ri_dsympath)
+        return ri->ri_dwarfinfo;
+
+    ri->ri_loading = 1;
+
+    char *dsympath = strdup(ri->ri_dsympath);
+    uint64_t cap = DIETREECAP;
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    void *dwarfinfo = NULL;
+
+    if(sym_init_with_dwarf_file(dsympath, &dwarfinfo, e))
+        dwarfinfo = NULL;
+    else if(cap > 0)
+        sym_set_die_tree_cap(dwarfinfo, cap, NULL);
+
+    free(dsympath);
+
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    ri->ri_dwarfinfo = dwarfinfo;
+    ri->ri_loadfailed = dwarfinfo == NULL;
+    ri->ri_loading = 0;
+    ri->ri_treesbuilt = 0;
+
+    pthread_cond_broadcast(&REGISTRY_COND);
+
+    /* Its symbol cache is finished and the rest of its DIE trees get
+     * built in the background
+     */
+    if(dwarfinfo)
+        symloader_start(SL_TREES);
+
+    return ri->ri_dwarfinfo;
+}
+
+static struct regimage *find_image(uint64_t pc){
+    int lo = 0, hi = NUMIMAGES - 1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+        struct regimage *ri = IMAGES[mid];
+
+        if(pc < ri->ri_textlo)
+            hi = mid - 1;
+        else if(pc >= ri->ri_texthi)
+            lo = mid + 1;
+        else
+            return ri;
+    }
+
+    return NULL;
+}
+
+static int imagecmp(const void *a, const void *b){
+    const struct regimage *ra = *(struct regimage * const *)a;
+    const struct regimage *rb = *(struct regimage * const *)b;
+
+    if(ra->ri_textlo < rb->ri_textlo)
+        return -1;
+
+    return ra->ri_textlo > rb->ri_textlo;
+}
+
+/* Reads the image dyld loaded at loadaddr. NULL if it has no UUID to
+ * match a dSYM against. Its dSYM isn't looked for yet.
+ */
+static struct regimage *new_image(uint64_t loadaddr, uint64_t pathaddr){
+    struct regimage *ri = calloc(1, sizeof(struct regimage));
+
+    if(read_image(loadaddr, ri)){
+        free(ri);
+        return NULL;
+    }
+
+    char fpath[PATH_MAX] = {0};
+
+    read_memory_at_location(pathaddr, fpath, sizeof(fpath) - 1);
+
+    ri->ri_imagepath = strdup(fpath);
+
+    return ri;
+}
+
+/* REGISTRY_LOCK has to be held */
+static void insert_image(struct regimage *ri){
+    int at = 0;
+
+    while(at < NUMIMAGES && IMAGES[at]->ri_textlo < ri->ri_textlo)
+        at++;
+
+    struct regimage **images_rea = realloc(IMAGES,
+            sizeof(struct regimage *) * (NUMIMAGES + 1));
+    IMAGES = images_rea;
+
+    memmove(&IMAGES[at + 1], &IMAGES[at],
+            sizeof(struct regimage *) * (NUMIMAGES - at));
+
+    IMAGES[at] = ri;
+    NUMIMAGES++;
+}
+
+/* REGISTRY_LOCK has to be held. Waits for images that are being loaded
+ * so nobody is left with a freed one.
+ */
+static void free_images(void){
+    for(int i=0; i<NUMIMAGES; i++){
+        struct regimage *ri = IMAGES[i];
+
+        while(ri->ri_loading)
+            pthread_cond_wait(&REGISTRY_COND, &REGISTRY_LOCK);
+
+        retire_dwarfinfo(ri);
+        free(ri->ri_imagepath);
+        free(ri->ri_dsympath);
+        free(ri);
+    }
+
+    free(IMAGES);
+    IMAGES = NULL;
+    NUMIMAGES = 0;
+}
+
+/* REGISTRY_LOCK has to be held. Registers the images dyld loaded after
+ * dwarfreg_build, from dlopen or an app extension. Called when a pc or
+ * a source line isn't in any image we know about, so until dyld's
+ * image count changes, that costs one read of dyld_all_image_infos.
+ * Images dyld unloads stay until the next attach.
+ */
+static void register_new_images(void){
+    if(!ALLIMAGEINFOSADDR)
+        return;
+
+    struct dyld_all_image_infos infos;
+
+    if(read_memory_at_location(ALLIMAGEINFOSADDR, &infos, sizeof(infos)))
+        return;
+
+    /* infoArray is NULL while dyld is changing it */
+    if(infos.infoArrayCount == LASTINFOCOUNT || !infos.infoArray)
+        return;
+
+    uint32_t count = infos.infoArrayCount;
+    struct dyld_image_info *infoarray =
+        malloc(sizeof(struct dyld_image_info) * count);
+
+    if(read_memory_at_location((unsigned long)infos.infoArray, infoarray,
+                sizeof(struct dyld_image_info) * count)){
+        free(infoarray);
+        return;
+    }
+
+    LASTINFOCOUNT = count;
+
+    int num_dsc_mappings = 0;
+    struct my_dsc_mapping *dsc_mappings = NULL;
+
+    if(DSCDATA)
+        dsc_mappings = get_dsc_mappings(DSCDATA, &num_dsc_mappings);
+
+    for(int i=0; i<count; i++){
+        unsigned long loadaddr = (unsigned long)infoarray[i].imageLoadAddress;
+
+        if(find_image(loadaddr))
+            continue;
+
+        if(dsc_mappings &&
+                is_dsc_image(loadaddr, dsc_mappings, num_dsc_mappings)){
+            continue;
+        }
+
+        struct regimage *ri = new_image(loadaddr,
+                (unsigned long)infoarray[i].imageFilePath);
+
+        if(!ri)
+            continue;
+
+        resolve_dsym(ri);
+        insert_image(ri);
+    }
+
+    free(dsc_mappings);
+    free(infoarray);
+}
+
+/* Remembers path for this attach and every one after it. If an image
+ * the debuggee has loaded has the same UUID, imagenameout gets that
+ * image's name, and its DWARF is parsed the next time
+ * dwarfreg_load_wanted is called, or whenever something asks about it
+ * first. Otherwise imagenameout is NULL and the file is used if an
+ * image with that UUID gets loaded, now or after the next attach.
+ */
+int dwarfreg_add_dwarf_file(const char *path, char **imagenameout,
+        void *e){
+    *imagenameout = NULL;
+
+    uint8_t uuid[16];
+    struct stat st;
+
+    if(stat(path, &st)){
+        errset(e, GENERIC_ERROR_KIND, GE_FILE_NOT_FOUND);
+        return 1;
+    }
+
+    if(get_file_uuid(path, uuid)){
+        errset(e, SYM_ERROR_KIND, SYM_NO_UUID);
+        return 1;
+    }
+
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    struct dwarffile *df = NULL;
+
+    for(int i=0; i<NUMDWARFFILES; i++){
+        if(memcmp(DWARFFILES[i].df_uuid, uuid, sizeof(uuid)) == 0){
+            df = &DWARFFILES[i];
+            free(df->df_path);
+            break;
+        }
+    }
+
+    if(!df){
+        DWARFFILES = realloc(DWARFFILES,
+                sizeof(struct dwarffile) * (NUMDWARFFILES + 1));
+        df = &DWARFFILES[NUMDWARFFILES++];
+        memcpy(df->df_uuid, uuid, sizeof(uuid));
+    }
+
+    df->df_path = strdup(path);
+
+    for(int i=0; i<NUMIMAGES; i++){
+        struct regimage *ri = IMAGES[i];
+
+        if(memcmp(ri->ri_uuid, uuid, sizeof(uuid)) != 0)
+            continue;
+
+        while(ri->ri_loading)
+            pthread_cond_wait(&REGISTRY_COND, &REGISTRY_LOCK);
+
+        /* Whatever we found for it before is replaced by this */
+        retire_dwarfinfo(ri);
+
+        free(ri->ri_dsympath);
+        ri->ri_dsympath = strdup(path);
+        ri->ri_dwarfinfo = NULL;
+        ri->ri_loadfailed = 0;
+        ri->ri_wanted = 1;
+
+        *imagenameout = strdup(basename_of(ri->ri_imagepath));
+
+        break;
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    return 0;
+}
+
+/* dir is searched for <image>.dSYM and <bundle>.dSYM, before the
+ * directories the images are in. Images that don't have a dSYM yet
+ * are looked for again.
+ */
+void dwarfreg_add_search_path(const char *dir){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    for(int i=0; i<NUMSEARCHPATHS; i++){
+        if(strcmp(SEARCHPATHS[i], dir) == 0){
+            pthread_mutex_unlock(&REGISTRY_LOCK);
+            return;
+        }
+    }
+
+    SEARCHPATHS = realloc(SEARCHPATHS,
+            sizeof(char *) * (NUMSEARCHPATHS + 1));
+    SEARCHPATHS[NUMSEARCHPATHS++] = strdup(dir);
+
+    for(int i=0; i<NUMIMAGES; i++){
+        if(!IMAGES[i]->ri_dsympath)
+            resolve_dsym(IMAGES[i]);
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+}
+
+/* Goes through every image dyld told us about and finds its dSYM.
+ * Images from the dyld shared cache are left out, there's never a
+ * dSYM for those. Call after initialize_debuggee_dyld_all_image_infos.
+ * Until this is done, the registry looks empty. Images dyld loads after
+ * this are registered by register_new_images. Whatever was registered
+ * for the last attach is thrown away.
+ */
+int dwarfreg_build(void){
+    if(!debuggee->dyld_info_array)
+        return 1;
+
+    int num_dsc_mappings = 0;
+    struct my_dsc_mapping *dsc_mappings = NULL;
+
+    if(DSCDATA)
+        dsc_mappings = get_dsc_mappings(DSCDATA, &num_dsc_mappings);
+
+    int count = debuggee->dyld_all_image_infos.infoArrayCount;
+
+    struct regimage **images = calloc(count, sizeof(struct regimage *));
+    int numimages = 0;
+
+    for(int i=0; i<count; i++){
+        unsigned long loadaddr =
+            (unsigned long)debuggee->dyld_info_array[i].imageLoadAddress;
+
+        if(dsc_mappings &&
+                is_dsc_image(loadaddr, dsc_mappings, num_dsc_mappings)){
+            continue;
+        }
+
+        struct regimage *ri = new_image(loadaddr,
+                (unsigned long)debuggee->dyld_info_array[i].imageFilePath);
+
+        if(!ri)
+            continue;
+
+        /* The search path and 'symbols add' can change under us */
+        pthread_mutex_lock(&REGISTRY_LOCK);
+        resolve_dsym(ri);
+        pthread_mutex_unlock(&REGISTRY_LOCK);
+
+        images[numimages++] = ri;
+    }
+
+    qsort(images, numimages, sizeof(struct regimage *), imagecmp);
+
+    struct task_dyld_info dyld_info = {0};
+    mach_msg_type_number_t infocount = TASK_DYLD_INFO_COUNT;
+
+    if(task_info(debuggee->task, TASK_DYLD_INFO, (task_info_t)&dyld_info,
+                &infocount)){
+        dyld_info.all_image_info_addr = 0;
+    }
+
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    free_images();
+
+    IMAGES = images;
+    NUMIMAGES = numimages;
+    ALLIMAGEINFOSADDR = dyld_info.all_image_info_addr;
+    LASTINFOCOUNT = count;
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    free(dsc_mappings);
+
+    return 0;
+}
+
+/* For 'symbols list' */
+void dwarfreg_describe(char **outbuffer){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    int nodsym = 0;
+
+    for(int i=0; i<NUMIMAGES; i++){
+        struct regimage *ri = IMAGES[i];
+
+        if(!ri->ri_dsympath){
+            nodsym++;
+            continue;
+        }
+
+        char uuid[40];
+        format_uuid(ri->ri_uuid, uuid);
+
+        const char *state = "not loaded";
+
+        if(ri->ri_dwarfinfo)
+            state = "loaded";
+        else if(ri->ri_loading)
+            state = "loading";
+        else if(ri->ri_loadfailed)
+            state = "failed";
+
+        concat(outbuffer, "%s %#llx (%s): %s\n\t%s\n",
+                basename_of(ri->ri_imagepath), ri->ri_loadaddr, state,
+                uuid, ri->ri_dsympath);
+    }
+
+    if(nodsym > 0)
+        concat(outbuffer, "%d image(s) without a dSYM\n", nodsym);
+
+    for(int i=0; i<NUMSEARCHPATHS; i++)
+        concat(outbuffer, "search path: %s\n", SEARCHPATHS[i]);
+
+    if(DIETREECAP > 0){
+        concat(outbuffer, "DIE trees limited to %llu MB per dSYM\n",
+                DIETREECAP >> 20);
+    }
+
+    for(int i=0; i<NUMDWARFFILES; i++){
+        int used = 0;
+
+        for(int j=0; j<NUMIMAGES && !used; j++)
+            used = memcmp(IMAGES[j]->ri_uuid, DWARFFILES[i].df_uuid, 16) == 0;
+
+        if(!used){
+            char uuid[40];
+            format_uuid(DWARFFILES[i].df_uuid, uuid);
+
+            concat(outbuffer, "%s: no image with UUID %s\n",
+                    DWARFFILES[i].df_path, uuid);
+        }
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+}
+
+/* Caps how much memory each dwarfinfo's DIE trees can use, for the ones
+ * already loaded and every one loaded after this. Zero removes the cap.
+ */
+void dwarfreg_set_die_tree_cap(uint64_t cap){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    DIETREECAP = cap;
+
+    for(int i=0; i<NUMIMAGES; i++){
+        if(IMAGES[i]->ri_dwarfinfo)
+            sym_set_die_tree_cap(IMAGES[i]->ri_dwarfinfo, cap, NULL);
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+}
+
+/* Throws away every image and the DWARF parsed for it. The search
+ * path and files from 'symbols add' stay for the next attach. The
+ * symbol loader has to be stopped first.
+ */
+void dwarfreg_end(void){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    free_images();
+
+    ALLIMAGEINFOSADDR = 0;
+    LASTINFOCOUNT = 0;
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+}
+
+/* Gives back the dwarfinfo for whatever image pc is in, parsing its
+ * dSYM if this is the first time anything asked, and how far that
+ * image was slid. Non-zero if there's no DWARF for pc. If there is,
+ * it isn't freed until you give it back with dwarfreg_release.
+ */
+int dwarfreg_find_by_pc(uint64_t pc, void **dwarfinfoout,
+        uint64_t *slideout){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    struct regimage *ri = find_image(pc);
+
+    if(!ri){
+        register_new_images();
+        ri = find_image(pc);
+    }
+
+    void *dwarfinfo = ri ? load_image_dwarf(ri, NULL) : NULL;
+
+    if(dwarfinfo){
+        ri->ri_users++;
+        *dwarfinfoout = dwarfinfo;
+
+        if(slideout)
+            *slideout = ri->ri_slide;
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    return dwarfinfo == NULL;
+}
+
+/* Gives back a dwarfinfo from dwarfreg_find_by_pc. Anything you got
+ * from it can't be used after this.
+ */
+void dwarfreg_release(void *dwarfinfo){
+    if(!dwarfinfo)
+        return;
+
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    for(int i=0; i<NUMIMAGES; i++){
+        if(IMAGES[i]->ri_dwarfinfo == dwarfinfo && IMAGES[i]->ri_users > 0){
+            IMAGES[i]->ri_users--;
+            pthread_mutex_unlock(&REGISTRY_LOCK);
+            return;
+        }
+    }
+
+    void *dead = NULL;
+
+    for(int i=0; i<NUMRETIRED; i++){
+        if(RETIRED[i].rd_dwarfinfo != dwarfinfo)
+            continue;
+
+        if(--RETIRED[i].rd_users == 0){
+            dead = dwarfinfo;
+            RETIRED[i] = RETIRED[--NUMRETIRED];
+        }
+
+        break;
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    sym_end(&dead);
+}
+
+int dwarfreg_has_dwarf(void){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    int have = 0;
+
+    for(int i=0; i<NUMIMAGES && !have; i++)
+        have = IMAGES[i]->ri_dsympath && !IMAGES[i]->ri_loadfailed;
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    return have;
+}
+
+/* Parses the dSYM of every image 'symbols add' asked for. progress is
+ * called before each one with how many are done and how many there
+ * are. If it returns non-zero, we stop. Meant for the symbol loader
+ * thread.
+ */
+void dwarfreg_load_wanted(int (*progress)(int, int)){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    int total = 0, done = 0;
+
+    for(int i=0; i<NUMIMAGES; i++)
+        total += IMAGES[i]->ri_wanted;
+
+    for(int i=0; i<NUMIMAGES && done<total; i++){
+        struct regimage *ri = IMAGES[i];
+
+        if(!ri->ri_wanted)
+            continue;
+
+        if(progress && progress(done, total))
+            break;
+
+        ri->ri_wanted = 0;
+
+        sym_error_t e = {0};
+
+        if(!load_image_dwarf(ri, &e) && e.error_kind != NO_ERROR_KIND){
+            io_append("warning: couldn't load DWARF for %s: %s\n",
+                    basename_of(ri->ri_imagepath), errmsg(e));
+        }
+
+        done++;
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+}
+
+/* Finishes the symbol cache of every dwarfinfo that's been loaded and
+ * builds all of its DIE trees, so the first query about a compilation
+ * unit doesn't have to. Each one's trees are built across every CPU,
+ * and queries about that image wait for it. progress is called before
+ * each image like it is for dwarfreg_load_wanted. With a 'symbols cap',
+ * most of the trees would just get thrown away, so only the cache is
+ * finished. Meant for the symbol loader thread.
+ */
+void dwarfreg_build_die_trees(int (*progress)(int, int)){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    int total = 0, done = 0;
+
+    for(int i=0; i<NUMIMAGES; i++)
+        total += IMAGES[i]->ri_dwarfinfo && !IMAGES[i]->ri_treesbuilt;
+
+    for(int i=0; i<NUMIMAGES && done<total; i++){
+        struct regimage *ri = IMAGES[i];
+
+        if(!ri->ri_dwarfinfo || ri->ri_treesbuilt)
+            continue;
+
+        if(progress && progress(done, total))
+            break;
+
+        void *dwarfinfo = ri->ri_dwarfinfo;
+        uint64_t cap = DIETREECAP;
+
+        ri->ri_treesbuilt = 1;
+
+        /* Keeps dwarfinfo around if we reattach while this is going */
+        ri->ri_users++;
+
+        pthread_mutex_unlock(&REGISTRY_LOCK);
+
+        sym_complete_symbol_cache(dwarfinfo, NULL);
+
+        if(cap == 0)
+            sym_build_all_die_trees(dwarfinfo, 0, NULL);
+
+        dwarfreg_release(dwarfinfo);
+
+        pthread_mutex_lock(&REGISTRY_LOCK);
+
+        done++;
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+}
+
+/* Whether the dSYM at path could have a line table for filename,
+ * without parsing it. Every compilation unit name and line table file
+ * name is a plain string in one of these sections, so if filename's
+ * base name isn't in any of them, neither is the file.
+ */
+static int dsym_mentions_file(const char *path, const char *filename){
+    static const char *sections[] = {
+        "debug_line", "debug_line_str", "debug_str"
+    };
+
+    const char *base = basename_of(filename);
+    size_t baselen = strlen(base);
+
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+        return 0;
+
+    struct stat st;
+
+    if(fstat(fd, &st) || st.st_size == 0){
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if(map == MAP_FAILED)
+        return 0;
+
+    int found = 0;
+
+    for(int i=0; i<sizeof(sections) / sizeof(*sections) && !found; i++){
+        const uint8_t *data = NULL;
+        uint64_t size = 0;
+
+        if(obj_find_section(map, st.st_size, sections[i], &data, &size))
+            continue;
+
+        found = memmem(data, size, base, baselen) != NULL;
+    }
+
+    munmap(map, st.st_size);
+
+    return found;
+}
+
+/* An image dwarfreg_lineno_to_pcs is looking in. The registry lock
+ * isn't held while it looks, ri_users keeps the dwarfinfo around.
+ */
+struct lookupimage {
+    void *lk_dwarfinfo;
+    uint64_t lk_slide;
+};
+
+static int pccmp(const void *a, const void *b){
+    uint64_t pa = *(const uint64_t *)a, pb = *(const uint64_t *)b;
+
+    return (pa > pb) - (pa < pb);
+}
+
+/* sym_lineno_to_pcs for every image in lks, with the PCs slid and put
+ * together. With adjust, the closest line after *lineno in any of them
+ * is the one used.
+ */
+static int lineno_to_pcs_in(struct lookupimage *lks, int numlks,
+        char *srcfilename, uint64_t *lineno, int adjust, uint64_t **pcsout,
+        int *numpcsout){
+    uint64_t want = *lineno;
+
+    if(adjust){
+        want = UINT64_MAX;
+
+        for(int i=0; i<numlks; i++){
+            uint64_t adjusted = *lineno, *pcs = NULL;
+            int numpcs = 0;
+
+            if(sym_lineno_to_pcs(lks[i].lk_dwarfinfo, srcfilename, &adjusted,
+                        1, &pcs, &numpcs, NULL) == 0){
+                if(adjusted < want)
+                    want = adjusted;
+
+                free(pcs);
+            }
+        }
+
+        if(want == UINT64_MAX)
+            return 1;
+    }
+
+    uint64_t *allpcs = NULL;
+    int numallpcs = 0;
+
+    for(int i=0; i<numlks; i++){
+        uint64_t exact = want, *pcs = NULL;
+        int numpcs = 0;
+
+        if(sym_lineno_to_pcs(lks[i].lk_dwarfinfo, srcfilename, &exact, 0,
+                    &pcs, &numpcs, NULL)){
+            continue;
+        }
+
+        uint64_t *allpcs_rea = realloc(allpcs,
+                sizeof(uint64_t) * (numallpcs + numpcs));
+        allpcs = allpcs_rea;
+
+        for(int j=0; j<numpcs; j++)
+            allpcs[numallpcs++] = pcs[j] + lks[i].lk_slide;
+
+        free(pcs);
+    }
+
+    if(numallpcs == 0)
+        return 1;
+
+    qsort(allpcs, numallpcs, sizeof(uint64_t), pccmp);
+
+    *lineno = want;
+    *pcsout = allpcs;
+    *numpcsout = numallpcs;
+
+    return 0;
+}
+
+/* Every PC a line in srcfilename was compiled to, in every image that
+ * has it, slid. An exact match in any image beats auto-adjusting a line
+ * with no code to the next one that has some. Images that are already
+ * parsed are looked in first. Then only the dSYMs that mention
+ * srcfilename are parsed and looked in. The registry lock is only held
+ * to decide which images to look in, not while looking. pcsout has to
+ * be freed.
+ */
+int dwarfreg_lineno_to_pcs(char *srcfilename, uint64_t *srcfilelineno,
+        uint64_t **pcsout, int *numpcsout, char **outbuffer, void *e){
+    pthread_mutex_lock(&REGISTRY_LOCK);
+
+    register_new_images();
+
+    struct lookupimage *lks = malloc(sizeof(struct lookupimage) *
+            (NUMIMAGES + 1));
+    char **unparsed = malloc(sizeof(char *) * (NUMIMAGES + 1));
+    int numlks = 0, numunparsed = 0;
+
+    for(int i=0; i<NUMIMAGES; i++){
+        struct regimage *ri = IMAGES[i];
+
+        if(ri->ri_dwarfinfo){
+            ri->ri_users++;
+
+            lks[numlks].lk_dwarfinfo = ri->ri_dwarfinfo;
+            lks[numlks].lk_slide = ri->ri_slide;
+            numlks++;
+        }
+        else if(ri->ri_dsympath && !ri->ri_loadfailed){
+            unparsed[numunparsed++] = strdup(ri->ri_dsympath);
+        }
+    }
+
+    pthread_mutex_unlock(&REGISTRY_LOCK);
+
+    uint64_t lineno = *srcfilelineno;
+
+    int failed = lineno_to_pcs_in(lks, numlks, srcfilename, &lineno, 0,
+            pcsout, numpcsout);
+
+    if(failed){
+        int numparsed = numlks;
+
+        for(int i=0; i<numunparsed; i++){
+            if(!dsym_mentions_file(unparsed[i], srcfilename))
+                continue;
+
+            pthread_mutex_lock(&REGISTRY_LOCK);
+
+            for(int j=0; j<NUMIMAGES; j++){
+                struct regimage *ri = IMAGES[j];
+
+                if(!ri->ri_dsympath || strcmp(ri->ri_dsympath, unparsed[i]))
+                    continue;
+
+                if(load_image_dwarf(ri, NULL)){
+                    ri->ri_users++;
+
+                    lks[numlks].lk_dwarfinfo = ri->ri_dwarfinfo;
+                    lks[numlks].lk_slide = ri->ri_slide;
+                    numlks++;
+                }
+
+                break;
+            }
+
+            pthread_mutex_unlock(&REGISTRY_LOCK);
+        }
+
+        failed = lineno_to_pcs_in(lks + numparsed, numlks - numparsed,
+                srcfilename, &lineno, 0, pcsout, numpcsout);
+    }
+
+    if(failed){
+        failed = lineno_to_pcs_in(lks, numlks, srcfilename, &lineno, 1,
+                pcsout, numpcsout);
+    }
+
+    for(int i=0; i<numlks; i++)
+        dwarfreg_release(lks[i].lk_dwarfinfo);
+
+    for(int i=0; i<numunparsed; i++)
+        free(unparsed[i]);
+
+    free(lks);
+    free(unparsed);
+
+    if(failed){
+        errset(e, DIE_ERROR_KIND, DIE_LINE_NOT_FOUND);
+        return 1;
+    }
+
+    if(lineno != *srcfilelineno){
+        concat(outbuffer, "Line %lld doesn't exist, auto-adjusted to line"
+                " %lld\n", *srcfilelineno, lineno);
+    }
+
+    *srcfilelineno = lineno;
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef _DWARFREG_H_
+#define _DWARFREG_H_
+
+#include <stdint.h>
+
+int dwarfreg_add_dwarf_file(const char *, char **, void *);
+void dwarfreg_add_search_path(const char *);
+int dwarfreg_build(void);
+void dwarfreg_build_die_trees(int (*)(int, int));
+void dwarfreg_describe(char **);
+void dwarfreg_end(void);
+int dwarfreg_find_by_pc(uint64_t, void **, uint64_t *);
+int dwarfreg_has_dwarf(void);
+int dwarfreg_lineno_to_pcs(char *, uint64_t *, uint64_t **, int *, char **,
+        void *);
+void dwarfreg_load_wanted(int (*)(int, int));
+void dwarfreg_release(void *);
+void dwarfreg_set_die_tree_cap(uint64_t);
+
+#endif
@@ -2,11 +2,14 @@
 #include <mach-o/loader.h>
 #include <mach-o/nlist.h>
 #include <mach-o/stab.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "dbgsymbol.h"
 #include "scache.h"
+#include "symtable.h"
 
 #include "../array.h"
 #include "../dbgio.h"
@@ -299,11 +302,38 @@ static int wrappercmp(const void *a, const void *b){
     return strcmp(wa->dylib_path, wb->dylib_path);
 }
 
+/* Read an image's whole string table at once, from its file if we can,
+ * and from its memory if we can't. It gets a NUL at the end so a bad
+ * string table index can't run off of it.
+ */
+static char *read_strtab(char *imagename, unsigned long image_load_addr,
+        struct symtab_command *symtab_cmd){
+    unsigned long strsize = symtab_cmd->strsize;
+    char *strtab = malloc(strsize + 1);
+
+    strtab[strsize] = '\0';
+
+    if(copy_file_contents(imagename, symtab_cmd->stroff, strtab,
+                strsize) == strsize){
+        return strtab;
+    }
+
+    kern_return_t kret = read_memory_at_location(
+            symtab_cmd->stroff + image_load_addr, strtab, strsize);
+
+    if(kret != KERN_SUCCESS){
+        free(strtab);
+        return NULL;
+    }
+
+    return strtab;
+}
+
 static int read_nlists(char *imagename, unsigned long image_load_addr,
         struct array *nlist_wrappers, struct my_dsc_mapping *mappings,
         int mappingcnt, int dsc_image, struct symtab_command *symtab_cmd,
         struct segment_command_64 *__text_seg_cmd, int __text_segment_nsect,
-        struct array *dsc_local_sym_entries_wrappers){
+        char *strtab, struct array *dsc_local_sym_entries_wrappers){
     unsigned long aslr_slide = image_load_addr - __text_seg_cmd->vmaddr;
 
     if(dsc_image){
@@ -388,8 +418,7 @@ static int read_nlists(char *imagename, unsigned long image_load_addr,
         }
     }
     else{
-        unsigned long symtab_addr = symtab_cmd->symoff + image_load_addr,
-                      strtab_addr = symtab_cmd->stroff + image_load_addr;
+        unsigned long symtab_addr = symtab_cmd->symoff + image_load_addr;
 
         size_t nscount = sizeof(struct nlist_64) * symtab_cmd->nsyms;
         struct nlist_64 *ns = malloc(nscount);
@@ -401,12 +430,9 @@ static int read_nlists(char *imagename, unsigned long image_load_addr,
 
         for(int j=0; j<symtab_cmd->nsyms; j++){
             struct nlist_64 nlist = ns[j];
-            enum { maxlen = 512 };
-            char str[maxlen] = {0};
-            kret = read_memory_at_location(strtab_addr + ns[j].n_un.n_strx,
-                    str, maxlen);
 
-            if(kret != KERN_SUCCESS || !(*str) ||
+            if(nlist.n_un.n_strx >= symtab_cmd->strsize ||
+                    !strtab[nlist.n_un.n_strx] ||
                     (nlist.n_type & N_TYPE) != N_SECT ||
                     nlist.n_sect != __text_segment_nsect || nlist.n_value == 0){
                 continue;
@@ -471,6 +497,18 @@ static struct dbg_sym_entry *create_sym_entry_for_image(char *imagename,
         unsigned long strtab_vmaddr = symtab_cmd->stroff + image_load_addr;
 
         entry = create_sym_entry(strtab_vmaddr, symtab_cmd->stroff, from_dsc);
+
+        entry->strtab = read_strtab(imagename, image_load_addr, symtab_cmd);
+
+        if(!entry->strtab){
+            free(entry);
+            free(symtab_cmd);
+            free(__text_seg_cmd);
+
+            return NULL;
+        }
+
+        entry->strtabsize = symtab_cmd->strsize;
     }
 
     entry->load_addr = image_load_addr;
@@ -479,6 +517,7 @@ static struct dbg_sym_entry *create_sym_entry_for_image(char *imagename,
 
     if(read_lc_fxn_starts(imagename, image_load_addr, lc_fxn_starts,
             aslr_slide, dsc_image ? DSC : NON_DSC)){
+        free(entry->strtab);
         free(entry);
         free(symtab_cmd);
         free(__text_seg_cmd);
@@ -495,7 +534,8 @@ static struct dbg_sym_entry *create_sym_entry_for_image(char *imagename,
     if(read_nlists(imagename, image_load_addr, nlist_wrappers,
             mappings, mappingcnt, dsc_image,
             symtab_cmd, __text_seg_cmd, __text_segment_nsect,
-            dsc_local_sym_entries_wrappers)){
+            entry->strtab, dsc_local_sym_entries_wrappers)){
+        free(entry->strtab);
         free(entry);
         free(symtab_cmd);
         free(__text_seg_cmd);
@@ -510,6 +550,8 @@ static struct dbg_sym_entry *create_sym_entry_for_image(char *imagename,
     /* prep nlist array for binary searches */
     array_qsort(nlist_wrappers, nlistwcmp);
 
+    reserve_symbols(entry, lc_fxn_starts->len);
+
     /* add the symbols for the current entry */
     for(int i=0; i<lc_fxn_starts->len; i++){
         struct lc_fxn_starts_entry *lc_entry =
@@ -605,6 +647,9 @@ static void stash_dsc_local_syms_entries(struct array *entries){
     }
 }
 
+/* Only reads the list of images dyld has loaded. Building symbol
+ * tables for them is left to initialize_debuggee_symbols.
+ */
 int initialize_debuggee_dyld_all_image_infos(void){
     struct task_dyld_info dyld_info = {0};
     mach_msg_type_number_t count = TASK_DYLD_INFO_COUNT;
@@ -632,13 +677,105 @@ int initialize_debuggee_dyld_all_image_infos(void){
     if(kret)
         return 1;
 
+    return 0;
+}
+
+struct symworker {
+    struct my_dsc_mapping *sw_dsc_mappings;
+    int sw_num_dsc_mappings;
+    struct array *sw_dsc_local_syms_entry_wrappers;
+
+    /* One slot per image, so the list can be put together in order */
+    struct dbg_sym_entry **sw_entries;
+    int sw_count;
+
+    int *sw_next;
+    int *sw_done;
+    int *sw_stopped;
+    pthread_mutex_t *sw_nextlock;
+
+    int (*sw_progress)(int, int);
+};
+
+static struct dbg_sym_entry *create_sym_entry_for_image_idx(int i,
+        struct symworker *sw){
+    int maxlen = PATH_MAX;
+    char fpath[maxlen];
+    memset(fpath, 0, maxlen);
+
+    unsigned long imgpath =
+        (unsigned long)debuggee->dyld_info_array[i].imageFilePath;
+
+    read_memory_at_location(imgpath, fpath, maxlen);
+
+    unsigned long image_load_address =
+        (unsigned long)debuggee->dyld_info_array[i].imageLoadAddress;
+
+    struct dbg_sym_entry *entry = create_sym_entry_for_image(fpath,
+            image_load_address, sw->sw_dsc_mappings, sw->sw_num_dsc_mappings,
+            sw->sw_dsc_local_syms_entry_wrappers);
+
+    if(!entry)
+        return NULL;
+
+    /* we only care about the last part of fpath */
+    char *lastslash = strrchr(fpath, '/');
+    char *path = fpath;
+
+    if(lastslash)
+        path = lastslash + 1;
+
+    entry->imagename = strdup(path);
+
+    return entry;
+}
+
+static void *symworker_main(void *arg){
+    struct symworker *sw = arg;
+    int finished = -1;
+
+    for(;;){
+        pthread_mutex_lock(sw->sw_nextlock);
+
+        if(finished != -1)
+            (*sw->sw_done)++;
+
+        if(!*sw->sw_stopped && sw->sw_progress &&
+                sw->sw_progress(*sw->sw_done, sw->sw_count)){
+            *sw->sw_stopped = 1;
+        }
+
+        int idx = *sw->sw_stopped ? sw->sw_count : (*sw->sw_next)++;
+
+        pthread_mutex_unlock(sw->sw_nextlock);
+
+        if(idx >= sw->sw_count)
+            return NULL;
+
+        sw->sw_entries[idx] = create_sym_entry_for_image_idx(idx, sw);
+        finished = idx;
+    }
+}
+
+/* Builds the symbol table of every image in dyld_info_array. This is
+ * slow enough that it happens on the symbol loader thread, so nothing
+ * sees debuggee->symbols until every image is done, and then all of it
+ * shows up at once. Images don't depend on each other, so they're
+ * built on a pool of one thread per CPU, and put in the list in
+ * dyld's order after. progress is called with how many images are
+ * done and how many there are. If it returns non-zero, we stop, and
+ * whatever we got through is still given to debuggee->symbols for
+ * destroy_all_symbol_entries.
+ */
+int initialize_debuggee_symbols(int (*progress)(int, int)){
     /* Read the mappings of dyld shared cache to differentiate
      * between cache images and other images.
      */
     int num_dsc_mappings = 0;
     struct my_dsc_mapping *dsc_mappings = get_dsc_mappings(DSCDATA, &num_dsc_mappings);
 
-    debuggee->symbols = linkedlist_new();
+    struct linkedlist *symbols = linkedlist_new();
+    int stopped = 0;
 
     /* Stash the local symbols entries from the dyld shared cache
      * so we can bsearch them.
@@ -650,38 +787,54 @@ int initialize_debuggee_dyld_all_image_infos(void){
     array_shrink_to_fit(dsc_local_syms_entry_wrappers);
     array_qsort(dsc_local_syms_entry_wrappers, wrappercmp);
 
-    for(int i=0; i<debuggee->dyld_all_image_infos.infoArrayCount; i++){
-        int maxlen = PATH_MAX;
-        char fpath[maxlen];
-        memset(fpath, 0, maxlen);
+    int count = debuggee->dyld_all_image_infos.infoArrayCount;
 
-        unsigned long imgpath =
-            (unsigned long)debuggee->dyld_info_array[i].imageFilePath;
+    struct dbg_sym_entry **entries = calloc(count + 1,
+            sizeof(struct dbg_sym_entry *));
 
-        read_memory_at_location(imgpath, fpath, maxlen);
+    int next = 0, done = 0;
+    pthread_mutex_t nextlock = PTHREAD_MUTEX_INITIALIZER;
 
-        unsigned long image_load_address =
-            (unsigned long)debuggee->dyld_info_array[i].imageLoadAddress;
+    struct symworker sw = { dsc_mappings, num_dsc_mappings,
+        dsc_local_syms_entry_wrappers, entries, count, &next, &done,
+        &stopped, &nextlock, progress };
 
-        struct dbg_sym_entry *entry = create_sym_entry_for_image(fpath,
-                image_load_address, dsc_mappings, num_dsc_mappings,
-                dsc_local_syms_entry_wrappers);
+    int numworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
 
-        if(!entry)
-            continue;
+    if(numworkers > count)
+        numworkers = count;
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * (numworkers + 1));
+    int numthreads = 0;
+
+    /* One less, since this thread is a worker too */
+    for(int i=1; i<numworkers; i++){
+        if(pthread_create(&threads[numthreads], NULL, symworker_main, &sw))
+            break;
+
+        numthreads++;
+    }
+
+    /* If none could start, this thread does all of it */
+    symworker_main(&sw);
 
-        /* we only care about the last part of fpath */
-        char *lastslash = strrchr(fpath, '/');
-        char *path = fpath;
+    for(int i=0; i<numthreads; i++)
+        pthread_join(threads[i], NULL);
 
-        if(lastslash)
-            path = lastslash + 1;
+    free(threads);
+    pthread_mutex_destroy(&nextlock);
 
-        entry->imagename = strdup(path);
+    for(int i=0; i<count; i++){
+        struct dbg_sym_entry *entry = entries[i];
 
-        linkedlist_add(debuggee->symbols, entry);
+        if(!entry)
+            continue;
+
+        number_unnamed_symbols(entry);
+        linkedlist_add(symbols, entry);
     }
 
+    free(entries);
     free(dsc_mappings);
 
     int num_dsc_local_sym_entries_wrappers = dsc_local_syms_entry_wrappers->len;
@@ -691,5 +844,14 @@ int initialize_debuggee_dyld_all_image_infos(void){
 
     array_destroy(&dsc_local_syms_entry_wrappers);
 
-    return 0;
+    struct symtable *symtable = symtable_build(symbols);
+
+    /* Whoever is reading debuggee->symbols on another thread either
+     * sees nothing and shows raw addresses, or sees every image. The
+     * symbol table goes first, so it's there by the time they do.
+     */
+    __atomic_store_n(&debuggee->symtable, symtable, __ATOMIC_RELEASE);
+    __atomic_store_n(&debuggee->symbols, symbols, __ATOMIC_RELEASE);
+
+    return stopped;
 }
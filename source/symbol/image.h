@@ -2,5 +2,6 @@
 #define _IMAGE_H_
 
 int initialize_debuggee_dyld_all_image_infos(void);
+int initialize_debuggee_symbols(int (*)(int, int));
 
 #endif
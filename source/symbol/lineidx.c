@@ -0,0 +1,322 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../hashtable.h"
+
+#include "common.h"
+#include "compunit.h"
+#include "die.h"
+#include "linetable.h"
+#include "strpool.h"
+
+/* Every (source file, line) in a dwarfinfo and every PC it was
+ * compiled to, across all of its compilation units. Code from a header
+ * shows up in every compilation unit that includes it, and all of it
+ * ends up under the one file here. Files are found by the hash of their
+ * base name, then lines by binary search, so resolving file:line never
+ * has to look at a compilation unit that doesn't have the file.
+ *
+ * Building this decodes every line table, so it's only done the first
+ * time something needs it.
+ */
+
+struct srcline {
+    uint32_t sl_lineno;
+    /* Index into li_pcs */
+    int sl_firstpc;
+    int sl_numpcs;
+};
+
+struct srcfile {
+    /* Pooled, so two files are the same only if this is */
+    const char *sf_path;
+
+    /* Sorted by line */
+    struct srcline *sf_lines;
+    int sf_numlines;
+
+    /* Next file whose base name hashes the same */
+    struct srcfile *sf_next;
+};
+
+struct lineidx {
+    struct srcfile *li_files;
+    int li_numfiles;
+
+    struct srcline *li_lines;
+    uint64_t *li_pcs;
+
+    /* Hash of a file's base name -> first struct srcfile with it */
+    struct hashtable *li_byname;
+};
+
+/* Only used while building */
+struct lineent {
+    const char *le_path;
+    uint32_t le_lineno;
+    uint64_t le_pc;
+};
+
+static const char *path_basename(const char *path){
+    const char *slash = strrchr(path, '/');
+
+    return slash ? slash + 1 : path;
+}
+
+static int lineent_cmp(const void *a, const void *b){
+    const struct lineent *la = a;
+    const struct lineent *lb = b;
+
+    if(la->le_path != lb->le_path)
+        return (uintptr_t)la->le_path < (uintptr_t)lb->le_path ? -1 : 1;
+
+    if(la->le_lineno != lb->le_lineno)
+        return la->le_lineno < lb->le_lineno ? -1 : 1;
+
+    if(la->le_pc != lb->le_pc)
+        return la->le_pc < lb->le_pc ? -1 : 1;
+
+    return 0;
+}
+
+static int pc_cmp(const void *a, const void *b){
+    uint64_t pa = *(const uint64_t *)a, pb = *(const uint64_t *)b;
+
+    return (pa > pb) - (pa < pb);
+}
+
+static void add_file_to_name_index(struct lineidx *li, struct srcfile *sf){
+    unsigned long key = hashtable_strhash(path_basename(sf->sf_path));
+    struct srcfile *head = NULL;
+
+    if(hashtable_get(li->li_byname, key, (void **)&head) == HASHTABLE_OK){
+        while(head->sf_next)
+            head = head->sf_next;
+
+        head->sf_next = sf;
+        return;
+    }
+
+    hashtable_insert(li->li_byname, key, sf);
+}
+
+/* di_lock has to be held */
+struct lineidx *lineidx_build(dwarfinfo_t *dwarfinfo){
+    struct lineent *ents = NULL;
+    int numents = 0, capacity = 0;
+
+    for(int i=0; i<dwarfinfo->di_numcompunits; i++){
+        void *root_die = NULL, *lt = NULL;
+        cu_get_root_die_no_tree(dwarfinfo->di_cus[i], &root_die, NULL);
+
+        if(die_get_linetable(cu_get_dwarf_debug(dwarfinfo), root_die, &lt,
+                    NULL)){
+            continue;
+        }
+
+        int numsrclines = lt_get_num_src_lines(lt);
+
+        for(int j=0; j<numsrclines; j++){
+            const char *file = NULL;
+            const uint64_t *pcs = NULL;
+            uint64_t lineno = 0;
+            int numpcs = 0;
+
+            lt_get_src_line(lt, j, &file, &lineno, &pcs, &numpcs);
+
+            if(!file)
+                continue;
+
+            const char *path = strpool_add(dwarfinfo->di_strpool, file);
+
+            if(numents + numpcs > capacity){
+                capacity = capacity ? capacity * 2 : 1024;
+
+                while(numents + numpcs > capacity)
+                    capacity *= 2;
+
+                struct lineent *ents_rea = realloc(ents,
+                        sizeof(struct lineent) * capacity);
+                ents = ents_rea;
+            }
+
+            for(int k=0; k<numpcs; k++){
+                ents[numents].le_path = path;
+                ents[numents].le_lineno = (uint32_t)lineno;
+                ents[numents].le_pc = pcs[k];
+                numents++;
+            }
+        }
+    }
+
+    qsort(ents, numents, sizeof(struct lineent), lineent_cmp);
+
+    struct lineidx *li = calloc(1, sizeof(struct lineidx));
+    int n = numents ? numents : 1;
+
+    li->li_files = malloc(sizeof(struct srcfile) * n);
+    li->li_lines = malloc(sizeof(struct srcline) * n);
+    li->li_pcs = malloc(sizeof(uint64_t) * n);
+    li->li_byname = hashtable_new();
+
+    int numlines = 0, numpcs = 0;
+
+    for(int i=0; i<numents; i++){
+        struct lineent *le = &ents[i];
+        struct srcfile *sf = NULL;
+        struct srcline *sl = NULL;
+
+        if(li->li_numfiles > 0)
+            sf = &li->li_files[li->li_numfiles - 1];
+
+        if(!sf || sf->sf_path != le->le_path){
+            sf = &li->li_files[li->li_numfiles++];
+
+            sf->sf_path = le->le_path;
+            sf->sf_lines = &li->li_lines[numlines];
+            sf->sf_numlines = 0;
+            sf->sf_next = NULL;
+        }
+        else{
+            sl = &sf->sf_lines[sf->sf_numlines - 1];
+        }
+
+        if(!sl || sl->sl_lineno != le->le_lineno){
+            sl = &li->li_lines[numlines++];
+            sf->sf_numlines++;
+
+            sl->sl_lineno = le->le_lineno;
+            sl->sl_firstpc = numpcs;
+            sl->sl_numpcs = 0;
+        }
+        /* More than one compilation unit can have the same code */
+        else if(li->li_pcs[numpcs - 1] == le->le_pc){
+            continue;
+        }
+
+        li->li_pcs[numpcs++] = le->le_pc;
+        sl->sl_numpcs++;
+    }
+
+    free(ents);
+
+    /* li_files doesn't move after this */
+    for(int i=0; i<li->li_numfiles; i++)
+        add_file_to_name_index(li, &li->li_files[i]);
+
+    return li;
+}
+
+/* Returns the first line in sf that's >= lineno, or NULL if there
+ * isn't one.
+ */
+static struct srcline *find_line(struct srcfile *sf, uint32_t lineno){
+    int lo = 0, hi = sf->sf_numlines;
+
+    while(lo < hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(sf->sf_lines[mid].sl_lineno < lineno)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < sf->sf_numlines ? &sf->sf_lines[lo] : NULL;
+}
+
+/* Every PC lineno in filename was compiled to, sorted, in every file
+ * filename could mean (see is_same_srcfile). With adjust, a line with
+ * no code resolves to the next one that has some, otherwise only an
+ * exact match counts. The line actually used goes in linenoout. pcsout
+ * is allocated and has to be freed. Returns non-zero if nothing
+ * matched.
+ */
+int lineidx_find(struct lineidx *li, const char *filename, uint64_t lineno,
+        int adjust, uint64_t *linenoout, uint64_t **pcsout, int *numpcsout){
+    struct srcfile *sf = NULL;
+
+    if(!li || lineno > UINT32_MAX)
+        return 1;
+
+    if(hashtable_get(li->li_byname,
+                hashtable_strhash(path_basename(filename)),
+                (void **)&sf) != HASHTABLE_OK){
+        return 1;
+    }
+
+    struct srcfile *first = sf;
+    uint64_t want = lineno;
+
+    /* The closest line after lineno in any of the files wins */
+    if(adjust){
+        want = UINT64_MAX;
+
+        for(sf = first; sf; sf = sf->sf_next){
+            if(!is_same_srcfile(sf->sf_path, filename))
+                continue;
+
+            struct srcline *sl = find_line(sf, (uint32_t)lineno);
+
+            if(sl && sl->sl_lineno < want)
+                want = sl->sl_lineno;
+        }
+
+        if(want == UINT64_MAX)
+            return 1;
+    }
+
+    uint64_t *pcs = NULL;
+    int numpcs = 0;
+
+    for(sf = first; sf; sf = sf->sf_next){
+        if(!is_same_srcfile(sf->sf_path, filename))
+            continue;
+
+        struct srcline *sl = find_line(sf, (uint32_t)want);
+
+        if(!sl || sl->sl_lineno != want)
+            continue;
+
+        uint64_t *pcs_rea = realloc(pcs,
+                sizeof(uint64_t) * (numpcs + sl->sl_numpcs));
+        pcs = pcs_rea;
+
+        memcpy(pcs + numpcs, &li->li_pcs[sl->sl_firstpc],
+                sizeof(uint64_t) * sl->sl_numpcs);
+        numpcs += sl->sl_numpcs;
+    }
+
+    if(numpcs == 0){
+        free(pcs);
+        return 1;
+    }
+
+    /* Two paths for the same file can share code */
+    qsort(pcs, numpcs, sizeof(uint64_t), pc_cmp);
+
+    int numunique = 1;
+
+    for(int i=1; i<numpcs; i++){
+        if(pcs[i] != pcs[numunique - 1])
+            pcs[numunique++] = pcs[i];
+    }
+
+    *linenoout = want;
+    *pcsout = pcs;
+    *numpcsout = numunique;
+
+    return 0;
+}
+
+void lineidx_free(struct lineidx *li){
+    if(!li)
+        return;
+
+    hashtable_destroy(&li->li_byname);
+    free(li->li_files);
+    free(li->li_lines);
+    free(li->li_pcs);
+    free(li);
+}
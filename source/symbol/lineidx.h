@@ -0,0 +1,11 @@
+#ifndef _LINEIDX_H_
+#define _LINEIDX_H_
+
+#include <stdint.h>
+
+void *lineidx_build(void *);
+int lineidx_find(void *, const char *, uint64_t, int, uint64_t *,
+        uint64_t **, int *);
+void lineidx_free(void *);
+
+#endif
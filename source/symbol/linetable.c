@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdwarf.h>
+
+/* A decoded row of a compilation unit's line number program. Rows are
+ * kept sorted by address so PC lookups are a binary search and never
+ * have to go back through libdwarf.
+ */
+struct linerow {
+    uint64_t lr_addr;
+    uint32_t lr_lineno;
+    /* Index into lt_files */
+    uint16_t lr_fileidx;
+    uint8_t lr_isstmt;
+    uint8_t lr_endseq;
+};
+
+/* Where every run of code a source line in one file was compiled to
+ * starts
+ */
+struct linepcs {
+    uint32_t lp_lineno;
+    uint16_t lp_fileidx;
+    /* Index into lt_stmtpcs */
+    int lp_firstpc;
+    int lp_numpcs;
+};
+
+struct linetable {
+    struct linerow *lt_rows;
+    int lt_numrows;
+
+    /* Every source file this line table references, stored once */
+    char **lt_files;
+    int lt_numfiles;
+
+    /* If lt_rows and the strings in lt_files belong to someone else,
+     * like a mapped symbol cache. See lt_from_raw_rows.
+     */
+    int lt_borrowed;
+
+    /* Reverse index for (file, line) -> PC lookups, built the first
+     * time one is done. lt_linepcs is sorted by file, then line. See
+     * lineidx.c for what looks things up in it.
+     */
+    int lt_hasreverseidx;
+    struct linepcs *lt_linepcs;
+    int lt_numlinepcs;
+    uint64_t *lt_stmtpcs;
+};
+
+/* Used only while sorting so rows with the same address keep
+ * the order the line number program gave them in.
+ */
+struct linerow_sortkey {
+    struct linerow row;
+    int idx;
+};
+
+static int linerow_sortkey_cmp(const void *a, const void *b){
+    const struct linerow_sortkey *ka = a;
+    const struct linerow_sortkey *kb = b;
+
+    if(ka->row.lr_addr != kb->row.lr_addr)
+        return ka->row.lr_addr < kb->row.lr_addr ? -1 : 1;
+
+    /* An end_sequence row ends the previous sequence, so it goes
+     * before a sequence which starts at the same address.
+     */
+    if(ka->row.lr_endseq != kb->row.lr_endseq)
+        return ka->row.lr_endseq ? -1 : 1;
+
+    return ka->idx - kb->idx;
+}
+
+/* Does the source file at path match name? name can either be the
+ * entire path or a trailing portion of it, like "main.c" or
+ * "src/main.c".
+ */
+int is_same_srcfile(const char *path, const char *name){
+    size_t pathlen = strlen(path), namelen = strlen(name);
+
+    if(namelen > pathlen)
+        return 0;
+
+    if(strcmp(path + (pathlen - namelen), name) != 0)
+        return 0;
+
+    return namelen == pathlen || path[pathlen - namelen - 1] == '/' ||
+        name[0] == '/';
+}
+
+static int stmtrow_cmp(const void *a, const void *b){
+    const struct linerow *ra = a;
+    const struct linerow *rb = b;
+
+    if(ra->lr_fileidx != rb->lr_fileidx)
+        return ra->lr_fileidx < rb->lr_fileidx ? -1 : 1;
+
+    if(ra->lr_lineno != rb->lr_lineno)
+        return ra->lr_lineno < rb->lr_lineno ? -1 : 1;
+
+    if(ra->lr_addr != rb->lr_addr)
+        return ra->lr_addr < rb->lr_addr ? -1 : 1;
+
+    return 0;
+}
+
+/* Group statement rows by file and line. Only is_stmt rows are used
+ * because those are where a debugger is expected to stop. Consecutive
+ * rows for the same line are one run of code, and only the first
+ * statement in each run is kept, so a line gets one PC for every
+ * separate stretch of code it was compiled to, like each copy of it
+ * that was inlined somewhere.
+ */
+static void build_reverse_index(struct linetable *lt){
+    lt->lt_hasreverseidx = 1;
+
+    struct linerow *stmtrows = malloc(sizeof(struct linerow) *
+            (lt->lt_numrows ? lt->lt_numrows : 1));
+    int numstmtrows = 0;
+
+    int runfileidx = -1, runhasstmt = 0;
+    uint32_t runlineno = 0;
+
+    for(int i=0; i<lt->lt_numrows; i++){
+        struct linerow *row = &lt->lt_rows[i];
+
+        if(row->lr_endseq){
+            runfileidx = -1;
+            continue;
+        }
+
+        if(row->lr_fileidx != runfileidx || row->lr_lineno != runlineno){
+            runfileidx = row->lr_fileidx;
+            runlineno = row->lr_lineno;
+            runhasstmt = 0;
+        }
+
+        if(runhasstmt || !row->lr_isstmt || row->lr_lineno == 0)
+            continue;
+
+        runhasstmt = 1;
+        stmtrows[numstmtrows++] = *row;
+    }
+
+    qsort(stmtrows, numstmtrows, sizeof(struct linerow), stmtrow_cmp);
+
+    lt->lt_stmtpcs = malloc(sizeof(uint64_t) *
+            (numstmtrows ? numstmtrows : 1));
+    lt->lt_linepcs = malloc(sizeof(struct linepcs) *
+            (numstmtrows ? numstmtrows : 1));
+
+    int numstmtpcs = 0;
+
+    for(int i=0; i<numstmtrows; i++){
+        struct linerow *row = &stmtrows[i];
+        struct linepcs *lp = NULL;
+
+        if(lt->lt_numlinepcs > 0)
+            lp = &lt->lt_linepcs[lt->lt_numlinepcs - 1];
+
+        if(!lp || lp->lp_fileidx != row->lr_fileidx ||
+                lp->lp_lineno != row->lr_lineno){
+            lp = &lt->lt_linepcs[lt->lt_numlinepcs++];
+
+            lp->lp_lineno = row->lr_lineno;
+            lp->lp_fileidx = row->lr_fileidx;
+            lp->lp_firstpc = numstmtpcs;
+            lp->lp_numpcs = 0;
+        }
+        /* the same address can show up more than once */
+        else if(lt->lt_stmtpcs[numstmtpcs - 1] == row->lr_addr){
+            continue;
+        }
+
+        lt->lt_stmtpcs[numstmtpcs++] = row->lr_addr;
+        lp->lp_numpcs++;
+    }
+
+    free(stmtrows);
+}
+
+/* Returns the index of the first row whose address is >= pc */
+static int lower_bound(struct linetable *lt, uint64_t pc){
+    int lo = 0, hi = lt->lt_numrows;
+
+    while(lo < hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(lt->lt_rows[mid].lr_addr < pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static uint16_t intern_file(Dwarf_Debug dbg, struct linetable *lt,
+        Dwarf_Line line, int **fileidxmap, int *fileidxmaplen){
+    Dwarf_Error d_error = NULL;
+    Dwarf_Unsigned srcfileno = 0;
+
+    int ret = dwarf_line_srcfileno(line, &srcfileno, &d_error);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+    /* dwarf_linesrc allocates, so only call it the first time we see
+     * a file number.
+     */
+    if(srcfileno < *fileidxmaplen && (*fileidxmap)[srcfileno])
+        return (*fileidxmap)[srcfileno] - 1;
+
+    if(srcfileno >= *fileidxmaplen){
+        int newlen = srcfileno + 1;
+        int *fileidxmap_rea = realloc(*fileidxmap, sizeof(int) * newlen);
+        *fileidxmap = fileidxmap_rea;
+
+        memset(*fileidxmap + *fileidxmaplen, 0,
+                sizeof(int) * (newlen - *fileidxmaplen));
+
+        *fileidxmaplen = newlen;
+    }
+
+    char *fname = NULL;
+    ret = dwarf_linesrc(line, &fname, &d_error);
+
+    if(ret == DW_DLV_ERROR)
+        dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+    char **files_rea = realloc(lt->lt_files,
+            sizeof(char *) * ++lt->lt_numfiles);
+    lt->lt_files = files_rea;
+    lt->lt_files[lt->lt_numfiles - 1] = fname ? strdup(fname) : NULL;
+
+    if(fname)
+        dwarf_dealloc(dbg, fname, DW_DLA_STRING);
+
+    (*fileidxmap)[srcfileno] = lt->lt_numfiles;
+
+    return lt->lt_numfiles - 1;
+}
+
+/* Decode every row of lines once. The caller is free to deallocate
+ * lines afterwards.
+ */
+void *lt_build(Dwarf_Debug dbg, Dwarf_Line *lines, Dwarf_Signed linecnt){
+    struct linetable *lt = calloc(1, sizeof(struct linetable));
+
+    if(linecnt <= 0)
+        return lt;
+
+    struct linerow_sortkey *keys =
+        malloc(sizeof(struct linerow_sortkey) * linecnt);
+
+    int *fileidxmap = NULL, fileidxmaplen = 0;
+
+    for(Dwarf_Signed i=0; i<linecnt; i++){
+        Dwarf_Line line = lines[i];
+        Dwarf_Error d_error = NULL;
+        Dwarf_Addr addr = 0;
+        Dwarf_Unsigned lineno = 0;
+        Dwarf_Bool isstmt = 0, endseq = 0;
+
+        if(dwarf_lineaddr(line, &addr, &d_error) == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+        if(dwarf_lineno(line, &lineno, &d_error) == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+        if(dwarf_linebeginstatement(line, &isstmt, &d_error) == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+        if(dwarf_lineendsequence(line, &endseq, &d_error) == DW_DLV_ERROR)
+            dwarf_dealloc(dbg, d_error, DW_DLA_ERROR);
+
+        struct linerow *row = &keys[i].row;
+
+        row->lr_addr = addr;
+        row->lr_lineno = (uint32_t)lineno;
+        row->lr_fileidx = intern_file(dbg, lt, line, &fileidxmap,
+                &fileidxmaplen);
+        row->lr_isstmt = isstmt ? 1 : 0;
+        row->lr_endseq = endseq ? 1 : 0;
+
+        keys[i].idx = i;
+    }
+
+    free(fileidxmap);
+
+    /* Lines given back aren't guarenteed to be in chronological order. */
+    qsort(keys, linecnt, sizeof(struct linerow_sortkey), linerow_sortkey_cmp);
+
+    lt->lt_rows = malloc(sizeof(struct linerow) * linecnt);
+    lt->lt_numrows = linecnt;
+
+    for(Dwarf_Signed i=0; i<linecnt; i++)
+        lt->lt_rows[i] = keys[i].row;
+
+    free(keys);
+
+    return lt;
+}
+
+/* Build a line table around rows someone else owns, which came from
+ * lt_get_raw_rows. They must outlive the line table, and so must the
+ * strings in files. files itself is copied.
+ */
+void *lt_from_raw_rows(const void *rows, int numrows, char **files,
+        int numfiles){
+    struct linetable *lt = calloc(1, sizeof(struct linetable));
+
+    lt->lt_borrowed = 1;
+    lt->lt_rows = (struct linerow *)rows;
+    lt->lt_numrows = numrows;
+
+    if(numfiles > 0){
+        lt->lt_files = malloc(sizeof(char *) * numfiles);
+        memcpy(lt->lt_files, files, sizeof(char *) * numfiles);
+    }
+
+    lt->lt_numfiles = numfiles;
+
+    return lt;
+}
+
+/* Find the closest PC after start_pc which belongs to a different
+ * source line than start_lineno.
+ */
+int lt_find_pc_of_next_line(struct linetable *lt, uint64_t start_pc,
+        uint64_t start_lineno, uint64_t *next_line_pc){
+    if(!lt || !next_line_pc)
+        return 1;
+
+    for(int i=lower_bound(lt, start_pc + 1); i<lt->lt_numrows; i++){
+        struct linerow *row = &lt->lt_rows[i];
+
+        if(row->lr_endseq || row->lr_lineno == 0 ||
+                row->lr_lineno == start_lineno){
+            continue;
+        }
+
+        *next_line_pc = row->lr_addr;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Exact match on pc. The returned file name belongs to the line table
+ * and must not be freed.
+ */
+int lt_find_row_by_pc(struct linetable *lt, uint64_t pc,
+        const char **filenameout, uint64_t *linenoout){
+    if(!lt)
+        return 1;
+
+    for(int i=lower_bound(lt, pc);
+            i<lt->lt_numrows && lt->lt_rows[i].lr_addr == pc;
+            i++){
+        struct linerow *row = &lt->lt_rows[i];
+
+        if(row->lr_endseq)
+            continue;
+
+        if(filenameout)
+            *filenameout = lt->lt_files[row->lr_fileidx];
+
+        if(linenoout)
+            *linenoout = row->lr_lineno;
+
+        return 0;
+    }
+
+    return 1;
+}
+
+void lt_free(struct linetable *lt){
+    if(!lt)
+        return;
+
+    free(lt->lt_linepcs);
+    free(lt->lt_stmtpcs);
+
+    if(!lt->lt_borrowed){
+        for(int i=0; i<lt->lt_numfiles; i++)
+            free(lt->lt_files[i]);
+
+        free(lt->lt_rows);
+    }
+
+    free(lt->lt_files);
+    free(lt);
+}
+
+/* Source files are NULL if libdwarf couldn't name them */
+void lt_get_files(struct linetable *lt, char ***filesout, int *numfilesout){
+    *filesout = lt->lt_files;
+    *numfilesout = lt->lt_numfiles;
+}
+
+/* How many (file, line) pairs have code, for lt_get_src_line */
+int lt_get_num_src_lines(struct linetable *lt){
+    if(!lt->lt_hasreverseidx)
+        build_reverse_index(lt);
+
+    return lt->lt_numlinepcs;
+}
+
+/* The file and line of one of the pairs lt_get_num_src_lines counted,
+ * and the PC every run of code it was compiled to starts at. file is
+ * NULL if libdwarf couldn't name it. Everything belongs to the line
+ * table.
+ */
+void lt_get_src_line(struct linetable *lt, int idx, const char **fileout,
+        uint64_t *linenoout, const uint64_t **pcsout, int *numpcsout){
+    struct linepcs *lp = &lt->lt_linepcs[idx];
+
+    *fileout = lt->lt_files[lp->lp_fileidx];
+    *linenoout = lp->lp_lineno;
+    *pcsout = &lt->lt_stmtpcs[lp->lp_firstpc];
+    *numpcsout = lp->lp_numpcs;
+}
+
+/* The sorted rows as they're kept in memory, for writing them out
+ * somewhere lt_from_raw_rows can get them back from.
+ */
+void lt_get_raw_rows(struct linetable *lt, const void **rowsout,
+        int *numrowsout){
+    *rowsout = lt->lt_rows;
+    *numrowsout = lt->lt_numrows;
+}
+
+/* How big each row from lt_get_raw_rows is */
+size_t lt_get_row_size(void){
+    return sizeof(struct linerow);
+}
+
+int lt_get_pc_values_from_lineno(struct linetable *lt, uint64_t lineno,
+        uint64_t **pcs, int *len){
+    if(!lt || !pcs || !len)
+        return 1;
+
+    *pcs = malloc(sizeof(uint64_t));
+    (*pcs)[0] = 0;
+
+    for(int i=0; i<lt->lt_numrows; i++){
+        struct linerow *row = &lt->lt_rows[i];
+
+        if(row->lr_lineno == lineno){
+            uint64_t *pcs_rea = realloc(*pcs, sizeof(uint64_t) * ++(*len));
+            *pcs = pcs_rea;
+            (*pcs)[(*len) - 1] = row->lr_addr;
+        }
+    }
+
+    return 0;
+}
+
+/* Find the closest line to lineno. Sometimes the source file does
+ * not accurately reflect the compiled program. Returns the line
+ * number actually used through linenoused.
+ */
+int lt_lineno_to_pc(struct linetable *lt, uint64_t lineno,
+        uint64_t *linenoused, uint64_t *pcout){
+    if(!lt || !linenoused || !pcout || lt->lt_numrows == 0)
+        return 1;
+
+    struct linerow *closest = NULL;
+    uint64_t closestdiff = 0;
+
+    for(int i=0; i<lt->lt_numrows; i++){
+        struct linerow *row = &lt->lt_rows[i];
+        uint64_t diff = llabs((int64_t)(row->lr_lineno - lineno));
+
+        if(!closest || diff < closestdiff){
+            closest = row;
+            closestdiff = diff;
+
+            /* exact match */
+            if(diff == 0)
+                break;
+        }
+    }
+
+    *linenoused = closest->lr_lineno;
+    *pcout = closest->lr_addr;
+
+    return 0;
+}
+
@@ -0,0 +1,19 @@
+#ifndef _LINETABLE_H_
+#define _LINETABLE_H_
+
+int is_same_srcfile(const char *, const char *);
+void *lt_build(Dwarf_Debug, Dwarf_Line *, Dwarf_Signed);
+int lt_find_pc_of_next_line(void *, uint64_t, uint64_t, uint64_t *);
+int lt_find_row_by_pc(void *, uint64_t, const char **, uint64_t *);
+void lt_free(void *);
+void *lt_from_raw_rows(const void *, int, char **, int);
+void lt_get_files(void *, char ***, int *);
+int lt_get_num_src_lines(void *);
+int lt_get_pc_values_from_lineno(void *, uint64_t, uint64_t **, int *);
+void lt_get_raw_rows(void *, const void **, int *);
+size_t lt_get_row_size(void);
+void lt_get_src_line(void *, int, const char **, uint64_t *,
+        const uint64_t **, int *);
+int lt_lineno_to_pc(void *, uint64_t, uint64_t *, uint64_t *);
+
+#endif
@@ -0,0 +1,900 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dwarf.h>
+
+#include "arena.h"
+#include "common.h"
+
+/* A location expression is compiled once, when its DIE is created,
+ * into a flat array of these. Every DW_OP_* which pushes a constant
+ * becomes LOP_CONST, every DW_OP_reg* becomes LOP_REG, and so on, with
+ * operands already decoded and branch targets already resolved to
+ * an index into the array. Evaluating one is a single loop that never
+ * has to decode anything.
+ */
+enum {
+    LOP_CONST = 0,
+    LOP_REG,
+    LOP_BREG,
+    LOP_FBREG,
+    LOP_DEREF,
+    LOP_DUP,
+    LOP_DROP,
+    LOP_OVER,
+    LOP_PICK,
+    LOP_SWAP,
+    LOP_ROT,
+    LOP_ABS,
+    LOP_NEG,
+    LOP_NOT,
+    LOP_PLUS_CONST,
+    /* Operations which pop two values and push one, keep these
+     * together.
+     */
+    LOP_AND,
+    LOP_DIV,
+    LOP_MINUS,
+    LOP_MOD,
+    LOP_MUL,
+    LOP_OR,
+    LOP_PLUS,
+    LOP_SHL,
+    LOP_SHR,
+    LOP_SHRA,
+    LOP_XOR,
+    LOP_EQ,
+    LOP_GE,
+    LOP_GT,
+    LOP_LE,
+    LOP_LT,
+    LOP_NE,
+    LOP_BRA,
+    LOP_SKIP,
+    LOP_STACK_VALUE,
+    LOP_UNSUPPORTED
+};
+
+struct locop {
+    uint8_t lo_op;
+    /* How many bytes LOP_DEREF reads */
+    uint8_t lo_size;
+    /* DWARF register number for LOP_REG and LOP_BREG */
+    uint16_t lo_reg;
+    /* Where LOP_BRA and LOP_SKIP go, -1 if nowhere valid */
+    int32_t lo_target;
+    int64_t lo_opd;
+};
+
+struct locexpr {
+    /* First DW_OP_* in here we don't implement, 0 if none */
+    int le_unsupported;
+
+    int le_numops;
+    struct locop le_ops[];
+};
+
+/* Enough for anything a compiler emits. DW_OP_pick can only reach
+ * what's on the stack.
+ */
+#define LOC_STACK_MAX (64)
+
+/* DW_OP_skip and DW_OP_bra can go backwards, so a malformed expression
+ * could loop forever. Nothing real comes close to this many operations.
+ */
+#define LOC_STEPS_MAX (0x10000)
+
+/* A read an expression needs for LOP_DEREF */
+struct memread {
+    uint64_t mr_addr;
+    uint64_t mr_value;
+    uint8_t mr_size;
+    uint8_t mr_failed;
+};
+
+/* A stretch of memory something needs, and where it goes */
+struct memspan {
+    uint64_t ms_addr;
+    uint64_t ms_size;
+    void *ms_buf;
+    int ms_failed;
+};
+
+/* Spans with less than SPAN_GAP bytes between them are read together,
+ * and what's between them comes along for free. Merging stops before
+ * a read gets bigger than SPAN_MAX, which is a stack page. Locals are
+ * nearly always within a few hundred bytes of the frame base, so most
+ * frames are one read.
+ */
+enum { SPAN_GAP = 256, SPAN_MAX = 0x4000 };
+
+/* Where an expression is at while it's being evaluated */
+struct locstate {
+    struct locexpr *ls_expr;
+    struct locexpr *ls_framebase;
+    int ls_pc;
+    int ls_sp;
+    /* Operations run so far, see LOC_STEPS_MAX */
+    int ls_steps;
+    int ls_status;
+    int ls_done;
+    /* Which read of the current round this is waiting on, or -1 */
+    int ls_read;
+    int64_t ls_stack[LOC_STACK_MAX];
+};
+
+int loc_evaluate(struct locexpr *, struct locexpr *, struct locctx *,
+        int64_t *);
+
+static int64_t mask_to_size(uint64_t value, uint8_t size){
+    if(size >= 8)
+        return value;
+
+    return value & ((1ULL << (size * 8)) - 1);
+}
+
+/* The operation at byte offset target of the original expression,
+ * the end of the expression if target is right past its last
+ * operation, otherwise -1.
+ */
+static int32_t resolve_branch(const struct locrawop *raw, int numraw,
+        const int *opidx, int numops, uint64_t target){
+    for(int i=0; i<numraw; i++){
+        if(raw[i].lr_offset == target)
+            return opidx[i];
+    }
+
+    /* DW_OP_bra and DW_OP_skip are three bytes long */
+    if(numraw > 0 && target > raw[numraw - 1].lr_offset)
+        return numops;
+
+    return -1;
+}
+
+static void compile_op(const struct locrawop *raw, struct locop *op,
+        int *unsupported){
+    uint8_t dwop = raw->lr_op;
+
+    switch(dwop){
+        case DW_OP_addr:
+        case DW_OP_const8u:
+        case DW_OP_constu:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (int64_t)raw->lr_opd1;
+            break;
+        case DW_OP_const1u:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (uint8_t)raw->lr_opd1;
+            break;
+        case DW_OP_const1s:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (int8_t)raw->lr_opd1;
+            break;
+        case DW_OP_const2u:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (uint16_t)raw->lr_opd1;
+            break;
+        case DW_OP_const2s:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (int16_t)raw->lr_opd1;
+            break;
+        case DW_OP_const4u:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (uint32_t)raw->lr_opd1;
+            break;
+        case DW_OP_const4s:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (int32_t)raw->lr_opd1;
+            break;
+        case DW_OP_const8s:
+        case DW_OP_consts:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = (int64_t)raw->lr_opd1;
+            break;
+        case DW_OP_lit0...DW_OP_lit31:
+            op->lo_op = LOP_CONST;
+            op->lo_opd = dwop - DW_OP_lit0;
+            break;
+        case DW_OP_reg0...DW_OP_reg31:
+            op->lo_op = LOP_REG;
+            op->lo_reg = dwop - DW_OP_reg0;
+            break;
+        case DW_OP_regx:
+            op->lo_op = LOP_REG;
+            op->lo_reg = raw->lr_opd1;
+            break;
+        case DW_OP_breg0...DW_OP_breg31:
+            op->lo_op = LOP_BREG;
+            op->lo_reg = dwop - DW_OP_breg0;
+            op->lo_opd = (int64_t)raw->lr_opd1;
+            break;
+        case DW_OP_bregx:
+            op->lo_op = LOP_BREG;
+            op->lo_reg = raw->lr_opd1;
+            op->lo_opd = (int64_t)raw->lr_opd2;
+            break;
+        case DW_OP_fbreg:
+            op->lo_op = LOP_FBREG;
+            op->lo_opd = (int64_t)raw->lr_opd1;
+            break;
+        case DW_OP_deref:
+            op->lo_op = LOP_DEREF;
+            op->lo_size = sizeof(uint64_t);
+            break;
+        case DW_OP_deref_size:
+            op->lo_op = LOP_DEREF;
+            op->lo_size = (uint8_t)raw->lr_opd1;
+            break;
+        case DW_OP_plus_uconst:
+            op->lo_op = LOP_PLUS_CONST;
+            op->lo_opd = (int64_t)raw->lr_opd1;
+            break;
+        case DW_OP_pick:
+            op->lo_op = LOP_PICK;
+            op->lo_opd = (uint8_t)raw->lr_opd1;
+            break;
+        case DW_OP_dup: op->lo_op = LOP_DUP; break;
+        case DW_OP_drop: op->lo_op = LOP_DROP; break;
+        case DW_OP_over: op->lo_op = LOP_OVER; break;
+        case DW_OP_swap: op->lo_op = LOP_SWAP; break;
+        case DW_OP_rot: op->lo_op = LOP_ROT; break;
+        case DW_OP_abs: op->lo_op = LOP_ABS; break;
+        case DW_OP_and: op->lo_op = LOP_AND; break;
+        case DW_OP_div: op->lo_op = LOP_DIV; break;
+        case DW_OP_minus: op->lo_op = LOP_MINUS; break;
+        case DW_OP_mod: op->lo_op = LOP_MOD; break;
+        case DW_OP_mul: op->lo_op = LOP_MUL; break;
+        case DW_OP_neg: op->lo_op = LOP_NEG; break;
+        case DW_OP_not: op->lo_op = LOP_NOT; break;
+        case DW_OP_or: op->lo_op = LOP_OR; break;
+        case DW_OP_plus: op->lo_op = LOP_PLUS; break;
+        case DW_OP_shl: op->lo_op = LOP_SHL; break;
+        case DW_OP_shr: op->lo_op = LOP_SHR; break;
+        case DW_OP_shra: op->lo_op = LOP_SHRA; break;
+        case DW_OP_xor: op->lo_op = LOP_XOR; break;
+        case DW_OP_eq: op->lo_op = LOP_EQ; break;
+        case DW_OP_ge: op->lo_op = LOP_GE; break;
+        case DW_OP_gt: op->lo_op = LOP_GT; break;
+        case DW_OP_le: op->lo_op = LOP_LE; break;
+        case DW_OP_lt: op->lo_op = LOP_LT; break;
+        case DW_OP_ne: op->lo_op = LOP_NE; break;
+        case DW_OP_bra: op->lo_op = LOP_BRA; break;
+        case DW_OP_skip: op->lo_op = LOP_SKIP; break;
+        case DW_OP_stack_value: op->lo_op = LOP_STACK_VALUE; break;
+        default:
+            op->lo_op = LOP_UNSUPPORTED;
+            op->lo_opd = dwop;
+
+            if(!(*unsupported))
+                *unsupported = dwop;
+
+            break;
+    };
+
+    if(op->lo_op == LOP_DEREF && (op->lo_size == 0 || op->lo_size > 8)){
+        op->lo_op = LOP_UNSUPPORTED;
+        op->lo_opd = dwop;
+
+        if(!(*unsupported))
+            *unsupported = dwop;
+    }
+}
+
+/* Compile the numraw operations of one location expression. If arena
+ * isn't NULL, the result is allocated from it and shouldn't be given
+ * to loc_free.
+ */
+void *loc_compile(void *arena, const struct locrawop *raw, int numraw){
+    int numops = 0;
+    int *opidx = malloc((numraw + 1) * sizeof(int));
+
+    /* DW_OP_nop doesn't make it into the compiled expression */
+    for(int i=0; i<numraw; i++){
+        opidx[i] = numops;
+
+        if(raw[i].lr_op != DW_OP_nop)
+            numops++;
+    }
+
+    size_t sz = sizeof(struct locexpr) + (numops * sizeof(struct locop));
+    struct locexpr *expr = NULL;
+
+    if(arena)
+        expr = arena_alloc(arena, sz);
+    else
+        expr = calloc(1, sz);
+
+    expr->le_numops = numops;
+
+    for(int i=0; i<numraw; i++){
+        if(raw[i].lr_op == DW_OP_nop)
+            continue;
+
+        struct locop *op = &expr->le_ops[opidx[i]];
+        compile_op(&raw[i], op, &expr->le_unsupported);
+
+        if(op->lo_op == LOP_BRA || op->lo_op == LOP_SKIP){
+            /* Relative to the end of this operation */
+            uint64_t target = raw[i].lr_offset + 3 +
+                (int16_t)raw[i].lr_opd1;
+
+            op->lo_target = resolve_branch(raw, numraw, opidx, numops,
+                    target);
+        }
+    }
+
+    free(opidx);
+
+    return expr;
+}
+
+void *loc_copy(struct locexpr *expr){
+    if(!expr)
+        return NULL;
+
+    size_t sz = sizeof(struct locexpr) +
+        (expr->le_numops * sizeof(struct locop));
+
+    struct locexpr *copy = malloc(sz);
+    memcpy(copy, expr, sz);
+
+    return copy;
+}
+
+static int getreg(struct locctx *ctx, int regno, int64_t *valout){
+    uint64_t val = 0;
+
+    if(ctx->lc_getreg(ctx->lc_arg, regno, &val))
+        return 1;
+
+    *valout = (int64_t)val;
+
+    return 0;
+}
+
+/* Returns the value of DW_AT_frame_base. If it names a register, like
+ * it almost always does, the frame base is what's in that register.
+ */
+static int evaluate_frame_base(struct locexpr *framebase,
+        struct locctx *ctx, int64_t *fbout){
+    if(!framebase)
+        return LOC_NO_FRAME_BASE;
+
+    if(framebase->le_numops == 1 && framebase->le_ops[0].lo_op == LOP_REG){
+        if(getreg(ctx, framebase->le_ops[0].lo_reg, fbout))
+            return LOC_BAD_REGISTER;
+
+        return LOC_OK;
+    }
+
+    return loc_evaluate(framebase, NULL, ctx, fbout);
+}
+
+/* Run ls until it finishes or needs memory read. If it needs memory,
+ * its read is added to reads.
+ */
+static void run(struct locstate *ls, struct locctx *ctx,
+        struct memread *reads, int *numreads){
+    struct locexpr *expr = ls->ls_expr;
+    int64_t *stack = ls->ls_stack;
+    int sp = ls->ls_sp;
+    int pc = ls->ls_pc;
+    int status = LOC_OK;
+
+    while(pc < expr->le_numops){
+        struct locop *op = &expr->le_ops[pc];
+
+        if(ls->ls_steps++ == LOC_STEPS_MAX)
+            goto bad;
+
+        /* Every operation pushes at most one value */
+        if(sp == LOC_STACK_MAX){
+            status = LOC_BAD_EXPR;
+            break;
+        }
+
+        switch(op->lo_op){
+            case LOP_CONST:
+                stack[sp++] = op->lo_opd;
+                break;
+            case LOP_REG:
+                if(getreg(ctx, op->lo_reg, &stack[sp])){
+                    status = LOC_BAD_REGISTER;
+                    goto out;
+                }
+
+                sp++;
+                break;
+            case LOP_BREG:
+                if(getreg(ctx, op->lo_reg, &stack[sp])){
+                    status = LOC_BAD_REGISTER;
+                    goto out;
+                }
+
+                stack[sp++] += op->lo_opd;
+                break;
+            case LOP_FBREG:
+                {
+                    int64_t fb = 0;
+                    status = evaluate_frame_base(ls->ls_framebase, ctx, &fb);
+
+                    if(status != LOC_OK)
+                        goto out;
+
+                    stack[sp++] = fb + op->lo_opd;
+                    break;
+                }
+            case LOP_DEREF:
+                {
+                    if(sp < 1)
+                        goto bad;
+
+                    struct memread *r = &reads[*numreads];
+
+                    r->mr_addr = (uint64_t)stack[sp - 1];
+                    r->mr_size = op->lo_size;
+                    r->mr_value = 0;
+                    r->mr_failed = 0;
+
+                    ls->ls_read = (*numreads)++;
+                    ls->ls_sp = sp;
+                    ls->ls_pc = pc;
+
+                    /* Picked back up once the read is done */
+                    return;
+                }
+            case LOP_DUP:
+                if(sp < 1)
+                    goto bad;
+
+                stack[sp] = stack[sp - 1];
+                sp++;
+                break;
+            case LOP_DROP:
+                if(sp < 1)
+                    goto bad;
+
+                sp--;
+                break;
+            case LOP_OVER:
+                if(sp < 2)
+                    goto bad;
+
+                stack[sp] = stack[sp - 2];
+                sp++;
+                break;
+            case LOP_PICK:
+                if(op->lo_opd >= sp)
+                    goto bad;
+
+                stack[sp] = stack[sp - 1 - op->lo_opd];
+                sp++;
+                break;
+            case LOP_SWAP:
+                {
+                    if(sp < 2)
+                        goto bad;
+
+                    int64_t t = stack[sp - 1];
+                    stack[sp - 1] = stack[sp - 2];
+                    stack[sp - 2] = t;
+                    break;
+                }
+            case LOP_ROT:
+                {
+                    if(sp < 3)
+                        goto bad;
+
+                    int64_t t = stack[sp - 1];
+                    stack[sp - 1] = stack[sp - 2];
+                    stack[sp - 2] = stack[sp - 3];
+                    stack[sp - 3] = t;
+                    break;
+                }
+            case LOP_ABS:
+                if(sp < 1)
+                    goto bad;
+
+                if(stack[sp - 1] < 0)
+                    stack[sp - 1] = -stack[sp - 1];
+                break;
+            case LOP_NEG:
+                if(sp < 1)
+                    goto bad;
+
+                stack[sp - 1] = -stack[sp - 1];
+                break;
+            case LOP_NOT:
+                if(sp < 1)
+                    goto bad;
+
+                stack[sp - 1] = ~stack[sp - 1];
+                break;
+            case LOP_PLUS_CONST:
+                if(sp < 1)
+                    goto bad;
+
+                stack[sp - 1] += op->lo_opd;
+                break;
+            case LOP_AND...LOP_NE:
+                {
+                    if(sp < 2)
+                        goto bad;
+
+                    int64_t a = stack[sp - 2], b = stack[sp - 1];
+                    int64_t r = 0;
+
+                    switch(op->lo_op){
+                        case LOP_AND: r = a & b; break;
+                        case LOP_OR: r = a | b; break;
+                        case LOP_XOR: r = a ^ b; break;
+                        case LOP_MINUS: r = a - b; break;
+                        case LOP_PLUS: r = a + b; break;
+                        case LOP_MUL: r = a * b; break;
+                        case LOP_SHL:
+                            r = (uint64_t)b >= 64 ? 0 : (uint64_t)a << b;
+                            break;
+                        case LOP_SHR:
+                            r = (uint64_t)b >= 64 ? 0 : (uint64_t)a >> b;
+                            break;
+                        case LOP_SHRA:
+                            r = a >> ((uint64_t)b >= 64 ? 63 : b);
+                            break;
+                        case LOP_EQ: r = a == b; break;
+                        case LOP_GE: r = a >= b; break;
+                        case LOP_GT: r = a > b; break;
+                        case LOP_LE: r = a <= b; break;
+                        case LOP_LT: r = a < b; break;
+                        case LOP_NE: r = a != b; break;
+                        case LOP_DIV:
+                        case LOP_MOD:
+                            {
+                                if(b == 0)
+                                    goto bad;
+
+                                /* Overflows, which is undefined */
+                                if(a == INT64_MIN && b == -1){
+                                    r = op->lo_op == LOP_DIV ? a : 0;
+                                    break;
+                                }
+
+                                r = op->lo_op == LOP_DIV ? a / b : a % b;
+                                break;
+                            }
+                        default:
+                            goto bad;
+                    };
+
+                    stack[sp - 2] = r;
+                    sp--;
+                    break;
+                }
+            case LOP_BRA:
+                if(sp < 1)
+                    goto bad;
+
+                if(stack[--sp] == 0)
+                    break;
+
+                /* Fall through */
+            case LOP_SKIP:
+                if(op->lo_target < 0)
+                    goto bad;
+
+                pc = op->lo_target;
+                continue;
+            case LOP_STACK_VALUE:
+                goto out;
+            case LOP_UNSUPPORTED:
+            default:
+                status = LOC_UNSUPPORTED;
+                goto out;
+        };
+
+        pc++;
+    }
+
+out:
+    if(status == LOC_OK && sp < 1)
+        status = LOC_BAD_EXPR;
+
+    ls->ls_sp = sp;
+    ls->ls_pc = pc;
+    ls->ls_status = status;
+    ls->ls_done = 1;
+    ls->ls_read = -1;
+
+    return;
+
+bad:
+    status = LOC_BAD_EXPR;
+    goto out;
+}
+
+static int readmem(struct locctx *ctx, uint64_t addr, void *buf,
+        size_t len){
+    ctx->lc_numreads++;
+
+    return ctx->lc_readmem(ctx->lc_arg, addr, buf, len);
+}
+
+static int spancmp(const void *a, const void *b){
+    const struct memspan *sa = *(const struct memspan **)a;
+    const struct memspan *sb = *(const struct memspan **)b;
+
+    return (sa->ms_addr > sb->ms_addr) - (sa->ms_addr < sb->ms_addr);
+}
+
+/* Do every read in spans, sorted by address, with ones that overlap or
+ * are close together merged into one. If a merged read fails, its spans
+ * are read again on their own, so one bad pointer doesn't take the
+ * variables next to it down too.
+ */
+static void read_spans(struct memspan *spans, int numspans,
+        struct locctx *ctx){
+    struct memspan **sorted = malloc(numspans * sizeof(struct memspan *));
+    int numsorted = 0;
+
+    for(int i=0; i<numspans; i++){
+        struct memspan *s = &spans[i];
+
+        s->ms_failed = 0;
+
+        if(s->ms_size == 0)
+            continue;
+
+        /* Garbage pointers can run off the end of the address space */
+        if(s->ms_addr + s->ms_size < s->ms_addr){
+            s->ms_failed = 1;
+            continue;
+        }
+
+        sorted[numsorted++] = s;
+    }
+
+    qsort(sorted, numsorted, sizeof(struct memspan *), spancmp);
+
+    uint8_t *buf = NULL;
+    size_t bufsz = 0;
+    int first = 0;
+
+    while(first < numsorted){
+        uint64_t lo = sorted[first]->ms_addr;
+        uint64_t hi = lo + sorted[first]->ms_size;
+        int last = first + 1;
+
+        for(; last<numsorted; last++){
+            struct memspan *s = sorted[last];
+            uint64_t end = s->ms_addr + s->ms_size;
+
+            if(s->ms_addr > hi && s->ms_addr - hi >= SPAN_GAP)
+                break;
+
+            if(end > hi){
+                if(end - lo > SPAN_MAX)
+                    break;
+
+                hi = end;
+            }
+        }
+
+        if(last - first == 1){
+            struct memspan *s = sorted[first];
+            s->ms_failed = readmem(ctx, s->ms_addr, s->ms_buf, s->ms_size);
+            first = last;
+            continue;
+        }
+
+        if(hi - lo > bufsz){
+            bufsz = hi - lo;
+            buf = realloc(buf, bufsz);
+        }
+
+        int failed = readmem(ctx, lo, buf, hi - lo);
+
+        for(int i=first; i<last; i++){
+            struct memspan *s = sorted[i];
+
+            if(failed){
+                s->ms_failed = readmem(ctx, s->ms_addr, s->ms_buf,
+                        s->ms_size);
+            }
+            else{
+                memcpy(s->ms_buf, buf + (s->ms_addr - lo), s->ms_size);
+            }
+        }
+
+        first = last;
+    }
+
+    free(buf);
+    free(sorted);
+}
+
+/* Evaluate numexprs expressions at once. Whenever every expression
+ * that isn't finished is waiting on memory, their reads are all done
+ * together with read_spans. framebases can be NULL if none of the
+ * expressions use DW_OP_fbreg, and any of its elements can be NULL if
+ * that expression's DIE has no frame base. The result and status of
+ * each expression go into results and statuses.
+ */
+void loc_evaluate_many(void **exprs, void **framebases, int numexprs,
+        struct locctx *ctx, int64_t *results, int *statuses){
+    struct locstate *states = malloc(numexprs * sizeof(struct locstate));
+    struct memread *reads = malloc(numexprs * sizeof(struct memread));
+    struct memspan *spans = malloc(numexprs * sizeof(struct memspan));
+
+    for(int i=0; i<numexprs; i++){
+        struct locstate *ls = &states[i];
+
+        ls->ls_expr = exprs[i];
+        ls->ls_framebase = framebases ? framebases[i] : NULL;
+        ls->ls_pc = 0;
+        ls->ls_sp = 0;
+        ls->ls_steps = 0;
+        ls->ls_status = LOC_OK;
+        ls->ls_done = 0;
+        ls->ls_read = -1;
+
+        if(!ls->ls_expr){
+            ls->ls_status = LOC_BAD_EXPR;
+            ls->ls_done = 1;
+        }
+    }
+
+    for(;;){
+        int numreads = 0;
+
+        for(int i=0; i<numexprs; i++){
+            if(!states[i].ls_done)
+                run(&states[i], ctx, reads, &numreads);
+        }
+
+        if(numreads == 0)
+            break;
+
+        for(int i=0; i<numreads; i++){
+            spans[i].ms_addr = reads[i].mr_addr;
+            spans[i].ms_size = reads[i].mr_size;
+            spans[i].ms_buf = &reads[i].mr_value;
+        }
+
+        read_spans(spans, numreads, ctx);
+
+        for(int i=0; i<numreads; i++)
+            reads[i].mr_failed = spans[i].ms_failed;
+
+        /* Finish the dereference each of them stopped on */
+        for(int i=0; i<numexprs; i++){
+            struct locstate *ls = &states[i];
+
+            if(ls->ls_done || ls->ls_read == -1)
+                continue;
+
+            struct memread *r = &reads[ls->ls_read];
+
+            ls->ls_read = -1;
+
+            if(r->mr_failed){
+                ls->ls_status = LOC_BAD_READ;
+                ls->ls_done = 1;
+                continue;
+            }
+
+            ls->ls_stack[ls->ls_sp - 1] = mask_to_size(r->mr_value,
+                    r->mr_size);
+            ls->ls_pc++;
+        }
+    }
+
+    for(int i=0; i<numexprs; i++){
+        struct locstate *ls = &states[i];
+
+        statuses[i] = ls->ls_status;
+        results[i] = ls->ls_sp > 0 ? ls->ls_stack[ls->ls_sp - 1] : 0;
+    }
+
+    free(spans);
+    free(reads);
+    free(states);
+}
+
+/* Non-zero if expr evaluates to the variable itself instead of where
+ * it is. That's the case when it names a register or ends with
+ * DW_OP_stack_value.
+ */
+static int evaluates_to_value(struct locexpr *expr){
+    if(expr->le_numops == 0)
+        return 0;
+
+    int last = expr->le_ops[expr->le_numops - 1].lo_op;
+
+    return last == LOP_STACK_VALUE ||
+        (expr->le_numops == 1 && last == LOP_REG);
+}
+
+/* Evaluate the location of every variable in a frame, then read all
+ * of their values. Both happen in as few reads as possible: every
+ * address is worked out first, and the values are fetched together
+ * afterwards with read_spans. Before calling, fv_size of each variable
+ * should be how big it is and fv_data should point to that many bytes
+ * for its value. exprs and framebases are like loc_evaluate_many's,
+ * except a NULL expression means the variable is optimized out.
+ */
+void loc_evaluate_frame(void **exprs, void **framebases, int numvars,
+        struct locctx *ctx, struct framevar *vars){
+    int64_t *results = malloc(numvars * sizeof(int64_t));
+    int *statuses = malloc(numvars * sizeof(int));
+    struct memspan *spans = malloc(numvars * sizeof(struct memspan));
+    int *spanvars = malloc(numvars * sizeof(int));
+    int numspans = 0;
+
+    loc_evaluate_many(exprs, framebases, numvars, ctx, results, statuses);
+
+    for(int i=0; i<numvars; i++){
+        struct framevar *fv = &vars[i];
+
+        fv->fv_status = exprs[i] ? statuses[i] : LOC_OPTIMIZED_OUT;
+        fv->fv_isvalue = 0;
+        fv->fv_addr = (uint64_t)results[i];
+
+        if(fv->fv_status != LOC_OK){
+            fv->fv_data = NULL;
+            continue;
+        }
+
+        if(evaluates_to_value(exprs[i])){
+            fv->fv_isvalue = 1;
+
+            if(fv->fv_data){
+                uint64_t sz = fv->fv_size < sizeof(int64_t) ?
+                    fv->fv_size : sizeof(int64_t);
+
+                memset(fv->fv_data, 0, fv->fv_size);
+                memcpy(fv->fv_data, &results[i], sz);
+            }
+
+            continue;
+        }
+
+        if(!fv->fv_data)
+            continue;
+
+        spans[numspans].ms_addr = fv->fv_addr;
+        spans[numspans].ms_size = fv->fv_size;
+        spans[numspans].ms_buf = fv->fv_data;
+        spanvars[numspans++] = i;
+    }
+
+    read_spans(spans, numspans, ctx);
+
+    for(int i=0; i<numspans; i++){
+        if(spans[i].ms_failed)
+            vars[spanvars[i]].fv_data = NULL;
+    }
+
+    free(spanvars);
+    free(spans);
+    free(statuses);
+    free(results);
+}
+
+/* Returns one of the LOC_* values */
+int loc_evaluate(struct locexpr *expr, struct locexpr *framebase,
+        struct locctx *ctx, int64_t *resultout){
+    int status = LOC_OK;
+
+    loc_evaluate_many((void **)&expr, (void **)&framebase, 1, ctx,
+            resultout, &status);
+
+    return status;
+}
+
+void loc_free(struct locexpr *expr){
+    free(expr);
+}
+
+int loc_get_unsupported_op(struct locexpr *expr){
+    return expr ? expr->le_unsupported : 0;
+}
@@ -0,0 +1,20 @@
+#ifndef _LOCEXPR_H_
+#define _LOCEXPR_H_
+
+#include <stdint.h>
+
+struct framevar;
+struct locctx;
+struct locrawop;
+
+void *loc_compile(void *, const struct locrawop *, int);
+void *loc_copy(void *);
+int loc_evaluate(void *, void *, struct locctx *, int64_t *);
+void loc_evaluate_frame(void **, void **, int, struct locctx *,
+        struct framevar *);
+void loc_evaluate_many(void **, void **, int, struct locctx *, int64_t *,
+        int *);
+void loc_free(void *);
+int loc_get_unsupported_op(void *);
+
+#endif
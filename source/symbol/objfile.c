@@ -0,0 +1,356 @@
+#include <stdint.h>
+#include <string.h>
+
+/* Just enough of Mach-O and ELF to find sections and identify a DWARF
+ * file, since libdwarf doesn't give out raw section contents. Works
+ * on a mapping of the whole file, so it works off device too.
+ */
+
+#define MACHO_MAGIC_64          (0xfeedfacf)
+#define MACHO_FAT_MAGIC         (0xcafebabe)
+#define MACHO_LC_SEGMENT_64     (0x19)
+#define MACHO_LC_UUID           (0x1b)
+#define MACHO_CPU_TYPE_ARM64    (0x0100000c)
+
+struct macho_header_64 {
+    uint32_t magic;
+    uint32_t cputype;
+    uint32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct macho_load_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+};
+
+struct macho_segment_command_64 {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    uint32_t maxprot;
+    uint32_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+
+struct macho_section_64 {
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+};
+
+/* Everything in a fat header is big endian */
+struct macho_fat_arch {
+    uint32_t cputype;
+    uint32_t cpusubtype;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t align;
+};
+
+struct macho_uuid_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint8_t uuid[16];
+};
+
+struct elf64_header {
+    unsigned char e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+};
+
+struct elf64_section_header {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint64_t sh_flags;
+    uint64_t sh_addr;
+    uint64_t sh_offset;
+    uint64_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint64_t sh_addralign;
+    uint64_t sh_entsize;
+};
+
+struct elf64_note_header {
+    uint32_t n_namesz;
+    uint32_t n_descsz;
+    uint32_t n_type;
+};
+
+#define ELF_NT_GNU_BUILD_ID     (3)
+
+static uint32_t swap32(uint32_t v){
+    return ((v & 0xff) << 24) | ((v & 0xff00) << 8) |
+        ((v >> 8) & 0xff00) | (v >> 24);
+}
+
+/* name can be the ELF name or the Mach-O name, the leading "." or "__"
+ * is ignored.
+ */
+static int section_name_matches(const char *sectname, size_t maxlen,
+        const char *name){
+    size_t prefixlen = 0;
+
+    if(strncmp(sectname, "__", 2) == 0)
+        prefixlen = 2;
+    else if(sectname[0] == '.')
+        prefixlen = 1;
+    else
+        return 0;
+
+    /* Mach-O section names are cut off at 16 characters, so
+     * "__apple_namespac" is all that's left of "apple_namespaces".
+     */
+    return strncmp(sectname + prefixlen, name, maxlen - prefixlen) == 0;
+}
+
+static int find_macho_section(const uint8_t *base, size_t size,
+        const char *name, const uint8_t **dataout, uint64_t *sizeout){
+    const struct macho_header_64 *mh = (const void *)base;
+
+    if(size < sizeof(*mh) || mh->magic != MACHO_MAGIC_64)
+        return 1;
+
+    const uint8_t *cmdp = base + sizeof(*mh);
+    const uint8_t *cmdend = cmdp + mh->sizeofcmds;
+
+    if(cmdend > base + size)
+        return 1;
+
+    for(uint32_t i=0; i<mh->ncmds && cmdp < cmdend; i++){
+        const struct macho_load_command *lc = (const void *)cmdp;
+
+        if(lc->cmdsize == 0)
+            return 1;
+
+        if(lc->cmd == MACHO_LC_SEGMENT_64){
+            const struct macho_segment_command_64 *seg = (const void *)lc;
+            const struct macho_section_64 *sect = (const void *)(seg + 1);
+
+            for(uint32_t j=0; j<seg->nsects; j++, sect++){
+                if(!section_name_matches(sect->sectname,
+                            sizeof(sect->sectname), name)){
+                    continue;
+                }
+
+                if((uint64_t)sect->offset + sect->size > size)
+                    return 1;
+
+                *dataout = base + sect->offset;
+                *sizeout = sect->size;
+
+                return 0;
+            }
+        }
+
+        cmdp += lc->cmdsize;
+    }
+
+    return 1;
+}
+
+static int find_elf_section(const uint8_t *base, size_t size,
+        const char *name, const uint8_t **dataout, uint64_t *sizeout){
+    const struct elf64_header *eh = (const void *)base;
+
+    if(size < sizeof(*eh) || memcmp(eh->e_ident, "\x7f" "ELF", 4) != 0)
+        return 1;
+
+    /* 64 bit only */
+    if(eh->e_ident[4] != 2)
+        return 1;
+
+    if(eh->e_shoff + (uint64_t)eh->e_shnum * sizeof(struct elf64_section_header)
+            > size || eh->e_shstrndx >= eh->e_shnum){
+        return 1;
+    }
+
+    const struct elf64_section_header *shdrs =
+        (const void *)(base + eh->e_shoff);
+    const struct elf64_section_header *shstrtab = &shdrs[eh->e_shstrndx];
+
+    if(shstrtab->sh_offset + shstrtab->sh_size > size)
+        return 1;
+
+    const char *names = (const char *)base + shstrtab->sh_offset;
+
+    for(uint16_t i=0; i<eh->e_shnum; i++){
+        const struct elf64_section_header *sh = &shdrs[i];
+
+        if(sh->sh_name >= shstrtab->sh_size)
+            continue;
+
+        const char *sectname = names + sh->sh_name;
+
+        if(!section_name_matches(sectname, strlen(sectname) + 1, name))
+            continue;
+
+        if(sh->sh_offset + sh->sh_size > size)
+            return 1;
+
+        *dataout = base + sh->sh_offset;
+        *sizeout = sh->sh_size;
+
+        return 0;
+    }
+
+    return 1;
+}
+
+/* For a fat file, use the arm64 slice, or the first slice if there
+ * isn't one.
+ */
+static int get_slice(const uint8_t **baseout, size_t *sizeout){
+    const uint8_t *base = *baseout;
+    size_t size = *sizeout;
+
+    if(size >= sizeof(uint32_t) * 2 &&
+            swap32(*(const uint32_t *)base) == MACHO_FAT_MAGIC){
+        uint32_t nfat = swap32(*(const uint32_t *)(base + 4));
+        const struct macho_fat_arch *archs = (const void *)(base + 8);
+        const struct macho_fat_arch *chosen = NULL;
+
+        if(8 + (uint64_t)nfat * sizeof(struct macho_fat_arch) > size)
+            return 1;
+
+        for(uint32_t i=0; i<nfat; i++){
+            if(!chosen || swap32(archs[i].cputype) == MACHO_CPU_TYPE_ARM64)
+                chosen = &archs[i];
+        }
+
+        if(!chosen)
+            return 1;
+
+        uint64_t sliceoff = swap32(chosen->offset);
+        uint64_t slicesz = swap32(chosen->size);
+
+        if(sliceoff + slicesz > size)
+            return 1;
+
+        base += sliceoff;
+        size = slicesz;
+    }
+
+    *baseout = base;
+    *sizeout = size;
+
+    return 0;
+}
+
+static int get_macho_uuid(const uint8_t *base, size_t size,
+        uint8_t *uuidout){
+    const struct macho_header_64 *mh = (const void *)base;
+
+    if(size < sizeof(*mh) || mh->magic != MACHO_MAGIC_64)
+        return 1;
+
+    const uint8_t *cmdp = base + sizeof(*mh);
+    const uint8_t *cmdend = cmdp + mh->sizeofcmds;
+
+    if(cmdend > base + size)
+        return 1;
+
+    for(uint32_t i=0; i<mh->ncmds && cmdp < cmdend; i++){
+        const struct macho_load_command *lc = (const void *)cmdp;
+
+        if(lc->cmdsize == 0)
+            return 1;
+
+        if(lc->cmd == MACHO_LC_UUID){
+            const struct macho_uuid_command *uc = (const void *)lc;
+            memcpy(uuidout, uc->uuid, sizeof(uc->uuid));
+
+            return 0;
+        }
+
+        cmdp += lc->cmdsize;
+    }
+
+    return 1;
+}
+
+/* ELF files have a GNU build ID note instead. It's usually a 20 byte
+ * SHA-1, we keep the first 16 bytes.
+ */
+static int get_elf_uuid(const uint8_t *base, size_t size,
+        uint8_t *uuidout){
+    const uint8_t *note = NULL;
+    uint64_t notesz = 0;
+
+    if(find_elf_section(base, size, "note.gnu.build-id", &note, &notesz))
+        return 1;
+
+    const struct elf64_note_header *nh = (const void *)note;
+
+    if(notesz < sizeof(*nh) || nh->n_type != ELF_NT_GNU_BUILD_ID)
+        return 1;
+
+    uint64_t descoff = sizeof(*nh) + ((nh->n_namesz + 3) & ~3);
+
+    if(descoff + nh->n_descsz > notesz)
+        return 1;
+
+    memset(uuidout, 0, 16);
+    memcpy(uuidout, note + descoff, nh->n_descsz < 16 ? nh->n_descsz : 16);
+
+    return 0;
+}
+
+int obj_find_section(const void *map, size_t mapsize, const char *name,
+        const uint8_t **dataout, uint64_t *sizeout){
+    const uint8_t *base = map;
+    size_t size = mapsize;
+
+    if(!map || get_slice(&base, &size))
+        return 1;
+
+    if(find_macho_section(base, size, name, dataout, sizeout) == 0)
+        return 0;
+
+    return find_elf_section(base, size, name, dataout, sizeout);
+}
+
+/* Fills 16 bytes of uuidout with the Mach-O UUID or ELF build ID */
+int obj_get_uuid(const void *map, size_t mapsize, uint8_t *uuidout){
+    const uint8_t *base = map;
+    size_t size = mapsize;
+
+    if(!map || get_slice(&base, &size))
+        return 1;
+
+    if(get_macho_uuid(base, size, uuidout) == 0)
+        return 0;
+
+    return get_elf_uuid(base, size, uuidout);
+}
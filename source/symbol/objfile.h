@@ -0,0 +1,8 @@
+#ifndef _OBJFILE_H_
+#define _OBJFILE_H_
+
+int obj_find_section(const void *, size_t, const char *, const uint8_t **,
+        uint64_t *);
+int obj_get_uuid(const void *, size_t, uint8_t *);
+
+#endif
@@ -0,0 +1,145 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../hashtable.h"
+
+#include "arena.h"
+
+/* Every DIE name and data type string is kept here once, for as long
+ * as the dwarfinfo lives. Strings handed out are never freed by the
+ * caller, and two of them are equal only if they're the same pointer.
+ *
+ * DIE trees are built on more than one thread, so this is locked.
+ */
+
+struct strpoolent {
+    const char *spe_str;
+
+    /* Next string whose hash is the same */
+    struct strpoolent *spe_next;
+};
+
+struct strpool {
+    pthread_mutex_t sp_lock;
+
+    /* Hash of the string -> struct strpoolent */
+    struct hashtable *sp_strs;
+
+    /* Holds the strings and their entries */
+    void *sp_arena;
+
+    uint64_t sp_numstrs;
+
+    /* Bytes that would have been spent on duplicates */
+    uint64_t sp_bytessaved;
+};
+
+static struct strpoolent *find_ent(struct strpool *sp, const char *str,
+        unsigned long hash){
+    struct strpoolent *ent = NULL;
+
+    if(hashtable_get(sp->sp_strs, hash, (void **)&ent))
+        return NULL;
+
+    while(ent && strcmp(ent->spe_str, str) != 0)
+        ent = ent->spe_next;
+
+    return ent;
+}
+
+/* Returns the pooled copy of str, adding it if it isn't there yet. */
+const char *strpool_add(struct strpool *sp, const char *str){
+    if(!sp || !str)
+        return NULL;
+
+    unsigned long hash = hashtable_strhash(str);
+    size_t len = strlen(str) + 1;
+
+    pthread_mutex_lock(&sp->sp_lock);
+
+    struct strpoolent *ent = find_ent(sp, str, hash);
+
+    if(ent){
+        sp->sp_bytessaved += len;
+        pthread_mutex_unlock(&sp->sp_lock);
+
+        return ent->spe_str;
+    }
+
+    char *copy = arena_alloc(sp->sp_arena, len);
+    memcpy(copy, str, len);
+
+    ent = arena_alloc(sp->sp_arena, sizeof(struct strpoolent));
+    ent->spe_str = copy;
+
+    hashtable_get(sp->sp_strs, hash, (void **)&ent->spe_next);
+    hashtable_insert(sp->sp_strs, hash, ent);
+
+    sp->sp_numstrs++;
+
+    pthread_mutex_unlock(&sp->sp_lock);
+
+    return copy;
+}
+
+/* Returns the pooled copy of str, or NULL if nothing is called str. */
+const char *strpool_find(struct strpool *sp, const char *str){
+    if(!sp || !str)
+        return NULL;
+
+    unsigned long hash = hashtable_strhash(str);
+
+    pthread_mutex_lock(&sp->sp_lock);
+
+    struct strpoolent *ent = find_ent(sp, str, hash);
+
+    pthread_mutex_unlock(&sp->sp_lock);
+
+    return ent ? ent->spe_str : NULL;
+}
+
+void strpool_free(struct strpool *sp){
+    if(!sp)
+        return;
+
+    arena_free(sp->sp_arena);
+    hashtable_destroy(&sp->sp_strs);
+    pthread_mutex_destroy(&sp->sp_lock);
+
+    free(sp);
+}
+
+void strpool_get_usage(struct strpool *sp, uint64_t *numstrsout,
+        uint64_t *bytesusedout, uint64_t *bytessavedout){
+    if(!sp)
+        return;
+
+    pthread_mutex_lock(&sp->sp_lock);
+
+    if(numstrsout)
+        *numstrsout = sp->sp_numstrs;
+
+    /* Include what the pool itself costs */
+    if(bytesusedout){
+        *bytesusedout = arena_get_size(sp->sp_arena) +
+            sp->sp_strs->capacity * sizeof(struct hashtable_entry);
+    }
+
+    if(bytessavedout)
+        *bytessavedout = sp->sp_bytessaved;
+
+    pthread_mutex_unlock(&sp->sp_lock);
+}
+
+struct strpool *strpool_new(void){
+    struct strpool *sp = calloc(1, sizeof(struct strpool));
+
+    pthread_mutex_init(&sp->sp_lock, NULL);
+
+    sp->sp_strs = hashtable_new();
+    sp->sp_arena = arena_new();
+
+    return sp;
+}
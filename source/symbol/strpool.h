@@ -0,0 +1,10 @@
+#ifndef _STRPOOL_H_
+#define _STRPOOL_H_
+
+const char *strpool_add(void *, const char *);
+const char *strpool_find(void *, const char *);
+void strpool_free(void *);
+void strpool_get_usage(void *, uint64_t *, uint64_t *, uint64_t *);
+void *strpool_new(void);
+
+#endif
@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,12 +8,21 @@
 
 #include <libdwarf.h>
 
+#include "../hashtable.h"
 #include "../linkedlist.h"
+#include "../strext.h"
 
+#include "accel.h"
 #include "common.h"
 #include "compunit.h"
 #include "die.h"
+#include "lineidx.h"
+#include "strpool.h"
+#include "symcache.h"
 #include "symerr.h"
+#include "typecache.h"
+
+void sym_end(dwarfinfo_t **);
 
 int sym_init_with_dwarf_file(const char *file, dwarfinfo_t **_dwarfinfo,
         sym_error_t *e){
@@ -24,21 +34,44 @@ int sym_init_with_dwarf_file(const char *file, dwarfinfo_t **_dwarfinfo,
     }
 
     dwarfinfo_t *dwarfinfo = calloc(1, sizeof(dwarfinfo_t));
-    Dwarf_Error d_error = NULL;
-    int ret = dwarf_init(fd, DW_DLC_READ, NULL, NULL,
-            &dwarfinfo->di_dbg, &d_error);
-
-    if(ret != DW_DLV_OK){
-        errset(e, SYM_ERROR_KIND, SYM_DWARF_INIT_FAILED);
-        free(dwarfinfo);
-        return 1;
-    }
-
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&dwarfinfo->di_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    dwarfinfo->di_fd = fd;
+    dwarfinfo->di_path = strdup(file);
     dwarfinfo->di_compunits = linkedlist_new();
+    dwarfinfo->di_cunameidx = hashtable_new();
+    dwarfinfo->di_strpool = strpool_new();
+    dwarfinfo->di_typecache = typecache_new();
     dwarfinfo->di_numcompunits = 0;
 
-    if(cu_load_compilation_units(dwarfinfo, e))
-        return 1;
+    /* With a symbol cache, libdwarf isn't needed until something
+     * the cache doesn't have is asked for. Otherwise, do the work the
+     * cache would have saved us and write it out for next time. Line
+     * tables are left for sym_complete_symbol_cache.
+     */
+    dwarfinfo->di_symcache = symcache_load(dwarfinfo);
+
+    if(!dwarfinfo->di_symcache){
+        if(!cu_get_dwarf_debug(dwarfinfo)){
+            errset(e, SYM_ERROR_KIND, SYM_DWARF_INIT_FAILED);
+            sym_end((void **)&dwarfinfo);
+            return 1;
+        }
+
+        if(cu_load_compilation_units(dwarfinfo, e))
+            return 1;
+
+        if(cu_build_arange_index(dwarfinfo, e))
+            return 1;
+
+        symcache_save(dwarfinfo, 0);
+    }
+
+    dwarfinfo->di_accel = accel_load(dwarfinfo);
 
     *_dwarfinfo = dwarfinfo;
 
@@ -55,13 +88,9 @@ void sym_end(dwarfinfo_t **_dwarfinfo){
 
     while(current){
         void *cu = current->data;
-        void *root_die = NULL;
-
-        cu_get_root_die(cu, &root_die, NULL);
 
         current = current->next;
 
-        die_tree_free(dwarfinfo->di_dbg, root_die, 0);
         linkedlist_delete(dwarfinfo->di_compunits, cu);
         cu_free(cu, NULL);
     }
@@ -69,12 +98,57 @@ void sym_end(dwarfinfo_t **_dwarfinfo){
     close(dwarfinfo->di_fd);
 
     Dwarf_Error d_error = NULL;
-    int ret = dwarf_finish(dwarfinfo->di_dbg, &d_error);
+
+    if(dwarfinfo->di_dbg)
+        dwarf_finish(dwarfinfo->di_dbg, &d_error);
+
+    for(int i=0; i<dwarfinfo->di_numworkerhandles; i++){
+        struct dwarfhandle *dh = &dwarfinfo->di_workerhandles[i];
+
+        dwarf_finish(dh->dh_dbg, &d_error);
+        close(dh->dh_fd);
+    }
+
+    free(dwarfinfo->di_workerhandles);
+    free(dwarfinfo->di_path);
 
     linkedlist_free(dwarfinfo->di_compunits);
+    accel_free(dwarfinfo->di_accel);
+    lineidx_free(dwarfinfo->di_lineidx);
+    free(dwarfinfo->di_cus);
+    free(dwarfinfo->di_cuaranges);
+    hashtable_destroy(&dwarfinfo->di_cunameidx);
+    strpool_free(dwarfinfo->di_strpool);
+    typecache_free(dwarfinfo->di_typecache);
+
+    /* Line tables freed above were borrowing from this */
+    symcache_free(dwarfinfo->di_symcache);
+    pthread_mutex_destroy(&dwarfinfo->di_lock);
     free(dwarfinfo);
 }
 
+void sym_lock(dwarfinfo_t *dwarfinfo){
+    if(dwarfinfo)
+        pthread_mutex_lock(&dwarfinfo->di_lock);
+}
+
+void sym_unlock(dwarfinfo_t *dwarfinfo){
+    if(dwarfinfo)
+        pthread_mutex_unlock(&dwarfinfo->di_lock);
+}
+
+/* Locks the dwarfinfo cu belongs to and returns it */
+static dwarfinfo_t *sym_lock_cu(void *cu){
+    dwarfinfo_t *dwarfinfo = NULL;
+
+    if(cu_get_dwarfinfo(cu, (void **)&dwarfinfo, NULL))
+        return NULL;
+
+    sym_lock(dwarfinfo);
+
+    return dwarfinfo;
+}
+
 int sym_display_compilation_units(dwarfinfo_t *dwarfinfo,
         sym_error_t *e){
     return cu_display_compilation_units(dwarfinfo, e);
@@ -90,7 +164,7 @@ int sym_get_compilation_unit_root_die(void *cu, void **dieout,
     return cu_get_root_die(cu, dieout, e);
 }
 
-int sym_create_variable_or_parameter_die_desc(void *die, void *cu,
+static int create_variable_or_parameter_die_desc(void *die, void *cu,
         char **desc, sym_error_t *e){
     void *root_die = NULL;
     if(cu_get_root_die(cu, &root_die, e))
@@ -99,26 +173,170 @@ int sym_create_variable_or_parameter_die_desc(void *die, void *cu,
     return die_create_variable_or_parameter_desc(die, root_die, desc, e, 0);
 }
 
+int sym_create_variable_or_parameter_die_desc(void *die, void *cu,
+        char **desc, sym_error_t *e){
+    dwarfinfo_t *dwarfinfo = sym_lock_cu(cu);
+    int ret = create_variable_or_parameter_die_desc(die, cu, desc, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+int sym_evaluate_frame_variables(void **dies, int numdies, uint64_t pc,
+        char **outbuffer, struct framevar **varsout, sym_error_t *e){
+    return die_evaluate_frame_variables(dies, numdies, pc, outbuffer,
+            varsout, e);
+}
+
 int sym_evaluate_die_location_description(void *die, uint64_t pc,
         char **outbuffer, int64_t *resultout, sym_error_t *e){
     return die_evaluate_location_description(die, pc, outbuffer, resultout, e);
 }
 
-int sym_find_die_by_name(void *cu, const char *name, void **dieout,
+/* Returns the first of offsets which is in cu and made it into
+ * cu's DIE tree.
+ */
+static void *find_die_in_cu_by_offsets(dwarfinfo_t *dwarfinfo, void *cu,
+        void *root_die, uint64_t *offsets, int len){
+    for(int i=0; i<len; i++){
+        void *offsetcu = NULL;
+        if(cu_find_compilation_unit_by_die_offset(dwarfinfo, &offsetcu,
+                    offsets[i], NULL) || offsetcu != cu){
+            continue;
+        }
+
+        void *result = NULL;
+        if(die_search(root_die, (void *)offsets[i],
+                    DIE_SEARCH_IF_DIE_OFFSET_MATCHES, &result, NULL) == 0){
+            return result;
+        }
+    }
+
+    return NULL;
+}
+
+static int find_die_by_name(void *cu, const char *name, void **dieout,
         sym_error_t *e){
     void *root_die = NULL;
     if(cu_get_root_die(cu, &root_die, e))
         return 1;
 
+    dwarfinfo_t *dwarfinfo = NULL;
+    cu_get_dwarfinfo(cu, (void **)&dwarfinfo, NULL);
+
+    uint64_t *offsets = NULL;
+    int len = 0;
+
+    /* Only globals and types are indexed, locals still need a search */
+    if(accel_find_die_offsets_by_name(dwarfinfo->di_accel, name,
+                &offsets, &len) == 0){
+        void *result = find_die_in_cu_by_offsets(dwarfinfo, cu, root_die,
+                offsets, len);
+
+        free(offsets);
+
+        if(result){
+            *dieout = result;
+            return 0;
+        }
+    }
+
+    /* If the string pool doesn't have it, nothing is called name */
+    const char *pooled = strpool_find(dwarfinfo->di_strpool, name);
+
+    if(!pooled){
+        errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+        return 1;
+    }
+
     void *result = NULL;
-    int ret = die_search(root_die, (void *)name, DIE_SEARCH_IF_NAME_MATCHES,
-            &result, e);
+    int ret = die_search(root_die, (void *)pooled,
+            DIE_SEARCH_IF_POOLED_NAME_IS, &result, e);
 
     *dieout = result;
     return ret;
 }
 
-int sym_find_function_die_by_pc(void *cu, uint64_t pc, void **dieout,
+int sym_find_die_by_name(void *cu, const char *name, void **dieout,
+        sym_error_t *e){
+    dwarfinfo_t *dwarfinfo = sym_lock_cu(cu);
+    int ret = find_die_by_name(cu, name, dieout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+int sym_find_die_offsets_by_name(dwarfinfo_t *dwarfinfo, const char *name,
+        uint64_t **offsetsout, int *lenout, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    if(!name || !offsetsout || !lenout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    if(accel_find_die_offsets_by_name(dwarfinfo->di_accel, name,
+                offsetsout, lenout)){
+        errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int find_global_die_by_name(dwarfinfo_t *dwarfinfo, const char *name,
+        void **dieout, void **cuout, sym_error_t *e){
+    uint64_t *offsets = NULL;
+    int len = 0;
+
+    if(sym_find_die_offsets_by_name(dwarfinfo, name, &offsets, &len, e))
+        return 1;
+
+    for(int i=0; i<len; i++){
+        void *cu = NULL, *root_die = NULL;
+
+        if(cu_find_compilation_unit_by_die_offset(dwarfinfo, &cu,
+                    offsets[i], NULL)){
+            continue;
+        }
+
+        if(cu_get_root_die(cu, &root_die, NULL))
+            continue;
+
+        void *result = find_die_in_cu_by_offsets(dwarfinfo, cu, root_die,
+                &offsets[i], 1);
+
+        if(result){
+            free(offsets);
+
+            *dieout = result;
+
+            if(cuout)
+                *cuout = cu;
+
+            return 0;
+        }
+    }
+
+    free(offsets);
+
+    errset(e, DIE_ERROR_KIND, DIE_DIE_NOT_FOUND);
+    return 1;
+}
+
+int sym_find_global_die_by_name(dwarfinfo_t *dwarfinfo, const char *name,
+        void **dieout, void **cuout, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = find_global_die_by_name(dwarfinfo, name, dieout, cuout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int find_function_die_by_pc(void *cu, uint64_t pc, void **dieout,
         sym_error_t *e){
     void *root_die = NULL;
     if(cu_get_root_die(cu, &root_die, e))
@@ -132,6 +350,15 @@ int sym_find_function_die_by_pc(void *cu, uint64_t pc, void **dieout,
     return ret;
 }
 
+int sym_find_function_die_by_pc(void *cu, uint64_t pc, void **dieout,
+        sym_error_t *e){
+    dwarfinfo_t *dwarfinfo = sym_lock_cu(cu);
+    int ret = find_function_die_by_pc(cu, pc, dieout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
 int sym_get_die_array_elem_size(void *die, uint64_t *elemszout,
         sym_error_t *e){
     return die_get_array_elem_size(die, elemszout, e);
@@ -142,6 +369,11 @@ int sym_get_die_array_size_determined_at_runtime(void *die, int *retval,
     return die_get_array_size_determined_at_runtime(die, retval, e);
 }
 
+int sym_get_die_call_site(void *die, char **fileout, uint64_t *lineout,
+        sym_error_t *e){
+    return die_get_call_site(die, fileout, lineout, e);
+}
+
 int sym_get_die_data_type_str(void *die, char **datatypeout, sym_error_t *e){
     return die_get_data_type_str(die, datatypeout, e);
 }
@@ -158,7 +390,7 @@ int sym_get_die_low_pc(void *die, uint64_t *lowpcout, sym_error_t *e){
     return die_get_low_pc(die, lowpcout, e);
 }
 
-int sym_get_die_members(void *die, void *cu, void ***membersout,
+static int get_die_members(void *die, void *cu, void ***membersout,
         int *membersarrlen, sym_error_t *e){
     void *root_die = NULL;
     if(cu_get_root_die(cu, &root_die, e))
@@ -167,6 +399,15 @@ int sym_get_die_members(void *die, void *cu, void ***membersout,
     return die_get_members(die, root_die, membersout, membersarrlen, e);
 }
 
+int sym_get_die_members(void *die, void *cu, void ***membersout,
+        int *membersarrlen, sym_error_t *e){
+    dwarfinfo_t *dwarfinfo = sym_lock_cu(cu);
+    int ret = get_die_members(die, cu, membersout, membersarrlen, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
 int sym_get_die_name(void *die, char **dienameout, sym_error_t *e){
     return die_get_name(die, dienameout, e);
 }
@@ -198,21 +439,53 @@ int sym_get_function_die_parameters(void *die, void ***paramsout,
     return die_get_parameters(die, paramsout, lenout, e);
 }
 
+static int get_inline_stack_by_pc(dwarfinfo_t *dwarfinfo, uint64_t pc,
+        void ***stackout, int *lenout, sym_error_t *e){
+    void *cu = NULL;
+    if(cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc, e))
+        return 1;
+
+    void *root_die = NULL;
+    if(cu_get_root_die(cu, &root_die, e))
+        return 1;
+
+    return die_get_inline_stack(root_die, pc, stackout, lenout, e);
+}
+
+int sym_get_inline_stack_by_pc(dwarfinfo_t *dwarfinfo, uint64_t pc,
+        void ***stackout, int *lenout, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = get_inline_stack_by_pc(dwarfinfo, pc, stackout, lenout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
 int sym_get_parent_of_die(void *die, void **parentout, sym_error_t *e){
     return die_get_parent(die, parentout, e);
 }
 
-int sym_get_variable_dies(dwarfinfo_t *dwarfinfo, uint64_t pc,
+static int get_variable_dies(dwarfinfo_t *dwarfinfo, uint64_t pc,
         void ***vardies, int *len, sym_error_t *e){
     void *cu = NULL;
     if(cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc, e))
         return 1;
 
     void *fxndie = NULL;
-    if(sym_find_function_die_by_pc(cu, pc, &fxndie, e))
+    if(find_function_die_by_pc(cu, pc, &fxndie, e))
         return 1;
 
-    return die_get_variables(dwarfinfo->di_dbg, fxndie, vardies, len, e);
+    return die_get_variables(cu_get_dwarf_debug(dwarfinfo), fxndie, vardies,
+            len, e);
+}
+
+int sym_get_variable_dies(dwarfinfo_t *dwarfinfo, uint64_t pc,
+        void ***vardies, int *len, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = get_variable_dies(dwarfinfo, pc, vardies, len, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
 }
 
 int sym_is_die_a_member_of_struct_or_union(void *die, int *retval,
@@ -220,7 +493,7 @@ int sym_is_die_a_member_of_struct_or_union(void *die, int *retval,
     return die_is_member_of_struct_or_union(die, retval, e);
 }
 
-int sym_get_line_info_from_pc(dwarfinfo_t *dwarfinfo, uint64_t pc,
+static int get_line_info_from_pc(dwarfinfo_t *dwarfinfo, uint64_t pc,
         char **outsrcfilename, char **outsrcfunction,
         uint64_t *outsrcfilelineno, void **cudieout, sym_error_t *e){
     void *cu = NULL;
@@ -231,31 +504,51 @@ int sym_get_line_info_from_pc(dwarfinfo_t *dwarfinfo, uint64_t pc,
     if(cu_get_root_die(cu, &root_die, e))
         return 1;
 
-    int ret = die_get_line_info_from_pc(dwarfinfo->di_dbg, root_die, pc,
-            outsrcfilename, outsrcfunction, outsrcfilelineno, e);
+    int ret = die_get_line_info_from_pc(cu_get_dwarf_debug(dwarfinfo),
+            root_die, pc, outsrcfilename, outsrcfunction, outsrcfilelineno, e);
 
     *cudieout = root_die;
     return 0;
 }
 
-int sym_get_pc_of_next_line(dwarfinfo_t *dwarfinfo, uint64_t pc,
+int sym_get_line_info_from_pc(dwarfinfo_t *dwarfinfo, uint64_t pc,
+        char **outsrcfilename, char **outsrcfunction,
+        uint64_t *outsrcfilelineno, void **cudieout, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = get_line_info_from_pc(dwarfinfo, pc, outsrcfilename,
+            outsrcfunction, outsrcfilelineno, cudieout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int get_pc_of_next_line(dwarfinfo_t *dwarfinfo, uint64_t pc,
         uint64_t *next_line_pc, void **cudieout, sym_error_t *e){
     void *cu = NULL;
     if(cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc, e))
         return 1;
 
     void *root_die = NULL;
-    if(cu_get_root_die(cu, &root_die, e))
+    if(cu_get_root_die_no_tree(cu, &root_die, e))
         return 1;
 
-    int ret = die_get_pc_of_next_line(dwarfinfo->di_dbg, root_die, pc,
-            next_line_pc, e);
+    int ret = die_get_pc_of_next_line(cu_get_dwarf_debug(dwarfinfo),
+            root_die, pc, next_line_pc, e);
 
     *cudieout = root_die;
     return ret;
 }
 
-int sym_get_pc_values_from_lineno(dwarfinfo_t *dwarfinfo, void *cu,
+int sym_get_pc_of_next_line(dwarfinfo_t *dwarfinfo, uint64_t pc,
+        uint64_t *next_line_pc, void **cudieout, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = get_pc_of_next_line(dwarfinfo, pc, next_line_pc, cudieout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int get_pc_values_from_lineno(dwarfinfo_t *dwarfinfo, void *cu,
         uint64_t lineno, uint64_t **pcs, int *len, sym_error_t *e){
     if(!dwarfinfo){
         errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
@@ -263,59 +556,223 @@ int sym_get_pc_values_from_lineno(dwarfinfo_t *dwarfinfo, void *cu,
     }
 
     void *root_die = NULL;
-    if(cu_get_root_die(cu, &root_die, e))
+    if(cu_get_root_die_no_tree(cu, &root_die, e))
         return 1;
 
-    return die_get_pc_values_from_lineno(dwarfinfo->di_dbg, root_die, lineno,
-            pcs, len, e);
+    return die_get_pc_values_from_lineno(cu_get_dwarf_debug(dwarfinfo),
+            root_die, lineno, pcs, len, e);
 }
 
-int sym_lineno_to_pc_a(dwarfinfo_t *dwarfinfo,
+int sym_get_pc_values_from_lineno(dwarfinfo_t *dwarfinfo, void *cu,
+        uint64_t lineno, uint64_t **pcs, int *len, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = get_pc_values_from_lineno(dwarfinfo, cu, lineno, pcs, len, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int lineno_to_pcs(dwarfinfo_t *dwarfinfo, char *srcfilename,
+        uint64_t *srcfilelineno, int adjust, uint64_t **pcsout,
+        int *numpcsout, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    if(!srcfilename || !srcfilelineno || !pcsout || !numpcsout){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_PARAMETER);
+        return 1;
+    }
+
+    if(!dwarfinfo->di_lineidx)
+        dwarfinfo->di_lineidx = lineidx_build(dwarfinfo);
+
+    if(lineidx_find(dwarfinfo->di_lineidx, srcfilename, *srcfilelineno,
+                adjust, srcfilelineno, pcsout, numpcsout)){
+        errset(e, DIE_ERROR_KIND, DIE_LINE_NOT_FOUND);
+        return 1;
+    }
+
+    return 0;
+}
+
+int sym_lineno_to_pcs(dwarfinfo_t *dwarfinfo, char *srcfilename,
+        uint64_t *srcfilelineno, int adjust, uint64_t **pcsout,
+        int *numpcsout, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = lineno_to_pcs(dwarfinfo, srcfilename, srcfilelineno, adjust,
+            pcsout, numpcsout, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int lineno_to_pc_a(dwarfinfo_t *dwarfinfo,
         char *srcfilename, uint64_t *srcfilelineno, uint64_t *pcout,
         char **outbuffer, sym_error_t *e){
-    void *cu = NULL;
-    if(cu_find_compilation_unit_by_name(dwarfinfo, &cu, srcfilename, e))
-        return 1;
+    uint64_t linepassedin = *srcfilelineno, *pcs = NULL;
+    int numpcs = 0;
 
-    void *root_die = NULL;
-    if(cu_get_root_die(cu, &root_die, e))
+    if(lineno_to_pcs(dwarfinfo, srcfilename, srcfilelineno, 0, &pcs,
+                &numpcs, NULL) &&
+            lineno_to_pcs(dwarfinfo, srcfilename, srcfilelineno, 1, &pcs,
+                &numpcs, e)){
         return 1;
+    }
+
+    if(*srcfilelineno != linepassedin){
+        concat(outbuffer, "Line %lld doesn't exist, auto-adjusted to line %lld\n",
+                linepassedin, *srcfilelineno);
+    }
 
-    return die_lineno_to_pc(dwarfinfo->di_dbg, root_die, srcfilelineno,
+    *pcout = pcs[0];
+    free(pcs);
+
+    return 0;
+}
+
+int sym_lineno_to_pc_a(dwarfinfo_t *dwarfinfo,
+        char *srcfilename, uint64_t *srcfilelineno, uint64_t *pcout,
+        char **outbuffer, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = lineno_to_pc_a(dwarfinfo, srcfilename, srcfilelineno,
             pcout, outbuffer, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
 }
 
-int sym_lineno_to_pc_b(dwarfinfo_t *dwarfinfo, void *cu,
+static int lineno_to_pc_b(dwarfinfo_t *dwarfinfo, void *cu,
         uint64_t *srcfilelineno, uint64_t *pcout, char **outbuffer,
         sym_error_t *e){
     void *root_die = NULL;
-    if(cu_get_root_die(cu, &root_die, e))
+    if(cu_get_root_die_no_tree(cu, &root_die, e))
         return 1;
 
-    return die_lineno_to_pc(dwarfinfo->di_dbg, root_die, srcfilelineno,
-            pcout, outbuffer, e);
+    return die_lineno_to_pc(cu_get_dwarf_debug(dwarfinfo), root_die,
+            srcfilelineno, pcout, outbuffer, e);
 }
 
-int sym_pc_to_lineno_a(dwarfinfo_t *dwarfinfo, uint64_t pc,
+int sym_lineno_to_pc_b(dwarfinfo_t *dwarfinfo, void *cu,
+        uint64_t *srcfilelineno, uint64_t *pcout, char **outbuffer,
+        sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = lineno_to_pc_b(dwarfinfo, cu, srcfilelineno, pcout,
+            outbuffer, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int pc_to_lineno_a(dwarfinfo_t *dwarfinfo, uint64_t pc,
         uint64_t *srcfilelineno, sym_error_t *e){
     void *cu = NULL;
     if(cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc, e))
         return 1;
 
     void *root_die = NULL;
-    if(cu_get_root_die(cu, &root_die, e))
+    if(cu_get_root_die_no_tree(cu, &root_die, e))
         return 1;
 
-    return die_pc_to_lineno(dwarfinfo->di_dbg, root_die, pc, srcfilelineno, e);
+    return die_pc_to_lineno(cu_get_dwarf_debug(dwarfinfo), root_die, pc,
+            srcfilelineno, e);
 }
 
-int sym_pc_to_lineno_b(dwarfinfo_t *dwarfinfo, void *cu, uint64_t pc,
+int sym_pc_to_lineno_a(dwarfinfo_t *dwarfinfo, uint64_t pc,
+        uint64_t *srcfilelineno, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = pc_to_lineno_a(dwarfinfo, pc, srcfilelineno, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+static int pc_to_lineno_b(dwarfinfo_t *dwarfinfo, void *cu, uint64_t pc,
         uint64_t *srcfilelineno, sym_error_t *e){
     void *root_die = NULL;
-    if(cu_get_root_die(cu, &root_die, e))
+    if(cu_get_root_die_no_tree(cu, &root_die, e))
         return 1;
 
-    return die_pc_to_lineno(dwarfinfo->di_dbg, root_die, pc, srcfilelineno, e);
+    return die_pc_to_lineno(cu_get_dwarf_debug(dwarfinfo), root_die, pc,
+            srcfilelineno, e);
+}
+
+int sym_pc_to_lineno_b(dwarfinfo_t *dwarfinfo, void *cu, uint64_t pc,
+        uint64_t *srcfilelineno, sym_error_t *e){
+    sym_lock(dwarfinfo);
+    int ret = pc_to_lineno_b(dwarfinfo, cu, pc, srcfilelineno, e);
+    sym_unlock(dwarfinfo);
+
+    return ret;
+}
+
+int sym_set_die_tree_cap(dwarfinfo_t *dwarfinfo, uint64_t cap,
+        sym_error_t *e){
+    return cu_set_die_tree_cap(dwarfinfo, cap, e);
+}
+
+int sym_build_all_die_trees(dwarfinfo_t *dwarfinfo, int numworkers,
+        sym_error_t *e){
+    return cu_build_all_die_trees(dwarfinfo, numworkers, e);
+}
+
+int sym_complete_symbol_cache(dwarfinfo_t *dwarfinfo, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    sym_lock(dwarfinfo);
+
+    /* Not being able to write it isn't an error, it's only a cache */
+    if(!dwarfinfo->di_symcachecomplete)
+        symcache_save(dwarfinfo, 1);
+
+    sym_unlock(dwarfinfo);
+
+    return 0;
+}
+
+int sym_get_string_pool_usage(dwarfinfo_t *dwarfinfo, uint64_t *numstrsout,
+        uint64_t *bytesusedout, uint64_t *bytessavedout, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    strpool_get_usage(dwarfinfo->di_strpool, numstrsout, bytesusedout,
+            bytessavedout);
+
+    return 0;
+}
+
+int sym_get_section_data(dwarfinfo_t *dwarfinfo, const char *name,
+        const uint8_t **dataout, uint64_t *sizeout, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    if(accel_get_section(dwarfinfo->di_accel, name, dataout, sizeout)){
+        errset(e, SYM_ERROR_KIND, SYM_SECTION_NOT_FOUND);
+        return 1;
+    }
+
+    return 0;
+}
+
+int sym_get_type_cache_usage(dwarfinfo_t *dwarfinfo, uint64_t *numtypesout,
+        uint64_t *bytesusedout, uint64_t *hitsout, sym_error_t *e){
+    if(!dwarfinfo){
+        errset(e, GENERIC_ERROR_KIND, GE_INVALID_DWARFINFO);
+        return 1;
+    }
+
+    typecache_get_usage(dwarfinfo->di_typecache, numtypesout, bytesusedout,
+            hitsout);
+
+    return 0;
 }
 
 const char *sym_strerror(sym_error_t e){
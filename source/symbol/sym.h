@@ -5,6 +5,8 @@
 
 #include "symerr.h"
 
+struct framevar;
+
 /*
  * Almost all of these functions return 0 on success and non-zero on error.
  * Those that do take a pointer to an error structure as the last parameter,
@@ -23,6 +25,17 @@ int sym_init_with_dwarf_file(
 void sym_end(
         void **     /* dwarfinfo ptr */);
 
+/* Every sym_* function is safe to call from more than one thread.
+ * DIEs they give back can be freed by another thread once a DIE tree
+ * cap is set, though, so hold this for as long as you use them.
+ * It can be taken more than once by the same thread.
+ */
+void sym_lock(
+        void *      /* dwarfinfo ptr */);
+
+void sym_unlock(
+        void *      /* dwarfinfo ptr */);
+
 
 /* Compilation unit related functions */
 int sym_display_compilation_units(
@@ -40,6 +53,68 @@ int sym_get_compilation_unit_root_die(
         void **     /* return root DIE */,
         void *      /* return error ptr */);
 
+/* Build every compilation unit's DIE tree now instead of when each
+ * one is first queried, spread across numworkers threads. Zero
+ * means one thread per CPU.
+ */
+int sym_build_all_die_trees(
+        void *      /* dwarfinfo ptr */,
+        int         /* numworkers */,
+        void *      /* return error ptr */);
+
+/* DIE trees are built the first time a compilation unit is queried.
+ * Once they take up more than cap bytes, the least recently used ones
+ * are discarded. Zero means no cap, which is the default.
+ */
+int sym_set_die_tree_cap(
+        void *      /* dwarfinfo ptr */,
+        uint64_t    /* cap, in bytes */,
+        void *      /* return error ptr */);
+
+/* The first time a DWARF file is loaded, its symbol cache is written
+ * without line tables, because decoding all of them takes a while.
+ * This decodes the rest and writes the cache again, so every later
+ * load gets them for free. Does nothing if the cache already has them.
+ */
+int sym_complete_symbol_cache(
+        void *      /* dwarfinfo ptr */,
+        void *      /* return error ptr */);
+
+/* DIE names and data type strings are only stored once. Returns how
+ * many unique strings there are, what storing them costs, and how many
+ * bytes copies of them would have taken up otherwise.
+ */
+int sym_get_string_pool_usage(
+        void *      /* dwarfinfo ptr */,
+        uint64_t *  /* return number of strings, optional */,
+        uint64_t *  /* return bytes used, optional */,
+        uint64_t *  /* return bytes saved, optional */,
+        void *      /* return error ptr */);
+
+
+/* Gives back the contents of a section of the DWARF file, like
+ * "debug_frame". They stay valid until sym_end.
+ */
+int sym_get_section_data(
+        void *              /* dwarfinfo ptr */,
+        const char *        /* section name */,
+        const uint8_t **    /* return section contents */,
+        uint64_t *          /* return section size */,
+        void *              /* return error ptr */);
+
+
+/* Data type layouts are resolved once per type and shared by every
+ * variable of that type. Returns how many have been resolved, what
+ * they take up, and how many times one was reused instead of being
+ * resolved again.
+ */
+int sym_get_type_cache_usage(
+        void *      /* dwarfinfo ptr */,
+        uint64_t *  /* return number of types, optional */,
+        uint64_t *  /* return bytes used, optional */,
+        uint64_t *  /* return cache hits, optional */,
+        void *      /* return error ptr */);
+
 
 /* DIE related functions */
 int sym_create_variable_or_parameter_die_desc(
@@ -48,6 +123,19 @@ int sym_create_variable_or_parameter_die_desc(
         char **     /* return description */,
         void *      /* return error ptr */);
 
+/* Evaluates every DIE from sym_get_variable_dies at once and reads
+ * their values, in a handful of reads instead of a few per variable.
+ * Returns an array of numdies framevars, in the same order. It holds
+ * the values too, so freeing it frees everything.
+ */
+int sym_evaluate_frame_variables(
+        void **             /* variable DIEs */,
+        int                 /* number of DIEs */,
+        uint64_t            /* pc */,
+        char **             /* outbuffer */,
+        struct framevar **  /* return variables */,
+        void *              /* return error ptr */);
+
 int sym_evaluate_die_location_description(
         void *      /* die */,
         uint64_t    /* pc */,
@@ -61,6 +149,28 @@ int sym_find_die_by_name(
         void **         /* return die */,
         void *          /* return error ptr */);
 
+/* Returns the offset of every function, global variable, and type
+ * DIE called name, across every compilation unit. Uses the
+ * accelerator tables if the DWARF file has them. Free the returned
+ * array when you're done with it.
+ */
+int sym_find_die_offsets_by_name(
+        void *          /* dwarfinfo ptr */,
+        const char *    /* name */,
+        uint64_t **     /* return DIE offsets */,
+        int *           /* return DIE offsets array len */,
+        void *          /* return error ptr */);
+
+/* Like sym_find_die_by_name, but searches every compilation unit.
+ * Only functions, global variables, and types can be found.
+ */
+int sym_find_global_die_by_name(
+        void *          /* dwarfinfo ptr */,
+        const char *    /* name */,
+        void **         /* return die */,
+        void **         /* return CU the die belongs to, optional */,
+        void *          /* return error ptr */);
+
 int sym_find_function_die_by_pc(
         void *      /* compilation unit */,
         uint64_t    /* pc */,
@@ -77,6 +187,15 @@ int sym_get_die_array_size_determined_at_runtime(
         int *       /* return retval */,
         void *      /* return error ptr */);
 
+/* Returns where an inlined subroutine DIE was inlined. The file name
+ * must not be freed.
+ */
+int sym_get_die_call_site(
+        void *      /* die */,
+        char **     /* return call file */,
+        uint64_t *  /* return call line */,
+        void *      /* return error ptr */);
+
 int sym_get_die_data_type_str(
         void *      /* die */,
         char **     /* return data type string */,
@@ -152,6 +271,17 @@ int sym_get_function_die_parameters(
         int *       /* return parameter array length */,
         void *      /* return error ptr */);
 
+/* Returns every inlined subroutine DIE pc is in, innermost first,
+ * followed by the function DIE they were inlined into. Free the
+ * returned array, but not the DIEs in it.
+ */
+int sym_get_inline_stack_by_pc(
+        void *      /* dwarfinfo ptr */,
+        uint64_t    /* pc */,
+        void ***    /* return DIE array */,
+        int *       /* return DIE array len */,
+        void *      /* return error ptr */);
+
 int sym_get_parent_of_die(
         void *      /* die */,
         void **     /* return parent DIE */,
@@ -175,7 +305,9 @@ int sym_is_die_a_member_of_struct_or_union(
 
 /* Line related functions */
 
-/* Returns CU DIE which this line resides in */
+/* Returns CU DIE which this line resides in. The source file name and
+ * function name returned belong to the symbol tables and must not be freed.
+ */
 int sym_get_line_info_from_pc(
         void *      /* dwarfinfo ptr */,
         uint64_t    /* pc */,
@@ -204,7 +336,7 @@ int sym_get_pc_values_from_lineno(
         int *           /* return PC values array len */,
         void *          /* return error ptr */);
 
-/* Finds CU DIE based on srcfilename */
+/* The lowest PC of sym_lineno_to_pcs, trying an exact match first */
 int sym_lineno_to_pc_a(
         void *      /* dwarfinfo ptr */,
         char *      /* srcfilename */,
@@ -213,6 +345,20 @@ int sym_lineno_to_pc_a(
         char **     /* outbuffer */,
         void *      /* return error ptr */);
 
+/* Every PC a line in srcfilename was compiled to, across every
+ * compilation unit, sorted. Only an exact match counts unless adjust
+ * is non-zero, then a line with no code resolves to the closest one
+ * after it that has some. The PC array has to be freed.
+ */
+int sym_lineno_to_pcs(
+        void *      /* dwarfinfo ptr */,
+        char *      /* srcfilename */,
+        uint64_t *  /* srcfilelineno, returns the one actually used */,
+        int         /* adjust */,
+        uint64_t ** /* return PCs */,
+        int *       /* return PC count */,
+        void *      /* return error ptr */);
+
 /* CU DIE given as second argument */
 int sym_lineno_to_pc_b(
         void *      /* dwarfinfo ptr */,
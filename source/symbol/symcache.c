@@ -0,0 +1,570 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../hashtable.h"
+#include "../strext.h"
+
+#include "common.h"
+#include "compunit.h"
+#include "die.h"
+#include "linetable.h"
+#include "objfile.h"
+
+/* Everything sym_init_with_dwarf_file has to work out from the DWARF
+ * file up front, written to disk the first time that file is loaded.
+ * That's every compilation unit's header and root DIE, the compilation
+ * unit address range index, and, once they've all been decoded, every
+ * compilation unit's line table. Later loads make the compilation units
+ * from the cache without opening the DWARF file with libdwarf, and the
+ * line tables are used right out of the mapping.
+ *
+ * Decoding every line table takes a while, so the first load writes
+ * the cache without them and sym_complete_symbol_cache writes it again
+ * with them later, off the main thread.
+ *
+ * A cache is named after the DWARF file's Mach-O UUID (or ELF build
+ * ID) and also records the file's size and modification time. If any
+ * of those change, or the layout of what we write changes, the cache
+ * is ignored and written again.
+ *
+ * Caches go in $IOSDBG_SYMCACHE_DIR, or ~/.iosdbg/symcache if that
+ * isn't set. Set IOSDBG_SYMCACHE_DIR to an empty string to turn the
+ * cache off.
+ */
+
+#define SYMCACHE_MAGIC          "IDBGSYMC"
+#define SYMCACHE_VERSION        (2)
+#define SYMCACHE_NO_STR         ((uint32_t)-1)
+
+struct symcache_header {
+    char sch_magic[8];
+    uint32_t sch_version;
+
+    /* Size of one line table row when this cache was written */
+    uint32_t sch_linerowsz;
+
+    uint8_t sch_uuid[16];
+    int64_t sch_mtime;
+    uint64_t sch_filesize;
+
+    uint32_t sch_numcus;
+    uint32_t sch_numaranges;
+
+    /* Whether every compilation unit's line table is in here */
+    uint32_t sch_haslinetables;
+    uint32_t sch_pad;
+
+    /* File offsets of the struct symcache_cu array, the
+     * struct symcache_arange array, and the string table.
+     */
+    uint64_t sch_cusoff;
+    uint64_t sch_arangesoff;
+    uint64_t sch_strsoff;
+    uint64_t sch_strssize;
+};
+
+/* One per compilation unit, in the same order as di_cus */
+struct symcache_cu {
+    uint64_t scc_headerlen;
+    uint64_t scc_abbrevoffset;
+    uint64_t scc_nextheaderoffset;
+
+    /* The root DIE */
+    uint64_t scc_rootdieoffset;
+    uint64_t scc_lowpc;
+    uint64_t scc_highpc;
+
+    /* Line table rows, and an array of uint32_t string table offsets
+     * for its source files (SYMCACHE_NO_STR if it had no name).
+     * Only there with sch_haslinetables.
+     */
+    uint64_t scc_rowsoff;
+    uint64_t scc_filesoff;
+    uint32_t scc_numrows;
+    uint32_t scc_numfiles;
+
+    /* String table offset of the root DIE's name, or SYMCACHE_NO_STR */
+    uint32_t scc_name;
+    uint16_t scc_addrsize;
+    uint16_t scc_tag;
+    uint16_t scc_haschildren;
+    uint16_t scc_pad[3];
+};
+
+struct symcache_arange {
+    uint64_t sca_lopc;
+    uint64_t sca_hipc;
+    uint32_t sca_cuidx;
+    uint32_t sca_pad;
+};
+
+struct symcache {
+    void *sc_map;
+    size_t sc_mapsize;
+};
+
+/* What gets written to disk is put together in one of these first */
+struct scbuf {
+    uint8_t *sb_data;
+    uint64_t sb_len;
+    uint64_t sb_capacity;
+};
+
+static uint64_t scbuf_append(struct scbuf *sb, const void *data,
+        uint64_t len){
+    /* Everything we write is read in place, so keep it aligned */
+    uint64_t off = (sb->sb_len + 7) & ~7ULL;
+
+    if(off + len > sb->sb_capacity){
+        uint64_t newcapacity = sb->sb_capacity ? sb->sb_capacity : 4096;
+
+        while(off + len > newcapacity)
+            newcapacity *= 2;
+
+        uint8_t *data_rea = realloc(sb->sb_data, newcapacity);
+        sb->sb_data = data_rea;
+        sb->sb_capacity = newcapacity;
+    }
+
+    memset(sb->sb_data + sb->sb_len, 0, off - sb->sb_len);
+
+    if(data)
+        memcpy(sb->sb_data + off, data, len);
+    else
+        memset(sb->sb_data + off, 0, len);
+
+    sb->sb_len = off + len;
+
+    return off;
+}
+
+static char *get_cache_dir(void){
+    const char *dir = getenv("IOSDBG_SYMCACHE_DIR");
+
+    if(dir)
+        return *dir ? strdup(dir) : NULL;
+
+    const char *home = getenv("HOME");
+
+    if(!home)
+        return NULL;
+
+    char *path = NULL;
+    concat(&path, "%s/.iosdbg", home);
+    mkdir(path, 0755);
+    concat(&path, "/symcache");
+
+    return path;
+}
+
+/* Fills in the parts of the header that identify the DWARF file */
+static int get_cache_key(dwarfinfo_t *dwarfinfo,
+        struct symcache_header *key){
+    struct stat st;
+
+    if(fstat(dwarfinfo->di_fd, &st) || st.st_size == 0)
+        return 1;
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+            dwarfinfo->di_fd, 0);
+
+    if(map == MAP_FAILED)
+        return 1;
+
+    int ret = obj_get_uuid(map, st.st_size, key->sch_uuid);
+
+    munmap(map, st.st_size);
+
+    if(ret)
+        return 1;
+
+    memcpy(key->sch_magic, SYMCACHE_MAGIC, sizeof(key->sch_magic));
+    key->sch_version = SYMCACHE_VERSION;
+    key->sch_mtime = st.st_mtime;
+    key->sch_filesize = st.st_size;
+
+    key->sch_linerowsz = lt_get_row_size();
+
+    return 0;
+}
+
+static char *get_cache_path(struct symcache_header *key){
+    char *dir = get_cache_dir();
+
+    if(!dir)
+        return NULL;
+
+    mkdir(dir, 0755);
+
+    char *path = NULL;
+    concat(&path, "%s/", dir);
+
+    for(int i=0; i<sizeof(key->sch_uuid); i++)
+        concat(&path, "%02X", key->sch_uuid[i]);
+
+    concat(&path, ".symcache");
+
+    free(dir);
+
+    return path;
+}
+
+static int in_map(struct symcache *sc, uint64_t off, uint64_t len){
+    return off <= sc->sc_mapsize && len <= sc->sc_mapsize - off;
+}
+
+static const char *get_str(struct symcache *sc, uint32_t stroff){
+    struct symcache_header *hdr = sc->sc_map;
+
+    if(stroff == SYMCACHE_NO_STR || stroff >= hdr->sch_strssize)
+        return NULL;
+
+    return (const char *)sc->sc_map + hdr->sch_strsoff + stroff;
+}
+
+static int is_cache_valid(struct symcache *sc, struct symcache_header *key){
+    struct symcache_header *hdr = sc->sc_map;
+
+    if(sc->sc_mapsize < sizeof(*hdr))
+        return 0;
+
+    /* Everything up to the counts has to match */
+    if(memcmp(hdr, key, offsetof(struct symcache_header, sch_numcus)) != 0)
+        return 0;
+
+    if(!in_map(sc, hdr->sch_cusoff,
+                (uint64_t)hdr->sch_numcus * sizeof(struct symcache_cu)) ||
+            !in_map(sc, hdr->sch_arangesoff, (uint64_t)hdr->sch_numaranges *
+                sizeof(struct symcache_arange)) ||
+            !in_map(sc, hdr->sch_strsoff, hdr->sch_strssize)){
+        return 0;
+    }
+
+    /* Strings are used in place, so they can't run off the end */
+    const char *strs = (const char *)sc->sc_map + hdr->sch_strsoff;
+
+    if(hdr->sch_strssize > 0 && strs[hdr->sch_strssize - 1] != '\0')
+        return 0;
+
+    if(!hdr->sch_haslinetables)
+        return 1;
+
+    struct symcache_cu *sccus =
+        (struct symcache_cu *)((uint8_t *)sc->sc_map + hdr->sch_cusoff);
+
+    for(uint32_t i=0; i<hdr->sch_numcus; i++){
+        if(!in_map(sc, sccus[i].scc_rowsoff,
+                    (uint64_t)sccus[i].scc_numrows * hdr->sch_linerowsz) ||
+                !in_map(sc, sccus[i].scc_filesoff,
+                    (uint64_t)sccus[i].scc_numfiles * sizeof(uint32_t))){
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Make the compilation units, fill in the address range index, and
+ * hand each compilation unit its line table if they're in here.
+ * Nothing here goes through libdwarf.
+ */
+static int use_cache(dwarfinfo_t *dwarfinfo, struct symcache *sc){
+    uint8_t *base = sc->sc_map;
+    struct symcache_header *hdr = sc->sc_map;
+    struct symcache_cu *sccus = (struct symcache_cu *)(base + hdr->sch_cusoff);
+    struct symcache_arange *scaranges =
+        (struct symcache_arange *)(base + hdr->sch_arangesoff);
+
+    struct cusummary *summaries = malloc(sizeof(struct cusummary) *
+            (hdr->sch_numcus ? hdr->sch_numcus : 1));
+
+    for(uint32_t i=0; i<hdr->sch_numcus; i++){
+        struct symcache_cu *scc = &sccus[i];
+        struct cusummary *cs = &summaries[i];
+
+        cs->cs_headerlen = scc->scc_headerlen;
+        cs->cs_abbrevoffset = scc->scc_abbrevoffset;
+        cs->cs_nextheaderoffset = scc->scc_nextheaderoffset;
+        cs->cs_rootdieoffset = scc->scc_rootdieoffset;
+        cs->cs_lowpc = scc->scc_lowpc;
+        cs->cs_highpc = scc->scc_highpc;
+        cs->cs_name = get_str(sc, scc->scc_name);
+        cs->cs_addrsize = scc->scc_addrsize;
+        cs->cs_tag = scc->scc_tag;
+        cs->cs_haschildren = scc->scc_haschildren;
+    }
+
+    int ret = cu_load_cached_compilation_units(dwarfinfo, summaries,
+            hdr->sch_numcus, NULL);
+
+    free(summaries);
+
+    if(ret)
+        return 1;
+
+    dwarfinfo->di_cuaranges = malloc(sizeof(struct cu_arange) *
+            (hdr->sch_numaranges ? hdr->sch_numaranges : 1));
+    dwarfinfo->di_numcuaranges = 0;
+
+    for(uint32_t i=0; i<hdr->sch_numaranges; i++){
+        if(scaranges[i].sca_cuidx >= hdr->sch_numcus)
+            continue;
+
+        struct cu_arange *ar =
+            &dwarfinfo->di_cuaranges[dwarfinfo->di_numcuaranges++];
+
+        ar->ar_lopc = scaranges[i].sca_lopc;
+        ar->ar_hipc = scaranges[i].sca_hipc;
+        ar->ar_cu = dwarfinfo->di_cus[scaranges[i].sca_cuidx];
+    }
+
+    dwarfinfo->di_symcachecomplete = hdr->sch_haslinetables;
+
+    if(!hdr->sch_haslinetables)
+        return 0;
+
+    char **files = NULL;
+    uint32_t filescapacity = 0;
+
+    for(uint32_t i=0; i<hdr->sch_numcus; i++){
+        struct symcache_cu *scc = &sccus[i];
+        uint32_t *fileoffs = (uint32_t *)(base + scc->scc_filesoff);
+
+        if(scc->scc_numfiles > filescapacity){
+            filescapacity = scc->scc_numfiles;
+            char **files_rea = realloc(files, sizeof(char *) * filescapacity);
+            files = files_rea;
+        }
+
+        for(uint32_t j=0; j<scc->scc_numfiles; j++)
+            files[j] = (char *)get_str(sc, fileoffs[j]);
+
+        void *lt = lt_from_raw_rows(base + scc->scc_rowsoff,
+                scc->scc_numrows, files, scc->scc_numfiles);
+
+        void *root_die = NULL;
+        cu_get_root_die_no_tree(dwarfinfo->di_cus[i], &root_die, NULL);
+
+        if(die_set_linetable(root_die, lt, NULL))
+            lt_free(lt);
+    }
+
+    free(files);
+
+    return 0;
+}
+
+void symcache_free(struct symcache *sc){
+    if(!sc)
+        return;
+
+    munmap(sc->sc_map, sc->sc_mapsize);
+    free(sc);
+}
+
+/* Returns NULL if there's no usable cache for dwarfinfo's DWARF file.
+ * Otherwise, the compilation units, the address range index, and every
+ * line table if it had them are already loaded from it, and the cache
+ * must outlive them. dwarfinfo must not have any compilation units yet.
+ */
+struct symcache *symcache_load(dwarfinfo_t *dwarfinfo){
+    struct symcache_header key = {0};
+
+    if(get_cache_key(dwarfinfo, &key))
+        return NULL;
+
+    char *path = get_cache_path(&key);
+
+    if(!path)
+        return NULL;
+
+    int fd = open(path, O_RDONLY);
+
+    free(path);
+
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+
+    if(fstat(fd, &st) || st.st_size < sizeof(struct symcache_header)){
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if(map == MAP_FAILED)
+        return NULL;
+
+    struct symcache *sc = calloc(1, sizeof(struct symcache));
+    sc->sc_map = map;
+    sc->sc_mapsize = st.st_size;
+
+    if(!is_cache_valid(sc, &key) || use_cache(dwarfinfo, sc)){
+        symcache_free(sc);
+        return NULL;
+    }
+
+    return sc;
+}
+
+/* With withlinetables, this decodes every line table that hasn't been
+ * yet, so it's slow. The address range index has to be built already.
+ * di_lock has to be held.
+ */
+int symcache_save(dwarfinfo_t *dwarfinfo, int withlinetables){
+    struct symcache_header hdr = {0};
+
+    if(get_cache_key(dwarfinfo, &hdr))
+        return 1;
+
+    char *path = get_cache_path(&hdr);
+
+    if(!path)
+        return 1;
+
+    int numcus = dwarfinfo->di_numcompunits;
+
+    struct scbuf sb = {0}, strs = {0};
+
+    scbuf_append(&sb, NULL, sizeof(struct symcache_header));
+
+    hdr.sch_numcus = numcus;
+    hdr.sch_haslinetables = withlinetables;
+    hdr.sch_cusoff = scbuf_append(&sb, NULL,
+            sizeof(struct symcache_cu) * numcus);
+
+    /* Compilation unit -> its index + 1, for the address ranges */
+    struct hashtable *cuidxs = hashtable_new();
+
+    for(int i=0; i<numcus; i++){
+        void *cu = dwarfinfo->di_cus[i];
+        struct symcache_cu scc = {0};
+
+        hashtable_insert(cuidxs, (unsigned long)cu, (void *)(long)(i + 1));
+
+        struct cusummary cs = {0};
+        cu_get_summary(cu, &cs, NULL);
+
+        scc.scc_headerlen = cs.cs_headerlen;
+        scc.scc_abbrevoffset = cs.cs_abbrevoffset;
+        scc.scc_nextheaderoffset = cs.cs_nextheaderoffset;
+        scc.scc_rootdieoffset = cs.cs_rootdieoffset;
+        scc.scc_lowpc = cs.cs_lowpc;
+        scc.scc_highpc = cs.cs_highpc;
+        scc.scc_addrsize = cs.cs_addrsize;
+        scc.scc_tag = cs.cs_tag;
+        scc.scc_haschildren = cs.cs_haschildren;
+        scc.scc_name = SYMCACHE_NO_STR;
+
+        if(cs.cs_name){
+            scc.scc_name = scbuf_append(&strs, cs.cs_name,
+                    strlen(cs.cs_name) + 1);
+        }
+
+        void *root_die = NULL, *lt = NULL;
+        cu_get_root_die_no_tree(cu, &root_die, NULL);
+
+        if(withlinetables && die_get_linetable(cu_get_dwarf_debug(dwarfinfo),
+                    root_die, &lt, NULL) == 0){
+            const void *rows = NULL;
+            int numrows = 0;
+            char **files = NULL;
+            int numfiles = 0;
+
+            lt_get_raw_rows(lt, &rows, &numrows);
+            lt_get_files(lt, &files, &numfiles);
+
+            scc.scc_numrows = numrows;
+            scc.scc_rowsoff = scbuf_append(&sb, rows,
+                    (uint64_t)numrows * hdr.sch_linerowsz);
+
+            uint32_t *fileoffs = malloc(sizeof(uint32_t) *
+                    (numfiles ? numfiles : 1));
+
+            for(int j=0; j<numfiles; j++){
+                if(!files[j]){
+                    fileoffs[j] = SYMCACHE_NO_STR;
+                    continue;
+                }
+
+                /* Only names go in here, so 32 bits is plenty */
+                fileoffs[j] = scbuf_append(&strs, files[j],
+                        strlen(files[j]) + 1);
+            }
+
+            scc.scc_numfiles = numfiles;
+            scc.scc_filesoff = scbuf_append(&sb, fileoffs,
+                    sizeof(uint32_t) * numfiles);
+
+            free(fileoffs);
+        }
+
+        memcpy(sb.sb_data + hdr.sch_cusoff + sizeof(scc) * i, &scc,
+                sizeof(scc));
+    }
+
+    hdr.sch_numaranges = dwarfinfo->di_numcuaranges;
+    hdr.sch_arangesoff = scbuf_append(&sb, NULL,
+            sizeof(struct symcache_arange) * hdr.sch_numaranges);
+
+    for(int i=0; i<dwarfinfo->di_numcuaranges; i++){
+        struct cu_arange *ar = &dwarfinfo->di_cuaranges[i];
+        struct symcache_arange sca = {0};
+        void *idx = NULL;
+
+        hashtable_get(cuidxs, (unsigned long)ar->ar_cu, &idx);
+
+        sca.sca_lopc = ar->ar_lopc;
+        sca.sca_hipc = ar->ar_hipc;
+        sca.sca_cuidx = (uint32_t)((long)idx - 1);
+
+        memcpy(sb.sb_data + hdr.sch_arangesoff + sizeof(sca) * i, &sca,
+                sizeof(sca));
+    }
+
+    hashtable_destroy(&cuidxs);
+
+    hdr.sch_strssize = strs.sb_len;
+    hdr.sch_strsoff = scbuf_append(&sb, strs.sb_data, strs.sb_len);
+
+    memcpy(sb.sb_data, &hdr, sizeof(hdr));
+
+    free(strs.sb_data);
+
+    /* Write somewhere else first so a half written cache is never
+     * picked up.
+     */
+    char *tmppath = NULL;
+    concat(&tmppath, "%s.%d", path, getpid());
+
+    int ret = 1;
+    FILE *fp = fopen(tmppath, "wb");
+
+    if(fp){
+        int ok = fwrite(sb.sb_data, 1, sb.sb_len, fp) == sb.sb_len;
+
+        if(fclose(fp) == 0 && ok && rename(tmppath, path) == 0)
+            ret = 0;
+        else
+            unlink(tmppath);
+    }
+
+    free(tmppath);
+    free(path);
+    free(sb.sb_data);
+
+    if(ret == 0 && withlinetables)
+        dwarfinfo->di_symcachecomplete = 1;
+
+    return ret;
+}
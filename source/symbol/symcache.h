@@ -0,0 +1,8 @@
+#ifndef _SYMCACHE_H_
+#define _SYMCACHE_H_
+
+void symcache_free(void *);
+void *symcache_load(void *);
+int symcache_save(void *, int);
+
+#endif
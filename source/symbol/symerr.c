@@ -19,7 +19,10 @@ static const char *const SYM_ERROR_TABLE[] = {
     "No error (0)",
     "dwarf_init failed (1 - sym error)",
     "dwarf_siblingof_b failed (2 - sym error)",
-    "dwarf_srclines failed (3 - sym error)"
+    "dwarf_srclines failed (3 - sym error)",
+    "dwarf_offdie_b failed (4 - sym error)",
+    "Section not found (5 - sym error)",
+    "No UUID in file (6 - sym error)"
 };
 
 static const char *const CU_ERROR_TABLE[] = {
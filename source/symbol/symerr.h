@@ -27,7 +27,10 @@ enum {
     SYM_NO_ERROR = 0,
     SYM_DWARF_INIT_FAILED,
     SYM_DWARF_SIBLING_OF_B_FAILED,
-    SYM_DWARF_SRCLINES_FAILED
+    SYM_DWARF_SRCLINES_FAILED,
+    SYM_DWARF_OFFDIE_B_FAILED,
+    SYM_SECTION_NOT_FOUND,
+    SYM_NO_UUID
 };
 
 enum {
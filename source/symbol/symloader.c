@@ -0,0 +1,175 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dwarfreg.h"
+#include "image.h"
+#include "symloader.h"
+
+#include "../dbgio.h"
+
+/* Everything slow about symbols happens on one thread, so attach and
+ * 'symbols add' give the prompt back right away. Whatever it builds
+ * isn't visible until it's finished. Until then, anything that needs
+ * the symbol tables shows raw addresses, and anything that needs one
+ * image's DWARF waits for just that image.
+ */
+static pthread_mutex_t LOADER_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t LOADER_COND = PTHREAD_COND_INITIALIZER;
+
+static pthread_t LOADER;
+static int LOADER_RUNNING = 0;
+static int LOADER_JOINABLE = 0;
+static int STOP = 0;
+
+/* SL_* work that hasn't been started, and the one being done now */
+static int PENDING = 0;
+static int CURRENT = 0;
+
+static int DONE = 0, TOTAL = 0;
+
+static int report_progress(int done, int total){
+    pthread_mutex_lock(&LOADER_LOCK);
+
+    DONE = done;
+    TOTAL = total;
+
+    int stop = STOP;
+
+    pthread_mutex_unlock(&LOADER_LOCK);
+
+    return stop;
+}
+
+static void *loader(void *arg){
+    pthread_setname_np("iosdbg symbol loader");
+
+    static const int order[] = {
+        SL_REGISTRY, SL_SYMBOLS, SL_DWARF, SL_TREES
+    };
+
+    pthread_mutex_lock(&LOADER_LOCK);
+
+    while(PENDING && !STOP){
+        int work = 0;
+
+        for(int i=0; i<sizeof(order) / sizeof(*order) && !work; i++){
+            if(PENDING & order[i])
+                work = order[i];
+        }
+
+        PENDING &= ~work;
+        CURRENT = work;
+        DONE = TOTAL = 0;
+
+        pthread_mutex_unlock(&LOADER_LOCK);
+
+        if(work == SL_REGISTRY)
+            dwarfreg_build();
+        else if(work == SL_SYMBOLS)
+            initialize_debuggee_symbols(report_progress);
+        else if(work == SL_DWARF)
+            dwarfreg_load_wanted(report_progress);
+        else if(work == SL_TREES)
+            dwarfreg_build_die_trees(report_progress);
+
+        pthread_mutex_lock(&LOADER_LOCK);
+
+        CURRENT = 0;
+        pthread_cond_broadcast(&LOADER_COND);
+    }
+
+    PENDING = 0;
+    LOADER_RUNNING = 0;
+    pthread_cond_broadcast(&LOADER_COND);
+
+    pthread_mutex_unlock(&LOADER_LOCK);
+
+    return NULL;
+}
+
+/* If the loader is busy, writes what it's doing to buf and returns
+ * non-zero. For the prompt.
+ */
+int symloader_get_progress(char *buf, size_t len){
+    pthread_mutex_lock(&LOADER_LOCK);
+
+    int busy = LOADER_RUNNING && (CURRENT || PENDING);
+
+    if(busy){
+        if(CURRENT == SL_REGISTRY || (!CURRENT && (PENDING & SL_REGISTRY)))
+            snprintf(buf, len, "finding dSYMs");
+        else if(CURRENT == SL_SYMBOLS)
+            snprintf(buf, len, "symbols %d/%d", DONE, TOTAL);
+        else if(CURRENT == SL_DWARF)
+            snprintf(buf, len, "DWARF %d/%d", DONE, TOTAL);
+        else if(CURRENT == SL_TREES)
+            snprintf(buf, len, "DIE trees %d/%d", DONE, TOTAL);
+        else
+            snprintf(buf, len, "symbols");
+    }
+
+    pthread_mutex_unlock(&LOADER_LOCK);
+
+    return busy;
+}
+
+/* Queues work, a mask of SL_*, and starts the loader if it isn't
+ * running already.
+ */
+void symloader_start(int work){
+    pthread_mutex_lock(&LOADER_LOCK);
+
+    PENDING |= work;
+
+    if(LOADER_RUNNING){
+        pthread_mutex_unlock(&LOADER_LOCK);
+        return;
+    }
+
+    /* The last one is finished, it doesn't need the lock anymore */
+    if(LOADER_JOINABLE)
+        pthread_join(LOADER, NULL);
+
+    STOP = 0;
+    LOADER_RUNNING = 1;
+    LOADER_JOINABLE = 1;
+
+    if(pthread_create(&LOADER, NULL, loader, NULL)){
+        io_append("warning: couldn't start the symbol loader thread\n");
+        PENDING = 0;
+        LOADER_RUNNING = 0;
+        LOADER_JOINABLE = 0;
+    }
+
+    pthread_mutex_unlock(&LOADER_LOCK);
+}
+
+/* Drops whatever work hasn't started and waits for the loader to get
+ * to a point where it can stop.
+ */
+void symloader_stop(void){
+    pthread_mutex_lock(&LOADER_LOCK);
+
+    STOP = 1;
+    PENDING = 0;
+
+    int joinable = LOADER_JOINABLE;
+    LOADER_JOINABLE = 0;
+
+    pthread_mutex_unlock(&LOADER_LOCK);
+
+    if(joinable)
+        pthread_join(LOADER, NULL);
+}
+
+/* Waits until none of work, a mask of SL_*, is queued or being done */
+void symloader_wait(int work){
+    pthread_mutex_lock(&LOADER_LOCK);
+
+    while(LOADER_RUNNING && ((PENDING | CURRENT) & work))
+        pthread_cond_wait(&LOADER_COND, &LOADER_LOCK);
+
+    pthread_mutex_unlock(&LOADER_LOCK);
+}
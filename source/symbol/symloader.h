@@ -0,0 +1,16 @@
+#ifndef _SYMLOADER_H_
+#define _SYMLOADER_H_
+
+#include <stddef.h>
+
+/* What symloader_start should do, in this order */
+enum {
+    SL_REGISTRY = 1, SL_SYMBOLS = 2, SL_DWARF = 4, SL_TREES = 8
+};
+
+int symloader_get_progress(char *, size_t);
+void symloader_start(int);
+void symloader_stop(void);
+void symloader_wait(int);
+
+#endif
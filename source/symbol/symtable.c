@@ -0,0 +1,180 @@
+#include <stdlib.h>
+
+#include "dbgsymbol.h"
+#include "symtable.h"
+
+#include "../linkedlist.h"
+
+/* Every symbol of every image, in one array sorted by address, so
+ * finding the symbol an address is in is one binary search instead of
+ * one per image. Built once all the images are loaded and never
+ * changed after that.
+ */
+struct symaddr {
+    unsigned long sa_start;
+    /* Index into st_images */
+    unsigned int sa_image;
+    /* Index into that image's symbols, which has its length and name */
+    unsigned int sa_sym;
+};
+
+struct symtable {
+    struct symaddr *st_addrs;
+    unsigned long st_numaddrs;
+
+    struct dbg_sym_entry **st_images;
+    int st_numimages;
+};
+
+static int imagecmp(const void *a, const void *b){
+    struct dbg_sym_entry *ea = *(struct dbg_sym_entry **)a;
+    struct dbg_sym_entry *eb = *(struct dbg_sym_entry **)b;
+
+    unsigned long sa = ea->load_addr + ea->sym_starts[0];
+    unsigned long sb = eb->load_addr + eb->sym_starts[0];
+
+    return (sa > sb) - (sa < sb);
+}
+
+static int symaddrcmp(const void *a, const void *b){
+    const struct symaddr *sa = a;
+    const struct symaddr *sb = b;
+
+    if(sa->sa_start != sb->sa_start)
+        return sa->sa_start < sb->sa_start ? -1 : 1;
+
+    return (sa->sa_image > sb->sa_image) - (sa->sa_image < sb->sa_image);
+}
+
+/* Images' symbols are already sorted, and images almost never overlap.
+ * Laying the images out by their first symbol is then enough, and
+ * everything only has to be sorted again if some of them do overlap.
+ */
+struct symtable *symtable_build(struct linkedlist *symbols){
+    struct symtable *st = calloc(1, sizeof(struct symtable));
+
+    if(!symbols)
+        return st;
+
+    int numimages = 0;
+
+    for(struct node *current = symbols->front;
+            current;
+            current = current->next){
+        struct dbg_sym_entry *entry = current->data;
+
+        if(entry->numsyms > 0){
+            numimages++;
+            st->st_numaddrs += entry->numsyms;
+        }
+    }
+
+    st->st_images = malloc(numimages * sizeof(struct dbg_sym_entry *));
+
+    for(struct node *current = symbols->front;
+            current;
+            current = current->next){
+        struct dbg_sym_entry *entry = current->data;
+
+        if(entry->numsyms > 0)
+            st->st_images[st->st_numimages++] = entry;
+    }
+
+    qsort(st->st_images, st->st_numimages, sizeof(struct dbg_sym_entry *),
+            imagecmp);
+
+    st->st_addrs = malloc(st->st_numaddrs * sizeof(struct symaddr));
+
+    unsigned long n = 0;
+    int sorted = 1;
+
+    for(int i=0; i<st->st_numimages; i++){
+        struct dbg_sym_entry *entry = st->st_images[i];
+
+        for(unsigned int j=0; j<entry->numsyms; j++){
+            struct symaddr *sa = &st->st_addrs[n];
+
+            sa->sa_start = entry->load_addr + entry->sym_starts[j];
+            sa->sa_image = i;
+            sa->sa_sym = j;
+
+            if(n > 0 && sa->sa_start < st->st_addrs[n - 1].sa_start)
+                sorted = 0;
+
+            n++;
+        }
+    }
+
+    if(!sorted){
+        qsort(st->st_addrs, st->st_numaddrs, sizeof(struct symaddr),
+                symaddrcmp);
+    }
+
+    return st;
+}
+
+void symtable_free(struct symtable *st){
+    if(!st)
+        return;
+
+    free(st->st_addrs);
+    free(st->st_images);
+    free(st);
+}
+
+/* How many symbols st holds and how much memory it takes up */
+void symtable_get_usage(struct symtable *st, unsigned long *numsymsout,
+        size_t *bytesout){
+    if(numsymsout)
+        *numsymsout = st ? st->st_numaddrs : 0;
+
+    if(bytesout){
+        *bytesout = 0;
+
+        if(st){
+            *bytesout = sizeof(struct symtable) +
+                (st->st_numaddrs * sizeof(struct symaddr)) +
+                (st->st_numimages * sizeof(struct dbg_sym_entry *));
+        }
+    }
+}
+
+/* Finds the closest symbol starting at or before addr, and gives back
+ * its image and its index in that image. Where more than one image has
+ * a symbol there, the one that comes first wins. Returns non-zero if
+ * there's nothing before addr.
+ */
+int symtable_lookup(struct symtable *st, unsigned long addr,
+        struct dbg_sym_entry **entryout, unsigned int *symout){
+    if(!st || st->st_numaddrs == 0 || addr < st->st_addrs[0].sa_start)
+        return 1;
+
+    unsigned long lo = 0, hi = st->st_numaddrs;
+
+    /* The first symbol starting after addr */
+    while(lo < hi){
+        unsigned long mid = lo + ((hi - lo) / 2);
+
+        if(st->st_addrs[mid].sa_start <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    unsigned long found = lo - 1;
+
+    while(found > 0 &&
+            st->st_addrs[found - 1].sa_start == st->st_addrs[found].sa_start){
+        found--;
+    }
+
+    struct symaddr *sa = &st->st_addrs[found];
+
+    if(entryout)
+        *entryout = st->st_images[sa->sa_image];
+
+    if(symout)
+        *symout = sa->sa_sym;
+
+    return 0;
+}
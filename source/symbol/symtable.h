@@ -0,0 +1,16 @@
+#ifndef _SYMTABLE_H_
+#define _SYMTABLE_H_
+
+#include <stddef.h>
+
+struct dbg_sym_entry;
+struct linkedlist;
+struct symtable;
+
+struct symtable *symtable_build(struct linkedlist *);
+void symtable_free(struct symtable *);
+void symtable_get_usage(struct symtable *, unsigned long *, size_t *);
+int symtable_lookup(struct symtable *, unsigned long,
+        struct dbg_sym_entry **, unsigned int *);
+
+#endif
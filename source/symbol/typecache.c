@@ -0,0 +1,122 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../hashtable.h"
+
+#include "arena.h"
+
+/* Resolved data type layouts, keyed by the offset of the type DIE they
+ * were resolved from. The same few types are used by thousands of
+ * variables across a DWARF file, so each one is only resolved the
+ * first time a variable of that type is seen, see
+ * get_die_data_type_info. Layouts live as long as the dwarfinfo, not
+ * as long as the DIE trees that use them.
+ *
+ * DIE trees are built on more than one thread, so this is locked.
+ */
+
+struct typecache {
+    pthread_mutex_t tc_lock;
+
+    /* Type DIE offset -> layout */
+    struct hashtable *tc_layouts;
+
+    /* Holds the layouts and everything they point to */
+    void *tc_arena;
+
+    uint64_t tc_numlayouts;
+
+    /* How many times a layout was reused instead of resolved again */
+    uint64_t tc_hits;
+};
+
+/* Memory for a layout that's about to be added with typecache_insert */
+void *typecache_alloc(struct typecache *tc, size_t sz){
+    pthread_mutex_lock(&tc->tc_lock);
+
+    void *mem = arena_alloc(tc->tc_arena, sz);
+
+    pthread_mutex_unlock(&tc->tc_lock);
+
+    return mem;
+}
+
+/* Returns the layout resolved from the type DIE at offset, or NULL if
+ * there isn't one yet.
+ */
+void *typecache_find(struct typecache *tc, uint64_t offset){
+    void *layout = NULL;
+
+    pthread_mutex_lock(&tc->tc_lock);
+
+    if(hashtable_get(tc->tc_layouts, offset, &layout) == 0)
+        tc->tc_hits++;
+
+    pthread_mutex_unlock(&tc->tc_lock);
+
+    return layout;
+}
+
+void typecache_free(struct typecache *tc){
+    if(!tc)
+        return;
+
+    arena_free(tc->tc_arena);
+    hashtable_destroy(&tc->tc_layouts);
+    pthread_mutex_destroy(&tc->tc_lock);
+
+    free(tc);
+}
+
+void typecache_get_usage(struct typecache *tc, uint64_t *numlayoutsout,
+        uint64_t *bytesusedout, uint64_t *hitsout){
+    if(!tc)
+        return;
+
+    pthread_mutex_lock(&tc->tc_lock);
+
+    if(numlayoutsout)
+        *numlayoutsout = tc->tc_numlayouts;
+
+    if(bytesusedout){
+        *bytesusedout = arena_get_size(tc->tc_arena) +
+            tc->tc_layouts->capacity * sizeof(struct hashtable_entry);
+    }
+
+    if(hitsout)
+        *hitsout = tc->tc_hits;
+
+    pthread_mutex_unlock(&tc->tc_lock);
+}
+
+/* Add a layout from typecache_alloc. If another thread resolved the
+ * same type first, theirs is returned and this one is left unused.
+ */
+void *typecache_insert(struct typecache *tc, uint64_t offset,
+        void *layout){
+    void *existing = NULL;
+
+    pthread_mutex_lock(&tc->tc_lock);
+
+    if(hashtable_get(tc->tc_layouts, offset, &existing)){
+        hashtable_insert(tc->tc_layouts, offset, layout);
+        tc->tc_numlayouts++;
+        existing = layout;
+    }
+
+    pthread_mutex_unlock(&tc->tc_lock);
+
+    return existing;
+}
+
+struct typecache *typecache_new(void){
+    struct typecache *tc = calloc(1, sizeof(struct typecache));
+
+    pthread_mutex_init(&tc->tc_lock, NULL);
+
+    tc->tc_layouts = hashtable_new();
+    tc->tc_arena = arena_new();
+
+    return tc;
+}
@@ -0,0 +1,11 @@
+#ifndef _TYPECACHE_H_
+#define _TYPECACHE_H_
+
+void *typecache_alloc(void *, size_t);
+void *typecache_find(void *, uint64_t);
+void typecache_free(void *);
+void typecache_get_usage(void *, uint64_t *, uint64_t *, uint64_t *);
+void *typecache_insert(void *, uint64_t, void *);
+void *typecache_new(void);
+
+#endif
@@ -0,0 +1,1852 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../hashtable.h"
+
+#include "unwind.h"
+
+/* Unwinds arm64 stacks with __unwind_info compact unwind, falling back
+ * to .eh_frame and then .debug_frame CFI, and then to the frame pointer
+ * chain. Nothing in here touches the debuggee: memory comes from the
+ * unwctx and sections from whoever called unw_add_image, so this can
+ * be run against a saved snapshot anywhere.
+ *
+ * Whatever the source, a function's unwind info is turned into a plan:
+ * a table of rows, each saying where the CFA is and where every
+ * register was saved from some pc onwards. Plans are kept by function
+ * start, and every pc that has been looked up is kept too, so going
+ * through the same functions again is one hash lookup per frame.
+ */
+
+/* DW_CFA_*, spelled out here so this builds without libdwarf */
+enum {
+    CFA_advance_loc             = 0x40,
+    CFA_offset                  = 0x80,
+    CFA_restore                 = 0xc0,
+    CFA_nop                     = 0x00,
+    CFA_set_loc                 = 0x01,
+    CFA_advance_loc1            = 0x02,
+    CFA_advance_loc2            = 0x03,
+    CFA_advance_loc4            = 0x04,
+    CFA_offset_extended         = 0x05,
+    CFA_restore_extended        = 0x06,
+    CFA_undefined               = 0x07,
+    CFA_same_value              = 0x08,
+    CFA_register                = 0x09,
+    CFA_remember_state          = 0x0a,
+    CFA_restore_state           = 0x0b,
+    CFA_def_cfa                 = 0x0c,
+    CFA_def_cfa_register        = 0x0d,
+    CFA_def_cfa_offset          = 0x0e,
+    CFA_def_cfa_expression      = 0x0f,
+    CFA_expression              = 0x10,
+    CFA_offset_extended_sf      = 0x11,
+    CFA_def_cfa_sf              = 0x12,
+    CFA_def_cfa_offset_sf       = 0x13,
+    CFA_val_offset              = 0x14,
+    CFA_val_offset_sf           = 0x15,
+    CFA_val_expression          = 0x16,
+    CFA_AARCH64_negate_ra_state = 0x2d,
+    CFA_GNU_args_size           = 0x2e,
+    CFA_GNU_negative_offset_ext = 0x2f
+};
+
+/* DW_EH_PE_* */
+enum {
+    PE_absptr   = 0x00,
+    PE_uleb128  = 0x01,
+    PE_udata2   = 0x02,
+    PE_udata4   = 0x03,
+    PE_udata8   = 0x04,
+    PE_sleb128  = 0x09,
+    PE_sdata2   = 0x0a,
+    PE_sdata4   = 0x0b,
+    PE_sdata8   = 0x0c,
+    PE_pcrel    = 0x10,
+    PE_indirect = 0x80,
+    PE_omit     = 0xff
+};
+
+/* From <mach-o/compact_unwind_encoding.h> */
+#define UNWIND_SECOND_LEVEL_REGULAR         (2)
+#define UNWIND_SECOND_LEVEL_COMPRESSED      (3)
+#define UNWIND_ARM64_MODE_MASK              (0x0f000000)
+#define UNWIND_ARM64_MODE_FRAMELESS         (0x02000000)
+#define UNWIND_ARM64_MODE_DWARF             (0x03000000)
+#define UNWIND_ARM64_MODE_FRAME             (0x04000000)
+#define UNWIND_ARM64_FRAME_X19_X20_PAIR     (0x00000001)
+#define UNWIND_ARM64_FRAMELESS_STACK_SIZE   (0x00fff000)
+#define UNWIND_ARM64_DWARF_SECTION_OFFSET   (0x00ffffff)
+
+enum {
+    RULE_SAME = 0, RULE_UNDEF, RULE_OFFSET, RULE_VALOFFSET, RULE_REG
+};
+
+struct unwrule {
+    uint8_t rl_how;
+    int32_t rl_off;
+};
+
+/* From rw_lopc until the next row, the CFA is rw_cfareg + rw_cfaoff
+ * and every register is wherever its rule says.
+ */
+struct unwrow {
+    uint64_t rw_lopc;
+    uint8_t rw_cfareg;
+    int32_t rw_cfaoff;
+    struct unwrule rw_rules[UNW_NUMREGS];
+
+    /* Worked out by finish_plan so a step only has to look at the
+     * registers which changed: a bit for every register with
+     * RULE_SAME, one for every register with RULE_OFFSET, and one for
+     * every register with any other rule except RULE_UNDEF. What was
+     * saved is between rw_savedlo and rw_savedhi + 8 from the CFA.
+     */
+    uint32_t rw_samemask;
+    uint32_t rw_offsetmask;
+    uint32_t rw_othermask;
+    int32_t rw_savedlo;
+    int32_t rw_savedhi;
+};
+
+/* Rows are sorted by rw_lopc. Addresses are slid. */
+struct unwplan {
+    uint64_t up_lopc;
+    uint64_t up_hipc;
+    /* From a compact unwind FRAME encoding, see frame_record_missing */
+    int up_compactframe;
+    int up_numrows;
+    struct unwrow up_rows[];
+};
+
+struct fdeent {
+    uint64_t fe_lopc;
+    uint64_t fe_hipc;
+    uint64_t fe_offset;
+};
+
+struct cfisect {
+    const uint8_t *cs_data;
+    uint64_t cs_size;
+    /* where cs_data is in the image, for pc relative pointers */
+    uint64_t cs_addr;
+    int cs_iseh;
+
+    /* Only built if a function isn't in __unwind_info */
+    int cs_indexed;
+    int cs_numfdes;
+    struct fdeent *cs_fdes;
+};
+
+struct unwimage {
+    struct unwsects ui_sects;
+    struct cfisect ui_ehframe;
+    struct cfisect ui_debugframe;
+};
+
+struct unwinder {
+    /* sorted by slid us_textlo */
+    struct unwimage **uw_images;
+    int uw_numimages;
+
+    /* slid function start -> struct unwplan */
+    struct hashtable *uw_plans;
+
+    /* every pc that's been unwound from -> struct unwplan */
+    struct hashtable *uw_pcs;
+
+    unsigned long uw_hits;
+    unsigned long uw_misses;
+};
+
+/* For pcs with no unwind info at all: follow the frame pointer */
+static struct unwplan *FPPLAN;
+
+static void init_row(struct unwrow *rw, uint64_t lopc, int cfareg,
+        int32_t cfaoff){
+    rw->rw_lopc = lopc;
+    rw->rw_cfareg = cfareg;
+    rw->rw_cfaoff = cfaoff;
+
+    /* x0-x18 are caller saved, x19-x30 are the callee's to preserve */
+    for(int i=0; i<UNW_NUMREGS; i++){
+        rw->rw_rules[i].rl_how = i < 19 ? RULE_UNDEF : RULE_SAME;
+        rw->rw_rules[i].rl_off = 0;
+    }
+}
+
+static void set_rule(struct unwrow *rw, uint64_t reg, int how, int64_t off){
+    /* Only the general purpose registers are tracked */
+    if(reg >= UNW_NUMREGS)
+        return;
+
+    rw->rw_rules[reg].rl_how = how;
+    rw->rw_rules[reg].rl_off = (int32_t)off;
+}
+
+static struct unwplan *plan_new(uint64_t lopc, uint64_t hipc, int numrows){
+    struct unwplan *plan = malloc(sizeof(struct unwplan) +
+            (sizeof(struct unwrow) * numrows));
+
+    plan->up_lopc = lopc;
+    plan->up_hipc = hipc;
+    plan->up_compactframe = 0;
+    plan->up_numrows = numrows;
+
+    return plan;
+}
+
+static void finish_row(struct unwrow *rw){
+    rw->rw_samemask = rw->rw_offsetmask = rw->rw_othermask = 0;
+    rw->rw_savedlo = INT32_MAX;
+    rw->rw_savedhi = INT32_MIN;
+
+    for(int r=0; r<UNW_NUMREGS; r++){
+        const struct unwrule *rl = &rw->rw_rules[r];
+
+        if(rl->rl_how == RULE_SAME)
+            rw->rw_samemask |= 1u << r;
+        else if(rl->rl_how == RULE_OFFSET){
+            rw->rw_offsetmask |= 1u << r;
+
+            if(rl->rl_off < rw->rw_savedlo)
+                rw->rw_savedlo = rl->rl_off;
+
+            if(rl->rl_off > rw->rw_savedhi)
+                rw->rw_savedhi = rl->rl_off;
+        }
+        else if(rl->rl_how != RULE_UNDEF)
+            rw->rw_othermask |= 1u << r;
+    }
+}
+
+static struct unwplan *finish_plan(struct unwplan *plan){
+    for(int i=0; i<plan->up_numrows; i++)
+        finish_row(&plan->up_rows[i]);
+
+    return plan;
+}
+
+static struct unwplan *fp_plan(void){
+    if(FPPLAN)
+        return FPPLAN;
+
+    struct unwplan *plan = plan_new(0, UINT64_MAX, 1);
+    struct unwrow *rw = &plan->up_rows[0];
+
+    init_row(rw, 0, UNW_FP, 16);
+    set_rule(rw, UNW_FP, RULE_OFFSET, -16);
+    set_rule(rw, UNW_LR, RULE_OFFSET, -8);
+
+    FPPLAN = finish_plan(plan);
+
+    return FPPLAN;
+}
+
+static int read_bytes(const uint8_t **p, const uint8_t *end, void *out,
+        size_t len){
+    if(*p > end || (size_t)(end - *p) < len)
+        return 1;
+
+    memcpy(out, *p, len);
+    *p += len;
+
+    return 0;
+}
+
+static int read_uleb(const uint8_t **p, const uint8_t *end, uint64_t *out){
+    uint64_t val = 0;
+    unsigned shift = 0;
+
+    while(*p < end){
+        uint8_t byte = *(*p)++;
+
+        if(shift < 64)
+            val |= (uint64_t)(byte & 0x7f) << shift;
+
+        shift += 7;
+
+        if(!(byte & 0x80)){
+            *out = val;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int read_sleb(const uint8_t **p, const uint8_t *end, int64_t *out){
+    uint64_t val = 0;
+    unsigned shift = 0;
+
+    while(*p < end){
+        uint8_t byte = *(*p)++;
+
+        if(shift < 64)
+            val |= (uint64_t)(byte & 0x7f) << shift;
+
+        shift += 7;
+
+        if(!(byte & 0x80)){
+            if(shift < 64 && (byte & 0x40))
+                val |= ~(uint64_t)0 << shift;
+
+            *out = (int64_t)val;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int read_encoded(const uint8_t **p, const uint8_t *end, uint8_t enc,
+        uint64_t fieldaddr, uint64_t *out){
+    uint64_t val = 0;
+    int err = 0;
+
+    switch(enc & 0x0f){
+        case PE_absptr:
+        case PE_udata8:
+        case PE_sdata8:
+            err = read_bytes(p, end, &val, sizeof(uint64_t));
+            break;
+        case PE_uleb128:
+            err = read_uleb(p, end, &val);
+            break;
+        case PE_sleb128:
+            err = read_sleb(p, end, (int64_t *)&val);
+            break;
+        case PE_udata2:
+        {
+            uint16_t v = 0;
+            err = read_bytes(p, end, &v, sizeof(v));
+            val = v;
+            break;
+        }
+        case PE_sdata2:
+        {
+            int16_t v = 0;
+            err = read_bytes(p, end, &v, sizeof(v));
+            val = (uint64_t)(int64_t)v;
+            break;
+        }
+        case PE_udata4:
+        {
+            uint32_t v = 0;
+            err = read_bytes(p, end, &v, sizeof(v));
+            val = v;
+            break;
+        }
+        case PE_sdata4:
+        {
+            int32_t v = 0;
+            err = read_bytes(p, end, &v, sizeof(v));
+            val = (uint64_t)(int64_t)v;
+            break;
+        }
+        default:
+            return 1;
+    }
+
+    if(err)
+        return 1;
+
+    /* Only absolute and pc relative pointers show up in FDE headers */
+    if(enc & PE_indirect)
+        return 1;
+    else if((enc & 0x70) == PE_pcrel)
+        val += fieldaddr;
+    else if(enc & 0x70)
+        return 1;
+
+    *out = val;
+
+    return 0;
+}
+
+struct cie {
+    uint64_t ci_codealign;
+    int64_t ci_dataalign;
+    uint64_t ci_rareg;
+    uint8_t ci_ptrenc;
+    int ci_hasaugdata;
+    const uint8_t *ci_insns;
+    const uint8_t *ci_insnsend;
+};
+
+/* Gives back where the entry at offset starts and ends, and its CIE
+ * ID or pointer, which tells CIEs and FDEs apart.
+ */
+static int read_entry_header(const struct cfisect *cs, uint64_t offset,
+        const uint8_t **bodyout, const uint8_t **endout, uint64_t *idout,
+        uint64_t *idfieldoffout, int *iscieout){
+    const uint8_t *p = cs->cs_data + offset;
+    const uint8_t *end = cs->cs_data + cs->cs_size;
+
+    if(offset >= cs->cs_size)
+        return 1;
+
+    uint32_t len32 = 0;
+
+    if(read_bytes(&p, end, &len32, sizeof(len32)) || len32 == 0)
+        return 1;
+
+    uint64_t len = len32;
+    int is64 = 0;
+
+    if(len32 == 0xffffffff){
+        if(read_bytes(&p, end, &len, sizeof(len)))
+            return 1;
+
+        is64 = 1;
+    }
+
+    if((uint64_t)(end - p) < len)
+        return 1;
+
+    const uint8_t *entryend = p + len;
+
+    *idfieldoffout = p - cs->cs_data;
+
+    /* .eh_frame CIE pointers are always four bytes */
+    if(is64 && !cs->cs_iseh){
+        if(read_bytes(&p, entryend, idout, sizeof(uint64_t)))
+            return 1;
+
+        *iscieout = *idout == UINT64_MAX;
+    }
+    else{
+        uint32_t id32 = 0;
+
+        if(read_bytes(&p, entryend, &id32, sizeof(id32)))
+            return 1;
+
+        *idout = id32;
+        *iscieout = cs->cs_iseh ? id32 == 0 : id32 == 0xffffffff;
+    }
+
+    *bodyout = p;
+    *endout = entryend;
+
+    return 0;
+}
+
+static int parse_cie(const struct cfisect *cs, uint64_t offset,
+        struct cie *cie){
+    const uint8_t *p = NULL, *end = NULL;
+    uint64_t id = 0, idfieldoff = 0;
+    int iscie = 0;
+
+    if(read_entry_header(cs, offset, &p, &end, &id, &idfieldoff, &iscie) ||
+            !iscie){
+        return 1;
+    }
+
+    memset(cie, 0, sizeof(*cie));
+    cie->ci_ptrenc = PE_absptr;
+
+    uint8_t version = 0;
+
+    if(read_bytes(&p, end, &version, sizeof(version)))
+        return 1;
+
+    const char *aug = (const char *)p;
+    size_t auglen = strnlen(aug, end - p);
+
+    if(auglen == (size_t)(end - p))
+        return 1;
+
+    p += auglen + 1;
+
+    /* Ancient GCC put the address of its exception table here */
+    if(strstr(aug, "eh"))
+        p += sizeof(uint64_t);
+
+    /* address_size and segment_selector_size */
+    if(version >= 4)
+        p += 2;
+
+    if(read_uleb(&p, end, &cie->ci_codealign) ||
+            read_sleb(&p, end, &cie->ci_dataalign)){
+        return 1;
+    }
+
+    if(version == 1){
+        uint8_t rareg = 0;
+
+        if(read_bytes(&p, end, &rareg, sizeof(rareg)))
+            return 1;
+
+        cie->ci_rareg = rareg;
+    }
+    else if(read_uleb(&p, end, &cie->ci_rareg))
+        return 1;
+
+    if(aug[0] == 'z'){
+        uint64_t augdatalen = 0;
+
+        if(read_uleb(&p, end, &augdatalen) ||
+                (uint64_t)(end - p) < augdatalen){
+            return 1;
+        }
+
+        const uint8_t *augdataend = p + augdatalen;
+
+        for(const char *a = aug + 1; *a; a++){
+            if(*a == 'R'){
+                if(read_bytes(&p, augdataend, &cie->ci_ptrenc, 1))
+                    return 1;
+            }
+            else if(*a == 'P'){
+                uint8_t penc = 0;
+                uint64_t personality = 0;
+
+                /* Only skipping it, so what it's relative to
+                 * doesn't matter.
+                 */
+                if(read_bytes(&p, augdataend, &penc, 1) ||
+                        read_encoded(&p, augdataend, penc & 0x0f, 0,
+                            &personality)){
+                    return 1;
+                }
+            }
+            else if(*a == 'L')
+                p++;
+            else if(*a != 'S' && *a != 'B')
+                break;
+        }
+
+        cie->ci_hasaugdata = 1;
+        p = augdataend;
+    }
+
+    cie->ci_insns = p;
+    cie->ci_insnsend = end;
+
+    return 0;
+}
+
+/* Decodes the FDE at offset, and its CIE. Everything is unslid. */
+static int parse_fde(const struct cfisect *cs, uint64_t offset,
+        struct cie *cie, uint64_t *lopcout, uint64_t *hipcout,
+        const uint8_t **insnsout, const uint8_t **insnsendout){
+    const uint8_t *p = NULL, *end = NULL;
+    uint64_t id = 0, idfieldoff = 0;
+    int iscie = 0;
+
+    if(read_entry_header(cs, offset, &p, &end, &id, &idfieldoff, &iscie) ||
+            iscie){
+        return 1;
+    }
+
+    /* .eh_frame CIE pointers are relative to themselves,
+     * .debug_frame ones are offsets into the section.
+     */
+    uint64_t cieoff = cs->cs_iseh ? idfieldoff - id : id;
+
+    if(cs->cs_iseh && id > idfieldoff)
+        return 1;
+
+    if(parse_cie(cs, cieoff, cie))
+        return 1;
+
+    uint64_t lopc = 0, range = 0;
+    uint64_t fieldaddr = cs->cs_addr + (p - cs->cs_data);
+
+    if(read_encoded(&p, end, cie->ci_ptrenc, fieldaddr, &lopc) ||
+            read_encoded(&p, end, cie->ci_ptrenc & 0x0f, 0, &range)){
+        return 1;
+    }
+
+    if(cie->ci_hasaugdata){
+        uint64_t augdatalen = 0;
+
+        if(read_uleb(&p, end, &augdatalen) ||
+                (uint64_t)(end - p) < augdatalen){
+            return 1;
+        }
+
+        p += augdatalen;
+    }
+
+    *lopcout = lopc;
+    *hipcout = lopc + range;
+    *insnsout = p;
+    *insnsendout = end;
+
+    return 0;
+}
+
+enum { MAX_REMEMBERED_STATES = 8 };
+
+struct cfistate {
+    const struct cie *st_cie;
+
+    /* slid */
+    uint64_t st_loc;
+    uint64_t st_hipc;
+
+    struct unwrow st_row;
+    struct unwrow st_initial;
+
+    struct unwrow st_remembered[MAX_REMEMBERED_STATES];
+    int st_numremembered;
+
+    struct unwrow *st_rows;
+    int st_numrows;
+    int st_caprows;
+};
+
+static void emit_row(struct cfistate *st){
+    st->st_row.rw_lopc = st->st_loc;
+
+    /* Nothing was in effect for the last one */
+    if(st->st_numrows > 0 &&
+            st->st_rows[st->st_numrows - 1].rw_lopc == st->st_loc){
+        st->st_rows[st->st_numrows - 1] = st->st_row;
+        return;
+    }
+
+    if(st->st_numrows == st->st_caprows){
+        st->st_caprows = st->st_caprows ? st->st_caprows * 2 : 8;
+        st->st_rows = realloc(st->st_rows,
+                sizeof(struct unwrow) * st->st_caprows);
+    }
+
+    st->st_rows[st->st_numrows++] = st->st_row;
+}
+
+static void advance(struct cfistate *st, uint64_t delta){
+    emit_row(st);
+    st->st_loc += delta * st->st_cie->ci_codealign;
+}
+
+/* Runs CFA instructions, emitting a row every time the location moves.
+ * Non-zero if one can't be represented, like DW_CFA_def_cfa_expression.
+ */
+static int run_cfa_insns(struct cfistate *st, const uint8_t *p,
+        const uint8_t *end, uint64_t slide){
+    const struct cie *cie = st->st_cie;
+    struct unwrow *rw = &st->st_row;
+
+    while(p < end && st->st_loc < st->st_hipc){
+        uint8_t op = *p++;
+        uint8_t operand = op & 0x3f;
+        uint64_t reg = 0, uoff = 0;
+        int64_t soff = 0;
+
+        switch(op & 0xc0){
+            case CFA_advance_loc:
+                advance(st, operand);
+                continue;
+            case CFA_offset:
+                if(read_uleb(&p, end, &uoff))
+                    return 1;
+
+                set_rule(rw, operand, RULE_OFFSET,
+                        (int64_t)uoff * cie->ci_dataalign);
+                continue;
+            case CFA_restore:
+                if(operand < UNW_NUMREGS)
+                    rw->rw_rules[operand] = st->st_initial.rw_rules[operand];
+
+                continue;
+        }
+
+        switch(op){
+            case CFA_nop:
+            case CFA_AARCH64_negate_ra_state:
+                break;
+            case CFA_set_loc:
+            {
+                uint64_t loc = 0;
+
+                if(read_encoded(&p, end, cie->ci_ptrenc & 0x0f, 0, &loc))
+                    return 1;
+
+                emit_row(st);
+                st->st_loc = loc + slide;
+                break;
+            }
+            case CFA_advance_loc1:
+            {
+                uint8_t delta = 0;
+
+                if(read_bytes(&p, end, &delta, sizeof(delta)))
+                    return 1;
+
+                advance(st, delta);
+                break;
+            }
+            case CFA_advance_loc2:
+            {
+                uint16_t delta = 0;
+
+                if(read_bytes(&p, end, &delta, sizeof(delta)))
+                    return 1;
+
+                advance(st, delta);
+                break;
+            }
+            case CFA_advance_loc4:
+            {
+                uint32_t delta = 0;
+
+                if(read_bytes(&p, end, &delta, sizeof(delta)))
+                    return 1;
+
+                advance(st, delta);
+                break;
+            }
+            case CFA_offset_extended:
+                if(read_uleb(&p, end, &reg) || read_uleb(&p, end, &uoff))
+                    return 1;
+
+                set_rule(rw, reg, RULE_OFFSET,
+                        (int64_t)uoff * cie->ci_dataalign);
+                break;
+            case CFA_offset_extended_sf:
+                if(read_uleb(&p, end, &reg) || read_sleb(&p, end, &soff))
+                    return 1;
+
+                set_rule(rw, reg, RULE_OFFSET, soff * cie->ci_dataalign);
+                break;
+            case CFA_GNU_negative_offset_ext:
+                if(read_uleb(&p, end, &reg) || read_uleb(&p, end, &uoff))
+                    return 1;
+
+                set_rule(rw, reg, RULE_OFFSET,
+                        -(int64_t)uoff * cie->ci_dataalign);
+                break;
+            case CFA_val_offset:
+                if(read_uleb(&p, end, &reg) || read_uleb(&p, end, &uoff))
+                    return 1;
+
+                set_rule(rw, reg, RULE_VALOFFSET,
+                        (int64_t)uoff * cie->ci_dataalign);
+                break;
+            case CFA_val_offset_sf:
+                if(read_uleb(&p, end, &reg) || read_sleb(&p, end, &soff))
+                    return 1;
+
+                set_rule(rw, reg, RULE_VALOFFSET, soff * cie->ci_dataalign);
+                break;
+            case CFA_restore_extended:
+                if(read_uleb(&p, end, &reg))
+                    return 1;
+
+                if(reg < UNW_NUMREGS)
+                    rw->rw_rules[reg] = st->st_initial.rw_rules[reg];
+
+                break;
+            case CFA_undefined:
+                if(read_uleb(&p, end, &reg))
+                    return 1;
+
+                set_rule(rw, reg, RULE_UNDEF, 0);
+                break;
+            case CFA_same_value:
+                if(read_uleb(&p, end, &reg))
+                    return 1;
+
+                set_rule(rw, reg, RULE_SAME, 0);
+                break;
+            case CFA_register:
+            {
+                uint64_t src = 0;
+
+                if(read_uleb(&p, end, &reg) || read_uleb(&p, end, &src))
+                    return 1;
+
+                if(src >= UNW_NUMREGS)
+                    set_rule(rw, reg, RULE_UNDEF, 0);
+                else
+                    set_rule(rw, reg, RULE_REG, src);
+
+                break;
+            }
+            case CFA_remember_state:
+                if(st->st_numremembered == MAX_REMEMBERED_STATES)
+                    return 1;
+
+                st->st_remembered[st->st_numremembered++] = *rw;
+                break;
+            case CFA_restore_state:
+                if(st->st_numremembered == 0)
+                    return 1;
+
+                *rw = st->st_remembered[--st->st_numremembered];
+                break;
+            case CFA_def_cfa:
+                if(read_uleb(&p, end, &reg) || read_uleb(&p, end, &uoff) ||
+                        reg >= UNW_NUMREGS){
+                    return 1;
+                }
+
+                rw->rw_cfareg = reg;
+                rw->rw_cfaoff = (int32_t)uoff;
+                break;
+            case CFA_def_cfa_sf:
+                if(read_uleb(&p, end, &reg) || read_sleb(&p, end, &soff) ||
+                        reg >= UNW_NUMREGS){
+                    return 1;
+                }
+
+                rw->rw_cfareg = reg;
+                rw->rw_cfaoff = (int32_t)(soff * cie->ci_dataalign);
+                break;
+            case CFA_def_cfa_register:
+                if(read_uleb(&p, end, &reg) || reg >= UNW_NUMREGS)
+                    return 1;
+
+                rw->rw_cfareg = reg;
+                break;
+            case CFA_def_cfa_offset:
+                if(read_uleb(&p, end, &uoff))
+                    return 1;
+
+                rw->rw_cfaoff = (int32_t)uoff;
+                break;
+            case CFA_def_cfa_offset_sf:
+                if(read_sleb(&p, end, &soff))
+                    return 1;
+
+                rw->rw_cfaoff = (int32_t)(soff * cie->ci_dataalign);
+                break;
+            case CFA_GNU_args_size:
+                if(read_uleb(&p, end, &uoff))
+                    return 1;
+
+                break;
+            case CFA_expression:
+            case CFA_val_expression:
+            {
+                /* These only matter for the register they describe,
+                 * which is rarely one we unwind with.
+                 */
+                uint64_t len = 0;
+
+                if(read_uleb(&p, end, &reg) || read_uleb(&p, end, &len) ||
+                        (uint64_t)(end - p) < len){
+                    return 1;
+                }
+
+                if(reg == UNW_FP || reg == UNW_LR || reg == UNW_SP)
+                    return 1;
+
+                set_rule(rw, reg, RULE_UNDEF, 0);
+                p += len;
+                break;
+            }
+            case CFA_def_cfa_expression:
+            default:
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Turns the FDE at offset into a plan. */
+static struct unwplan *plan_from_fde(const struct cfisect *cs,
+        uint64_t offset, uint64_t slide){
+    struct cie cie;
+    uint64_t lopc = 0, hipc = 0;
+    const uint8_t *insns = NULL, *insnsend = NULL;
+
+    if(parse_fde(cs, offset, &cie, &lopc, &hipc, &insns, &insnsend))
+        return NULL;
+
+    struct cfistate st;
+    memset(&st, 0, sizeof(st));
+
+    st.st_cie = &cie;
+    st.st_loc = lopc + slide;
+    st.st_hipc = hipc + slide;
+
+    /* The CIE's instructions almost always set this up anyway */
+    init_row(&st.st_row, st.st_loc, UNW_SP, 0);
+
+    if(run_cfa_insns(&st, cie.ci_insns, cie.ci_insnsend, slide)){
+        free(st.st_rows);
+        return NULL;
+    }
+
+    /* The CIE can't advance the location, so anything it emitted is
+     * replaced by the FDE's first row.
+     */
+    st.st_numrows = 0;
+    st.st_loc = lopc + slide;
+    st.st_initial = st.st_row;
+
+    if(run_cfa_insns(&st, insns, insnsend, slide)){
+        free(st.st_rows);
+        return NULL;
+    }
+
+    if(st.st_loc < st.st_hipc)
+        emit_row(&st);
+
+    struct unwplan *plan = plan_new(lopc + slide, hipc + slide,
+            st.st_numrows);
+
+    for(int i=0; i<st.st_numrows; i++){
+        struct unwrow *rw = &plan->up_rows[i];
+
+        *rw = st.st_rows[i];
+
+        /* The return address is what the caller's pc is found from */
+        if(cie.ci_rareg < UNW_NUMREGS && cie.ci_rareg != UNW_LR)
+            rw->rw_rules[UNW_LR] = rw->rw_rules[cie.ci_rareg];
+    }
+
+    free(st.st_rows);
+
+    if(plan->up_numrows == 0){
+        free(plan);
+        return NULL;
+    }
+
+    return finish_plan(plan);
+}
+
+static int fdeentcmp(const void *a, const void *b){
+    const struct fdeent *fa = a;
+    const struct fdeent *fb = b;
+
+    if(fa->fe_lopc < fb->fe_lopc)
+        return -1;
+    else if(fa->fe_lopc > fb->fe_lopc)
+        return 1;
+
+    return 0;
+}
+
+static void index_fdes(struct cfisect *cs){
+    cs->cs_indexed = 1;
+
+    int capfdes = 0;
+    uint64_t offset = 0;
+
+    while(offset < cs->cs_size){
+        const uint8_t *p = NULL, *end = NULL;
+        uint64_t id = 0, idfieldoff = 0;
+        int iscie = 0;
+
+        if(read_entry_header(cs, offset, &p, &end, &id, &idfieldoff,
+                    &iscie)){
+            break;
+        }
+
+        struct cie cie;
+        uint64_t lopc = 0, hipc = 0;
+        const uint8_t *insns = NULL, *insnsend = NULL;
+
+        if(!iscie && parse_fde(cs, offset, &cie, &lopc, &hipc, &insns,
+                    &insnsend) == 0 && lopc < hipc){
+            if(cs->cs_numfdes == capfdes){
+                capfdes = capfdes ? capfdes * 2 : 64;
+                cs->cs_fdes = realloc(cs->cs_fdes,
+                        sizeof(struct fdeent) * capfdes);
+            }
+
+            struct fdeent *fe = &cs->cs_fdes[cs->cs_numfdes++];
+
+            fe->fe_lopc = lopc;
+            fe->fe_hipc = hipc;
+            fe->fe_offset = offset;
+        }
+
+        offset = end - cs->cs_data;
+    }
+
+    qsort(cs->cs_fdes, cs->cs_numfdes, sizeof(struct fdeent), fdeentcmp);
+}
+
+/* upc is unslid */
+static struct fdeent *find_fde(struct cfisect *cs, uint64_t upc){
+    if(!cs->cs_data)
+        return NULL;
+
+    if(!cs->cs_indexed)
+        index_fdes(cs);
+
+    int lo = 0, hi = cs->cs_numfdes - 1;
+    struct fdeent *found = NULL;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(cs->cs_fdes[mid].fe_lopc <= upc){
+            found = &cs->cs_fdes[mid];
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    if(found && upc < found->fe_hipc)
+        return found;
+
+    return NULL;
+}
+
+static int read32_at(const struct unwsects *us, uint64_t off,
+        uint32_t *out){
+    if(off > us->us_unwindinfosz ||
+            us->us_unwindinfosz - off < sizeof(uint32_t)){
+        return 1;
+    }
+
+    memcpy(out, us->us_unwindinfo + off, sizeof(uint32_t));
+
+    return 0;
+}
+
+static int read16_at(const struct unwsects *us, uint64_t off,
+        uint16_t *out){
+    if(off > us->us_unwindinfosz ||
+            us->us_unwindinfosz - off < sizeof(uint16_t)){
+        return 1;
+    }
+
+    memcpy(out, us->us_unwindinfo + off, sizeof(uint16_t));
+
+    return 0;
+}
+
+/* Finds the __unwind_info entry for upc, which is unslid. Gives back
+ * the function's bounds, also unslid, and its encoding.
+ */
+static int find_compact_entry(const struct unwsects *us, uint64_t upc,
+        uint64_t *lopcout, uint64_t *hipcout, uint32_t *encodingout){
+    if(!us->us_unwindinfo || upc < us->us_textlo ||
+            upc - us->us_textlo > UINT32_MAX){
+        return 1;
+    }
+
+    uint32_t funcoff = (uint32_t)(upc - us->us_textlo);
+    uint32_t version = 0, commonoff = 0, commoncnt = 0;
+    uint32_t indexoff = 0, indexcnt = 0;
+
+    /* unwind_info_section_header */
+    if(read32_at(us, 0, &version) || version != 1 ||
+            read32_at(us, 4, &commonoff) || read32_at(us, 8, &commoncnt) ||
+            read32_at(us, 20, &indexoff) || read32_at(us, 24, &indexcnt) ||
+            indexcnt < 2){
+        return 1;
+    }
+
+    /* unwind_info_section_header_index_entry is 12 bytes, and the
+     * last one only marks where the last page's functions end.
+     */
+    int lo = 0, hi = indexcnt - 2, idx = -1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+        uint32_t midoff = 0;
+
+        if(read32_at(us, indexoff + (12 * mid), &midoff))
+            return 1;
+
+        if(midoff <= funcoff){
+            idx = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    uint32_t pagefuncoff = 0, nextpagefuncoff = 0, pageoff = 0;
+
+    if(idx == -1 ||
+            read32_at(us, indexoff + (12 * idx), &pagefuncoff) ||
+            read32_at(us, indexoff + (12 * idx) + 4, &pageoff) ||
+            read32_at(us, indexoff + (12 * (idx + 1)), &nextpagefuncoff) ||
+            funcoff >= nextpagefuncoff || pageoff == 0){
+        return 1;
+    }
+
+    uint32_t kind = 0;
+    uint16_t entryoff = 0, entrycnt = 0;
+
+    if(read32_at(us, pageoff, &kind) ||
+            read16_at(us, pageoff + 4, &entryoff) ||
+            read16_at(us, pageoff + 6, &entrycnt) || entrycnt == 0){
+        return 1;
+    }
+
+    int isregular = kind == UNWIND_SECOND_LEVEL_REGULAR;
+
+    if(!isregular && kind != UNWIND_SECOND_LEVEL_COMPRESSED)
+        return 1;
+
+    /* Regular entries are a function offset and an encoding. Compressed
+     * ones are an offset from pagefuncoff in the low 24 bits and an
+     * encoding index in the high 8.
+     */
+    int entrysz = isregular ? 8 : 4;
+    lo = 0;
+    hi = entrycnt - 1;
+    int eidx = -1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+        uint32_t e = 0;
+
+        if(read32_at(us, pageoff + entryoff + (entrysz * mid), &e))
+            return 1;
+
+        uint32_t efuncoff = isregular ? e : pagefuncoff + (e & 0xffffff);
+
+        if(efuncoff <= funcoff){
+            eidx = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    if(eidx == -1)
+        return 1;
+
+    uint32_t e = 0, lo_off = 0, hi_off = nextpagefuncoff, encoding = 0;
+
+    if(read32_at(us, pageoff + entryoff + (entrysz * eidx), &e))
+        return 1;
+
+    if(eidx + 1 < entrycnt){
+        uint32_t next = 0;
+
+        if(read32_at(us, pageoff + entryoff + (entrysz * (eidx + 1)), &next))
+            return 1;
+
+        hi_off = isregular ? next : pagefuncoff + (next & 0xffffff);
+    }
+
+    if(isregular){
+        lo_off = e;
+
+        if(read32_at(us, pageoff + entryoff + (entrysz * eidx) + 4,
+                    &encoding)){
+            return 1;
+        }
+    }
+    else{
+        lo_off = pagefuncoff + (e & 0xffffff);
+
+        uint32_t encidx = e >> 24;
+
+        if(encidx < commoncnt){
+            if(read32_at(us, commonoff + (4 * encidx), &encoding))
+                return 1;
+        }
+        else{
+            uint16_t pageencoff = 0;
+
+            if(read16_at(us, pageoff + 8, &pageencoff) ||
+                    read32_at(us, pageoff + pageencoff +
+                        (4 * (encidx - commoncnt)), &encoding)){
+                return 1;
+            }
+        }
+    }
+
+    *lopcout = us->us_textlo + lo_off;
+    *hipcout = us->us_textlo + hi_off;
+    *encodingout = encoding;
+
+    return 0;
+}
+
+/* Compact unwind only describes a function once its prologue is done,
+ * which is all that's needed for every frame but the first. For that
+ * one, the first instruction is covered here, and unw_step checks the
+ * rest of the prologue and the epilogue with frame_record_missing.
+ */
+static struct unwplan *plan_from_compact(uint32_t encoding, uint64_t lopc,
+        uint64_t hipc){
+    uint32_t mode = encoding & UNWIND_ARM64_MODE_MASK;
+
+    if(mode != UNWIND_ARM64_MODE_FRAME && mode != UNWIND_ARM64_MODE_FRAMELESS)
+        return NULL;
+
+    struct unwplan *plan = plan_new(lopc, hipc, 2);
+
+    init_row(&plan->up_rows[0], lopc, UNW_SP, 0);
+
+    struct unwrow *rw = &plan->up_rows[1];
+
+    /* x19-x28 pairs are saved right below whatever's at the top of
+     * the frame, lower numbered pair first.
+     */
+    int32_t savedoff = 0;
+
+    if(mode == UNWIND_ARM64_MODE_FRAME){
+        plan->up_compactframe = 1;
+
+        init_row(rw, lopc + 4, UNW_FP, 16);
+        set_rule(rw, UNW_FP, RULE_OFFSET, -16);
+        set_rule(rw, UNW_LR, RULE_OFFSET, -8);
+
+        savedoff = -24;
+    }
+    else{
+        uint32_t stacksz = 16 * ((encoding &
+                    UNWIND_ARM64_FRAMELESS_STACK_SIZE) >> 12);
+
+        init_row(rw, lopc + 4, UNW_SP, stacksz);
+
+        savedoff = -8;
+    }
+
+    for(int pair=0; pair<5; pair++){
+        if(!(encoding & (UNWIND_ARM64_FRAME_X19_X20_PAIR << pair)))
+            continue;
+
+        set_rule(rw, 19 + (pair * 2), RULE_OFFSET, savedoff);
+        set_rule(rw, 20 + (pair * 2), RULE_OFFSET, savedoff - 8);
+
+        savedoff -= 16;
+    }
+
+    return finish_plan(plan);
+}
+
+static struct unwplan *cached_plan(struct unwinder *uw, uint64_t lopc){
+    void *plan = NULL;
+
+    if(hashtable_get(uw->uw_plans, lopc, &plan) == HASHTABLE_OK)
+        return plan;
+
+    return NULL;
+}
+
+static struct unwplan *cache_plan(struct unwinder *uw,
+        struct unwplan *plan){
+    if(plan)
+        hashtable_insert(uw->uw_plans, plan->up_lopc, plan);
+
+    return plan;
+}
+
+/* pc is slid */
+static struct unwplan *plan_for_image(struct unwinder *uw,
+        struct unwimage *ui, uint64_t pc){
+    uint64_t slide = ui->ui_sects.us_slide;
+    uint64_t upc = pc - slide;
+    uint64_t lopc = 0, hipc = 0;
+    uint32_t encoding = 0;
+    struct unwplan *plan = NULL;
+
+    if(find_compact_entry(&ui->ui_sects, upc, &lopc, &hipc,
+                &encoding) == 0 && encoding != 0){
+        if((plan = cached_plan(uw, lopc + slide)))
+            return plan;
+
+        uint32_t mode = encoding & UNWIND_ARM64_MODE_MASK;
+
+        if(mode == UNWIND_ARM64_MODE_DWARF){
+            plan = plan_from_fde(&ui->ui_ehframe,
+                    encoding & UNWIND_ARM64_DWARF_SECTION_OFFSET, slide);
+        }
+        else
+            plan = plan_from_compact(encoding, lopc + slide, hipc + slide);
+
+        if(plan)
+            return cache_plan(uw, plan);
+    }
+
+    struct cfisect *sects[] = { &ui->ui_ehframe, &ui->ui_debugframe };
+
+    for(size_t i=0; i<sizeof(sects) / sizeof(*sects); i++){
+        struct fdeent *fe = find_fde(sects[i], upc);
+
+        if(!fe)
+            continue;
+
+        if((plan = cached_plan(uw, fe->fe_lopc + slide)))
+            return plan;
+
+        if((plan = plan_from_fde(sects[i], fe->fe_offset, slide)))
+            return cache_plan(uw, plan);
+    }
+
+    return NULL;
+}
+
+static struct unwimage *find_image(struct unwinder *uw, uint64_t pc){
+    int lo = 0, hi = uw->uw_numimages - 1;
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+        struct unwsects *us = &uw->uw_images[mid]->ui_sects;
+
+        if(pc < us->us_textlo + us->us_slide)
+            hi = mid - 1;
+        else if(pc >= us->us_texthi + us->us_slide)
+            lo = mid + 1;
+        else
+            return uw->uw_images[mid];
+    }
+
+    return NULL;
+}
+
+static struct unwplan *find_plan(struct unwinder *uw, uint64_t pc,
+        struct unwctx *ctx){
+    void *plan = NULL;
+
+    if(hashtable_get(uw->uw_pcs, pc, &plan) == HASHTABLE_OK){
+        uw->uw_hits++;
+        return plan;
+    }
+
+    uw->uw_misses++;
+
+    struct unwimage *ui = find_image(uw, pc);
+
+    if(!ui && ctx->uc_findimage &&
+            ctx->uc_findimage(ctx->uc_arg, uw, pc) == 0){
+        ui = find_image(uw, pc);
+    }
+
+    if(ui)
+        plan = plan_for_image(uw, ui, pc);
+
+    if(!plan)
+        plan = fp_plan();
+
+    hashtable_insert(uw->uw_pcs, pc, plan);
+
+    return plan;
+}
+
+static const struct unwrow *find_row(const struct unwplan *plan,
+        uint64_t pc){
+    int lo = 0, hi = plan->up_numrows - 1;
+    const struct unwrow *found = &plan->up_rows[0];
+
+    while(lo <= hi){
+        int mid = lo + ((hi - lo) / 2);
+
+        if(plan->up_rows[mid].rw_lopc <= pc){
+            found = &plan->up_rows[mid];
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    return found;
+}
+
+/* Anything saved more spread out than this is read one at a time */
+enum { MAX_SAVED_SPAN = 512 };
+
+/* How far frame_record_missing looks for the end of a prologue or
+ * the ret of an epilogue, in instructions
+ */
+enum { MAX_PROLOGUE = 16, MAX_EPILOGUE = 8 };
+
+static int64_t imm7(uint32_t insn){
+    return 8 * (int64_t)((int32_t)(insn << 10) >> 25);
+}
+
+static uint64_t imm12(uint32_t insn){
+    uint64_t imm = (insn >> 10) & 0xfff;
+
+    return (insn & (1u << 22)) ? imm << 12 : imm;
+}
+
+/* A compact FRAME plan assumes x29 points to the frame record, but
+ * that's only true between "add x29, sp, #n" in the prologue and
+ * "ldp x29, x30, ..." in the epilogue. Outside of that, in the
+ * innermost frame, fp is still or already the caller's and lr is the
+ * return address. Non-zero if pc is there, with how far above sp the
+ * CFA is in cfaoffout. Anything that doesn't look like a standard
+ * prologue or epilogue is left to the plan.
+ */
+static int frame_record_missing(const struct unwplan *plan, uint64_t pc,
+        struct unwctx *ctx, int64_t *cfaoffout){
+    uint32_t insns[MAX_PROLOGUE];
+    int64_t cfaoff = 0;
+
+    if(pc >= plan->up_lopc && pc - plan->up_lopc < 4 * MAX_PROLOGUE){
+        int n = (pc - plan->up_lopc) / 4;
+
+        if(n > 0 && ctx->uc_readmem(ctx->uc_arg, plan->up_lopc, insns,
+                    n * 4)){
+            return 0;
+        }
+
+        int setup = 0;
+
+        for(int i=0; i<n && !setup; i++){
+            uint32_t insn = insns[i];
+
+            /* add x29, sp, #n: the frame record is set up */
+            if((insn & 0xffc003ff) == 0x910003fd)
+                setup = 1;
+            /* stp xt1, xt2, [sp, #-n]! */
+            else if((insn & 0xffc003e0) == 0xa98003e0)
+                cfaoff -= imm7(insn);
+            /* sub sp, sp, #n */
+            else if((insn & 0xff8003ff) == 0xd10003ff)
+                cfaoff += imm12(insn);
+        }
+
+        if(!setup){
+            *cfaoffout = cfaoff;
+            return 1;
+        }
+
+        /* Short functions can be in their epilogue already */
+        cfaoff = 0;
+    }
+
+    int n = MAX_EPILOGUE;
+
+    if(plan->up_hipc > pc && (plan->up_hipc - pc) / 4 < MAX_EPILOGUE)
+        n = (plan->up_hipc - pc) / 4;
+
+    if(ctx->uc_readmem(ctx->uc_arg, pc, insns, n * 4))
+        return 0;
+
+    for(int i=0; i<n; i++){
+        uint32_t insn = insns[i];
+
+        /* ret, retaa, retab */
+        if(insn == 0xd65f03c0 || insn == 0xd65f0bff || insn == 0xd65f0fff){
+            *cfaoffout = cfaoff;
+            return 1;
+        }
+
+        /* autiasp, autibsp */
+        if(insn == 0xd50323bf || insn == 0xd50323ff)
+            continue;
+
+        /* ldp xt1, xt2, [xn], #n or ldp xt1, xt2, [xn, #n] */
+        uint32_t ldp = insn & 0xffc00000;
+
+        if(ldp == 0xa8c00000 || ldp == 0xa9400000){
+            int rt = insn & 0x1f, rt2 = (insn >> 10) & 0x1f;
+            int rn = (insn >> 5) & 0x1f;
+
+            /* Hasn't been restored yet, fp is still good */
+            if(rt == 29 && rt2 == 30)
+                return 0;
+
+            if(ldp == 0xa8c00000 && rn == 31)
+                cfaoff += imm7(insn);
+
+            continue;
+        }
+
+        /* add sp, sp, #n */
+        if((insn & 0xff8003ff) == 0x910003ff){
+            cfaoff += imm12(insn);
+            continue;
+        }
+
+        return 0;
+    }
+
+    return 0;
+}
+
+/* Replaces regs, which describe a frame, with its caller's. first
+ * says whether this is the innermost frame, where pc is where it
+ * stopped. Everywhere else it's a return address, so it's the
+ * instruction before that that's looked up.
+ */
+int unw_step(struct unwinder *uw, struct unwregs *regs, int first,
+        struct unwctx *ctx){
+    uint64_t pc = regs->ur_pc;
+
+    if(pc == 0)
+        return UNW_END;
+
+    uint64_t lookuppc = first ? pc : pc - 4;
+
+    struct unwplan *plan = find_plan(uw, lookuppc, ctx);
+    const struct unwrow *rw = find_row(plan, lookuppc);
+
+    struct unwrow leaf;
+    int64_t leafoff = 0;
+
+    /* Everything is still where the caller left it, but sp */
+    if(first && plan->up_compactframe &&
+            frame_record_missing(plan, pc, ctx, &leafoff)){
+        init_row(&leaf, pc, UNW_SP, (int32_t)leafoff);
+        finish_row(&leaf);
+
+        rw = &leaf;
+    }
+
+    if(!(regs->ur_valid & (1u << rw->rw_cfareg)))
+        return UNW_BAD_REGISTER;
+
+    uint64_t cfa = regs->ur_regs[rw->rw_cfareg] + rw->rw_cfaoff;
+
+    struct unwregs caller;
+    memcpy(caller.ur_regs, regs->ur_regs, sizeof(caller.ur_regs));
+    caller.ur_valid = regs->ur_valid & rw->rw_samemask;
+
+    /* Everything this frame saved is usually close together, so it's
+     * all read at once.
+     */
+    if(rw->rw_offsetmask){
+        int32_t lo = rw->rw_savedlo;
+        uint64_t span = (uint64_t)(rw->rw_savedhi - lo) + 8;
+        uint8_t saved[MAX_SAVED_SPAN];
+
+        if(span <= MAX_SAVED_SPAN &&
+                ctx->uc_readmem(ctx->uc_arg, cfa + lo, saved, span)){
+            return UNW_BAD_READ;
+        }
+
+        for(uint32_t m=rw->rw_offsetmask; m; m &= m - 1){
+            int r = __builtin_ctz(m);
+            int32_t off = rw->rw_rules[r].rl_off;
+
+            if(span <= MAX_SAVED_SPAN)
+                memcpy(&caller.ur_regs[r], saved + (off - lo), 8);
+            else if(ctx->uc_readmem(ctx->uc_arg, cfa + off,
+                        &caller.ur_regs[r], 8)){
+                return UNW_BAD_READ;
+            }
+
+            caller.ur_valid |= 1u << r;
+        }
+    }
+
+    for(uint32_t m=rw->rw_othermask; m; m &= m - 1){
+        int r = __builtin_ctz(m);
+        const struct unwrule *rl = &rw->rw_rules[r];
+
+        if(rl->rl_how == RULE_VALOFFSET)
+            caller.ur_regs[r] = cfa + rl->rl_off;
+        else if(regs->ur_valid & (1u << rl->rl_off))
+            caller.ur_regs[r] = regs->ur_regs[rl->rl_off];
+        else
+            continue;
+
+        caller.ur_valid |= 1u << r;
+    }
+
+    caller.ur_regs[UNW_SP] = cfa;
+    caller.ur_valid |= 1u << UNW_SP;
+
+    if(!(caller.ur_valid & (1u << UNW_LR)))
+        return UNW_END;
+
+    caller.ur_pc = caller.ur_regs[UNW_LR];
+
+    /* The stack only grows one way. If nothing moved, we'd be
+     * going in circles.
+     */
+    uint64_t sp = regs->ur_regs[UNW_SP];
+    int havesp = regs->ur_valid & (1u << UNW_SP);
+
+    if(caller.ur_pc == 0 || (havesp && (cfa < sp ||
+                    (cfa == sp && caller.ur_pc == pc)))){
+        return UNW_END;
+    }
+
+    *regs = caller;
+
+    return UNW_OK;
+}
+
+static void copy_section(const uint8_t *src, uint64_t size,
+        const uint8_t **dst){
+    *dst = NULL;
+
+    if(!src || size == 0)
+        return;
+
+    uint8_t *copy = malloc(size);
+    memcpy(copy, src, size);
+
+    *dst = copy;
+}
+
+/* The section contents are copied. */
+int unw_add_image(struct unwinder *uw, const struct unwsects *us){
+    if(!uw || !us || us->us_textlo >= us->us_texthi)
+        return 1;
+
+    /* Overlapping images would make find_image ambiguous */
+    if(find_image(uw, us->us_textlo + us->us_slide) ||
+            find_image(uw, us->us_texthi + us->us_slide - 1)){
+        return 1;
+    }
+
+    struct unwimage *ui = calloc(1, sizeof(struct unwimage));
+
+    ui->ui_sects = *us;
+
+    copy_section(us->us_unwindinfo, us->us_unwindinfosz,
+            &ui->ui_sects.us_unwindinfo);
+    copy_section(us->us_ehframe, us->us_ehframesz,
+            &ui->ui_sects.us_ehframe);
+    copy_section(us->us_debugframe, us->us_debugframesz,
+            &ui->ui_sects.us_debugframe);
+
+    if(!ui->ui_sects.us_unwindinfo)
+        ui->ui_sects.us_unwindinfosz = 0;
+
+    ui->ui_ehframe.cs_data = ui->ui_sects.us_ehframe;
+    ui->ui_ehframe.cs_size = ui->ui_sects.us_ehframe ? us->us_ehframesz : 0;
+    ui->ui_ehframe.cs_addr = us->us_ehframeaddr;
+    ui->ui_ehframe.cs_iseh = 1;
+
+    ui->ui_debugframe.cs_data = ui->ui_sects.us_debugframe;
+    ui->ui_debugframe.cs_size =
+        ui->ui_sects.us_debugframe ? us->us_debugframesz : 0;
+
+    uint64_t lo = us->us_textlo + us->us_slide;
+    int idx = uw->uw_numimages;
+
+    while(idx > 0 && uw->uw_images[idx - 1]->ui_sects.us_textlo +
+            uw->uw_images[idx - 1]->ui_sects.us_slide > lo){
+        idx--;
+    }
+
+    uw->uw_images = realloc(uw->uw_images,
+            sizeof(struct unwimage *) * (uw->uw_numimages + 1));
+
+    memmove(&uw->uw_images[idx + 1], &uw->uw_images[idx],
+            sizeof(struct unwimage *) * (uw->uw_numimages - idx));
+
+    uw->uw_images[idx] = ui;
+    uw->uw_numimages++;
+
+    /* Some pcs may have been given the frame pointer plan because
+     * they weren't in any image.
+     */
+    hashtable_destroy(&uw->uw_pcs);
+    uw->uw_pcs = hashtable_new();
+
+    return 0;
+}
+
+/* Throws away every plan, but keeps the images. */
+void unw_flush_plans(struct unwinder *uw){
+    if(!uw)
+        return;
+
+    for(unsigned long i=0; i<uw->uw_plans->capacity; i++){
+        if(uw->uw_plans->entries[i].used)
+            free(uw->uw_plans->entries[i].value);
+    }
+
+    hashtable_destroy(&uw->uw_plans);
+    hashtable_destroy(&uw->uw_pcs);
+
+    uw->uw_plans = hashtable_new();
+    uw->uw_pcs = hashtable_new();
+}
+
+void unw_free(struct unwinder *uw){
+    if(!uw)
+        return;
+
+    unw_flush_plans(uw);
+
+    for(int i=0; i<uw->uw_numimages; i++){
+        struct unwimage *ui = uw->uw_images[i];
+
+        free((void *)ui->ui_sects.us_unwindinfo);
+        free((void *)ui->ui_sects.us_ehframe);
+        free((void *)ui->ui_sects.us_debugframe);
+        free(ui->ui_ehframe.cs_fdes);
+        free(ui->ui_debugframe.cs_fdes);
+        free(ui);
+    }
+
+    free(uw->uw_images);
+    hashtable_destroy(&uw->uw_plans);
+    hashtable_destroy(&uw->uw_pcs);
+    free(uw);
+}
+
+/* How many functions have a plan, and how many pcs were and weren't
+ * already looked up. Any can be NULL.
+ */
+void unw_get_cache_usage(struct unwinder *uw, unsigned long *numplansout,
+        unsigned long *hitsout, unsigned long *missesout){
+    if(numplansout)
+        *numplansout = uw ? uw->uw_plans->len : 0;
+
+    if(hitsout)
+        *hitsout = uw ? uw->uw_hits : 0;
+
+    if(missesout)
+        *missesout = uw ? uw->uw_misses : 0;
+}
+
+/* Images are in address order. The sections still belong to uw. */
+int unw_get_image(struct unwinder *uw, int idx, struct unwsects *out){
+    if(!uw || idx < 0 || idx >= uw->uw_numimages)
+        return 1;
+
+    *out = uw->uw_images[idx]->ui_sects;
+
+    return 0;
+}
+
+struct unwinder *unw_new(void){
+    struct unwinder *uw = calloc(1, sizeof(struct unwinder));
+
+    uw->uw_plans = hashtable_new();
+    uw->uw_pcs = hashtable_new();
+
+    return uw;
+}
+
+/* A snapshot is the registers of the innermost frame, a copy of the
+ * stack, and the unwind info of every image the unwinder knows about,
+ * so unwinding can be tried again somewhere without the debuggee.
+ * Everything is in host byte order.
+ */
+static const char SNAPSHOT_MAGIC[8] = "IDBGUNW1";
+
+struct snapimage {
+    uint64_t si_textlo;
+    uint64_t si_texthi;
+    uint64_t si_slide;
+    uint64_t si_unwindinfosz;
+    uint64_t si_ehframeaddr;
+    uint64_t si_ehframesz;
+    uint64_t si_debugframesz;
+};
+
+int unw_save_snapshot(struct unwinder *uw, const struct unwregs *regs,
+        uint64_t stacklo, const uint8_t *stack, uint64_t stacksz,
+        const char *path){
+    FILE *fp = fopen(path, "wb");
+
+    if(!fp)
+        return 1;
+
+    uint32_t numimages = uw ? uw->uw_numimages : 0;
+
+    fwrite(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC), 1, fp);
+    fwrite(regs, sizeof(*regs), 1, fp);
+    fwrite(&stacklo, sizeof(stacklo), 1, fp);
+    fwrite(&stacksz, sizeof(stacksz), 1, fp);
+    fwrite(stack, 1, stacksz, fp);
+    fwrite(&numimages, sizeof(numimages), 1, fp);
+
+    for(uint32_t i=0; i<numimages; i++){
+        struct unwsects *us = &uw->uw_images[i]->ui_sects;
+        struct snapimage si = {
+            .si_textlo = us->us_textlo,
+            .si_texthi = us->us_texthi,
+            .si_slide = us->us_slide,
+            .si_unwindinfosz = us->us_unwindinfo ? us->us_unwindinfosz : 0,
+            .si_ehframeaddr = us->us_ehframeaddr,
+            .si_ehframesz = us->us_ehframe ? us->us_ehframesz : 0,
+            .si_debugframesz = us->us_debugframe ? us->us_debugframesz : 0
+        };
+
+        fwrite(&si, sizeof(si), 1, fp);
+        fwrite(us->us_unwindinfo, 1, si.si_unwindinfosz, fp);
+        fwrite(us->us_ehframe, 1, si.si_ehframesz, fp);
+        fwrite(us->us_debugframe, 1, si.si_debugframesz, fp);
+    }
+
+    int err = ferror(fp);
+
+    return fclose(fp) || err;
+}
+
+static uint8_t *read_blob(FILE *fp, uint64_t size){
+    if(size == 0)
+        return NULL;
+
+    uint8_t *blob = malloc(size);
+
+    if(!blob || fread(blob, 1, size, fp) != size){
+        free(blob);
+        return NULL;
+    }
+
+    return blob;
+}
+
+/* Gives back a new unwinder with the snapshot's images, along with
+ * its registers and stack. Free the stack when you're done with it.
+ */
+struct unwinder *unw_load_snapshot(const char *path, struct unwregs *regs,
+        uint64_t *stackloout, uint8_t **stackout, uint64_t *stackszout){
+    FILE *fp = fopen(path, "rb");
+
+    if(!fp)
+        return NULL;
+
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    uint64_t stacklo = 0, stacksz = 0;
+    uint32_t numimages = 0;
+
+    if(fread(magic, sizeof(magic), 1, fp) != 1 ||
+            memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) ||
+            fread(regs, sizeof(*regs), 1, fp) != 1 ||
+            fread(&stacklo, sizeof(stacklo), 1, fp) != 1 ||
+            fread(&stacksz, sizeof(stacksz), 1, fp) != 1){
+        fclose(fp);
+        return NULL;
+    }
+
+    uint8_t *stack = read_blob(fp, stacksz);
+
+    if((stacksz && !stack) || fread(&numimages, sizeof(numimages), 1, fp) != 1){
+        free(stack);
+        fclose(fp);
+        return NULL;
+    }
+
+    struct unwinder *uw = unw_new();
+
+    for(uint32_t i=0; i<numimages; i++){
+        struct snapimage si;
+
+        if(fread(&si, sizeof(si), 1, fp) != 1)
+            break;
+
+        uint8_t *unwindinfo = read_blob(fp, si.si_unwindinfosz);
+        uint8_t *ehframe = read_blob(fp, si.si_ehframesz);
+        uint8_t *debugframe = read_blob(fp, si.si_debugframesz);
+
+        struct unwsects us = {
+            .us_textlo = si.si_textlo,
+            .us_texthi = si.si_texthi,
+            .us_slide = si.si_slide,
+            .us_unwindinfo = unwindinfo,
+            .us_unwindinfosz = si.si_unwindinfosz,
+            .us_ehframe = ehframe,
+            .us_ehframeaddr = si.si_ehframeaddr,
+            .us_ehframesz = si.si_ehframesz,
+            .us_debugframe = debugframe,
+            .us_debugframesz = si.si_debugframesz
+        };
+
+        unw_add_image(uw, &us);
+
+        free(unwindinfo);
+        free(ehframe);
+        free(debugframe);
+    }
+
+    fclose(fp);
+
+    *stackloout = stacklo;
+    *stackout = stack;
+    *stackszout = stacksz;
+
+    return uw;
+}
@@ -0,0 +1,76 @@
+#ifndef _UNWIND_H_
+#define _UNWIND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* x0-x30 are 0-30 and sp is 31, the same as their DWARF numbers */
+#define UNW_NUMREGS (32)
+#define UNW_FP (29)
+#define UNW_LR (30)
+#define UNW_SP (31)
+
+struct unwregs {
+    uint64_t ur_pc;
+    uint64_t ur_regs[UNW_NUMREGS];
+
+    /* Bit n is set if ur_regs[n] is known. After a step, only the
+     * registers the callee had to preserve are.
+     */
+    uint32_t ur_valid;
+};
+
+struct unwinder;
+
+struct unwctx {
+    /* Reads len bytes at addr into buf, non-zero if it couldn't */
+    int (*uc_readmem)(void *, uint64_t, void *, size_t);
+
+    /* Called the first time a pc isn't inside any image the unwinder
+     * knows about, to give it a chance to unw_add_image the right one.
+     * Non-zero if there is none. Optional.
+     */
+    int (*uc_findimage)(void *, struct unwinder *, uint64_t);
+
+    void *uc_arg;
+};
+
+/* Where an image's unwind info is. Addresses are unslid, the same as
+ * the ones inside the image. us_textlo is also where the Mach-O
+ * header is, which __unwind_info offsets are from. Any section can
+ * be missing.
+ */
+struct unwsects {
+    uint64_t us_textlo;
+    uint64_t us_texthi;
+    uint64_t us_slide;
+
+    const uint8_t *us_unwindinfo;
+    uint64_t us_unwindinfosz;
+
+    const uint8_t *us_ehframe;
+    uint64_t us_ehframeaddr;
+    uint64_t us_ehframesz;
+
+    const uint8_t *us_debugframe;
+    uint64_t us_debugframesz;
+};
+
+enum {
+    UNW_OK = 0, UNW_END, UNW_BAD_READ, UNW_BAD_REGISTER
+};
+
+int unw_add_image(struct unwinder *, const struct unwsects *);
+void unw_flush_plans(struct unwinder *);
+void unw_free(struct unwinder *);
+void unw_get_cache_usage(struct unwinder *, unsigned long *,
+        unsigned long *, unsigned long *);
+int unw_get_image(struct unwinder *, int, struct unwsects *);
+struct unwinder *unw_load_snapshot(const char *, struct unwregs *,
+        uint64_t *, uint8_t **, uint64_t *);
+struct unwinder *unw_new(void);
+int unw_save_snapshot(struct unwinder *, const struct unwregs *, uint64_t,
+        const uint8_t *, uint64_t, const char *);
+int unw_step(struct unwinder *, struct unwregs *, int, struct unwctx *);
+
+#endif
@@ -0,0 +1,709 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../source/symbol/common.h"
+#include "../source/symbol/compunit.h"
+#include "../source/symbol/die.h"
+#include "../source/symbol/linetable.h"
+#include "../source/symbol/locexpr.h"
+#include "../source/symbol/sym.h"
+#include "../source/symbol/symerr.h"
+
+/* Loads a DWARF file and times random queries against it, the same
+ * ones iosdbg makes: pc to line, line to pc, function by pc, global
+ * name lookups, and evaluating the location of every variable in a
+ * function, one at a time and a whole frame at once, then the members
+ * of every struct or union variable, nested ones included. Compilation
+ * unit by pc is also timed against the linear scan the address range
+ * index replaced. Links everything in source/symbol that doesn't need
+ * a debuggee, so it builds and runs anywhere libdwarf does. An ELF
+ * built with clang -g works as well as a dSYM.
+ *
+ *  usage: symbench [-n queries] [-s seed] [-l loads] [-b workers]
+ *                  [-c megabytes] file
+ *
+ * -l loads the file that many times and reports each, so the second
+ * one shows what the symbol cache saves. After a load whose cache
+ * doesn't have line tables yet, the rest of the cache is written the
+ * way iosdbg's symbol loader thread does it, and that's timed too.
+ * -b builds every DIE tree up front with that many threads, otherwise
+ * the first query to touch a compilation unit pays for its tree and
+ * shows up in the tail. -c caps
+ * how much the DIE trees can take up, like 'symbols cap' does, so the
+ * tail shows what rebuilding evicted trees costs.
+ *
+ * Some batches exist to measure one structure: cu@pc the address range
+ * index, members the per compilation unit DIE offset map, var location
+ * and frame vars the location bytecode. The string pool line shows what
+ * interning names saves.
+ */
+
+struct samples {
+    double *s_times;
+    int s_num;
+    int s_cap;
+    int s_failed;
+};
+
+struct srcline {
+    char *sl_file;
+    uint64_t sl_line;
+};
+
+static uint64_t RNGSTATE = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng(void){
+    /* xorshift64*, reproducible from -s */
+    RNGSTATE ^= RNGSTATE >> 12;
+    RNGSTATE ^= RNGSTATE << 25;
+    RNGSTATE ^= RNGSTATE >> 27;
+
+    return RNGSTATE * 0x2545f4914f6cdd1dULL;
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static long peak_rss_kb(void){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+static void add_sample(struct samples *s, double t){
+    if(s->s_num == s->s_cap){
+        s->s_cap = s->s_cap ? s->s_cap * 2 : 1024;
+        s->s_times = realloc(s->s_times, sizeof(double) * s->s_cap);
+    }
+
+    s->s_times[s->s_num++] = t;
+}
+
+static int dblcmp(const void *a, const void *b){
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+static double percentile(struct samples *s, double p){
+    int idx = (int)(p * (s->s_num - 1) + 0.5);
+
+    return s->s_times[idx];
+}
+
+static void report(const char *what, struct samples *s){
+    if(s->s_num == 0){
+        printf("%-14s no samples\n", what);
+        return;
+    }
+
+    qsort(s->s_times, s->s_num, sizeof(double), dblcmp);
+
+    double total = 0;
+
+    for(int i=0; i<s->s_num; i++)
+        total += s->s_times[i];
+
+    printf("%-14s %7d  mean %9.0f  p50 %9.0f  p90 %9.0f  p99 %9.0f"
+            "  max %10.0f ns", what, s->s_num, total / s->s_num,
+            percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99),
+            s->s_times[s->s_num - 1]);
+
+    if(s->s_failed > 0)
+        printf("  (%d failed)", s->s_failed);
+
+    printf("\n");
+}
+
+/* Stands in for dexpr.c, which reads the focused thread of a real
+ * debuggee. Registers and memory here are made up, but every
+ * expression still runs to the end.
+ */
+static int fake_getreg(void *arg, int rn, uint64_t *valout){
+    if(rn < 0 || rn > 31)
+        return 1;
+
+    *valout = 0x16fdff000ULL + (rn * 0x10);
+
+    return 0;
+}
+
+static int fake_readmem(void *arg, uint64_t addr, void *buf, size_t len){
+    uint8_t *p = buf;
+
+    for(size_t i=0; i<len; i++)
+        p[i] = (uint8_t)((addr + i) ^ 0x5a);
+
+    return 0;
+}
+
+/* How many reads a real debuggee would have been asked for */
+static unsigned long NUM_READS;
+
+int decode_location_description(void *framebase, void *locexpr,
+        uint64_t pc, char **outbuffer, int64_t *resultout){
+    struct locctx ctx = {
+        .lc_getreg = fake_getreg,
+        .lc_readmem = fake_readmem,
+        .lc_arg = NULL
+    };
+
+    int status = loc_evaluate(locexpr, framebase, &ctx, resultout);
+
+    NUM_READS += ctx.lc_numreads;
+
+    return status != LOC_OK;
+}
+
+int decode_frame_variables(void **framebases, void **locexprs,
+        int numvars, char **outbuffer, struct framevar *vars){
+    struct locctx ctx = {
+        .lc_getreg = fake_getreg,
+        .lc_readmem = fake_readmem,
+        .lc_arg = NULL
+    };
+
+    loc_evaluate_frame(locexprs, framebases, numvars, &ctx, vars);
+
+    NUM_READS += ctx.lc_numreads;
+
+    return 0;
+}
+
+/* strext.c wants this for is_number_slow, which nothing here uses */
+long eval_expr(char *expr, char **error){
+    return 0;
+}
+
+/* A pc inside some compilation unit, chosen by how much code each
+ * one has.
+ */
+static uint64_t random_pc(dwarfinfo_t *dwarfinfo, uint64_t totalcode){
+    uint64_t off = rng() % totalcode;
+
+    for(int i=0; i<dwarfinfo->di_numcuaranges; i++){
+        struct cu_arange *ar = &dwarfinfo->di_cuaranges[i];
+        uint64_t len = ar->ar_hipc - ar->ar_lopc;
+
+        if(off < len)
+            return ar->ar_lopc + off;
+
+        off -= len;
+    }
+
+    return dwarfinfo->di_cuaranges[0].ar_lopc;
+}
+
+/* pc to line only finds a pc that starts a line table row, so a random
+ * pc almost never resolves. Instead, pcs are drawn from where each
+ * source line starts in the line tables. Every line table is decoded
+ * here, so pc->line measures the lookup and not the decode.
+ */
+static uint64_t *line_table_pcs(dwarfinfo_t *dwarfinfo, int *numout){
+    uint64_t *pcs = NULL;
+    int num = 0, cap = 0;
+
+    for(int i=0; i<dwarfinfo->di_numcompunits; i++){
+        void *rootdie = NULL, *lt = NULL;
+
+        cu_get_root_die_no_tree(dwarfinfo->di_cus[i], &rootdie, NULL);
+
+        if(die_get_linetable(cu_get_dwarf_debug(dwarfinfo), rootdie, &lt,
+                    NULL)){
+            continue;
+        }
+
+        int numsrclines = lt_get_num_src_lines(lt);
+
+        for(int j=0; j<numsrclines; j++){
+            const char *file = NULL;
+            const uint64_t *linepcs = NULL;
+            uint64_t lineno = 0;
+            int numlinepcs = 0;
+
+            lt_get_src_line(lt, j, &file, &lineno, &linepcs, &numlinepcs);
+
+            for(int k=0; k<numlinepcs; k++){
+                if(num == cap){
+                    cap = cap ? cap * 2 : 1024;
+                    pcs = realloc(pcs, sizeof(uint64_t) * cap);
+                }
+
+                pcs[num++] = linepcs[k];
+            }
+        }
+    }
+
+    *numout = num;
+
+    return pcs;
+}
+
+/* What cu_find_compilation_unit_by_pc did before it had an address
+ * range index: check every compilation unit's root DIE low and high PC.
+ */
+static void *linear_cu_by_pc(dwarfinfo_t *dwarfinfo, uint64_t pc){
+    for(int i=0; i<dwarfinfo->di_numcompunits; i++){
+        void *rootdie = NULL;
+        uint64_t lpc = 0, hpc = 0;
+
+        cu_get_root_die_no_tree(dwarfinfo->di_cus[i], &rootdie, NULL);
+        sym_get_die_low_pc(rootdie, &lpc, NULL);
+        sym_get_die_high_pc(rootdie, &hpc, NULL);
+
+        if(pc >= lpc && pc < hpc)
+            return dwarfinfo->di_cus[i];
+    }
+
+    return NULL;
+}
+
+/* Deep enough for anything real, shallow enough to stop on a struct
+ * that somehow contains itself.
+ */
+#define MAX_MEMBER_DEPTH (16)
+
+/* Gets the members of a struct or union DIE, then of every member that
+ * is itself a struct or union, the way printing a variable does. Each
+ * member's type is found through its compilation unit's offset map.
+ * Pointers aren't followed.
+ */
+static void time_members(void *die, void *cu, int depth,
+        struct samples *s, int *maxdepth){
+    if(depth > MAX_MEMBER_DEPTH)
+        return;
+
+    void **members = NULL;
+    int nummembers = 0;
+
+    double t0 = now();
+    int failed = sym_get_die_members(die, cu, &members, &nummembers, NULL);
+    double t = now() - t0;
+
+    add_sample(s, t);
+
+    if(failed){
+        s->s_failed++;
+        return;
+    }
+
+    if(depth > *maxdepth)
+        *maxdepth = depth;
+
+    for(int i=0; i<nummembers; i++){
+        int isptr = 0, isstruct = 0, isunion = 0;
+
+        sym_get_die_represents_pointer(members[i], &isptr, NULL);
+        sym_get_die_represents_struct(members[i], &isstruct, NULL);
+        sym_get_die_represents_union(members[i], &isunion, NULL);
+
+        if(!isptr && (isstruct || isunion))
+            time_members(members[i], cu, depth + 1, s, maxdepth);
+    }
+
+    free(members);
+}
+
+static dwarfinfo_t *load(const char *file, int loads){
+    dwarfinfo_t *dwarfinfo = NULL;
+
+    for(int i=0; i<loads; i++){
+        if(dwarfinfo)
+            sym_end((void **)&dwarfinfo);
+
+        sym_error_t e = {0};
+        double t0 = now();
+
+        if(sym_init_with_dwarf_file(file, (void **)&dwarfinfo, &e)){
+            fprintf(stderr, "couldn't load '%s': %s\n", file,
+                    sym_strerror(e));
+            return NULL;
+        }
+
+        double t = now() - t0;
+
+        printf("load #%d: %.2f ms (%s), peak RSS %ld KB\n", i + 1, t / 1e6,
+                dwarfinfo->di_symcache ? "from symbol cache" : "no cache",
+                peak_rss_kb());
+
+        if(!dwarfinfo->di_symcachecomplete){
+            t0 = now();
+            sym_complete_symbol_cache(dwarfinfo, NULL);
+
+            printf("  finishing the symbol cache: %.2f ms\n",
+                    (now() - t0) / 1e6);
+        }
+    }
+
+    return dwarfinfo;
+}
+
+static int usage(const char *argv0){
+    fprintf(stderr, "usage: %s [-n queries] [-s seed] [-l loads]"
+            " [-b workers] [-c megabytes] file\n", argv0);
+
+    return 1;
+}
+
+int main(int argc, char **argv){
+    int queries = 10000, loads = 1, workers = 0;
+    uint64_t cap = 0;
+    const char *file = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:s:l:b:c:")) != -1){
+        switch(opt){
+            case 'n': queries = atoi(optarg); break;
+            case 's': RNGSTATE = strtoull(optarg, NULL, 0) | 1; break;
+            case 'l': loads = atoi(optarg); break;
+            case 'b': workers = atoi(optarg); break;
+            case 'c': cap = strtoull(optarg, NULL, 0) << 20; break;
+            default: return usage(argv[0]);
+        }
+    }
+
+    if(optind != argc - 1)
+        return usage(argv[0]);
+
+    file = argv[optind];
+
+    if(queries < 1)
+        queries = 1;
+
+    if(loads < 1)
+        loads = 1;
+
+    dwarfinfo_t *dwarfinfo = load(file, loads);
+
+    if(!dwarfinfo)
+        return 1;
+
+    uint64_t totalcode = 0;
+
+    for(int i=0; i<dwarfinfo->di_numcuaranges; i++){
+        totalcode += dwarfinfo->di_cuaranges[i].ar_hipc -
+            dwarfinfo->di_cuaranges[i].ar_lopc;
+    }
+
+    printf("%d compilation units, %d address ranges, %#llx bytes of code\n",
+            dwarfinfo->di_numcompunits, dwarfinfo->di_numcuaranges,
+            (unsigned long long)totalcode);
+
+    if(totalcode == 0){
+        fprintf(stderr, "no code to look anything up in\n");
+        return 1;
+    }
+
+    if(cap > 0){
+        sym_set_die_tree_cap(dwarfinfo, cap, NULL);
+
+        printf("DIE trees capped at %llu MB\n",
+                (unsigned long long)(cap >> 20));
+    }
+
+    if(workers > 0){
+        double t0 = now();
+        sym_build_all_die_trees(dwarfinfo, workers, NULL);
+
+        printf("built every DIE tree with %d workers in %.2f ms,"
+                " peak RSS %ld KB\n", workers, (now() - t0) / 1e6,
+                peak_rss_kb());
+    }
+
+    struct samples pctoline = {0}, linetopc = {0}, fxnbypc = {0},
+                   byname = {0}, varloc = {0}, framevars = {0},
+                   cuindexed = {0}, culinear = {0}, members = {0};
+
+    struct srcline *lines = calloc(queries, sizeof(struct srcline));
+    char **names = calloc(queries, sizeof(char *));
+    int numlines = 0, numnames = 0;
+
+    /* Compilation unit by pc, indexed and linear, on the same pcs. The
+     * linear scan only sees a root DIE's low and high PC, so it misses
+     * compilation units described by DW_AT_ranges.
+     */
+    int cudisagree = 0;
+
+    for(int i=0; i<queries; i++){
+        uint64_t pc = random_pc(dwarfinfo, totalcode);
+        void *cu = NULL;
+
+        double t0 = now();
+        int failed = cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc, NULL);
+        double t = now() - t0;
+
+        add_sample(&cuindexed, t);
+
+        if(failed)
+            cuindexed.s_failed++;
+
+        t0 = now();
+        void *linearcu = linear_cu_by_pc(dwarfinfo, pc);
+        t = now() - t0;
+
+        add_sample(&culinear, t);
+
+        if(!linearcu)
+            culinear.s_failed++;
+
+        if(linearcu != cu)
+            cudisagree++;
+    }
+
+    double t0 = now();
+    int numltpcs = 0;
+    uint64_t *ltpcs = line_table_pcs(dwarfinfo, &numltpcs);
+
+    printf("decoded every line table in %.2f ms, %d line starts\n",
+            (now() - t0) / 1e6, numltpcs);
+
+    /* pc to line. The lines found here are what line to pc looks up. */
+    for(int i=0; i<queries && numltpcs > 0; i++){
+        uint64_t pc = ltpcs[rng() % numltpcs], line = 0;
+        char *srcfile = NULL, *srcfxn = NULL;
+        void *cudie = NULL;
+
+        double t0 = now();
+        int failed = sym_get_line_info_from_pc(dwarfinfo, pc, &srcfile,
+                &srcfxn, &line, &cudie, NULL);
+        double t = now() - t0;
+
+        add_sample(&pctoline, t);
+
+        if(failed || !srcfile){
+            pctoline.s_failed++;
+            continue;
+        }
+
+        lines[numlines].sl_file = strdup(srcfile);
+        lines[numlines].sl_line = line;
+        numlines++;
+    }
+
+    for(int i=0; i<numlines; i++){
+        struct srcline *sl = &lines[rng() % numlines];
+        uint64_t line = sl->sl_line, pc = 0;
+        char *outbuffer = NULL;
+
+        double t0 = now();
+        int failed = sym_lineno_to_pc_a(dwarfinfo, sl->sl_file, &line, &pc,
+                &outbuffer, NULL);
+        double t = now() - t0;
+
+        add_sample(&linetopc, t);
+
+        if(failed)
+            linetopc.s_failed++;
+
+        free(outbuffer);
+    }
+
+    /* Function by pc. The functions found here are what name lookups
+     * look for.
+     */
+    for(int i=0; i<queries; i++){
+        uint64_t pc = random_pc(dwarfinfo, totalcode);
+        void *cu = NULL, *fxndie = NULL;
+
+        double t0 = now();
+        int failed = cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc,
+                NULL) || sym_find_function_die_by_pc(cu, pc, &fxndie, NULL);
+        double t = now() - t0;
+
+        add_sample(&fxnbypc, t);
+
+        if(failed || !fxndie){
+            fxnbypc.s_failed++;
+            continue;
+        }
+
+        char *name = NULL;
+        sym_get_die_name(fxndie, &name, NULL);
+
+        if(name)
+            names[numnames++] = strdup(name);
+    }
+
+    for(int i=0; i<numnames; i++){
+        const char *name = names[rng() % numnames];
+        void *die = NULL, *cu = NULL;
+
+        double t0 = now();
+        int failed = sym_find_global_die_by_name(dwarfinfo, name, &die, &cu,
+                NULL);
+        double t = now() - t0;
+
+        add_sample(&byname, t);
+
+        if(failed)
+            byname.s_failed++;
+    }
+
+    /* Every variable visible at a pc, one evaluation each, then all of
+     * them at once along with their values. Only the second reads
+     * values, so its read count is the one a real frame would see.
+     */
+    int numvarpcs = 0, numstructvars = 0, maxdepth = 0;
+    unsigned long numframevars = 0, numframereads = 0;
+
+    for(int i=0; i<queries; i++){
+        uint64_t pc = random_pc(dwarfinfo, totalcode);
+        void **vars = NULL;
+        int numvars = 0;
+
+        if(sym_get_variable_dies(dwarfinfo, pc, &vars, &numvars, NULL)){
+            free(vars);
+            continue;
+        }
+
+        numvarpcs++;
+
+        for(int j=0; j<numvars; j++){
+            char *outbuffer = NULL;
+            int64_t result = 0;
+
+            double t0 = now();
+            int failed = sym_evaluate_die_location_description(vars[j], pc,
+                    &outbuffer, &result, NULL);
+            double t = now() - t0;
+
+            add_sample(&varloc, t);
+
+            if(failed)
+                varloc.s_failed++;
+
+            free(outbuffer);
+        }
+
+        struct framevar *fvs = NULL;
+        char *outbuffer = NULL;
+
+        NUM_READS = 0;
+
+        double t0 = now();
+        int failed = sym_evaluate_frame_variables(vars, numvars, pc,
+                &outbuffer, &fvs, NULL);
+        double t = now() - t0;
+
+        add_sample(&framevars, t);
+
+        if(failed)
+            framevars.s_failed++;
+
+        numframevars += numvars;
+        numframereads += NUM_READS;
+
+        free(outbuffer);
+        free(fvs);
+
+        void *cu = NULL;
+
+        if(cu_find_compilation_unit_by_pc(dwarfinfo, &cu, pc, NULL)){
+            free(vars);
+            continue;
+        }
+
+        for(int j=0; j<numvars; j++){
+            int isptr = 0, isstruct = 0, isunion = 0;
+
+            sym_get_die_represents_pointer(vars[j], &isptr, NULL);
+            sym_get_die_represents_struct(vars[j], &isstruct, NULL);
+            sym_get_die_represents_union(vars[j], &isunion, NULL);
+
+            if(isptr || !(isstruct || isunion))
+                continue;
+
+            numstructvars++;
+            time_members(vars[j], cu, 1, &members, &maxdepth);
+        }
+
+        free(vars);
+    }
+
+    report("cu@pc index", &cuindexed);
+    report("cu@pc linear", &culinear);
+
+    if(cudisagree > 0){
+        printf("the linear scan disagreed with the index on %d of %d pcs\n",
+                cudisagree, queries);
+    }
+
+    report("pc->line", &pctoline);
+    report("line->pc", &linetopc);
+    report("function@pc", &fxnbypc);
+    report("name", &byname);
+    report("var location", &varloc);
+
+    report("frame vars", &framevars);
+
+    printf("%d of %d pcs had variables", numvarpcs, queries);
+
+    if(numvarpcs > 0){
+        printf(", %.1f per frame, read in %.1f reads",
+                (double)numframevars / numvarpcs,
+                (double)numframereads / numvarpcs);
+    }
+
+    printf("\n");
+
+    report("members", &members);
+
+    if(numstructvars > 0){
+        printf("%d struct or union variables, nested %d deep at most\n",
+                numstructvars, maxdepth);
+    }
+
+    uint64_t numstrs = 0, strbytes = 0, strsaved = 0;
+    uint64_t numtypes = 0, typebytes = 0, typehits = 0;
+
+    sym_get_string_pool_usage(dwarfinfo, &numstrs, &strbytes, &strsaved,
+            NULL);
+    sym_get_type_cache_usage(dwarfinfo, &numtypes, &typebytes, &typehits,
+            NULL);
+
+    printf("string pool: %llu strings, %llu bytes, %llu bytes saved\n",
+            (unsigned long long)numstrs, (unsigned long long)strbytes,
+            (unsigned long long)strsaved);
+    printf("type cache: %llu types, %llu bytes, %llu hits\n",
+            (unsigned long long)numtypes, (unsigned long long)typebytes,
+            (unsigned long long)typehits);
+    printf("DIE trees: %llu bytes\n",
+            (unsigned long long)dwarfinfo->di_dietreebytes);
+    printf("peak RSS %ld KB\n", peak_rss_kb());
+
+    for(int i=0; i<numlines; i++)
+        free(lines[i].sl_file);
+
+    for(int i=0; i<numnames; i++)
+        free(names[i]);
+
+    free(lines);
+    free(ltpcs);
+    free(names);
+    free(cuindexed.s_times);
+    free(culinear.s_times);
+    free(pctoline.s_times);
+    free(linetopc.s_times);
+    free(fxnbypc.s_times);
+    free(byname.s_times);
+    free(varloc.s_times);
+    free(framevars.s_times);
+    free(members.s_times);
+
+    sym_end((void **)&dwarfinfo);
+
+    return 0;
+}
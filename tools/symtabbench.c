@@ -0,0 +1,358 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/array.h"
+#include "../source/linkedlist.h"
+#include "../source/symbol/dbgsymbol.h"
+#include "../source/symbol/symtable.h"
+
+/* Makes up a process with a shared cache's worth of images and times
+ * finding the symbol for random addresses in it, the way iosdbg did
+ * before the global symbol table, and with it. Both have to agree on
+ * every address. Also shows how much memory symbols took when each one
+ * was its own malloc'd struct sym, and how much they take now.
+ *
+ *  usage: symtabbench [-i images] [-y symbols per image] [-n queries]
+ *      [-s seed]
+ */
+
+static uint64_t RNGSTATE = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng(void){
+    /* xorshift64*, reproducible from -s */
+    RNGSTATE ^= RNGSTATE >> 12;
+    RNGSTATE ^= RNGSTATE << 25;
+    RNGSTATE ^= RNGSTATE >> 27;
+
+    return RNGSTATE * 0x2545f4914f6cdd1dULL;
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+/* How symbols used to be kept: one malloc'd struct sym each, in a
+ * struct array of pointers per image.
+ */
+struct oldsym {
+    unsigned long sym_func_start;
+    char *dsc_symname;
+    int unnamed_sym_num;
+    unsigned int sym_func_len;
+};
+
+struct oldimage {
+    unsigned long load_addr;
+    struct array *syms;
+    /* The dbg_sym_entry with the same symbols */
+    struct dbg_sym_entry *entry;
+};
+
+/* Images are laid out one after the other with a little room between
+ * them, like the shared cache, but put in the list in a random order,
+ * like dyld's image list. Every image is made twice, once each way.
+ */
+static struct linkedlist *make_images(int numimages, int symsperimage,
+        struct linkedlist *oldimages, unsigned long *loout,
+        unsigned long *hiout){
+    struct dbg_sym_entry **entries = malloc(numimages *
+            sizeof(struct dbg_sym_entry *));
+    struct oldimage **olds = malloc(numimages * sizeof(struct oldimage *));
+    unsigned long addr = 0x180000000UL;
+
+    *loout = addr;
+
+    for(int i=0; i<numimages; i++){
+        struct dbg_sym_entry *entry = calloc(1, sizeof(struct dbg_sym_entry));
+        struct oldimage *old = calloc(1, sizeof(struct oldimage));
+
+        entry->load_addr = old->load_addr = addr;
+        entry->from_dsc = 1;
+
+        old->syms = array_new();
+        old->entry = entry;
+
+        unsigned int numsyms = 1 + (rng() % (2 * symsperimage));
+
+        entry->numsyms = entry->symcapacity = numsyms;
+        entry->sym_starts = malloc(numsyms * sizeof(uint32_t));
+        entry->sym_lens = malloc(numsyms * sizeof(uint32_t));
+        entry->sym_names = malloc(numsyms * sizeof(uint32_t));
+
+        for(unsigned int j=0; j<numsyms; j++){
+            struct oldsym *sym = calloc(1, sizeof(struct oldsym));
+            unsigned int len = 4 * (4 + (rng() % 512));
+
+            sym->sym_func_start = addr;
+            sym->sym_func_len = len;
+            sym->unnamed_sym_num = j;
+
+            array_insert(old->syms, sym);
+
+            entry->sym_starts[j] = addr - entry->load_addr;
+            entry->sym_lens[j] = len;
+            entry->sym_names[j] = SYM_UNNAMED | j;
+
+            addr += len;
+        }
+
+        entries[i] = entry;
+        olds[i] = old;
+        addr += 0x1000 + ((rng() % 16) * 0x1000);
+    }
+
+    *hiout = addr;
+
+    for(int i=numimages-1; i>0; i--){
+        int j = rng() % (i + 1);
+        struct dbg_sym_entry *t = entries[i];
+        struct oldimage *ot = olds[i];
+
+        entries[i] = entries[j];
+        entries[j] = t;
+        olds[i] = olds[j];
+        olds[j] = ot;
+    }
+
+    struct linkedlist *symbols = linkedlist_new();
+
+    for(int i=0; i<numimages; i++){
+        linkedlist_add(symbols, entries[i]);
+        linkedlist_add(oldimages, olds[i]);
+    }
+
+    free(entries);
+    free(olds);
+
+    return symbols;
+}
+
+/* A malloc'd 24 byte struct sym takes up a 32 byte block */
+static size_t old_memory_usage(struct linkedlist *oldimages){
+    size_t bytes = 0;
+
+    for(struct node *current = oldimages->front;
+            current;
+            current = current->next){
+        struct oldimage *old = current->data;
+
+        bytes += sizeof(struct array) +
+            (old->syms->capacity * sizeof(void *)) + (old->syms->len * 32);
+    }
+
+    return bytes;
+}
+
+static size_t new_memory_usage(struct linkedlist *symbols){
+    size_t bytes = 0;
+
+    for(struct node *current = symbols->front;
+            current;
+            current = current->next){
+        struct dbg_sym_entry *entry = current->data;
+
+        bytes += entry->symcapacity * 3 * sizeof(uint32_t);
+    }
+
+    return bytes;
+}
+
+/* What get_symbol_info_from_address did before symtable.c: binary
+ * search every image, collect the best symbol of each, sort those, and
+ * binary search again.
+ */
+struct goodcombo {
+    struct oldimage *image;
+    struct oldsym *sym;
+    int idx;
+};
+
+enum { SYM = 0, GC };
+
+static unsigned long start_of(struct array *a, int idx, int which){
+    if(which == GC)
+        return ((struct goodcombo *)a->items[idx])->sym->sym_func_start;
+
+    return ((struct oldsym *)a->items[idx])->sym_func_start;
+}
+
+static int bsearch_lc(struct array *a, unsigned long vmaddr, int lo, int hi,
+        int which){
+    if(lo == hi)
+        return start_of(a, lo, which) > vmaddr ? -1 : lo;
+
+    if((hi - 1) == lo){
+        if(vmaddr >= start_of(a, hi, which))
+            return hi;
+        else if(vmaddr >= start_of(a, lo, which))
+            return lo;
+
+        return -1;
+    }
+
+    int mid = (lo + hi) / 2;
+
+    if(vmaddr < start_of(a, mid, which))
+        return bsearch_lc(a, vmaddr, lo, mid - 1, which);
+
+    return bsearch_lc(a, vmaddr, mid, hi, which);
+}
+
+static int goodcombocmp(const void *a, const void *b){
+    struct goodcombo *gca = *(struct goodcombo **)a;
+    struct goodcombo *gcb = *(struct goodcombo **)b;
+
+    unsigned long sa = gca->sym->sym_func_start;
+    unsigned long sb = gcb->sym->sym_func_start;
+
+    return (sa > sb) - (sa < sb);
+}
+
+static int old_lookup(struct linkedlist *oldimages, unsigned long vmaddr,
+        struct dbg_sym_entry **entryout, unsigned int *symout){
+    struct array *good_combos = array_new();
+
+    for(struct node *current = oldimages->front;
+            current;
+            current = current->next){
+        struct oldimage *old = current->data;
+
+        if(old->syms->len == 0 || vmaddr < old->load_addr)
+            continue;
+
+        int best = old->syms->len == 1 ? 0 :
+            bsearch_lc(old->syms, vmaddr, 0, old->syms->len - 1, SYM);
+
+        if(best != -1){
+            struct goodcombo *gc = malloc(sizeof(struct goodcombo));
+            gc->image = old;
+            gc->sym = old->syms->items[best];
+            gc->idx = best;
+
+            array_insert(good_combos, gc);
+        }
+    }
+
+    int found = good_combos->len > 0;
+
+    if(found){
+        array_qsort(good_combos, goodcombocmp);
+
+        int best = bsearch_lc(good_combos, vmaddr, 0,
+                good_combos->len - 1, GC);
+        struct goodcombo *gc = good_combos->items[best];
+
+        *entryout = gc->image->entry;
+        *symout = gc->idx;
+    }
+
+    for(unsigned long i=0; i<good_combos->len; i++)
+        free(good_combos->items[i]);
+
+    array_destroy(&good_combos);
+
+    return !found;
+}
+
+int main(int argc, char **argv){
+    int numimages = 1000, symsperimage = 1500, queries = 20000;
+
+    for(int i=1; i<argc; i++){
+        if(i + 1 >= argc){
+            fprintf(stderr, "usage: %s [-i images] [-y symbols per image]"
+                    " [-n queries] [-s seed]\n", argv[0]);
+            return 1;
+        }
+
+        if(strcmp(argv[i], "-i") == 0)
+            numimages = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-y") == 0)
+            symsperimage = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-n") == 0)
+            queries = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0)
+            RNGSTATE ^= strtoull(argv[++i], NULL, 0);
+    }
+
+    if(numimages < 1)
+        numimages = 1;
+
+    if(symsperimage < 1)
+        symsperimage = 1;
+
+    if(queries < 1)
+        queries = 1;
+
+    unsigned long lo = 0, hi = 0;
+    struct linkedlist *oldimages = linkedlist_new();
+    struct linkedlist *symbols = make_images(numimages, symsperimage,
+            oldimages, &lo, &hi);
+
+    double t0 = now();
+    struct symtable *st = symtable_build(symbols);
+    double buildtime = now() - t0;
+
+    unsigned long numsyms = 0;
+    size_t bytes = 0;
+    symtable_get_usage(st, &numsyms, &bytes);
+
+    printf("%d images, %lu symbols, table built in %.2f ms, %zu KB\n",
+            numimages, numsyms, buildtime / 1e6, bytes / 1024);
+    printf("symbols as struct sym %8zu KB\n",
+            old_memory_usage(oldimages) / 1024);
+    printf("symbols packed        %8zu KB\n",
+            new_memory_usage(symbols) / 1024);
+
+    unsigned long *addrs = malloc(queries * sizeof(unsigned long));
+
+    for(int i=0; i<queries; i++)
+        addrs[i] = lo + (rng() % (hi - lo));
+
+    struct dbg_sym_entry **oldentries = calloc(queries,
+            sizeof(struct dbg_sym_entry *));
+    struct dbg_sym_entry **newentries = calloc(queries,
+            sizeof(struct dbg_sym_entry *));
+    unsigned int *oldsyms = calloc(queries, sizeof(unsigned int));
+    unsigned int *newsyms = calloc(queries, sizeof(unsigned int));
+
+    t0 = now();
+
+    for(int i=0; i<queries; i++)
+        old_lookup(oldimages, addrs[i], &oldentries[i], &oldsyms[i]);
+
+    double oldtime = now() - t0;
+
+    t0 = now();
+
+    for(int i=0; i<queries; i++)
+        symtable_lookup(st, addrs[i], &newentries[i], &newsyms[i]);
+
+    double newtime = now() - t0;
+
+    int mismatches = 0;
+
+    for(int i=0; i<queries; i++){
+        if(oldentries[i] != newentries[i] || oldsyms[i] != newsyms[i])
+            mismatches++;
+    }
+
+    printf("per image   %10.0f ns/lookup\n", oldtime / queries);
+    printf("symtable    %10.0f ns/lookup  (%.0fx)\n", newtime / queries,
+            newtime > 0 ? oldtime / newtime : 0);
+    printf("%d of %d lookups disagree\n", mismatches, queries);
+
+    free(oldentries);
+    free(newentries);
+    free(oldsyms);
+    free(newsyms);
+    free(addrs);
+    symtable_free(st);
+
+    return mismatches != 0;
+}
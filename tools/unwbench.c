@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/symbol/unwind.h"
+
+/* Replays a stack snapshot saved with 'backtrace --save' and times
+ * unwinding it, first with nothing cached, then with every plan the
+ * first unwind made already there. Builds and runs anywhere, the
+ * snapshot has everything the unwinder needs.
+ *
+ *  usage: unwbench snapshot [iterations] [-v]
+ */
+
+struct snapstack {
+    uint64_t ss_lo;
+    uint8_t *ss_data;
+    uint64_t ss_size;
+};
+
+enum { MAX_FRAMES = 8192, MAX_COLD_RUNS = 200 };
+
+static int read_snapshot_stack(void *arg, uint64_t addr, void *buf,
+        size_t len){
+    struct snapstack *ss = arg;
+
+    if(addr < ss->ss_lo || addr - ss->ss_lo > ss->ss_size ||
+            ss->ss_size - (addr - ss->ss_lo) < len){
+        return 1;
+    }
+
+    memcpy(buf, ss->ss_data + (addr - ss->ss_lo), len);
+
+    return 0;
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static int unwind_once(struct unwinder *uw, const struct unwregs *start,
+        struct unwctx *ctx, uint64_t *pcs, int *statusout){
+    struct unwregs regs = *start;
+    int numpcs = 0;
+    int status = UNW_OK;
+
+    while(status == UNW_OK && numpcs < MAX_FRAMES){
+        pcs[numpcs++] = regs.ur_pc;
+        status = unw_step(uw, &regs, numpcs == 1, ctx);
+    }
+
+    if(statusout)
+        *statusout = status;
+
+    return numpcs;
+}
+
+static int dblcmp(const void *a, const void *b){
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+static void report(const char *what, double *times, int n, int numframes){
+    qsort(times, n, sizeof(double), dblcmp);
+
+    double median = times[n / 2];
+
+    printf("%-6s %6d runs  median %10.0f ns/unwind  %8.1f ns/frame  "
+            "min %10.0f ns\n", what, n, median, median / numframes,
+            times[0]);
+}
+
+static const char *status_name(int status){
+    switch(status){
+        case UNW_OK: return "frame limit";
+        case UNW_END: return "outermost frame";
+        case UNW_BAD_READ: return "memory outside the snapshot";
+        case UNW_BAD_REGISTER: return "unknown register";
+        default: return "?";
+    }
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        fprintf(stderr, "usage: %s snapshot [iterations] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = 10000, verbose = 0;
+
+    for(int i=2; i<argc; i++){
+        if(strcmp(argv[i], "-v") == 0)
+            verbose = 1;
+        else
+            iterations = atoi(argv[i]);
+    }
+
+    if(iterations < 1)
+        iterations = 1;
+
+    struct unwregs start;
+    struct snapstack ss;
+
+    struct unwinder *uw = unw_load_snapshot(argv[1], &start, &ss.ss_lo,
+            &ss.ss_data, &ss.ss_size);
+
+    if(!uw){
+        fprintf(stderr, "couldn't load snapshot '%s'\n", argv[1]);
+        return 1;
+    }
+
+    int numimages = 0;
+    struct unwsects us;
+
+    while(unw_get_image(uw, numimages, &us) == 0)
+        numimages++;
+
+    struct unwctx ctx = {
+        .uc_readmem = read_snapshot_stack,
+        .uc_findimage = NULL,
+        .uc_arg = &ss
+    };
+
+    uint64_t *pcs = malloc(sizeof(uint64_t) * MAX_FRAMES);
+    int status = 0;
+    int numframes = unwind_once(uw, &start, &ctx, pcs, &status);
+
+    printf("%d frames, stopped at the %s\n", numframes,
+            status_name(status));
+    printf("%d images, %#llx bytes of stack\n", numimages,
+            (unsigned long long)ss.ss_size);
+
+    if(verbose){
+        for(int i=0; i<numframes; i++)
+            printf("  frame #%d: %#llx\n", i, (unsigned long long)pcs[i]);
+    }
+
+    /* Cold: every plan is thrown away first, so each unwind decodes
+     * __unwind_info and CFI all over again.
+     */
+    int coldruns = iterations < MAX_COLD_RUNS ? iterations : MAX_COLD_RUNS;
+    double *cold = malloc(sizeof(double) * coldruns);
+
+    for(int i=0; i<coldruns; i++){
+        unw_flush_plans(uw);
+
+        double t0 = now();
+        unwind_once(uw, &start, &ctx, pcs, NULL);
+        cold[i] = now() - t0;
+    }
+
+    double *warm = malloc(sizeof(double) * iterations);
+
+    for(int i=0; i<iterations; i++){
+        double t0 = now();
+        unwind_once(uw, &start, &ctx, pcs, NULL);
+        warm[i] = now() - t0;
+    }
+
+    report("cold", cold, coldruns, numframes);
+    report("warm", warm, iterations, numframes);
+
+    unsigned long numplans = 0, hits = 0, misses = 0;
+    unw_get_cache_usage(uw, &numplans, &hits, &misses);
+
+    printf("%lu plans cached, %lu pc lookups hit, %lu missed\n",
+            numplans, hits, misses);
+
+    free(cold);
+    free(warm);
+    free(pcs);
+    free(ss.ss_data);
+    unw_free(uw);
+
+    return 0;
+}